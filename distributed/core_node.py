@@ -123,6 +123,11 @@ def main():
     parser.add_argument("--protocol", default="mqtt", help="Protocol to use")
     parser.add_argument("--duration", default=300, type=int)
     parser.add_argument("--enable-elk", action="store_true", help="Enable ELK monitoring")
+    parser.add_argument("--srtp-nodes", default=1, type=int,
+                        help="SRTP: local server nodes behind the steering router")
+    parser.add_argument("--srtp-cluster", default="",
+                        help="SRTP: comma-separated ip:sensor_port[:client_port] of remote "
+                             "nodes (started with distributed/srtp_cluster.py node)")
     
     args = parser.parse_args()
     
@@ -137,6 +142,10 @@ def main():
         "role": "core",
         "enable_elk": args.enable_elk
     }
+    if args.protocol == "srtp":
+        config["shards"] = args.srtp_nodes
+        if args.srtp_cluster:
+            config["cluster_nodes"] = args.srtp_cluster.split(",")
     
     config_file = Path("core_node_config.json")
     config_file.write_text(json.dumps(config, indent=2))
@@ -146,6 +155,8 @@ def main():
     print(f"   Sensor Port: {args.sensor_port}")
     print(f"   Protocol: {args.protocol}")
     print(f"   Mode: SERVER ONLY (no local clients)")
+    if args.protocol == "srtp" and (args.srtp_cluster or args.srtp_nodes > 1):
+        print(f"   SRTP Nodes: {args.srtp_cluster or args.srtp_nodes} (consistent-hash partitioned)")
     
     # Launch main test with generated config
     subprocess.run([sys.executable, "-m", "stgen.main", str(config_file)])
@@ -0,0 +1,293 @@
+#!/usr/bin/env python3
+"""
+SRTP Cluster Runner
+Runs SRTP server nodes for the three-tier deployment and measures how
+subscribe-all scales as nodes are added.
+
+Sensors are partitioned across nodes on a consistent-hash ring; the
+srtp_shard_router on the core proxies list/subscribe to the owning nodes
+(see protocols/SRTP/srtp_shard_router.c).
+
+Usage:
+  # on each server machine (sensors auto-register on first update)
+  python srtp_cluster.py node --bind-ip 0.0.0.0 --sensor-port 6000
+
+  # on the core, fronting the nodes on the public SRTP ports
+  python core_node.py --protocol srtp --sensor-port 5004 \
+                      --srtp-cluster 10.0.0.2:6000,10.0.0.3:6000
+
+  # on one machine, loopback nodes on different ports
+  python srtp_cluster.py bench --nodes 1,2,4 --sensors 512
+"""
+
+import argparse
+import json
+import random
+import signal
+import socket
+import statistics
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+from pathlib import Path
+from typing import Callable, List
+
+# Add parent directory to path to find protocols and stgen modules
+sys.path.insert(0, str(Path(__file__).parent.parent))
+
+SRTP_DIR = Path(__file__).parent.parent / "protocols" / "SRTP"
+
+# PRTP client-port message types (prtp_msg.h)
+LIST, LIST_RESPONSE, SUBSCRIBE, SUBSCRIBE_ACK, UPDATE, UNSUBSCRIBE = 0, 1, 2, 3, 4, 8
+
+# STGen_Server stops acking subscribes of about 1 KB
+SUBSCRIBE_MAX_BYTES = 700
+
+
+# ---------- minimal PRTP (BSON dialect) encoding ----------
+
+def _doc(body: bytes) -> bytes:
+    return struct.pack("<i", len(body) + 5) + body + b"\x00"
+
+
+def _str(key: str, value: str) -> bytes:
+    # PRTP strings: the length excludes the trailing NUL
+    v = value.encode()
+    return b"\x02" + key.encode() + b"\x00" + struct.pack("<i", len(v)) + v + b"\x00"
+
+
+def _header(msg_type: int, seq_no: int) -> bytes:
+    return (b"\x10type\x00" + struct.pack("<i", msg_type)
+            + b"".join(b"\x08" + k + b"\x00\x00"
+                       for k in (b"end_marker", b"reliable", b"fragmented", b"utilize_timestamp"))
+            + b"\x10seq_no\x00" + struct.pack("<i", seq_no))
+
+
+def _subscribe(msg_type: int, seq_no: int, sids: List[str], reliable: bool) -> bytes:
+    flag = b"\x08reliable\x00" + (b"\x01" if reliable else b"\x00")
+    items = b"".join(b"\x03\x00" + _doc(_str("sid", sid) + flag) for sid in sids)
+    return _doc(_header(msg_type, seq_no) + b"\x04sids\x00" + _doc(items))
+
+
+def _subscribe_chunks(sids: List[str]) -> List[List[str]]:
+    """Split sids so each subscribe stays under SUBSCRIBE_MAX_BYTES."""
+    chunks, size = [[]], 95                  # header and array framing
+    for sid in sids:
+        if chunks[-1] and size + 28 + len(sid) > SUBSCRIBE_MAX_BYTES:
+            chunks.append([])
+            size = 95
+        chunks[-1].append(sid)
+        size += 28 + len(sid)
+    return chunks
+
+
+def _list_sids(reply: bytes) -> List[str]:
+    """Sensor ids of a list response (array of strings with empty keys)."""
+    out, i = [], reply.find(b"\x04sids\x00")
+    if i < 0:
+        return out
+    i += 10                                  # key + array length
+    while i < len(reply) and reply[i] == 0x02:
+        n = struct.unpack_from("<i", reply, i + 2)[0]
+        out.append(reply[i + 6:i + 6 + n].decode())
+        i += 6 + n + 1
+    return out
+
+
+def _msg_type(reply: bytes) -> int:
+    return struct.unpack_from("<i", reply, 10)[0] if len(reply) >= 14 else -1
+
+
+def _update_sid(reply: bytes) -> str:
+    """Sensor id carried in an update's data document ('' if none)."""
+    i = reply.find(b"\x02sid\x00")
+    if i < 0:
+        return ""
+    n = struct.unpack_from("<i", reply, i + 5)[0]
+    return reply[i + 9:i + 9 + n].decode(errors="replace")
+
+
+def _recv_type(sock: socket.socket, msg_type: int) -> bytes:
+    """Receive until a message of msg_type arrives (updates may interleave)."""
+    while True:
+        reply = sock.recv(65535)
+        if _msg_type(reply) == msg_type:
+            return reply
+
+
+def subscribe_all(server_ip: str, client_port: int, publish: Callable[[str], None],
+                  timeout: float = 2.0) -> dict:
+    """
+    One subscribe-all round, as STGen_Client -a does it: list, subscribe to
+    everything (in chunks small enough to be acked), then publish one
+    reading per sensor and wait for the subscribed ones to arrive.
+
+    STGen_Server stops acking a client's subscriptions after a couple of
+    dozen sensors; subscribing ends at the first unacked chunk and only the
+    acked sensors are expected back.
+
+    Raises socket.timeout if the list request goes unanswered.
+    """
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.settimeout(timeout)
+    addr = (server_ip, client_port)
+    subscribed: List[str] = []
+    try:
+        t0 = time.perf_counter()
+        sock.sendto(_doc(_header(LIST, random.randrange(1 << 16))), addr)
+        sids = _list_sids(_recv_type(sock, LIST_RESPONSE))
+        t1 = time.perf_counter()
+        try:
+            for chunk in _subscribe_chunks(sids):
+                sock.sendto(_subscribe(SUBSCRIBE, random.randrange(1 << 16), chunk, False), addr)
+                _recv_type(sock, SUBSCRIBE_ACK)
+                subscribed += chunk
+        except socket.timeout:
+            pass
+        t2 = time.perf_counter()
+
+        for sid in sids:
+            publish(sid)
+        pending, deadline = set(subscribed), t2 + timeout
+        try:
+            while pending and time.perf_counter() < deadline:
+                reply = sock.recv(65535)
+                if _msg_type(reply) == UPDATE:
+                    pending.discard(_update_sid(reply))
+        except socket.timeout:
+            pass
+        t3 = time.perf_counter()
+        for chunk in _subscribe_chunks(subscribed):
+            sock.sendto(_subscribe(UNSUBSCRIBE, random.randrange(1 << 16), chunk, False), addr)
+    finally:
+        sock.close()
+    return {
+        "sensors": len(sids),
+        "subscribed": len(subscribed),
+        "delivered": len(subscribed) - len(pending),
+        "list_ms": (t1 - t0) * 1e3,
+        "subscribe_ms": (t2 - t1) * 1e3,
+        "delivery_ms": (t3 - t2) * 1e3,
+    }
+
+
+# ---------- roles ----------
+
+def run_node(args) -> None:
+    """Run one SRTP server node; sensors register on their first update."""
+    sensor_list = Path(tempfile.mkdtemp(prefix="srtp_node_")) / "sensor.list"
+    sensor_list.write_text("")
+    cmd = [
+        str(SRTP_DIR / "STGen_Server"),
+        f"-i{args.bind_ip}",
+        f"-p{args.sensor_port}",
+        f"-s{args.client_port or args.sensor_port + 1}",
+        f"-l{sensor_list}",
+        f"-c{SRTP_DIR / 'conf' / 'test.conf'}",
+    ]
+    print(f"🎯 Starting SRTP cluster node")
+    print(f"   Sensor Port: {args.sensor_port}")
+    print(f"   Client Port: {args.client_port or args.sensor_port + 1}")
+    proc = subprocess.Popen(cmd, stdout=subprocess.DEVNULL, cwd=str(sensor_list.parent))
+    try:
+        proc.wait(timeout=args.duration)
+    except (subprocess.TimeoutExpired, KeyboardInterrupt):
+        proc.send_signal(signal.SIGINT)
+        proc.wait(timeout=2)
+
+
+def run_bench(args) -> None:
+    """
+    Subscribe-all latency for growing loopback clusters.
+
+    A single STGen_Server stops answering list requests once the response
+    outgrows its ~1.5 KB message buffer (about 100 sensor ids), so rounds
+    whose list goes unanswered are counted rather than treated as fatal.
+    A client holding more than about 32 subscriptions on one server stops
+    receiving updates altogether, which is what spreading sensors over more
+    nodes buys back.  The server also does not recover cleanly from an
+    unsubscribe, so every round runs against a freshly started cluster.
+    """
+    from protocols.SRTP import Protocol
+
+    results = []
+    for n in [int(x) for x in args.nodes.split(",")]:
+        rounds, failed, router = [], 0, {}
+        for r in range(args.rounds):
+            proto = Protocol({
+                "server_ip": "127.0.0.1",
+                "server_port": args.sensor_port,
+                "client_port": args.sensor_port + 1,
+                "num_clients": args.sensors,
+                "shards": n,
+                "shard_base_port": args.base_port,
+            })
+            proto.start_server()
+            publish = lambda sid: proto.send_data(
+                "bench", {"dev_id": sid, "seq_no": 1, "sensor_data": {"value": 21.0}}
+            )
+            try:
+                rounds.append(subscribe_all("127.0.0.1", args.sensor_port + 1, publish))
+            except socket.timeout:
+                failed += 1
+            finally:
+                proto.stop()
+                router = proto.get_metrics().get("shard_router", router)
+
+        def p50(key):
+            return round(statistics.median(x[key] for x in rounds), 3) if rounds else None
+
+        results.append({
+            "nodes": n,
+            "sensors": args.sensors,
+            "rounds_ok": len(rounds),
+            "rounds_failed": failed,
+            "listed_p50": p50("sensors"),
+            "subscribed_p50": p50("subscribed"),
+            "delivered_p50": p50("delivered"),
+            "list_ms_p50": p50("list_ms"),
+            "subscribe_ms_p50": p50("subscribe_ms"),
+            "delivery_ms_p50": p50("delivery_ms"),
+            "router": router,
+        })
+        print(f"📊 {n} node(s): {len(rounds)}/{args.rounds} rounds answered, "
+              f"{results[-1]['subscribed_p50']}/{args.sensors} subscribed, "
+              f"{results[-1]['delivered_p50']} delivered, "
+              f"list {results[-1]['list_ms_p50']} ms, delivery {results[-1]['delivery_ms_p50']} ms")
+
+    if args.output:
+        Path(args.output).write_text(json.dumps(results, indent=2))
+        print(f"✓ Results written to {args.output}")
+    else:
+        print(json.dumps(results, indent=2))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="SRTP cluster node / scaling benchmark")
+    sub = parser.add_subparsers(dest="role", required=True)
+
+    node = sub.add_parser("node", help="Run one server node")
+    node.add_argument("--bind-ip", default="0.0.0.0", help="IP to bind to")
+    node.add_argument("--sensor-port", default=6000, type=int)
+    node.add_argument("--client-port", default=0, type=int, help="Default: sensor port + 1")
+    node.add_argument("--duration", default=3600, type=int)
+
+    bench = sub.add_parser("bench", help="Measure subscribe-all against 1..N loopback nodes")
+    bench.add_argument("--nodes", default="1,2,4", help="Comma-separated cluster sizes")
+    bench.add_argument("--sensors", default=256, type=int)
+    bench.add_argument("--rounds", default=20, type=int)
+    bench.add_argument("--sensor-port", default=5004, type=int, help="Public sensor port")
+    bench.add_argument("--base-port", default=6000, type=int, help="First node's sensor port")
+    bench.add_argument("--output", default="", help="Write JSON results here")
+
+    args = parser.parse_args()
+    if args.role == "node":
+        run_node(args)
+    else:
+        run_bench(args)
+
+
+if __name__ == "__main__":
+    main()
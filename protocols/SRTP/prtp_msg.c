@@ -0,0 +1,510 @@
+#include <string.h>
+#include <stdlib.h>
+#include "prtp_msg.h"
+
+/* ---------- decoding ---------- */
+
+static int32_t rd_i32(const uint8_t *p)
+{
+    return (int32_t)((uint32_t)p[0] | (uint32_t)p[1] << 8 |
+                     (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+}
+
+static double rd_f64(const uint8_t *p)
+{
+    uint64_t u = 0;
+    double d;
+
+    for (int i = 7; i >= 0; i--)
+        u = u << 8 | p[i];
+    memcpy(&d, &u, sizeof(d));
+    return d;
+}
+
+/* Size of an element value of the given BSON type, or -1 if unknown/truncated. */
+static long value_size(uint8_t type, const uint8_t *v, const uint8_t *end)
+{
+    long avail = end - v;
+
+    switch (type) {
+    case 0x01: case 0x09: case 0x11: case 0x12: return avail >= 8 ? 8 : -1;
+    case 0x10: return avail >= 4 ? 4 : -1;
+    case 0x08: return avail >= 1 ? 1 : -1;
+    case 0x0A: return 0;
+    case 0x02:
+        /* PRTP strings: length excludes the trailing NUL that follows */
+        if (avail < 4) return -1;
+        return (rd_i32(v) >= 0 && rd_i32(v) <= avail - 5) ? 4 + rd_i32(v) + 1 : -1;
+    case 0x03: case 0x04:
+        if (avail < 5) return -1;
+        return (rd_i32(v) >= 5 && rd_i32(v) <= avail) ? rd_i32(v) : -1;
+    case 0x05:
+        if (avail < 5) return -1;
+        return (rd_i32(v) >= 0 && rd_i32(v) <= avail - 5) ? 5 + rd_i32(v) : -1;
+    default:
+        return -1;
+    }
+}
+
+typedef struct {
+    const uint8_t *p, *end;
+    uint8_t type;
+    const char *key;
+    const uint8_t *val;
+    long vlen;
+} bson_iter_t;
+
+static int iter_init(bson_iter_t *it, const uint8_t *doc, size_t len)
+{
+    if (len < 5 || rd_i32(doc) < 5 || (size_t)rd_i32(doc) > len)
+        return -1;
+    it->p = doc + 4;
+    it->end = doc + rd_i32(doc) - 1;
+    return 0;
+}
+
+static int iter_next(bson_iter_t *it)
+{
+    const uint8_t *k;
+
+    if (it->p >= it->end || *it->p == 0)
+        return 0;
+    it->type = *it->p++;
+    k = memchr(it->p, 0, it->end - it->p);
+    if (!k)
+        return -1;
+    it->key = (const char *)it->p;
+    it->val = k + 1;
+    it->vlen = value_size(it->type, it->val, it->end);
+    if (it->vlen < 0)
+        return -1;
+    it->p = it->val + it->vlen;
+    return 1;
+}
+
+static void copy_string(char *dst, const bson_iter_t *it)
+{
+    size_t n = (size_t)rd_i32(it->val);
+    if (n >= PRTP_SID_MAX)
+        n = PRTP_SID_MAX - 1;
+    memcpy(dst, it->val + 4, n);
+    dst[n] = '\0';
+}
+
+static int parse_sid_doc(const uint8_t *doc, size_t len, prtp_sid_t *s)
+{
+    bson_iter_t it;
+    int rc;
+
+    memset(s, 0, sizeof(*s));
+    if (iter_init(&it, doc, len) < 0)
+        return -1;
+    while ((rc = iter_next(&it)) > 0) {
+        if (it.type == 0x02 && strcmp(it.key, "sid") == 0)
+            copy_string(s->sid, &it);
+        else if (it.type == 0x08 && strcmp(it.key, "reliable") == 0)
+            s->reliable = it.val[0] != 0;
+        else if (it.type == 0x10 && strcmp(it.key, "status") == 0)
+            s->status = rd_i32(it.val);
+        else if (it.type == 0x10 && strcmp(it.key, "cum") == 0)
+            s->cum = (uint32_t)rd_i32(it.val);
+        else if (it.type == 0x10 && strcmp(it.key, "bits") == 0)
+            s->bits = (uint32_t)rd_i32(it.val);
+        else if (it.type == 0x10 && strcmp(it.key, "min_interval_ms") == 0)
+            s->opts.min_interval_ms = (uint32_t)rd_i32(it.val);
+        else if (it.type == 0x01 && strcmp(it.key, "deadband") == 0)
+            s->opts.deadband = rd_f64(it.val);
+        else if (it.type == 0x08 && strcmp(it.key, "latest") == 0)
+            s->opts.latest = it.val[0] != 0;
+        else if (it.type == 0x08 && strcmp(it.key, "multicast") == 0)
+            s->opts.multicast = it.val[0] != 0;
+        else if (it.type == 0x08 && strcmp(it.key, "compress") == 0)
+            s->opts.compress = it.val[0] != 0;
+        else if (it.type == 0x10 && strcmp(it.key, "group_addr") == 0)
+            s->group_addr = (uint32_t)rd_i32(it.val);
+        else if (it.type == 0x10 && strcmp(it.key, "group_port") == 0)
+            s->group_port = (uint16_t)rd_i32(it.val);
+    }
+    return rc;
+}
+
+int prtp_parse(const uint8_t *buf, size_t len, prtp_msg_t *m)
+{
+    prtp_sid_t *sids = m->sids;
+    bson_iter_t it;
+    int rc;
+
+    memset(m, 0, sizeof(*m));
+    m->sids = sids;
+    m->type = -1;
+    if (iter_init(&it, buf, len) < 0)
+        return -1;
+
+    while ((rc = iter_next(&it)) > 0) {
+        const char *k = it.key;
+
+        if (it.type == 0x10) {
+            uint32_t v = (uint32_t)rd_i32(it.val);
+            if (strcmp(k, "type") == 0) m->type = (int32_t)v;
+            else if (strcmp(k, "seq_no") == 0) m->seq_no = v;
+            else if (strcmp(k, "timestamp") == 0) { m->timestamp = v; m->has_timestamp = true; }
+            else if (strcmp(k, "frag_no") == 0) m->frag_no = v;
+            else if (strcmp(k, "frag_total") == 0) m->frag_total = v;
+        } else if (it.type == 0x08) {
+            bool v = it.val[0] != 0;
+            if (strcmp(k, "end_marker") == 0) m->end_marker = v;
+            else if (strcmp(k, "reliable") == 0) m->reliable = v;
+            else if (strcmp(k, "fragmented") == 0) m->fragmented = v;
+            else if (strcmp(k, "utilize_timestamp") == 0) m->utilize_timestamp = v;
+        } else if (it.type == 0x02 && strcmp(k, "sid") == 0) {
+            copy_string(m->sid, &it);
+        } else if (it.type == 0x03 && strcmp(k, "data") == 0) {
+            bson_iter_t d;
+            m->data = it.val;
+            m->data_len = (uint32_t)it.vlen;
+            if (iter_init(&d, it.val, it.vlen) == 0) {
+                while (iter_next(&d) > 0) {
+                    if (d.type == 0x02 && strcmp(d.key, "sid") == 0) {
+                        copy_string(m->sid, &d);
+                    } else if (d.type == 0x05) {
+                        m->blob = d.val + 5;            /* past length and subtype */
+                        m->blob_len = (uint32_t)rd_i32(d.val);
+                    }
+                }
+            }
+        } else if (it.type == 0x04 && strcmp(k, "sids") == 0 && m->sids) {
+            bson_iter_t a;
+            if (iter_init(&a, it.val, it.vlen) < 0)
+                return -1;
+            while (iter_next(&a) > 0 && m->nsids < PRTP_MAX_SIDS) {
+                prtp_sid_t *s = &m->sids[m->nsids];
+                if (a.type == 0x02) {
+                    memset(s, 0, sizeof(*s));
+                    copy_string(s->sid, &a);
+                    m->nsids++;
+                } else if (a.type == 0x03 && parse_sid_doc(a.val, a.vlen, s) == 0) {
+                    m->nsids++;
+                }
+            }
+        }
+    }
+    return (rc < 0 || m->type < 0) ? -1 : 0;
+}
+
+int prtp_patch_header(uint8_t *buf, size_t len, uint32_t seq_no, bool reliable)
+{
+    bson_iter_t it;
+    int found = 0;
+
+    if (iter_init(&it, buf, len) < 0)
+        return -1;
+    while (iter_next(&it) > 0) {
+        uint8_t *v = buf + (it.val - buf);
+        if (it.type == 0x10 && strcmp(it.key, "seq_no") == 0) {
+            v[0] = seq_no & 0xff;
+            v[1] = (seq_no >> 8) & 0xff;
+            v[2] = (seq_no >> 16) & 0xff;
+            v[3] = (seq_no >> 24) & 0xff;
+            found |= 1;
+        } else if (it.type == 0x08 && strcmp(it.key, "reliable") == 0) {
+            v[0] = reliable;
+            found |= 2;
+        }
+    }
+    return found == 3 ? 0 : -1;
+}
+
+int prtp_header_offsets(const uint8_t *buf, size_t len, size_t *seq_off, size_t *ts_off)
+{
+    bson_iter_t it;
+
+    *seq_off = *ts_off = 0;
+    if (iter_init(&it, buf, len) < 0)
+        return -1;
+    while (iter_next(&it) > 0) {
+        if (it.type == 0x10 && strcmp(it.key, "seq_no") == 0)
+            *seq_off = (size_t)(it.val - buf);
+        else if (it.type == 0x10 && strcmp(it.key, "timestamp") == 0)
+            *ts_off = (size_t)(it.val - buf);
+    }
+    return *seq_off ? 0 : -1;
+}
+
+/* ---------- encoding ---------- */
+
+typedef struct {
+    uint8_t *buf;
+    size_t cap, len;
+    bool overflow;
+} bson_writer_t;
+
+static void put(bson_writer_t *w, const void *src, size_t n)
+{
+    if (w->overflow || w->len + n > w->cap) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, src, n);
+    w->len += n;
+}
+
+static void put_i32_at(bson_writer_t *w, size_t at, int32_t v)
+{
+    uint8_t b[4] = { v & 0xff, (v >> 8) & 0xff, (v >> 16) & 0xff, (v >> 24) & 0xff };
+    if (!w->overflow)
+        memcpy(w->buf + at, b, 4);
+}
+
+static void put_i32(bson_writer_t *w, int32_t v)
+{
+    size_t at = w->len;
+    put(w, "\0\0\0\0", 4);
+    put_i32_at(w, at, v);
+}
+
+static void put_key(bson_writer_t *w, uint8_t type, const char *key)
+{
+    put(w, &type, 1);
+    put(w, key, strlen(key) + 1);
+}
+
+static size_t begin_doc(bson_writer_t *w)
+{
+    size_t at = w->len;
+    put(w, "\0\0\0\0", 4);
+    return at;
+}
+
+static void end_doc(bson_writer_t *w, size_t at)
+{
+    put(w, "\0", 1);
+    put_i32_at(w, at, (int32_t)(w->len - at));
+}
+
+static void w_int(bson_writer_t *w, const char *key, int32_t v)
+{
+    put_key(w, 0x10, key);
+    put_i32(w, v);
+}
+
+static void w_bool(bson_writer_t *w, const char *key, bool v)
+{
+    uint8_t b = v ? 1 : 0;
+    put_key(w, 0x08, key);
+    put(w, &b, 1);
+}
+
+static void w_double(bson_writer_t *w, const char *key, double v)
+{
+    uint64_t u;
+    uint8_t b[8];
+
+    memcpy(&u, &v, sizeof(u));
+    for (int i = 0; i < 8; i++)
+        b[i] = (uint8_t)(u >> (8 * i));
+    put_key(w, 0x01, key);
+    put(w, b, sizeof(b));
+}
+
+static void w_string(bson_writer_t *w, const char *key, const char *s)
+{
+    size_t n = strlen(s);
+    put_key(w, 0x02, key);
+    put_i32(w, (int32_t)n);
+    put(w, s, n + 1);
+}
+
+static size_t header(bson_writer_t *w, int32_t type, uint32_t seq_no)
+{
+    size_t doc = begin_doc(w);
+    w_int(w, "type", type);
+    w_bool(w, "end_marker", false);
+    w_bool(w, "reliable", false);
+    w_bool(w, "fragmented", false);
+    w_bool(w, "utilize_timestamp", false);
+    w_int(w, "seq_no", (int32_t)seq_no);
+    return doc;
+}
+
+static size_t finish(bson_writer_t *w, size_t doc)
+{
+    end_doc(w, doc);
+    return w->overflow ? 0 : w->len;
+}
+
+size_t prtp_build_simple(uint8_t *buf, size_t cap, int32_t type, uint32_t seq_no)
+{
+    bson_writer_t w = { buf, cap, 0, false };
+    return finish(&w, header(&w, type, seq_no));
+}
+
+size_t prtp_build_ack(uint8_t *buf, size_t cap, int32_t type, uint32_t seq_no, const char *sid)
+{
+    bson_writer_t w = { buf, cap, 0, false };
+    size_t doc = header(&w, type, seq_no);
+    w_string(&w, "sid", sid);
+    return finish(&w, doc);
+}
+
+enum { DOC_SUBSCRIBE, DOC_RELIABLE, DOC_STATUS, DOC_SACK };
+
+/* Arrays of per-sensor documents carrying the reliable flag and any
+ * options set (subscribe), the reliable flag (unsubscribe), the status
+ * code and any multicast group (subscribe ack) or the cumulative seq_no
+ * and bitmap (sack). */
+static size_t build_sid_docs(uint8_t *buf, size_t cap, int32_t type, uint32_t seq_no,
+                             const prtp_sid_t *sids, int nsids, int fields)
+{
+    bson_writer_t w = { buf, cap, 0, false };
+    size_t doc = header(&w, type, seq_no), arr;
+
+    put_key(&w, 0x04, "sids");
+    arr = begin_doc(&w);
+    for (int i = 0; i < nsids; i++) {
+        size_t el;
+        put_key(&w, 0x03, "");
+        el = begin_doc(&w);
+        w_string(&w, "sid", sids[i].sid);
+        if (fields == DOC_STATUS) {
+            w_int(&w, "status", sids[i].status);
+            if (sids[i].group_port) {
+                w_int(&w, "group_addr", (int32_t)sids[i].group_addr);
+                w_int(&w, "group_port", sids[i].group_port);
+            }
+        } else if (fields == DOC_SACK) {
+            w_int(&w, "cum", (int32_t)sids[i].cum);
+            w_int(&w, "bits", (int32_t)sids[i].bits);
+        } else {
+            w_bool(&w, "reliable", sids[i].reliable);
+        }
+        if (fields == DOC_SUBSCRIBE) {
+            const prtp_sub_opts_t *o = &sids[i].opts;
+            if (o->min_interval_ms)
+                w_int(&w, "min_interval_ms", (int32_t)o->min_interval_ms);
+            if (o->deadband > 0)
+                w_double(&w, "deadband", o->deadband);
+            if (o->latest)
+                w_bool(&w, "latest", true);
+            if (o->multicast)
+                w_bool(&w, "multicast", true);
+            if (o->compress)
+                w_bool(&w, "compress", true);
+        }
+        end_doc(&w, el);
+    }
+    end_doc(&w, arr);
+    return finish(&w, doc);
+}
+
+size_t prtp_build_subscribe(uint8_t *buf, size_t cap, uint32_t seq_no,
+                            const prtp_sid_t *sids, int nsids)
+{
+    return build_sid_docs(buf, cap, PRTP_SUBSCRIBE, seq_no, sids, nsids, DOC_SUBSCRIBE);
+}
+
+size_t prtp_build_unsubscribe(uint8_t *buf, size_t cap, uint32_t seq_no,
+                              const prtp_sid_t *sids, int nsids)
+{
+    return build_sid_docs(buf, cap, PRTP_UNSUBSCRIBE, seq_no, sids, nsids, DOC_RELIABLE);
+}
+
+size_t prtp_build_sack(uint8_t *buf, size_t cap, uint32_t seq_no,
+                       const prtp_sid_t *sids, int nsids)
+{
+    return build_sid_docs(buf, cap, PRTP_SACK, seq_no, sids, nsids, DOC_SACK);
+}
+
+/* 95 bytes of header and array framing, 28 + strlen per sensor document
+ * plus 21 / 18 / 9 / 12 / 11 for the options set */
+static size_t sid_doc_bytes(const prtp_sid_t *s)
+{
+    return 28 + strlen(s->sid) + (s->opts.min_interval_ms ? 21 : 0) +
+           (s->opts.deadband > 0 ? 18 : 0) + (s->opts.latest ? 9 : 0) +
+           (s->opts.multicast ? 12 : 0) + (s->opts.compress ? 11 : 0);
+}
+
+int prtp_subscribe_fit(const prtp_sid_t *sids, int nsids)
+{
+    size_t bytes = 95;
+    int c = 0;
+
+    while (c < nsids && (c == 0 || bytes + sid_doc_bytes(&sids[c]) <= PRTP_SUBSCRIBE_MAX_BYTES))
+        bytes += sid_doc_bytes(&sids[c++]);
+    return c;
+}
+
+size_t prtp_build_subscribe_ack(uint8_t *buf, size_t cap, uint32_t seq_no,
+                                const prtp_sid_t *sids, int nsids)
+{
+    return build_sid_docs(buf, cap, PRTP_SUBSCRIBE_ACK, seq_no, sids, nsids, DOC_STATUS);
+}
+
+size_t prtp_build_list_response(uint8_t *buf, size_t cap, uint32_t seq_no,
+                                const prtp_sid_t *sids, int nsids)
+{
+    bson_writer_t w = { buf, cap, 0, false };
+    size_t doc = header(&w, PRTP_LIST_RESPONSE, seq_no), arr;
+
+    put_key(&w, 0x04, "sids");
+    arr = begin_doc(&w);
+    for (int i = 0; i < nsids; i++)
+        w_string(&w, "", sids[i].sid);
+    end_doc(&w, arr);
+    return finish(&w, doc);
+}
+
+size_t prtp_build_stats(uint8_t *buf, size_t cap, uint32_t seq_no, const char *json)
+{
+    bson_writer_t w = { buf, cap, 0, false };
+    size_t doc = header(&w, PRTP_STATS, seq_no);
+    w_string(&w, "stats", json);
+    return finish(&w, doc);
+}
+
+uint32_t prtp_ntp_middle(const struct timespec *ts)
+{
+    uint32_t sec = (uint32_t)((uint64_t)ts->tv_sec + PRTP_NTP_UNIX_OFFSET);
+    uint32_t frac = (uint32_t)(((uint64_t)ts->tv_nsec << 16) / 1000000000u);
+
+    return sec << 16 | frac;
+}
+
+/* STGen_Server parses temperatures with "%d.%d C" into data.temp1 /
+ * data.temp2 (written with two decimals, so hundredths) and device
+ * states into the boolean data.dev. */
+int prtp_update_value(const prtp_msg_t *m, double *value)
+{
+    int type = prtp_sensor_type(m->sid), got = 0;
+    int32_t whole = 0, frac = 0;
+    bson_iter_t it;
+
+    if (!m->data || iter_init(&it, m->data, m->data_len) < 0)
+        return -1;
+    while (iter_next(&it) > 0) {
+        if (type == PRTP_SENSOR_TEMP && it.type == 0x10 && strcmp(it.key, "temp1") == 0) {
+            whole = rd_i32(it.val);
+            got |= 1;
+        } else if (type == PRTP_SENSOR_TEMP && it.type == 0x10 && strcmp(it.key, "temp2") == 0) {
+            frac = rd_i32(it.val);
+            got |= 2;
+        } else if (type == PRTP_SENSOR_DEVICE && it.type == 0x08 && strcmp(it.key, "dev") == 0) {
+            *value = it.val[0] ? 1.0 : 0.0;
+            return 0;
+        }
+    }
+    if (got != 3)
+        return -1;
+    *value = whole + (whole < 0 ? -frac : frac) / 100.0;
+    return 0;
+}
+
+int prtp_sensor_type(const char *sid)
+{
+    static const char *names[] = { NULL, "temp", "device", "gps", "camera" };
+    size_t n = strcspn(sid, "_");
+
+    for (int t = PRTP_SENSOR_TEMP; t <= PRTP_SENSOR_CAMERA; t++)
+        if (strlen(names[t]) == n && strncmp(sid, names[t], n) == 0)
+            return t;
+    return PRTP_SENSOR_UNKNOWN;
+}
@@ -0,0 +1,182 @@
+/*
+ * prtp_msg - minimal codec for the PRTP client-port messages.
+ *
+ * Mirrors the BSON layout STGen_Server/STGen_Client exchange: a common
+ * header (type, end_marker, reliable, fragmented, utilize_timestamp,
+ * seq_no[, timestamp]) followed by type-specific fields.  Arrays are
+ * written with empty element keys, and string lengths exclude the trailing
+ * NUL (unlike standard BSON), as the PRTP binaries do.
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define PRTP_SID_MAX   64
+#define PRTP_MAX_SIDS  1024
+#define PRTP_MAX_PKT   65507
+
+/* STGen_Server stops acking (and serving) subscribes of about 1 KB */
+#define PRTP_SUBSCRIBE_MAX_BYTES 700
+
+enum prtp_type {
+    PRTP_LIST = 0,
+    PRTP_LIST_RESPONSE = 1,
+    PRTP_SUBSCRIBE = 2,
+    PRTP_SUBSCRIBE_ACK = 3,
+    PRTP_UPDATE = 4,
+    PRTP_UPDATE_ACK = 5,
+    PRTP_UPDATE_NACK = 6,
+    PRTP_KEEP_ALIVE = 7,
+    PRTP_UNSUBSCRIBE = 8,
+    /* srtp_subscriber -> srtp_shard_router only; STGen_Server never sees it */
+    PRTP_SACK = 9,
+    /* answered by srtp_shard_router with a JSON snapshot in "stats" */
+    PRTP_STATS = 10,
+    /* srtp_subscriber -> srtp_shard_router: header compression context
+     * seq_no lost (srtp_hc.h), send an IR */
+    PRTP_HC_RESYNC = 11,
+};
+
+/* Per-sensor status in a subscribe ack */
+enum prtp_sub_status {
+    PRTP_SUB_OK = 0,
+    PRTP_SUB_NO_SENSOR = 1,
+    PRTP_SUB_EXISTS = 2,
+};
+
+/*
+ * STGen_Server accepts at most PRTP_CAMERA_CHUNK_MAX raw bytes of camera
+ * data per sensor reading (sent as \xHH escapes) and hands them to clients
+ * as the binary value of the update's data document.  Larger frames
+ * travel as consecutive camera readings, each chunk starting with an
+ * 8-byte big-endian header: magic, frame id, fragment number, fragment
+ * count.  Chunks carry PRTP_FRAG_DATA frame bytes; only the last is shorter.
+ */
+#define PRTP_CAMERA_CHUNK_MAX 255
+#define PRTP_FRAG_MAGIC       0xF7A6
+#define PRTP_FRAG_HDR         8
+#define PRTP_FRAG_DATA        (PRTP_CAMERA_CHUNK_MAX - PRTP_FRAG_HDR)
+
+enum prtp_sensor_type {
+    PRTP_SENSOR_UNKNOWN = 0,
+    PRTP_SENSOR_TEMP = 1,
+    PRTP_SENSOR_DEVICE = 2,
+    PRTP_SENSOR_GPS = 3,
+    PRTP_SENSOR_CAMERA = 4,
+};
+
+/*
+ * Subscription options, per sid of a subscribe.  srtp_shard_router
+ * evaluates them before an update fans out to the subscriber (the stock
+ * server does not know them; the router strips them upstream):
+ *   min_interval_ms  at most one update per interval; later ones within
+ *                    it are dropped, or with latest the newest is held
+ *                    and delivered when the interval ends
+ *   deadband         temperature / device updates whose value (see
+ *                    prtp_update_value) is within deadband of the last
+ *                    one delivered are dropped
+ *   multicast        updates arrive on the multicast group named in the
+ *                    subscribe ack (router -M) instead of one unicast
+ *                    copy per subscriber
+ *   compress         updates arrive header-compressed (srtp_hc.h)
+ * All zero: every update is delivered, and the subscribe is what the
+ * stock client sends.
+ */
+typedef struct {
+    uint32_t min_interval_ms;
+    double deadband;
+    bool latest;
+    bool multicast;
+    bool compress;
+} prtp_sub_opts_t;
+
+typedef struct {
+    char sid[PRTP_SID_MAX];
+    bool reliable;
+    prtp_sub_opts_t opts;    /* subscribe only */
+    int32_t status;
+    uint32_t group_addr;     /* subscribe ack: multicast group (host order), */
+    uint16_t group_port;     /* both 0 for unicast delivery */
+    uint32_t cum;            /* sack: updates of sid received in order up to cum */
+    uint32_t bits;           /* sack: bit i set = cum + 2 + i received too */
+} prtp_sid_t;
+
+typedef struct {
+    int32_t type;
+    bool end_marker;
+    bool reliable;
+    bool fragmented;
+    bool utilize_timestamp;
+    uint32_t seq_no;         /* per subscription in updates */
+    uint32_t timestamp;      /* NTP "middle 32 bits" (16.16 seconds) */
+    bool has_timestamp;
+    uint32_t frag_no;
+    uint32_t frag_total;
+    char sid[PRTP_SID_MAX];  /* ack / nack, or the update's data.sid */
+    int nsids;               /* list response / subscribe / subscribe ack */
+    prtp_sid_t *sids;        /* caller-provided, PRTP_MAX_SIDS entries */
+    const uint8_t *data;     /* update payload document, points into the packet */
+    uint32_t data_len;
+    const uint8_t *blob;     /* binary value in data (camera bytes), or NULL */
+    uint32_t blob_len;
+} prtp_msg_t;
+
+/* Parses one datagram.  m->sids may be NULL when sid lists are not needed.
+ * Returns 0 on success, -1 on malformed input. */
+int prtp_parse(const uint8_t *buf, size_t len, prtp_msg_t *m);
+
+/* Rewrites the seq_no and reliable flag of an encoded message in place;
+ * 0 on success, -1 if either field is missing. */
+int prtp_patch_header(uint8_t *buf, size_t len, uint32_t seq_no, bool reliable);
+
+/* Offsets of the seq_no and timestamp values in an encoded message
+ * (*ts_off 0 if it has no timestamp); -1 if it has no seq_no. */
+int prtp_header_offsets(const uint8_t *buf, size_t len, size_t *seq_off, size_t *ts_off);
+
+/* Builders return the encoded length, or 0 if cap is too small. */
+size_t prtp_build_simple(uint8_t *buf, size_t cap, int32_t type, uint32_t seq_no);
+size_t prtp_build_ack(uint8_t *buf, size_t cap, int32_t type, uint32_t seq_no, const char *sid);
+size_t prtp_build_subscribe(uint8_t *buf, size_t cap, uint32_t seq_no,
+                            const prtp_sid_t *sids, int nsids);
+size_t prtp_build_subscribe_ack(uint8_t *buf, size_t cap, uint32_t seq_no,
+                                const prtp_sid_t *sids, int nsids);
+size_t prtp_build_sack(uint8_t *buf, size_t cap, uint32_t seq_no,
+                       const prtp_sid_t *sids, int nsids);
+size_t prtp_build_unsubscribe(uint8_t *buf, size_t cap, uint32_t seq_no,
+                              const prtp_sid_t *sids, int nsids);
+size_t prtp_build_list_response(uint8_t *buf, size_t cap, uint32_t seq_no,
+                                const prtp_sid_t *sids, int nsids);
+size_t prtp_build_stats(uint8_t *buf, size_t cap, uint32_t seq_no, const char *json);
+
+/* How many of sids fit into one subscribe of at most PRTP_SUBSCRIBE_MAX_BYTES
+ * (always at least one). */
+int prtp_subscribe_fit(const prtp_sid_t *sids, int nsids);
+
+/* STGen_Server stamps reliable updates with the middle 32 bits of an NTP
+ * time (16.16 seconds), truncated to whole seconds and running 768 s ahead
+ * of the NTP epoch proper; this offset reproduces its clock. */
+#define PRTP_NTP_UNIX_OFFSET (2208988800u + 768u)
+
+/* ts (CLOCK_REALTIME) in the server's timestamp format. */
+uint32_t prtp_ntp_middle(const struct timespec *ts);
+
+/* The numeric reading of a temperature (degrees) or device (0 off, 1 on)
+ * update into *value; -1 for other sensor types and empty updates. */
+int prtp_update_value(const prtp_msg_t *m, double *value);
+
+/* Sensor type from a sensor id prefix ("temp_3" -> PRTP_SENSOR_TEMP). */
+int prtp_sensor_type(const char *sid);
+
+/* Stable sensor-id hash (32-bit FNV-1a) used for shard ownership; the
+ * Python side (srtp.py::sid_hash) must stay identical. */
+static inline uint32_t prtp_sid_hash(const char *sid)
+{
+    uint32_t h = 2166136261u;
+    while (*sid) {
+        h ^= (uint8_t)*sid++;
+        h *= 16777619u;
+    }
+    return h;
+}
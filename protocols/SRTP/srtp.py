@@ -3,21 +3,170 @@ SRTP protocol plugin for STGen – active mode.
 Uses UDP sockets to communicate with SRTP binaries instead of sensor-launcher.
 """
 
+import os
 import sys
+import json
+import bisect
+import shutil
+import tempfile
 import subprocess
 import socket
 import signal
+import struct
 import time
 import logging
+import threading
 from pathlib import Path
-from typing import Any, Dict, List, Tuple
+from typing import Any, Dict, Iterable, List, Optional, Tuple
 
 # ensure stgen package is discoverable
 sys.path.insert(0, str(Path(__file__).parent.parent.parent))
 from stgen.protocol_interface import ProtocolInterface
+from stgen.network_emulator import NetworkRelay
 
 _LOG = logging.getLogger("srtp")
 
+# Largest camera frame (in raw bytes) embedded in a single sensor datagram.
+# Every byte is escaped as \xHH on the wire, and PRTP_server drops camera
+# readings over 255 bytes; larger frames need srtp_feeder -F, which splits
+# them into fragment readings (PRTP_FRAG_* in prtp_msg.h).
+_CAMERA_PAYLOAD_MAX = 255
+
+
+def _quote(value: str) -> str:
+    """Escape a value for the server's single-quoted string parser."""
+    return value.replace("\\", "\\\\").replace("'", "\\'")
+
+
+def _quote_value(value: str) -> str:
+    """Escape a wire-form value's quotes; its \\xHH sequences go as they are."""
+    return value.replace("'", "\\'")
+
+
+def format_sensor_value(sensor_type: str, value: Any, camera_bytes: int = 128) -> str:
+    """
+    Convert a generated reading into the value syntax PRTP_server expects.
+
+    The server picks a parser from the dev_id prefix:
+        temp    -> "%d.%d C"
+        device  -> "ON" / "OFF"
+        gps     -> "[lat, lon]"
+        camera  -> raw bytes escaped as \\xHH
+    Strings are assumed to already be in wire form.
+    """
+    if isinstance(value, str):
+        return value
+
+    reading = value.get("value") if isinstance(value, dict) else value
+
+    if sensor_type == "temp":
+        return f"{float(reading if reading is not None else 0.0):.2f} C"
+    if sensor_type == "device":
+        if isinstance(reading, bool):
+            return "ON" if reading else "OFF"
+        return "ON" if float(reading or 0) >= 50 else "OFF"
+    if sensor_type == "gps":
+        lat = value.get("latitude", 0.0) if isinstance(value, dict) else 0.0
+        lon = value.get("longitude", 0.0) if isinstance(value, dict) else 0.0
+        return f"[{lat:.6f}, {lon:.6f}]"
+    if sensor_type == "camera":
+        if isinstance(value, (bytes, bytearray)):
+            frame = bytes(value[:_CAMERA_PAYLOAD_MAX])
+        else:
+            size = min(camera_bytes, _CAMERA_PAYLOAD_MAX)
+            frame = bytes((i * 31 + 7) & 0xFF for i in range(size))
+        return "".join(f"\\x{b:02x}" for b in frame)
+    return str(reading)
+
+
+def format_sensor_update(data: Dict[str, Any], camera_bytes: int = 128) -> bytes:
+    """
+    Frame one reading as a sensor-port datagram.
+
+    PRTP_server's parse_sensor_update() accepts a flat dict whose keys and
+    values are all quoted strings; nested dicts and bare numbers are
+    rejected, and anything after the first closing brace is ignored.
+    """
+    dev_id = str(data.get("dev_id", "unknown"))
+    sensor_type = dev_id.split("_", 1)[0]
+    value = format_sensor_value(sensor_type, data.get("sensor_data", ""), camera_bytes)
+    return (
+        f"{{'dev_id': '{_quote(dev_id)}', "
+        f"'seq_no': '{int(data.get('seq_no', 0))}', "
+        f"'sensor_data': '{_quote_value(value)}'}}"
+    ).encode("utf-8")
+
+
+def sid_hash(sid: str) -> int:
+    """32-bit FNV-1a of a sensor id; must match prtp_sid_hash() in prtp_msg.h."""
+    h = 0x811C9DC5
+    for b in sid.encode("utf-8"):
+        h = ((h ^ b) * 0x01000193) & 0xFFFFFFFF
+    return h
+
+
+# Client-port message types (prtp_msg.h); PRTP_STATS is answered by
+# srtp_shard_router itself, never forwarded
+_PRTP_LIST, _PRTP_LIST_RESPONSE, _PRTP_STATS = 0, 1, 10
+
+
+def _bare_request(msg_type: int, seq_no: int) -> bytes:
+    """A client-port message that is just the common header."""
+    body = (b"\x10type\x00" + struct.pack("<i", msg_type)
+            + b"".join(b"\x08" + k + b"\x00\x00"
+                       for k in (b"end_marker", b"reliable", b"fragmented", b"utilize_timestamp"))
+            + b"\x10seq_no\x00" + struct.pack("<i", seq_no))
+    return struct.pack("<i", len(body) + 5) + body + b"\x00"
+
+
+def stats_request(seq_no: int) -> bytes:
+    """A PRTP_STATS request."""
+    return _bare_request(_PRTP_STATS, seq_no)
+
+
+def parse_stats_reply(reply: bytes) -> Optional[Dict[str, Any]]:
+    """The router's JSON snapshot from a PRTP_STATS reply, None if absent."""
+    i = reply.find(b"\x02stats\x00")
+    if i < 0:
+        return None
+    n = struct.unpack_from("<i", reply, i + 7)[0]      # PRTP: excludes the NUL
+    return json.loads(reply[i + 11:i + 11 + n])
+
+
+def _fmix32(h: int) -> int:
+    """murmur3 finalizer, as in srtp_ring_hash()."""
+    h ^= h >> 16
+    h = (h * 0x85EBCA6B) & 0xFFFFFFFF
+    h ^= h >> 13
+    h = (h * 0xC2B2AE35) & 0xFFFFFFFF
+    h ^= h >> 16
+    return h
+
+
+class HashRing:
+    """
+    Consistent-hash ring assigning sensor ids to SRTP nodes.
+    
+    Mirrors srtp_ring.c: each node name ("ip:sensor_port") contributes
+    VNODES points, and a sensor belongs to the first point clockwise from
+    its hash, so the router, the feeder and this plugin agree on owners.
+    """
+    
+    VNODES = 64
+    
+    def __init__(self, names: List[str]):
+        points = sorted(
+            (_fmix32(sid_hash(f"{name}#{v}")), n)
+            for n, name in enumerate(names) for v in range(self.VNODES)
+        )
+        self._points = [p for p, _ in points]
+        self._nodes = [n for _, n in points]
+    
+    def owner(self, sid: str) -> int:
+        """Index of the node owning sid."""
+        i = bisect.bisect_left(self._points, _fmix32(sid_hash(sid)))
+        return self._nodes[i if i < len(self._points) else 0]
+
 
 class Protocol(ProtocolInterface):
     """SRTP protocol wrapper for STGen - operates in ACTIVE mode."""
@@ -43,9 +192,132 @@ class Protocol(ProtocolInterface):
         self._server_bin = self._srtp_dir / "STGen_Server"
         self._client_bin = self._srtp_dir / "STGen_Client"
         
+        # Files a run writes (sensor.list, server and client logs) go to
+        # cfg 'work_dir', so runs side by side (ExperimentCell) keep apart
+        self._work_dir = Path(cfg.get("work_dir", self._srtp_dir))
+        self._work_dir.mkdir(parents=True, exist_ok=True)
+        
         # Configuration files
-        self._client_config = self._srtp_dir.parent.parent / "conf" / "test.conf"
-        self._sensor_list = self._srtp_dir / "sensor.list"
+        self._client_config = self._srtp_dir / "conf" / "test.conf"
+        self._sensor_list = self._work_dir / "sensor.list"
+        
+        # Native feeder (replaces per-message send_data when enabled)
+        self._feeder_bin = self._srtp_dir.parent.parent / "bin" / "srtp_feeder"
+        self._use_feeder = bool(cfg.get("feeder", False)) or "feeder_schedule" in cfg
+        self._feeder_batch = int(cfg.get("feeder_batch", 1))
+        self._camera_bytes = int(cfg.get("camera_payload_bytes", 128))
+        self._feeder_stats: Dict[str, Any] = {}
+        
+        # Sharding (cfg 'shards' > 1): shard k runs its own STGen_Server on
+        # shard_base_port + 2k / + 2k + 1, fronted by srtp_shard_router on
+        # the public ports. The server binary does not set SO_REUSEPORT, so
+        # ownership is decided on a HashRing in user space instead.
+        # cfg 'cluster_nodes' ("ip:sensor_port[:client_port]", already
+        # running, possibly remote) are fronted the same way.
+        self._cluster_nodes = list(cfg.get("cluster_nodes", []))
+        self._nodes: List[Tuple[str, int, int]] = []
+        self._ring: HashRing | None = None
+        self._shards = max(1, int(cfg.get("shards", 1)))
+        self._shard_base = int(cfg.get("shard_base_port", 6000))
+        self._shard_pin = bool(cfg.get("shard_pin_cpus", True))
+        self._router_bin = self._srtp_dir.parent.parent / "bin" / "srtp_shard_router"
+        self._shard_processes: List[subprocess.Popen] = []
+        self._router_process: subprocess.Popen | None = None
+        self._router_stats: Dict[str, Any] = {}
+        self._shard_dir: Path | None = None
+        
+        # Egress classes (cfg 'srtp_classes': a class file, bare names
+        # resolved in conf/; cfg 'srtp_egress_kbps': downlink rate): the
+        # router queues datagrams to clients per priority class (see
+        # srtp_sched.h), so either one puts the router in front
+        classes = cfg.get("srtp_classes", "")
+        if classes and not Path(classes).is_absolute() and "/" not in classes:
+            classes = str(self._srtp_dir / "conf" / classes)
+        self._classes = classes
+        self._egress_kbps = int(cfg.get("srtp_egress_kbps", 0))
+        # datagrams per recvmmsg/sendmmsg in the router (1 = one per syscall)
+        self._router_batch = int(cfg.get("srtp_router_batch", 64))
+        
+        # Trace logs (cfg 'srtp_trace_dir'): the router and subscriber host
+        # record their trace points (srtp_log.h) there as router.trace /
+        # subscriber.trace, decoded offline with srtp_trace.py
+        self._trace_dir = cfg.get("srtp_trace_dir", "")
+        self._traces: Dict[str, str] = {}
+        
+        # Subscriber host (cfg 'subscriber_host': true): one srtp_subscriber
+        # process runs every client as a session instead of one STGen_Client
+        # per sensor, opening subscriber_rate sessions per second.
+        # subscriber_ack_delay_ms > 0 batches reliable acks into sacks,
+        # which only the router understands, so it forces one in front
+        self._use_host = bool(cfg.get("subscriber_host", False))
+        self._host_rate = int(cfg.get("subscriber_rate", 500))
+        self._ack_delay = int(cfg.get("subscriber_ack_delay_ms", 0)) if self._use_host else 0
+        self._host_bin = self._srtp_dir.parent.parent / "bin" / "srtp_subscriber"
+        self._host_process: subprocess.Popen | None = None
+        self._host_stats: Dict[str, Any] = {}
+        # cfg 'subscriber_control_port': the host takes scripted
+        # subscribe/unsubscribe/list commands there, see control()
+        self._control_port = int(cfg.get("subscriber_control_port", 0)) if self._use_host else 0
+        self._control_sock: socket.socket | None = None
+        # Subscription options (cfg 'subscriber_min_interval_ms',
+        # 'subscriber_deadband', 'subscriber_latest'): the router applies
+        # them before updates fan out, so they put one in front
+        self._min_interval = int(cfg.get("subscriber_min_interval_ms", 0)) if self._use_host else 0
+        self._deadband = float(cfg.get("subscriber_deadband", 0)) if self._use_host else 0.0
+        self._latest = bool(cfg.get("subscriber_latest", False)) and self._min_interval > 0
+        # cfg 'subscriber_compress': the router header-compresses updates
+        # towards the host (srtp_hc.h)
+        self._compress = bool(cfg.get("subscriber_compress", False)) and self._use_host
+        # cfg 'network_mix': session i of the host is device i, on local port
+        # device_base_port + i, where NetworkEmulator.from_mix put its class;
+        # STGen_Client cannot bind, so its clients stay on ephemeral ports
+        self._device_base_port = 0
+        if cfg.get("network_mix"):
+            if self._use_host:
+                self._device_base_port = int(cfg.get("device_base_port", 30000))
+            else:
+                _LOG.warning("network_mix needs subscriber_host; clients get the default class")
+        
+        # Live stats (cfg 'srtp_stats_interval_ms' > 0): the router answers
+        # PRTP_STATS on the client port, so it is put in front and polled;
+        # each snapshot is kept, with per-sensor rates since the previous
+        # one, as the 'srtp_timeseries' metric
+        self._stats_interval = int(cfg.get("srtp_stats_interval_ms", 0)) / 1000.0
+        self._stats_stop = threading.Event()
+        self._stats_thread: threading.Thread | None = None
+        self._stats_series: List[Dict[str, Any]] = []
+        
+        # Warm restart (cfg 'srtp_snapshot': a file path): the router keeps
+        # its sessions and subscriptions there and restores them when
+        # restart_server() brings the server tier back after a crash
+        self._snapshot = cfg.get("srtp_snapshot", "")
+        
+        # Latest-value cache (cfg 'srtp_latest_cache': sensors to cache):
+        # the router answers a subscribe with each sensor's last update,
+        # so new subscribers do not wait for the next reading
+        self._latest_cache = int(cfg.get("srtp_latest_cache", 0))
+        
+        # Multicast fan-out (cfg 'srtp_multicast': "group:port"): the router
+        # sends each update of a multicast subscription once, to the
+        # sensor's group, and the subscriber host joins the groups
+        self._multicast = cfg.get("srtp_multicast", "")
+        
+        # User-space network emulation (cfg 'network_emulation': "relay"
+        # with 'network_profile'): bin/srtp_impair applies the profile to
+        # each client on its own, between the clients and the client port;
+        # clients connect to network_relay_port (default client_port + 100)
+        self._relay: NetworkRelay | None = None
+        self._relay_stats: Dict[str, Any] = {}
+        if cfg.get("network_emulation") == "relay" and cfg.get("network_profile"):
+            self._relay = NetworkRelay(
+                cfg["network_profile"],
+                int(cfg.get("network_relay_port", self._client_port + 100)),
+                self._client_port,
+                socket.gethostbyname(cfg.get("server_ip", "127.0.0.1")),
+                # "test3.conf:3": a conf/test*.conf row's delay and Gilbert-Elliott loss
+                extra_args=["-g", str(self._srtp_dir / "conf" / cfg["network_burst_loss"])]
+                if cfg.get("network_burst_loss") else None,
+            )
         
         # Metrics
         self._sent_count = 0
@@ -55,64 +327,265 @@ class Protocol(ProtocolInterface):
                   self._sensor_port, self._client_port)
 
     def start_server(self) -> None:
-        """Start SRTP server binary."""
+        """Start SRTP server binary (or one per shard behind the router)."""
         # Check if server binary exists
         if not self._server_bin.exists():
             _LOG.error(" STGen_Server binary not found at: %s", self._server_bin)
             raise FileNotFoundError(f"STGen_Server not found: {self._server_bin}")
         
-        # Create sensor.list with expected sensors
+        # Expected sensors
         num_clients = self.cfg.get("num_clients", 4)
         sensor_types = ["temp", "device", "gps", "camera"]
+        sensors = [f"{sensor_types[i % len(sensor_types)]}_{i}" for i in range(num_clients)]
         
-        with open(self._sensor_list, 'w') as f:
-            for i in range(num_clients):
-                sensor = sensor_types[i % len(sensor_types)]
-                f.write(f"{sensor}_{i}\n")
-        
-        _LOG.info("📝 Created sensor.list with %d entries", num_clients)
-        
-        # Start the SRTP server
+        try:
+            if self._cluster_nodes:
+                self._start_router([self._parse_node(n) for n in self._cluster_nodes])
+                self._wait_ready(self._router_process, "Router", self._client_port, _PRTP_STATS)
+            elif (self._shards > 1 or self._ack_delay > 0 or self._classes
+                  or self._egress_kbps or self._stats_interval or self._snapshot
+                  or self._min_interval or self._deadband or self._latest_cache
+                  or self._multicast or self._compress):
+                self._start_shards(sensors)
+            else:
+                with open(self._sensor_list, 'w') as f:
+                    f.writelines(f"{sid}\n" for sid in sensors)
+                _LOG.info("📝 Created sensor.list with %d entries", num_clients)
+                
+                self._server_process = self._launch_server(
+                    self._sensor_port, self._client_port, self._sensor_list
+                )
+                self._wait_ready(self._server_process, "Server", self._client_port)
+                _LOG.info(" SRTP Server started (PID: %d)", self._server_process.pid)
+            
+            # Create UDP socket for sending sensor data
+            self._sensor_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            _LOG.info(" UDP socket created for sensor data")
+            
+            if self._relay:
+                self._relay.start()
+            
+            if self._stats_interval and self._router_process:
+                self._stats_thread = threading.Thread(target=self._poll_stats, daemon=True)
+                self._stats_thread.start()
+            
+        except Exception as e:
+            _LOG.error("Failed to start SRTP server: %s", e)
+            raise
+
+    def _launch_server(self, sensor_port: int, client_port: int, sensor_list: Path,
+                       cpu: Optional[int] = None, cwd: Optional[Path] = None) -> subprocess.Popen:
+        """Spawn one STGen_Server, optionally pinned to a single CPU."""
         cmd = [
             str(self._server_bin),
             f"-i{self.cfg['server_ip']}",
-            f"-p{self._sensor_port}",
-            f"-s{self._client_port}",
-            f"-l{self._sensor_list}",
+            f"-p{sensor_port}",
+            f"-s{client_port}",
+            f"-l{sensor_list}",
             f"-c{self._client_config}"
         ]
         
         _LOG.info("📡 Starting SRTP Server: %s", " ".join(cmd))
         
+        # stdout carries the server's debug trace and stderr an error line
+        # per client it fails to answer; undrained pipes would fill up and
+        # block the server mid-run, so stderr goes to a scratch file that
+        # _check_started() reads back
+        errors = tempfile.TemporaryFile()
+        proc = subprocess.Popen(
+            cmd,
+            stdout=subprocess.DEVNULL,
+            stderr=errors,
+            cwd=str(cwd or self._work_dir),
+            preexec_fn=(lambda: os.sched_setaffinity(0, {cpu})) if cpu is not None else None
+        )
+        proc.stderr = errors
+        return proc
+
+    @staticmethod
+    def _check_started(proc: subprocess.Popen, name: str) -> None:
+        """Raise if a freshly spawned process died during startup."""
+        if proc.poll() is not None:
+            _LOG.error(" %s process died immediately", name)
+            if proc.stderr and proc.stderr.seekable():
+                proc.stderr.seek(0)
+            stderr = proc.stderr.read().decode() if proc.stderr else ""
+            _LOG.error("%s stderr: %s", name, stderr)
+            raise RuntimeError(f"SRTP {name.lower()} failed to start")
+
+    def _wait_ready(self, proc: subprocess.Popen, name: str, client_port: int,
+                    probe: int = _PRTP_LIST, timeout: float = 3.0) -> None:
+        """
+        Block until the process answers a probe request on client_port.
+
+        Replaces a fixed startup sleep: STGen_Server answers within tens of
+        milliseconds, so back-to-back runs in a sweep no longer spend a
+        second per (re)start.  The router is probed with PRTP_STATS, which
+        it answers without opening a client session.  Raises if the process
+        dies meanwhile; after timeout it carries on, as the fixed sleep did.
+        """
+        expect = _PRTP_LIST_RESPONSE if probe == _PRTP_LIST else probe
+        addr = (socket.gethostbyname(self.cfg['server_ip']), client_port)
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.settimeout(0.02)
+        deadline, seq = time.monotonic() + timeout, 0
         try:
-            self._server_process = subprocess.Popen(
-                cmd,
-                stdout=subprocess.PIPE,
-                stderr=subprocess.PIPE,
-                cwd=str(self._srtp_dir)
+            while time.monotonic() < deadline:
+                self._check_started(proc, name)
+                seq += 1
+                try:
+                    sock.sendto(_bare_request(probe, seq), addr)
+                    reply = sock.recv(65535)
+                except (socket.timeout, ConnectionRefusedError):
+                    continue
+                if len(reply) >= 14 and struct.unpack_from("<i", reply, 10)[0] == expect:
+                    return
+            _LOG.warning("%s did not answer on port %d within %.1fs", name, client_port, timeout)
+        finally:
+            sock.close()
+
+    @staticmethod
+    def _parse_node(spec: str) -> Tuple[str, int, int]:
+        """'ip:sensor_port[:client_port]' -> (numeric ip, sensor_port, client_port)."""
+        parts = spec.split(":")
+        sensor_port = int(parts[1])
+        client_port = int(parts[2]) if len(parts) > 2 else sensor_port + 1
+        return socket.gethostbyname(parts[0]), sensor_port, client_port
+
+    def _start_router(self, nodes: List[Tuple[str, int, int]]) -> None:
+        """Front the given nodes with srtp_shard_router on the public ports."""
+        if not self._router_bin.exists():
+            raise FileNotFoundError(
+                f"srtp_shard_router not found: {self._router_bin}\n"
+                "Run: make -C protocols/SRTP"
             )
-            time.sleep(1.0)  # Give server time to bind
-            
-            # Check if server started successfully
-            if self._server_process.poll() is not None:
-                _LOG.error(" Server process died immediately")
-                stderr = self._server_process.stderr.read().decode() if self._server_process.stderr else ""
-                _LOG.error("Server stderr: %s", stderr)
-                raise RuntimeError("SRTP server failed to start")
-            
-            _LOG.info(" SRTP Server started (PID: %d)", self._server_process.pid)
-            
-            # Create UDP socket for sending sensor data
-            self._sensor_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
-            _LOG.info(" UDP socket created for sensor data")
-            
-        except Exception as e:
-            _LOG.error("Failed to start SRTP server: %s", e)
-            raise
+        
+        self._nodes = nodes
+        self._ring = HashRing([f"{ip}:{sp}" for ip, sp, _ in nodes])
+        cmd = [
+            str(self._router_bin),
+            "-i", socket.gethostbyname(self.cfg['server_ip']),
+            "-p", str(self._sensor_port),
+            "-s", str(self._client_port),
+        ]
+        for ip, sp, cp in nodes:
+            cmd += ["-N", f"{ip}:{sp}:{cp}"]
+        if self._classes:
+            cmd += ["-Q", self._classes]
+        if self._egress_kbps:
+            cmd += ["-B", str(self._egress_kbps)]
+        if self._router_batch != 64:
+            cmd += ["-b", str(self._router_batch)]
+        cmd += self._trace_args("shard_router", "router.trace")
+        if self._snapshot:
+            cmd += ["-S", self._snapshot]
+        if self._latest_cache:
+            cmd += ["-V", str(self._latest_cache)]
+        if self._multicast:
+            cmd += ["-M", self._multicast]
+        _LOG.info("Starting srtp_shard_router: %s", " ".join(cmd))
+        self._router_process = subprocess.Popen(
+            cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True
+        )
+
+    def _start_shards(self, sensors: List[str]) -> None:
+        """Start one server per shard and the router on the public ports."""
+        ip = socket.gethostbyname(self.cfg['server_ip'])
+        self._start_router([
+            (ip, self._shard_base + 2 * k, self._shard_base + 2 * k + 1)
+            for k in range(self._shards)
+        ])
+        
+        # Each shard only lists the sensors it owns; the server rewrites its
+        # list file and writes per-sensor logs to its cwd, so each shard
+        # runs in its own scratch directory.
+        self._shard_dir = Path(tempfile.mkdtemp(prefix="srtp_shards_"))
+        cpus = sorted(os.sched_getaffinity(0))
+        
+        for k, (_, sensor_port, client_port) in enumerate(self._nodes):
+            owned = [sid for sid in sensors if self._ring.owner(sid) == k]
+            shard_dir = self._shard_dir / f"shard{k}"
+            shard_dir.mkdir()
+            shard_list = shard_dir / "sensor.list"
+            shard_list.write_text("".join(f"{sid}\n" for sid in owned))
+            cpu = cpus[k % len(cpus)] if self._shard_pin else None
+            self._shard_processes.append(
+                self._launch_server(sensor_port, client_port, shard_list, cpu, shard_dir)
+            )
+            _LOG.info("Shard %d: %d sensors, ports %d/%d, cpu %s", k, len(owned),
+                      sensor_port, client_port, cpu)
+        
+        for k, (proc, (_, _, client_port)) in enumerate(zip(self._shard_processes, self._nodes)):
+            self._wait_ready(proc, f"Shard {k}", client_port)
+        self._wait_ready(self._router_process, "Router", self._client_port, _PRTP_STATS)
+        self._server_process = self._shard_processes[0]
+        _LOG.info(" SRTP started with %d shards behind router (PID: %d)",
+                  self._shards, self._router_process.pid)
+
+    def restart_server(self) -> float:
+        """Kill the router and its shards as a crash would and start them
+        again; returns the seconds until they answer.  Clients are left
+        running: with srtp_snapshot the router resubscribes on their
+        behalf, without it they are no longer served."""
+        if not self._shard_processes:
+            raise RuntimeError("restart_server needs the router in front")
+        for proc in [self._router_process] + self._shard_processes:
+            if proc.poll() is None:
+                proc.kill()
+            proc.wait()
+        self._shard_processes = []
+        if self._shard_dir:
+            shutil.rmtree(self._shard_dir, ignore_errors=True)
+        
+        num_clients = self.cfg.get("num_clients", 4)
+        sensor_types = ["temp", "device", "gps", "camera"]
+        t0 = time.monotonic()
+        self._start_shards([f"{sensor_types[i % len(sensor_types)]}_{i}" for i in range(num_clients)])
+        return time.monotonic() - t0
+
+    def _poll_stats(self) -> None:
+        """Sample the router's PRTP_STATS snapshot every stats interval."""
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.settimeout(max(self._stats_interval, 0.2))
+        router = (socket.gethostbyname(self.cfg['server_ip']), self._client_port)
+        prev: Dict[str, Dict[str, Any]] = {}
+        prev_t, seq = 0.0, 0
+        try:
+            while not self._stats_stop.wait(self._stats_interval):
+                seq += 1
+                try:
+                    sock.sendto(stats_request(seq), router)
+                    snap = parse_stats_reply(sock.recv(65535))
+                except (OSError, ValueError):
+                    continue
+                if not snap:
+                    continue
+                t = snap["uptime_ms"] / 1e3
+                sensors = {e.pop("sid"): e for e in snap.get("sensors", [])}
+                if t > prev_t:
+                    for sid, e in sensors.items():
+                        p = prev.get(sid, {})
+                        for k in ("readings", "updates", "retransmits"):
+                            e[f"{k}_hz"] = round((e[k] - p.get(k, 0)) / (t - prev_t), 2)
+                snap["sensors"] = sensors
+                self._stats_series.append(snap)
+                prev, prev_t = sensors, t
+        finally:
+            sock.close()
+
+    def _sensor_address(self, dev_id: str) -> Tuple[str, int]:
+        """Sensor port for a reading: the owning node's, skipping the router."""
+        if self._ring:
+            ip, sensor_port, _ = self._nodes[self._ring.owner(dev_id)]
+            return ip, sensor_port
+        return (self.cfg['server_ip'], self._sensor_port)
 
     def start_clients(self, num: int) -> None:
         """Start PRTP client binaries."""
         _LOG.info("Starting %d PRTP clients", num)
+        if self._use_host:
+            self._start_subscriber_host(num)
+            return
         
         # Check if client binary exists
         if not self._client_bin.exists():
@@ -121,7 +594,7 @@ class Protocol(ProtocolInterface):
         
         # Start clients
         for i in range(num):
-            client_log = self._srtp_dir / f"client{i+1}_sensor_log"
+            client_log = self._work_dir / f"client{i+1}_sensor_log"
             sensor_types = ["temp", "device", "gps", "camera"]
             sensor_id = f"{sensor_types[i % len(sensor_types)]}_{i}"
             
@@ -130,7 +603,7 @@ class Protocol(ProtocolInterface):
                 f"-l{client_log}",
                 f"-s{self.cfg['server_ip']}",
                 f"-r{sensor_id}",
-                f"-p{self._client_port}",
+                f"-p{self._clients_port()}",
                 "-A"  # Active mode flag
             ]
             
@@ -141,7 +614,7 @@ class Protocol(ProtocolInterface):
                     cmd,
                     stdout=subprocess.PIPE,
                     stderr=subprocess.PIPE,
-                    cwd=str(self._srtp_dir)
+                    cwd=str(self._work_dir)
                 )
                 self._client_processes.append(proc)
                 time.sleep(0.2)
@@ -150,6 +623,77 @@ class Protocol(ProtocolInterface):
         
         _LOG.info(" Started %d clients", len(self._client_processes))
 
+    def _clients_port(self) -> int:
+        """The port clients subscribe on: the relay's, if one is in front."""
+        return self._relay.listen_port if self._relay else self._client_port
+
+    def _trace_args(self, name: str, file: str) -> List[str]:
+        """-T for a native tool when tracing is on, remembering the path."""
+        if not self._trace_dir:
+            return []
+        Path(self._trace_dir).mkdir(parents=True, exist_ok=True)
+        self._traces[name] = str(Path(self._trace_dir) / file)
+        return ["-T", self._traces[name]]
+
+    def _start_subscriber_host(self, num: int) -> None:
+        """Run num clients as sessions of one srtp_subscriber process."""
+        if not self._host_bin.exists():
+            raise FileNotFoundError(
+                f"srtp_subscriber not found: {self._host_bin}\n"
+                "Run: make -C protocols/SRTP"
+            )
+        
+        # Same subscriptions as the per-process clients: session i reliably
+        # to sensor i, plus everything the server lists
+        sensor_types = ["temp", "device", "gps", "camera"]
+        cmd = [
+            str(self._host_bin),
+            "-s", socket.gethostbyname(self.cfg['server_ip']),
+            "-p", str(self._clients_port()),
+            "-n", str(num),
+            "-R", str(self._host_rate),
+            "-D", str(self._ack_delay),
+            "-A", "-r",
+        ] + self._trace_args("subscriber_host", "subscriber.trace")
+        if self._control_port:
+            cmd += ["-C", str(self._control_port)]
+        if self._min_interval:
+            cmd += ["-I", str(self._min_interval)] + (["-L"] if self._latest else [])
+        if self._deadband:
+            cmd += ["-E", str(self._deadband)]
+        if self._multicast:
+            cmd += ["-G"]
+        if self._compress:
+            cmd += ["-H"]
+        if self._device_base_port:
+            cmd += ["-b", str(self._device_base_port)]
+        cmd += [f"{sensor_types[i % len(sensor_types)]}_{i}" for i in range(num)]
+        _LOG.info("Starting srtp_subscriber with %d sessions", num)
+        
+        self._host_process = subprocess.Popen(
+            cmd,
+            stdout=subprocess.PIPE,
+            stderr=subprocess.PIPE,
+            text=True
+        )
+        time.sleep(0.1)
+        self._check_started(self._host_process, "Subscriber host")
+    
+    def control(self, commands: List[str], timeout: float = 2.0) -> List[str]:
+        """
+        Send a batch of subscriber host commands in one datagram and return
+        the reply line of each.  Commands (session index or '*'):
+            sub <session> sid...    rsub <session> sid...    unsub <session> sid...
+            list <session>          stats
+        """
+        if not self._control_port:
+            raise RuntimeError("control() needs subscriber_host and subscriber_control_port")
+        if self._control_sock is None:
+            self._control_sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            self._control_sock.settimeout(timeout)
+        self._control_sock.sendto("\n".join(commands).encode(), ("127.0.0.1", self._control_port))
+        return self._control_sock.recv(65535).decode().splitlines()
+
     def send_data(self, client_id: str, data: Dict) -> Tuple[bool, float]:
         """
         Send sensor data via UDP socket (mimics sensor.py behavior).
@@ -170,27 +714,19 @@ class Protocol(ProtocolInterface):
             return False, 0.0
         
         try:
-            # Format message similar to sensor.py output
-            message = str(data)  # Convert dict to string representation
+            message = format_sensor_update(data, self._camera_bytes)
             
-            # Send via UDP to server's sensor port
-            server_address = (self.cfg['server_ip'], self._sensor_port)
-            sent_bytes = self._sensor_socket.sendto(
-                message.encode('utf-8'), 
-                server_address
-            )
+            # Send via UDP to the (owning shard's) sensor port
+            server_address = self._sensor_address(str(data.get('dev_id', 'unknown')))
+            sent_bytes = self._sensor_socket.sendto(message, server_address)
             
             self._sent_count += 1
             t_sent = time.perf_counter()
             
-            # Log every message with full details
-            sensor_data_preview = str(data.get('sensor_data', ''))[:50]
-            _LOG.info("📤 [%s] SENT msg #%d from %s: %s (size: %d bytes)", 
-                      client_id, 
-                      data.get('seq_no', 0),
-                      data.get('dev_id', 'unknown'),
-                      sensor_data_preview,
-                      sent_bytes)
+            if _LOG.isEnabledFor(logging.DEBUG):
+                _LOG.debug("[%s] sent seq %s from %s (%d bytes)",
+                           client_id, data.get('seq_no', 0),
+                           data.get('dev_id', 'unknown'), sent_bytes)
             
             return True, t_sent
             
@@ -198,6 +734,83 @@ class Protocol(ProtocolInterface):
             _LOG.error(" Failed to send data: %s", e)
             return False, 0.0
 
+    def feed_stream(self, stream: Iterable[Tuple[str, Dict, float]]) -> Optional[int]:
+        """
+        Hand the whole stream to the native srtp_feeder (cfg 'feeder': true).
+        
+        The stream is compiled on the fly into feeder schedule lines
+        (offset_us, dev_id, seq_no, wire value) and piped to the feeder's
+        stdin; pipe back-pressure keeps the generator roughly in step with
+        the feeder's clock. If cfg['feeder_schedule'] names a precompiled
+        schedule file, it is replayed instead and the stream is ignored.
+        
+        Returns:
+            Number of datagrams sent, or None when the feeder is disabled
+            and the orchestrator should call send_data() per message.
+        """
+        if not self._use_feeder:
+            return None
+        
+        if not self._feeder_bin.exists():
+            raise FileNotFoundError(
+                f"srtp_feeder not found: {self._feeder_bin}\n"
+                "Run: make -C protocols/SRTP"
+            )
+        
+        schedule = self.cfg.get("feeder_schedule")
+        cmd = [
+            str(self._feeder_bin),
+            "-i", str(self.cfg['server_ip']),
+            "-p", str(self._sensor_port),
+            "-b", str(self._feeder_batch),
+            "-f", str(schedule) if schedule else "-",
+        ]
+        for ip, sensor_port, _ in self._nodes:
+            cmd += ["-N", f"{ip}:{sensor_port}"]
+        _LOG.info("Starting srtp_feeder: %s", " ".join(cmd))
+        
+        proc = subprocess.Popen(
+            cmd,
+            stdin=None if schedule else subprocess.PIPE,
+            stdout=subprocess.PIPE,
+            stderr=subprocess.PIPE,
+            text=True
+        )
+        
+        try:
+            if not schedule:
+                offset_s = 0.0
+                for _cid, data, interval in stream:
+                    if not self.is_alive():
+                        break
+                    value = format_sensor_value(
+                        str(data.get("dev_id", "")).split("_", 1)[0],
+                        data.get("sensor_data", ""),
+                        self._camera_bytes
+                    )
+                    proc.stdin.write(
+                        f"{int(offset_s * 1e6)}\t{data.get('dev_id', 'unknown')}\t"
+                        f"{int(data.get('seq_no', 0))}\t{_quote_value(value)}\n"
+                    )
+                    offset_s += interval
+            # communicate() closes stdin, which ends the schedule
+            out, err = proc.communicate()
+        except (BrokenPipeError, KeyboardInterrupt):
+            proc.send_signal(signal.SIGINT)
+            out, err = proc.communicate()
+        
+        if proc.returncode != 0:
+            _LOG.error("srtp_feeder exited with %d: %s", proc.returncode, err.strip())
+        
+        lines = out.strip().splitlines()
+        self._feeder_stats = json.loads(lines[-1]) if lines else {}
+        sent = int(self._feeder_stats.get("sent", 0))
+        self._sent_count += sent
+        _LOG.info("srtp_feeder: %d datagrams in %d syscalls, max lag %d us",
+                  sent, self._feeder_stats.get("syscalls", 0),
+                  self._feeder_stats.get("max_lag_us", 0))
+        return sent
+
     def stop(self) -> None:
         """Gracefully shutdown all processes."""
         _LOG.info("Stopping SRTP protocol...")
@@ -206,6 +819,9 @@ class Protocol(ProtocolInterface):
         if self._sensor_socket:
             self._sensor_socket.close()
             _LOG.debug("Closed UDP sensor socket")
+        if self._control_sock:
+            self._control_sock.close()
+            self._control_sock = None
         
         # Stop clients
         for i, proc in enumerate(self._client_processes):
@@ -217,14 +833,46 @@ class Protocol(ProtocolInterface):
                 except Exception:
                     proc.kill()
         
-        # Stop server
-        if self._server_process and self._server_process.poll() is None:
-            _LOG.info("Stopping server (PID: %d)", self._server_process.pid)
+        if self._host_process and self._host_process.poll() is None:
+            _LOG.info("Stopping subscriber host (PID: %d)", self._host_process.pid)
+            self._host_process.send_signal(signal.SIGINT)
+            try:
+                out, _ = self._host_process.communicate(timeout=5)
+                lines = out.strip().splitlines()
+                self._host_stats = json.loads(lines[-1]) if lines else {}
+            except Exception:
+                self._host_process.kill()
+        
+        if self._relay:
+            self._relay_stats = self._relay.stop()
+        
+        if self._stats_thread:
+            self._stats_stop.set()
+            self._stats_thread.join(timeout=2)
+            _LOG.info("📊 %d router stats samples", len(self._stats_series))
+        
+        # Stop router first so shards see no traffic while shutting down
+        if self._router_process and self._router_process.poll() is None:
+            _LOG.info("Stopping router (PID: %d)", self._router_process.pid)
+            self._router_process.send_signal(signal.SIGINT)
             try:
-                self._server_process.send_signal(signal.SIGINT)
-                self._server_process.wait(timeout=2)
+                out, _ = self._router_process.communicate(timeout=2)
+                lines = out.strip().splitlines()
+                self._router_stats = json.loads(lines[-1]) if lines else {}
             except Exception:
-                self._server_process.kill()
+                self._router_process.kill()
+        
+        # Stop server(s)
+        for proc in self._shard_processes or [self._server_process]:
+            if proc and proc.poll() is None:
+                _LOG.info("Stopping server (PID: %d)", proc.pid)
+                try:
+                    proc.send_signal(signal.SIGINT)
+                    proc.wait(timeout=2)
+                except Exception:
+                    proc.kill()
+        if self._shard_dir:
+            shutil.rmtree(self._shard_dir, ignore_errors=True)
         
         # Parse client logs for metrics
         self._parse_client_logs()
@@ -235,9 +883,13 @@ class Protocol(ProtocolInterface):
     def _parse_client_logs(self) -> None:
         """Parse client logs to extract received message count."""
         total_received = 0
+        if self._host_stats:
+            # the empty update opening each subscription carries no reading
+            total_received = (int(self._host_stats.get("updates", 0))
+                              - int(self._host_stats.get("empty_updates", 0)))
         
         for i, proc in enumerate(self._client_processes):
-            client_log_path = self._srtp_dir / f"client{i+1}_sensor_log"
+            client_log_path = self._work_dir / f"client{i+1}_sensor_log"
             
             if not client_log_path.exists():
                 _LOG.warning("Client %d log not found: %s", i+1, client_log_path)
@@ -277,15 +929,43 @@ class Protocol(ProtocolInterface):
             _LOG.info("📊 Total sent: %d, Total received: %d, Loss: %.1f%%",
                       self._sent_count, total_received,
                       (1 - total_received/max(self._sent_count, 1)) * 100)
+            if self._host_stats.get("lat_samples"):
+                _LOG.info("📊 Latency (%d samples): p50=%.1fms p95=%.1fms p99=%.1fms",
+                          self._host_stats["lat_samples"], self._host_stats["lat_p50_ms"],
+                          self._host_stats["lat_p95_ms"], self._host_stats["lat_p99_ms"])
         else:
             _LOG.warning("📊 No messages found in client logs (sent: %d)", self._sent_count)
+        for c in self._router_stats.get("classes", []):
+            _LOG.info("📊 Class %s (prio %d): %d sent, %d dropped, queueing p50=%.1fms p99=%.1fms",
+                      c["name"], c["prio"], c["sent"], c["dropped"],
+                      c["qdelay_p50_ms"], c["qdelay_p99_ms"])
     
     def get_metrics(self) -> Dict[str, Any]:
         """Return protocol-specific metrics."""
-        return {
+        metrics = {
             "sent_count": self._sent_count,
             "protocol_type": "UDP-based SRTP"
         }
+        if self._feeder_stats:
+            metrics["feeder"] = self._feeder_stats
+        if self._router_stats:
+            metrics["shard_router"] = self._router_stats
+        if self._stats_series:
+            metrics["srtp_timeseries"] = self._stats_series
+        if self._traces:
+            metrics["srtp_traces"] = self._traces
+        if self._relay_stats:
+            metrics["network_relay"] = self._relay_stats
+        if self._host_stats:
+            metrics["subscriber_host"] = self._host_stats
+            # one-way latency from the server's update timestamps, in the
+            # orchestrator's lat_*_ms terms (upper bounds: 1 s stamp resolution)
+            if self._host_stats.get("lat_samples"):
+                metrics["latency"] = {
+                    k: v for k, v in self._host_stats.items() if k.startswith("lat_")
+                }
+                metrics["latency"]["lat_resolution_ms"] = 1000
+        return metrics
 
 
 # Ensure the orchestrator can find the Protocol symbol
@@ -336,7 +1016,7 @@ __all__ = ["Protocol"]
 #         self._sensor_script = self._srtp_dir.parent.parent / "stgen" / "sensor.py"
         
 #         # Config files
-#         self._client_config = self._srtp_dir.parent.parent / "conf" / "test.conf"
+#         self._client_config = self._srtp_dir / "conf" / "test.conf"
 #         self._sensor_list = self._srtp_dir / "sensor.list"
         
 #         # Metrics
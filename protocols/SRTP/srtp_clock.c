@@ -0,0 +1,27 @@
+#include <time.h>
+#include "srtp_clock.h"
+
+static int virtual_time;
+static uint64_t virtual_us;
+
+uint64_t srtp_now_us(void)
+{
+    struct timespec ts;
+
+    if (virtual_time)
+        return virtual_us;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void srtp_clock_virtual(uint64_t start_us)
+{
+    virtual_time = 1;
+    virtual_us = start_us;
+}
+
+void srtp_clock_advance(uint64_t t_us)
+{
+    if (t_us > virtual_us)
+        virtual_us = t_us;
+}
@@ -0,0 +1,24 @@
+/*
+ * srtp_clock - time source of the native SRTP tools.
+ *
+ * Timers, deadlines and latency stamps all read srtp_now_us().  By default
+ * that is CLOCK_MONOTONIC; after srtp_clock_virtual() it is a virtual
+ * clock that only moves when a discrete-event driver (srtp_sim) advances
+ * it to the next event, so protocol logic written against this clock runs
+ * unchanged, and as fast as the CPU allows, in simulation.
+ */
+#pragma once
+#include <stdint.h>
+
+uint64_t srtp_now_us(void);
+
+static inline uint64_t srtp_now_ms(void)
+{
+    return srtp_now_us() / 1000;
+}
+
+/* Switches to virtual time, starting at start_us. */
+void srtp_clock_virtual(uint64_t start_us);
+
+/* Moves virtual time forward to t_us; earlier times are ignored. */
+void srtp_clock_advance(uint64_t t_us);
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "srtp_cond.h"
+
+int srtp_cond_load(srtp_cond_t *c, const char *path, bool loop)
+{
+    char line[256];
+    int cap = 0;
+    FILE *fp = fopen(path, "r");
+
+    memset(c, 0, sizeof(*c));
+    if (!fp)
+        return -1;
+    while (fgets(line, sizeof(line), fp)) {
+        srtp_cond_row_t r = { .jit_ms = -1 };
+        if (line[0] == '#' ||
+            sscanf(line, "%lf %lf %lf %lf %lf", &r.t_ms, &r.kbps, &r.lat_ms, &r.loss_pct, &r.jit_ms) < 4)
+            continue;
+        if (r.t_ms < 0 || r.kbps < 0 || r.lat_ms < 0 || r.loss_pct < 0 || r.loss_pct > 100 ||
+            (c->n && r.t_ms < c->rows[c->n - 1].t_ms)) {
+            fclose(fp);
+            srtp_cond_free(c);
+            return -1;
+        }
+        if (c->n == cap) {
+            srtp_cond_row_t *rows = realloc(c->rows, sizeof(*rows) * (size_t)(cap = cap ? cap * 2 : 64));
+            if (!rows) {
+                fclose(fp);
+                srtp_cond_free(c);
+                return -1;
+            }
+            c->rows = rows;
+        }
+        c->rows[c->n++] = r;
+    }
+    fclose(fp);
+    if (c->n == 0)
+        return -1;
+    c->loop = loop;
+    /* the last row lasts as long as the gap before it */
+    c->period_ms = c->rows[c->n - 1].t_ms +
+                   (c->n > 1 ? c->rows[c->n - 1].t_ms - c->rows[c->n - 2].t_ms : 1000);
+    if (c->period_ms <= 0)
+        c->period_ms = 1000;
+    return 0;
+}
+
+const srtp_cond_row_t *srtp_cond_step(srtp_cond_t *c, double elapsed_ms)
+{
+    const srtp_cond_row_t *r = NULL;
+
+    for (;;) {
+        while (c->next < c->n && c->base_ms + c->rows[c->next].t_ms <= elapsed_ms)
+            r = &c->rows[c->next++];
+        if (!c->loop || c->next < c->n || c->base_ms + c->period_ms > elapsed_ms)
+            break;
+        /* the pass elapsed_ms is in, skipping whole passes nothing saw */
+        c->base_ms += c->period_ms * (double)(int64_t)((elapsed_ms - c->base_ms) / c->period_ms);
+        c->next = 0;
+    }
+    if (r)
+        c->steps++;
+    return r;
+}
+
+double srtp_cond_next_ms(const srtp_cond_t *c)
+{
+    if (c->next < c->n)
+        return c->base_ms + c->rows[c->next].t_ms;
+    return c->loop ? c->base_ms + c->period_ms : -1;
+}
+
+void srtp_cond_free(srtp_cond_t *c)
+{
+    free(c->rows);
+    c->rows = NULL;
+    c->n = 0;
+}
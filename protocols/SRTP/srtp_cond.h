@@ -0,0 +1,50 @@
+/*
+ * srtp_cond - time-varying network conditions for srtp_impair and
+ * srtp_sim: a trace of the bandwidth, delay and loss a profile goes
+ * through, e.g. a recorded 4G drive or a scripted congestion event.
+ *
+ * A trace is a text table like conf/test*.conf, '#' lines skipped, one
+ * row per change:
+ *
+ *   t_ms  bandwidth_kbps  latency_ms  loss_percent  [jitter_ms]
+ *
+ * Each row holds from its t_ms until the next one (sample and hold);
+ * bandwidth 0 means unlimited, as in the profiles, and a row without
+ * jitter keeps the one in force.  Rows must be in time order.  Past the
+ * last row the trace either stays there or, looped, starts over, the
+ * last row being held as long as the gap before it.
+ *
+ * The tools call srtp_cond_step() with the run's elapsed time before
+ * each batch of work; it moves a cursor and returns the row to apply, or
+ * NULL when nothing changed, so an update is a few stores between two
+ * packets and never stalls the packet path.
+ */
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+    double t_ms, kbps, lat_ms, loss_pct, jit_ms;   /* jit_ms < 0: unchanged */
+} srtp_cond_row_t;
+
+typedef struct {
+    srtp_cond_row_t *rows;
+    int n, next;                   /* next: first row not applied yet */
+    bool loop;
+    double period_ms;              /* length of one pass when looped */
+    double base_ms;                /* start of the current pass */
+    uint64_t steps;                /* rows applied so far */
+} srtp_cond_t;
+
+/* Reads a trace; 0 on success, -1 if it is missing, empty or out of order. */
+int srtp_cond_load(srtp_cond_t *c, const char *path, bool loop);
+
+/* The row that takes effect at elapsed_ms if it differs from the last
+ * one returned, else NULL.  elapsed_ms must not go back. */
+const srtp_cond_row_t *srtp_cond_step(srtp_cond_t *c, double elapsed_ms);
+
+/* Elapsed time of the next change, or -1 if there is none; lets a tool
+ * sleep no longer than that. */
+double srtp_cond_next_ms(const srtp_cond_t *c);
+
+void srtp_cond_free(srtp_cond_t *c);
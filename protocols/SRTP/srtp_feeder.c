@@ -0,0 +1,576 @@
+/*
+ * srtp_feeder - native sensor feeder for the SRTP server's sensor port.
+ *
+ * Emits sensor updates in the framing PRTP_server's parse_sensor_update()
+ * accepts: one flat dict per datagram whose keys and values are all quoted
+ * strings, e.g.
+ *
+ *     {'dev_id': 'temp_0', 'seq_no': '17', 'sensor_data': '21.38 C'}
+ *
+ * The server stops parsing at the first closing brace, so readings cannot
+ * be packed into one datagram; batching instead hands up to -b due
+ * datagrams to the kernel in a single sendmmsg() call.
+ *
+ * Input is either a schedule (-f file, "-" for stdin) with one reading per
+ * line:
+ *
+ *     <offset_us>\t<dev_id>\t<seq_no>\t<sensor_data>
+ *
+ * where sensor_data is already in wire form, or a synthetic workload of
+ * -n sensors publishing at -r Hz each for -d seconds.  Pacing is absolute
+ * (CLOCK_MONOTONIC deadlines), so lateness never accumulates.  With -S or
+ * -N the feeder steers each reading straight to the sensor port of the
+ * shard or cluster node that owns its dev_id on the consistent-hash ring
+ * (see srtp_ring.h), skipping the router hop.  A one-line JSON summary is
+ * printed to stdout on exit.
+ *
+ * With -F, synthetic camera readings become frames of that many bytes,
+ * split into fragment readings (see PRTP_FRAG_* in prtp_msg.h).  A frame
+ * is escaped once; every fragment datagram is then gathered from three
+ * iovecs (its own dict prefix and fragment header, a slice of the escaped
+ * frame, the closing quote) instead of being copied together.  Fragments
+ * leave in sendmmsg() batches, or with -G as UDP GSO super-datagrams: the
+ * seq_no is zero-padded so all but the last fragment have the same size.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/udp.h>
+#include "prtp_msg.h"
+#include "srtp_ring.h"
+
+#define MAX_BATCH     64
+#define MAX_FRAME     4096
+#define MAX_ID        64
+#define MAX_DATA      (MAX_FRAME - 128)
+#define MAX_TYPES     16
+#define MAX_SHARDS    64
+#define GSO_MAX_BYTES 65000
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT   103
+#endif
+
+typedef struct {
+    uint64_t due_us;
+    char dev_id[MAX_ID];
+    uint32_t seq_no;
+    int sensor;                /* synthetic sensor index */
+    int frame;                 /* camera frame: data unused, see send_frame() */
+    char data[MAX_DATA];
+} reading_t;
+
+typedef struct {
+    uint64_t sent;
+    uint64_t syscalls;
+    uint64_t errors;
+    uint64_t max_lag_us;
+    uint64_t bytes;
+    uint64_t frames, fragments, gso_sends;
+} feeder_stats_t;
+
+static volatile sig_atomic_t run = 1;
+static void handle_sig(int s) { (void)s; run = 0; }
+
+static uint64_t mono_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void sleep_until_us(uint64_t deadline_us)
+{
+    struct timespec ts;
+    ts.tv_sec = deadline_us / 1000000ULL;
+    ts.tv_nsec = (deadline_us % 1000000ULL) * 1000;
+    while (run && clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
+/* ---------- input sources ---------- */
+
+typedef struct {
+    FILE *fp;
+    /* synthetic workload */
+    int synthetic;
+    int num_sensors;
+    char types[MAX_TYPES][16];
+    int num_types;
+    uint64_t interval_ns;
+    uint64_t total;
+    uint64_t produced;
+    int camera_bytes;
+    int frame_bytes;
+    double *temp;
+    uint32_t *seq;
+} source_t;
+
+static int next_from_schedule(source_t *src, reading_t *r)
+{
+    char line[MAX_FRAME];
+
+    while (fgets(line, sizeof(line), src->fp)) {
+        char *p = line, *f[4];
+        int n = 0;
+
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+        line[strcspn(line, "\r\n")] = '\0';
+        while (n < 4 && p) {
+            f[n++] = p;
+            p = (n < 4) ? strchr(p, '\t') : NULL;
+            if (p)
+                *p++ = '\0';
+        }
+        if (n < 4) {
+            fprintf(stderr, "srtp_feeder: malformed schedule line skipped\n");
+            continue;
+        }
+        r->due_us = strtoull(f[0], NULL, 10);
+        snprintf(r->dev_id, sizeof(r->dev_id), "%s", f[1]);
+        r->seq_no = (uint32_t)strtoul(f[2], NULL, 10);
+        snprintf(r->data, sizeof(r->data), "%s", f[3]);
+        return 1;
+    }
+    return 0;
+}
+
+static void synth_value(source_t *src, int idx, const char *type, char *out, size_t len)
+{
+    if (strcmp(type, "temp") == 0) {
+        /* bounded random walk around 22 C; the server scans "%d.%d C" */
+        double t = src->temp[idx] + ((rand() % 21) - 10) / 100.0;
+        if (t < 0.5) t = 0.5;
+        if (t > 45.0) t = 45.0;
+        src->temp[idx] = t;
+        snprintf(out, len, "%.2f C", t);
+    } else if (strcmp(type, "device") == 0) {
+        snprintf(out, len, "%s", (rand() & 1) ? "ON" : "OFF");
+    } else if (strcmp(type, "gps") == 0) {
+        snprintf(out, len, "[%.6f, %.6f]",
+                 23.8 + (rand() % 10000) / 1e5, 90.4 + (rand() % 10000) / 1e5);
+    } else if (strcmp(type, "camera") == 0) {
+        /* binary frame bytes, escaped as \xHH inside the quoted value */
+        size_t o = 0;
+        for (int i = 0; i < src->camera_bytes && o + 4 < len; i++)
+            o += snprintf(out + o, len - o, "\\x%02x", rand() & 0xff);
+        out[o] = '\0';
+    } else {
+        snprintf(out, len, "%d", rand() % 100);
+    }
+}
+
+static int next_synthetic(source_t *src, reading_t *r)
+{
+    int idx;
+    const char *type;
+
+    if (src->produced >= src->total)
+        return 0;
+    idx = (int)(src->produced % (uint64_t)src->num_sensors);
+    type = src->types[idx % src->num_types];
+    r->due_us = src->produced * src->interval_ns / 1000ULL;
+    snprintf(r->dev_id, sizeof(r->dev_id), "%s_%d", type, idx);
+    r->sensor = idx;
+    r->frame = src->frame_bytes > 0 && strcmp(type, "camera") == 0;
+    if (r->frame)
+        r->seq_no = src->seq[idx], r->data[0] = '\0';
+    else
+        r->seq_no = ++src->seq[idx], synth_value(src, idx, type, r->data, sizeof(r->data));
+    src->produced++;
+    return 1;
+}
+
+static int next_reading(source_t *src, reading_t *r)
+{
+    return src->synthetic ? next_synthetic(src, r) : next_from_schedule(src, r);
+}
+
+/* ---------- framing ---------- */
+
+static int frame_reading(const reading_t *r, char *buf, size_t len)
+{
+    int n = snprintf(buf, len, "{'dev_id': '%s', 'seq_no': '%u', 'sensor_data': '%s'}",
+                     r->dev_id, r->seq_no, r->data);
+    return (n < 0 || (size_t)n >= len) ? -1 : n;
+}
+
+/* ---------- camera frames ---------- */
+
+/*
+ * Sends one frame of len random bytes as fragment readings of dev_id,
+ * numbered on from *seq, pausing gap_us between bursts so the server's
+ * socket buffer is not overrun.  gso is cleared if the kernel rejects
+ * UDP_SEGMENT.
+ */
+static void send_frame(int fd, const struct sockaddr_in *dst, const char *dev_id,
+                       uint32_t *seq, size_t len, int gap_us, int *gso, feeder_stats_t *st)
+{
+    static char *esc;
+    static size_t esc_cap;
+    static char heads[MAX_BATCH][MAX_ID + 96];
+    static const char tail[] = "'}";
+    static uint16_t frame_id;
+    struct iovec iov[MAX_BATCH * 3];
+    struct mmsghdr msgs[MAX_BATCH];
+    int total = (int)((len + PRTP_FRAG_DATA - 1) / PRTP_FRAG_DATA), per_send = MAX_BATCH;
+    /* every fragment but the last: prefix, 8 escaped header bytes, data, tail */
+    size_t seg = (size_t)snprintf(NULL, 0, "{'dev_id': '%s', 'seq_no': '%010u', 'sensor_data': '",
+                                  dev_id, 0u) + 4 * (PRTP_FRAG_HDR + PRTP_FRAG_DATA) + 2;
+
+    if (total < 1 || total > 0xffff)
+        return;
+    if (esc_cap < len * 4) {
+        free(esc);
+        esc_cap = len * 4;
+        if (!(esc = malloc(esc_cap))) {
+            esc_cap = 0;
+            st->errors++;
+            return;
+        }
+    }
+    for (size_t i = 0; i < len; i++) {
+        static const char hex[] = "0123456789abcdef";
+        int b = rand() & 0xff;
+        memcpy(esc + 4 * i, "\\x", 2);
+        esc[4 * i + 2] = hex[b >> 4];
+        esc[4 * i + 3] = hex[b & 15];
+    }
+    frame_id++;
+
+    if (*gso && per_send > (int)(GSO_MAX_BYTES / seg))
+        per_send = (int)(GSO_MAX_BYTES / seg);
+    memset(msgs, 0, sizeof(msgs));
+    for (int f = 0; f < total; ) {
+        size_t bytes = 0;
+        int n = 0, rc;
+
+        if (f && gap_us > 0)
+            usleep((useconds_t)gap_us);
+        for (; n < per_send && f < total; n++, f++) {
+            size_t off = (size_t)f * PRTP_FRAG_DATA;
+            size_t chunk = len - off < PRTP_FRAG_DATA ? len - off : PRTP_FRAG_DATA;
+            uint8_t h[PRTP_FRAG_HDR] = {
+                PRTP_FRAG_MAGIC >> 8, PRTP_FRAG_MAGIC & 0xff, frame_id >> 8, frame_id & 0xff,
+                f >> 8, f & 0xff, total >> 8, total & 0xff,
+            };
+            int hl = snprintf(heads[n], sizeof(heads[n]),
+                              "{'dev_id': '%s', 'seq_no': '%010u', 'sensor_data': '",
+                              dev_id, ++*seq);
+
+            for (int k = 0; k < PRTP_FRAG_HDR; k++)
+                hl += snprintf(heads[n] + hl, sizeof(heads[n]) - hl, "\\x%02x", h[k]);
+            iov[3 * n] = (struct iovec){ heads[n], (size_t)hl };
+            iov[3 * n + 1] = (struct iovec){ esc + 4 * off, 4 * chunk };
+            iov[3 * n + 2] = (struct iovec){ (void *)tail, 2 };
+            bytes += (size_t)hl + 4 * chunk + 2;
+            msgs[n].msg_hdr.msg_iov = &iov[3 * n];
+            msgs[n].msg_hdr.msg_iovlen = 3;
+            msgs[n].msg_hdr.msg_name = (void *)dst;
+            msgs[n].msg_hdr.msg_namelen = dst ? sizeof(*dst) : 0;
+        }
+
+        if (*gso) {
+            /* one super-datagram, split by the kernel every seg bytes */
+            char cbuf[CMSG_SPACE(sizeof(uint16_t))] = { 0 };
+            struct msghdr mh = msgs[0].msg_hdr;
+            struct cmsghdr *cm;
+
+            mh.msg_iovlen = 3 * (size_t)n;
+            mh.msg_control = cbuf;
+            mh.msg_controllen = sizeof(cbuf);
+            cm = CMSG_FIRSTHDR(&mh);
+            cm->cmsg_level = SOL_UDP;
+            cm->cmsg_type = UDP_SEGMENT;
+            cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            *(uint16_t *)CMSG_DATA(cm) = (uint16_t)seg;
+            st->syscalls++;
+            if (sendmsg(fd, &mh, 0) >= 0) {
+                st->gso_sends++;
+                st->sent += (uint64_t)n;
+                st->fragments += (uint64_t)n;
+                st->bytes += bytes;
+                continue;
+            }
+            if (errno != EIO && errno != EINVAL && errno != ENOPROTOOPT) {
+                st->errors += (uint64_t)n;
+                continue;
+            }
+            *gso = 0;                          /* no GSO here: resend as sendmmsg */
+        }
+        for (int off = 0; off < n; ) {
+            rc = sendmmsg(fd, msgs + off, (unsigned)(n - off), 0);
+            st->syscalls++;
+            if (rc < 0) {
+                if (errno == EINTR)
+                    continue;
+                st->errors++;
+                off++;
+                continue;
+            }
+            for (int i = off; i < off + rc; i++)
+                st->bytes += iov[3 * i].iov_len + iov[3 * i + 1].iov_len + 2;
+            st->sent += (uint64_t)rc;
+            st->fragments += (uint64_t)rc;
+            off += rc;
+        }
+    }
+    st->frames++;
+}
+
+/* ---------- main loop ---------- */
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [-i server_ip] [-p sensor_port] [-b batch]\n"
+        "          (-f schedule | -n sensors [-t types] [-r rate_hz] [-d duration_s]\n"
+        "           [-c camera_bytes | -F frame_bytes [-G] [-g gap_us]])\n"
+        "\t-f <file>\tReplay a schedule file (\"-\" reads stdin)\n"
+        "\t-n <count>\tSynthetic mode: number of sensor ids\n"
+        "\t-t <list>\tComma separated sensor types, default temp,device,gps,camera\n"
+        "\t-r <hz>\t\tPer-sensor publish rate, default 1\n"
+        "\t-d <sec>\tSynthetic run duration, default 10\n"
+        "\t-c <bytes>\tCamera frame size in synthetic mode, default 128\n"
+        "\t-F <bytes>\tSend synthetic camera frames of this size as fragment readings\n"
+        "\t-G\t\tSend fragments as UDP GSO super-datagrams (falls back to sendmmsg)\n"
+        "\t-g <us>\t\tPause between fragment bursts of one frame, default 0\n"
+        "\t-b <n>\t\tMax datagrams per sendmmsg() call (1-%d), default 1\n"
+        "\t-S <n>\t\tSend straight to n local shards, sensor port -P base + 2k\n"
+        "\t-P <port>\tShard base port, default 6000\n"
+        "\t-N <ip:port>\tSend straight to cluster node sensor ports (numeric ip), repeatable\n",
+        prog, MAX_BATCH);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *ip = "127.0.0.1";
+    const char *schedule = NULL;
+    const char *types = "temp,device,gps,camera";
+    int port = 5004, batch = 1, shards = 0, shard_base = 6000, gso = 0, gap_us = 0, opt;
+    double rate_hz = 1.0, duration_s = 10.0;
+    source_t src;
+    feeder_stats_t st;
+    struct sockaddr_in servaddr, shard_addr[MAX_SHARDS];
+    char node_name[MAX_SHARDS][SRTP_NODE_NAME_MAX];
+    const char *names[MAX_SHARDS];
+    int nnodes = 0;
+    srtp_ring_t ring = { NULL, 0 };
+    int sockfd;
+
+    memset(&src, 0, sizeof(src));
+    memset(&st, 0, sizeof(st));
+    src.camera_bytes = 128;
+
+    while ((opt = getopt(argc, argv, "i:p:f:n:t:r:d:c:F:Gg:b:S:P:N:h")) != -1) {
+        switch (opt) {
+        case 'i': ip = optarg; break;
+        case 'p': port = atoi(optarg); break;
+        case 'f': schedule = optarg; break;
+        case 'n': src.num_sensors = atoi(optarg); break;
+        case 't': types = optarg; break;
+        case 'r': rate_hz = atof(optarg); break;
+        case 'd': duration_s = atof(optarg); break;
+        case 'c': src.camera_bytes = atoi(optarg); break;
+        case 'F': src.frame_bytes = atoi(optarg); break;
+        case 'G': gso = 1; break;
+        case 'g': gap_us = atoi(optarg); break;
+        case 'b': batch = atoi(optarg); break;
+        case 'S': shards = atoi(optarg); break;
+        case 'P': shard_base = atoi(optarg); break;
+        case 'N': {
+            char nip[32];
+            int nport;
+            if (nnodes >= MAX_SHARDS || sscanf(optarg, "%31[^:]:%d", nip, &nport) != 2 ||
+                inet_pton(AF_INET, nip, &shard_addr[nnodes].sin_addr) != 1 ||
+                nport < 1 || nport > 65535) {
+                fprintf(stderr, "srtp_feeder: bad node '%s'\n", optarg);
+                return 1;
+            }
+            shard_addr[nnodes].sin_family = AF_INET;
+            shard_addr[nnodes].sin_port = htons(nport);
+            snprintf(node_name[nnodes], sizeof(node_name[0]), "%s:%d", nip, nport);
+            nnodes++;
+            break;
+        }
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (port < 1 || port > 65535 || batch < 1 || batch > MAX_BATCH ||
+        shards < 0 || nnodes + shards > MAX_SHARDS || shard_base + 2 * shards > 65535 ||
+        (!schedule && (src.num_sensors < 1 || rate_hz <= 0.0))) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (schedule) {
+        src.fp = strcmp(schedule, "-") == 0 ? stdin : fopen(schedule, "r");
+        if (!src.fp) {
+            perror(schedule);
+            return 1;
+        }
+    } else {
+        char tmp[256], *tok, *save = NULL;
+        snprintf(tmp, sizeof(tmp), "%s", types);
+        for (tok = strtok_r(tmp, ",", &save); tok && src.num_types < MAX_TYPES;
+             tok = strtok_r(NULL, ",", &save))
+            snprintf(src.types[src.num_types++], sizeof(src.types[0]), "%s", tok);
+        if (src.num_types == 0) {
+            usage(argv[0]);
+            return 1;
+        }
+        src.synthetic = 1;
+        src.interval_ns = (uint64_t)(1e9 / (rate_hz * src.num_sensors));
+        src.total = (uint64_t)(duration_s * rate_hz * src.num_sensors);
+        src.temp = calloc(src.num_sensors, sizeof(double));
+        src.seq = calloc(src.num_sensors, sizeof(uint32_t));
+        if (!src.temp || !src.seq) {
+            perror("calloc");
+            return 1;
+        }
+        for (int i = 0; i < src.num_sensors; i++)
+            src.temp[i] = 20.0 + (rand() % 500) / 100.0;
+    }
+
+    memset(&servaddr, 0, sizeof(servaddr));
+    servaddr.sin_family = AF_INET;
+    servaddr.sin_port = htons(port);
+    if (inet_pton(AF_INET, ip, &servaddr.sin_addr) != 1) {
+        struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_DGRAM }, *res;
+        if (getaddrinfo(ip, NULL, &hints, &res) != 0) {
+            fprintf(stderr, "srtp_feeder: cannot resolve %s\n", ip);
+            return 1;
+        }
+        servaddr.sin_addr = ((struct sockaddr_in *)res->ai_addr)->sin_addr;
+        freeaddrinfo(res);
+    }
+
+    /* Node names must match the router's ("ip:sensor_port") to agree on owners */
+    for (int k = 0; k < shards; k++) {
+        char nip[INET_ADDRSTRLEN];
+        shard_addr[nnodes] = servaddr;
+        shard_addr[nnodes].sin_port = htons(shard_base + 2 * k);
+        inet_ntop(AF_INET, &servaddr.sin_addr, nip, sizeof(nip));
+        snprintf(node_name[nnodes], sizeof(node_name[0]), "%s:%d", nip, shard_base + 2 * k);
+        nnodes++;
+    }
+    for (int k = 0; k < nnodes; k++)
+        names[k] = node_name[k];
+    if (nnodes > 0 && srtp_ring_init(&ring, names, nnodes) < 0) {
+        perror("srtp_ring_init");
+        return 1;
+    }
+
+    /* Single destination: a connected socket saves a route lookup per send */
+    sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sockfd < 0 ||
+        (nnodes == 0 && connect(sockfd, (struct sockaddr *)&servaddr, sizeof(servaddr)) < 0)) {
+        perror("socket");
+        return 1;
+    }
+
+    signal(SIGTERM, handle_sig);
+    signal(SIGINT, handle_sig);
+    signal(SIGPIPE, SIG_IGN);
+
+    static char frames[MAX_BATCH][MAX_FRAME];
+    struct mmsghdr msgs[MAX_BATCH];
+    struct iovec iov[MAX_BATCH];
+    reading_t pending;
+    int have_pending = next_reading(&src, &pending);
+    uint64_t start_us = mono_us();
+
+    memset(msgs, 0, sizeof(msgs));
+    while (run && have_pending) {
+        uint64_t now, due = start_us + pending.due_us;
+        int n = 0;
+
+        if (mono_us() < due)
+            sleep_until_us(due);
+        now = mono_us();
+
+        /* Gather every reading that is already due, up to the batch size. */
+        while (run && have_pending && n < batch && start_us + pending.due_us <= now) {
+            int len;
+            uint64_t lag = now - (start_us + pending.due_us);
+
+            if (pending.frame) {
+                if (n > 0)
+                    break;                 /* send the readings gathered so far first */
+                send_frame(sockfd,
+                           nnodes > 0 ? &shard_addr[srtp_ring_owner(&ring, pending.dev_id)] : NULL,
+                           pending.dev_id, &src.seq[pending.sensor],
+                           (size_t)src.frame_bytes, gap_us, &gso, &st);
+                if (lag > st.max_lag_us)
+                    st.max_lag_us = lag;
+                have_pending = next_reading(&src, &pending);
+                continue;
+            }
+            len = frame_reading(&pending, frames[n], MAX_FRAME);
+            if (lag > st.max_lag_us)
+                st.max_lag_us = lag;
+            if (len > 0) {
+                iov[n].iov_base = frames[n];
+                iov[n].iov_len = (size_t)len;
+                msgs[n].msg_hdr.msg_iov = &iov[n];
+                msgs[n].msg_hdr.msg_iovlen = 1;
+                if (nnodes > 0) {
+                    int k = srtp_ring_owner(&ring, pending.dev_id);
+                    msgs[n].msg_hdr.msg_name = &shard_addr[k];
+                    msgs[n].msg_hdr.msg_namelen = sizeof(shard_addr[k]);
+                }
+                n++;
+            } else {
+                st.errors++;
+            }
+            have_pending = next_reading(&src, &pending);
+        }
+        if (n == 0)
+            continue;
+
+        for (int off = 0; off < n; ) {
+            int rc = sendmmsg(sockfd, msgs + off, (unsigned)(n - off), 0);
+            st.syscalls++;
+            if (rc < 0) {
+                if (errno == EINTR)
+                    continue;
+                /* ECONNREFUSED etc.: count the datagram as lost and move on */
+                st.errors++;
+                off++;
+                continue;
+            }
+            for (int i = off; i < off + rc; i++)
+                st.bytes += iov[i].iov_len;
+            st.sent += (uint64_t)rc;
+            off += rc;
+        }
+    }
+
+    double elapsed = (mono_us() - start_us) / 1e6;
+    printf("{\"sent\": %lu, \"syscalls\": %lu, \"errors\": %lu, \"bytes\": %lu, "
+           "\"elapsed_s\": %.3f, \"max_lag_us\": %lu, \"frames\": %lu, \"fragments\": %lu, "
+           "\"gso_sends\": %lu}\n",
+           (unsigned long)st.sent, (unsigned long)st.syscalls, (unsigned long)st.errors,
+           (unsigned long)st.bytes, elapsed, (unsigned long)st.max_lag_us,
+           (unsigned long)st.frames, (unsigned long)st.fragments, (unsigned long)st.gso_sends);
+    fflush(stdout);
+
+    if (src.fp && src.fp != stdin)
+        fclose(src.fp);
+    free(src.temp);
+    free(src.seq);
+    srtp_ring_free(&ring);
+    close(sockfd);
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "srtp_ge.h"
+
+int srtp_ge_load_conf(const char *path, int row, double *delay_ms, srtp_ge_params_t *pm)
+{
+    char line[256];
+    FILE *fp = fopen(path, "r");
+    int n = 0;
+
+    if (!fp)
+        return -1;
+    while (fgets(line, sizeof(line), fp)) {
+        double d, p, q;
+        if (line[0] == '#' || sscanf(line, "%lf %lf %lf", &d, &p, &q) != 3)
+            continue;
+        if (n++ == row) {
+            fclose(fp);
+            if (p < 0 || p > 1 || q < 0 || q > 1)
+                return -1;
+            *delay_ms = d;
+            pm->p = p;
+            pm->q = q;
+            pm->loss_bad = 1;
+            return 0;
+        }
+    }
+    fclose(fp);
+    return -1;
+}
+
+int srtp_ge_parse(const char *spec, double *delay_ms, srtp_ge_params_t *pm)
+{
+    char path[512];
+    const char *colon = strrchr(spec, ':');
+    size_t len;
+
+    if (!colon || (len = (size_t)(colon - spec)) >= sizeof(path))
+        return -1;
+    memcpy(path, spec, len);
+    path[len] = '\0';
+    return srtp_ge_load_conf(path, atoi(colon + 1), delay_ms, pm);
+}
+
+void srtp_ge_print(FILE *out, const srtp_ge_params_t *pm, const srtp_ge_hist_t *h)
+{
+    double c = (1 - pm->q) * pm->loss_bad;
+    double loss = pm->p + pm->q > 0 ? pm->loss_bad * pm->p / (pm->p + pm->q) : 0;
+    uint64_t bursts = 0;
+
+    for (int i = 0; i < SRTP_GE_HIST; i++)
+        bursts += h->bursts[i];
+    fprintf(out, "{\"p\": %g, \"q\": %g, \"loss_bad\": %g, \"packets\": %lu, \"lost\": %lu, "
+            "\"configured_loss\": %.4f, \"observed_loss\": %.4f, "
+            "\"configured_mean_burst\": %.3f, \"observed_mean_burst\": %.3f, \"bursts\": [",
+            pm->p, pm->q, pm->loss_bad, (unsigned long)h->packets, (unsigned long)h->lost,
+            loss, h->packets ? (double)h->lost / (double)h->packets : 0.0,
+            c < 1 ? 1 / (1 - c) : 0.0, bursts ? (double)h->lost / (double)bursts : 0.0);
+    for (int i = 0; i < SRTP_GE_HIST; i++)
+        fprintf(out, "%s%lu", i ? ", " : "", (unsigned long)h->bursts[i]);
+    /* expected counts for as many bursts, the last bucket taking the tail */
+    fprintf(out, "], \"configured_bursts\": [");
+    for (int i = 0; i < SRTP_GE_HIST; i++) {
+        double pn = i < SRTP_GE_HIST - 1 ? (1 - c) * pow(c, i) : pow(c, i);
+        fprintf(out, "%s%.1f", i ? ", " : "", (double)bursts * pn);
+    }
+    fprintf(out, "]}");
+}
@@ -0,0 +1,73 @@
+/*
+ * srtp_ge - Gilbert-Elliott burst loss for srtp_impair and srtp_sim, the
+ * model behind the "delay(ms) p_prob q_prob" rows of conf/test*.conf.
+ *
+ * A link is either good or bad.  Before each packet it moves good->bad
+ * with p and bad->good with q; a packet is lost in the bad state with
+ * loss_bad (1 in the conf tables) and never in the good one.  So the
+ * long-run loss is loss_bad * p / (p + q), and a burst of consecutive
+ * losses goes on with c = (1 - q) * loss_bad after each of its packets:
+ * geometric, P(n) = (1 - c) c^(n-1), mean 1 / (1 - c).
+ *
+ * The state is per link (srtp_impair: per flow and direction); bursts are
+ * counted into a shared srtp_ge_hist_t, the last bucket holding all of
+ * SRTP_GE_HIST packets or more, so observed and configured burst lengths
+ * can be reported side by side (srtp_ge_print).
+ */
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#define SRTP_GE_HIST 16
+
+typedef struct {
+    double p, q, loss_bad;
+} srtp_ge_params_t;
+
+typedef struct {
+    bool bad;
+    uint32_t run;                  /* losses in a row so far */
+} srtp_ge_t;
+
+typedef struct {
+    uint64_t packets, lost;
+    uint64_t bursts[SRTP_GE_HIST];
+} srtp_ge_hist_t;
+
+static inline void srtp_ge_end_burst(srtp_ge_t *g, srtp_ge_hist_t *h)
+{
+    if (g->run)
+        h->bursts[(g->run < SRTP_GE_HIST ? g->run : SRTP_GE_HIST) - 1]++;
+    g->run = 0;
+}
+
+/* Moves g one packet on and returns whether that packet is lost; rnd
+ * returns uniform numbers in [0, 1). */
+static inline bool srtp_ge_lose(srtp_ge_t *g, const srtp_ge_params_t *pm, srtp_ge_hist_t *h,
+                                double (*rnd)(void))
+{
+    bool lost;
+
+    g->bad = g->bad ? rnd() >= pm->q : rnd() < pm->p;
+    lost = g->bad && (pm->loss_bad >= 1 || rnd() < pm->loss_bad);
+    h->packets++;
+    if (lost) {
+        h->lost++;
+        g->run++;
+    } else {
+        srtp_ge_end_burst(g, h);
+    }
+    return lost;
+}
+
+/* Reads row (0-based, comments skipped) of a conf/test*.conf table into
+ * *delay_ms and pm, with loss_bad 1.  0 on success, -1 if absent. */
+int srtp_ge_load_conf(const char *path, int row, double *delay_ms, srtp_ge_params_t *pm);
+
+/* "file:row" form of srtp_ge_load_conf, as the tools take it. */
+int srtp_ge_parse(const char *spec, double *delay_ms, srtp_ge_params_t *pm);
+
+/* Writes pm and h as a JSON object: configured and observed loss, mean
+ * burst length and burst-length distribution. */
+void srtp_ge_print(FILE *out, const srtp_ge_params_t *pm, const srtp_ge_hist_t *h);
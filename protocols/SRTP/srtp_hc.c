@@ -0,0 +1,179 @@
+#include <stdlib.h>
+#include <string.h>
+#include "prtp_msg.h"
+#include "srtp_hc.h"
+
+/* Equal bytes between two differing ones that stay inside one run: a new
+ * run would cost at least two header bytes. */
+#define MERGE_GAP 2
+
+static size_t put_varint(uint8_t *p, uint32_t v)
+{
+    size_t n = 0;
+
+    while (v >= 0x80) {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+static int get_varint(const uint8_t **p, const uint8_t *end, uint32_t *v)
+{
+    uint32_t r = 0;
+
+    for (int shift = 0; shift < 35; shift += 7) {
+        uint8_t b;
+        if (*p >= end)
+            return -1;
+        b = *(*p)++;
+        r |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *v = r;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static uint32_t rd32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void wr32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+}
+
+static int refresh(srtp_hc_ctx_t *c, const uint8_t *pkt, size_t len, size_t seq_off, size_t ts_off)
+{
+    if (len > c->cap) {
+        uint8_t *ref = realloc(c->ref, len);
+        if (!ref)
+            return -1;
+        c->ref = ref;
+        c->cap = (uint16_t)len;
+    }
+    memcpy(c->ref, pkt, len);
+    c->len = (uint16_t)len;
+    c->seq_off = (uint16_t)seq_off;
+    c->ts_off = (uint16_t)ts_off;
+    c->seq = rd32(pkt + seq_off);
+    c->ts = ts_off ? rd32(pkt + ts_off) : 0;
+    c->valid = true;
+    return 0;
+}
+
+/* Whether byte i of an update matches the reference; seq_no and the
+ * timestamp travel as deltas instead. */
+static bool same(const srtp_hc_ctx_t *c, const uint8_t *pkt, size_t i)
+{
+    if ((i >= c->seq_off && i < c->seq_off + 4u) || (c->ts_off && i >= c->ts_off && i < c->ts_off + 4u))
+        return true;
+    return pkt[i] == c->ref[i];
+}
+
+size_t srtp_hc_compress(srtp_hc_ctx_t *c, uint8_t cid, const uint8_t *pkt, size_t len,
+                        uint8_t *out, size_t cap)
+{
+    size_t seq_off, ts_off, n = 4, last = 0;
+
+    if (cid == 0 || len > PRTP_MAX_PKT || prtp_header_offsets(pkt, len, &seq_off, &ts_off) < 0)
+        return 0;
+    out[0] = SRTP_HC_MAGIC;
+    out[2] = cid;
+    if (c->valid && len == c->len && seq_off == c->seq_off && ts_off == c->ts_off && cap >= 14) {
+        out[1] = SRTP_HC_CO;
+        out[3] = c->gen;
+        n += put_varint(out + n, rd32(pkt + seq_off) - c->seq);
+        if (ts_off) {
+            int32_t d = (int32_t)(rd32(pkt + ts_off) - c->ts);
+            n += put_varint(out + n, ((uint32_t)d << 1) ^ (uint32_t)(d >> 31));
+        }
+        for (size_t i = 0; i < len && n < len + 4; ) {
+            size_t start, end, j;
+            if (same(c, pkt, i)) {
+                i++;
+                continue;
+            }
+            start = i;
+            end = i + 1;
+            for (j = end; j < len && (!same(c, pkt, j) || j - end < MERGE_GAP); j++)
+                if (!same(c, pkt, j))
+                    end = j + 1;
+            if (n + 6 + (end - start) > cap || n + 6 + (end - start) >= len + 4) {
+                n = len + 4;           /* no smaller than an IR: send that */
+                break;
+            }
+            n += put_varint(out + n, (uint32_t)(start - last));
+            n += put_varint(out + n, (uint32_t)(end - start));
+            memcpy(out + n, pkt + start, end - start);
+            n += end - start;
+            last = i = end;
+        }
+        if (n < len + 4)
+            return n;
+    } else if (c->valid && (int32_t)(rd32(pkt + seq_off) - c->seq) <= 0) {
+        return 0;                      /* a retransmit in another layout: keep the reference */
+    }
+    if (cap < len + 4 || refresh(c, pkt, len, seq_off, ts_off) < 0)
+        return 0;
+    out[1] = SRTP_HC_IR;
+    out[3] = ++c->gen;
+    memcpy(out + 4, pkt, len);
+    return len + 4;
+}
+
+int srtp_hc_decompress(srtp_hc_ctx_t *ctxs, const uint8_t *in, size_t len,
+                       uint8_t *out, size_t cap)
+{
+    const uint8_t *p = in + 4, *end = in + len;
+    srtp_hc_ctx_t *c;
+    uint32_t dseq, dts = 0, skip, count;
+    size_t pos = 0;
+
+    if (!srtp_hc_is_compressed(in, len))
+        return -1;
+    c = &ctxs[in[2]];
+    if (in[1] == SRTP_HC_IR) {
+        size_t seq_off, ts_off;
+        if (len - 4 > cap || prtp_header_offsets(p, len - 4, &seq_off, &ts_off) < 0 ||
+            refresh(c, p, len - 4, seq_off, ts_off) < 0)
+            return -1;
+        c->gen = in[3];
+        memcpy(out, p, len - 4);
+        return (int)(len - 4);
+    }
+    if (in[1] != SRTP_HC_CO)
+        return -1;
+    if (!c->valid || c->gen != in[3])
+        return SRTP_HC_DAMAGED;
+    if (c->len > cap || get_varint(&p, end, &dseq) < 0 ||
+        (c->ts_off && get_varint(&p, end, &dts) < 0))
+        return -1;
+    memcpy(out, c->ref, c->len);
+    while (p < end) {
+        if (get_varint(&p, end, &skip) < 0 || get_varint(&p, end, &count) < 0 ||
+            pos + skip + count > c->len || count > (size_t)(end - p))
+            return -1;
+        pos += skip;
+        memcpy(out + pos, p, count);
+        p += count;
+        pos += count;
+    }
+    wr32(out + c->seq_off, c->seq + dseq);
+    if (c->ts_off)
+        wr32(out + c->ts_off, c->ts + (uint32_t)((int32_t)(dts >> 1) ^ -(int32_t)(dts & 1)));
+    return c->len;
+}
+
+void srtp_hc_free(srtp_hc_ctx_t *ctxs, int n)
+{
+    for (int i = 0; i < n; i++)
+        free(ctxs[i].ref);
+}
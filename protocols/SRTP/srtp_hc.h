@@ -0,0 +1,76 @@
+/*
+ * srtp_hc - header compression of PRTP updates towards a subscriber, in
+ * the spirit of ROHC's unidirectional mode.
+ *
+ * Every update of a flow (one client, one sid) repeats the same BSON
+ * layout: the header keys, the sid, the sensor type and the data keys,
+ * with only seq_no, the timestamp and the reading changing.  Both ends
+ * keep a context per flow, numbered 1..255 per client (the context id):
+ *
+ *   IR   magic, SRTP_HC_IR, cid, generation, then the update as it is.
+ *        Both ends store it as the context's reference.
+ *   CO   magic, SRTP_HC_CO, cid, generation, seq_no - ref seq_no
+ *        (varint), timestamp - ref timestamp (zigzag varint, only if the
+ *        reference has one), then the bytes that differ from the
+ *        reference as (skip, count, bytes) runs, all varints.
+ *
+ * Every CO is coded against the IR, never against the previous CO, so a
+ * lost CO damages nothing.  An IR is sent when a flow starts, when its
+ * layout changes (a different length or header) and when the receiver
+ * asks; an update no newer than the reference whose layout differs (a
+ * retransmit) goes out uncompressed instead, so it cannot thrash the
+ * reference.  The receiver asks by dropping a CO whose context or
+ * generation it does not hold (its IR was lost) and sending
+ * PRTP_HC_RESYNC with the cid.
+ *
+ * A compressed datagram starts with SRTP_HC_MAGIC, a byte with the top
+ * bit set and a non-zero cid, so read as a BSON length it would exceed
+ * PRTP_MAX_PKT: plain PRTP messages and compressed updates share the
+ * client port unambiguously.
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define SRTP_HC_MAGIC    0xC5
+#define SRTP_HC_IR       0x80
+#define SRTP_HC_CO       0x81
+#define SRTP_HC_CONTEXTS 256       /* cid 0 is not used */
+#define SRTP_HC_DAMAGED  (-2)
+
+typedef struct {
+    uint8_t *ref;                  /* the update of the last IR */
+    uint16_t len, cap;
+    uint8_t gen;                   /* IR generation, carried by every packet */
+    bool valid;
+    uint32_t seq, ts;              /* ref's seq_no and timestamp */
+    uint16_t seq_off, ts_off;      /* their value offsets in ref, ts_off 0 if none */
+} srtp_hc_ctx_t;
+
+static inline bool srtp_hc_is_compressed(const uint8_t *buf, size_t len)
+{
+    return len >= 4 && buf[0] == SRTP_HC_MAGIC && (buf[1] & 0x80) && buf[2] != 0;
+}
+
+/* Codes update pkt of context cid into out: an IR if the context is not
+ * valid or no longer matches the layout, else a CO.  Returns the length,
+ * or 0 if pkt is to be sent as it is: not an update the codec handles,
+ * a retransmit in another layout, or out too small. */
+size_t srtp_hc_compress(srtp_hc_ctx_t *c, uint8_t cid, const uint8_t *pkt, size_t len,
+                        uint8_t *out, size_t cap);
+
+/* Restores the update a compressed datagram carries into out, with
+ * ctxs indexed by cid.  Returns its length, -1 if malformed, or
+ * SRTP_HC_DAMAGED if the context is missing or of another generation. */
+int srtp_hc_decompress(srtp_hc_ctx_t *ctxs, const uint8_t *in, size_t len,
+                       uint8_t *out, size_t cap);
+
+/* Forces an IR for the next update of c. */
+static inline void srtp_hc_invalidate(srtp_hc_ctx_t *c)
+{
+    c->valid = false;
+}
+
+/* Releases the references of n contexts. */
+void srtp_hc_free(srtp_hc_ctx_t *ctxs, int n);
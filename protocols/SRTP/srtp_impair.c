@@ -0,0 +1,1138 @@
+/*
+ * srtp_impair - user-space network impairment relay, an alternative to
+ * NetworkEmulator's `sudo tc qdisc ... netem` that needs no root and
+ * shapes every flow on its own.
+ *
+ * Listens on -l port and relays to -u ip:port: UDP datagrams, or with -t
+ * a TCP byte stream.  A UDP flow is one client address and gets its own
+ * upstream socket, so replies find their way back; a TCP flow is one
+ * connection.  Each direction of a flow gets
+ *
+ *   loss        each datagram dropped with -X percent, or in bursts by
+ *               the Gilbert-Elliott model of srtp_ge.h with -g (UDP only)
+ *   corruption  one random bit of a datagram flipped with -C percent, as
+ *               netem does (UDP only: over TCP it would only show up as a
+ *               retransmit the kernel makes anyway)
+ *   bandwidth   a token bucket of -B kbps with -K bytes of burst: a packet
+ *               that finds no tokens waits for them, up to -Q ms of
+ *               backlog, past which UDP datagrams are tail-dropped and a
+ *               TCP flow stops being read
+ *   delay       half of -L latency plus a uniform +-half of -J jitter
+ *               each way, as run_srtp_ack_test.py's relay and srtp_sim;
+ *               datagrams may reorder, TCP chunks never overtake
+ *
+ * -P reads all of these from a configs/network_conditions profile
+ * (latency_ms, jitter_ms, loss_percent, corruption_percent,
+ * bandwidth_kbps, and gilbert_p, gilbert_q, gilbert_loss_bad for burst
+ * loss); options given after it override single values.  -g file:row
+ * takes the latency and p/q of a conf/test*.conf row instead.  With -a
+ * all flows share one pair of buckets and loss states, like a netem'd
+ * interface.
+ *
+ * The profile's lora_* keys (or -O sf) make the link a LoRaWAN channel
+ * (srtp_lora.h, UDP only): each datagram takes its time on air at the
+ * flow's spreading factor, waits out the device's (uplink) or gateway's
+ * (downlink) duty cycle, up to -Q ms, and uplinks that overlap another on
+ * the same gateway, channel and SF are lost at the end of their airtime.
+ * This replaces -B; latency, jitter and loss still apply on top, as the
+ * backhaul and the radio path.  The summary's "lora" object has the
+ * airtime sent each way, for EnergyModel.
+ *
+ * -V (or the profile's "trace", relative to the profile, and
+ * "trace_loop") makes bandwidth, latency, loss and jitter follow a trace
+ * of srtp_cond.h rows over the run.  The loop wakes up for each change,
+ * so a row takes effect within about a millisecond of its time, between
+ * two packets; packets already in the wheel keep the delay they got.
+ *
+ * Delayed packets wait in a hashed timing wheel of WHEEL_SLOTS 1 ms slots
+ * (a delay beyond one turn waits for the next), so holding or releasing
+ * a packet is O(1) however many are in flight; their buffers come from a
+ * fixed pool of -q buffers of -m bytes.  The front socket is drained in
+ * recvmmsg batches straight into pool buffers, and due datagrams leave in
+ * sendmmsg batches per socket.  A one-line JSON summary is printed to
+ * stdout on exit.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include "srtp_clock.h"
+#include "srtp_ge.h"
+#include "srtp_cond.h"
+#include "srtp_lora.h"
+
+#define WHEEL_SLOTS   4096         /* power of two */
+#define TICK_US       1000
+#define BATCH         64
+#define DRAIN_BATCHES 8            /* per socket and pass, so due packets keep leaving */
+#define SOCK_BUF      (4 << 20)
+#define TCP_INFLIGHT  (256 * 1024) /* bytes held per direction before reading pauses */
+#define IDLE_MS       60000        /* a UDP flow without traffic is closed */
+
+enum { UP, DOWN };                 /* client->server, server->client */
+
+typedef struct {
+    double tokens;                 /* bytes; negative while packets wait for them */
+    uint64_t at_us;                /* when tokens was last brought up to date */
+    uint64_t last_due;             /* latest departure so far, for TCP ordering */
+} link_t;
+
+typedef struct flow flow_t;
+
+/* What an epoll event points at: one socket of a flow */
+typedef struct {
+    flow_t *f;
+    int side;                      /* UP: the client socket, DOWN: the upstream one */
+} end_t;
+
+struct flow {
+    bool used;
+    uint32_t gen;                  /* bumped on close; packets of an old flow are dropped */
+    struct sockaddr_in client;
+    int fd[2];                     /* [UP] client conn (TCP), [DOWN] upstream socket */
+    end_t end[2];
+    link_t link[2];
+    srtp_ge_t ge[2];
+    srtp_lora_radio_t radio;       /* the device's duty cycle */
+    int sf, gw;
+    uint64_t last_ms;
+    flow_t *hnext;                 /* UDP flows by client address */
+    /* TCP only: chunks due but not yet written, per direction */
+    int out_head[2], out_tail[2];
+    uint32_t out_off[2];
+    uint32_t held[2];
+    bool connected, eof[2], shut[2];
+    uint32_t events[2];            /* what each socket is armed for */
+};
+
+typedef struct {
+    uint64_t due_tick;
+    int next;
+    uint32_t len, gen;
+    uint32_t txid;                 /* on the LoRa air, if not 0 */
+    int flow;
+    uint8_t dir;
+    bool hit;                      /* collided on the LoRa air */
+    uint8_t *data;
+} pkt_t;
+
+static volatile sig_atomic_t run = 1;
+
+static bool tcp, aggregate;
+static int front_fd, epfd, max_flows = 4096, pool_size = 65536, pkt_max = 2048;
+static struct sockaddr_in upstream;
+static double half_latency_us, half_jitter_us, loss, corruption;
+static double rate_bpus, burst = 0, queue_us = 1e6;   /* rate in bytes per us */
+static uint64_t rng_state = 88172645463325252ULL;
+static bool use_ge;
+static srtp_ge_params_t ge;
+static srtp_ge_hist_t ge_hist;
+static srtp_cond_t cond;
+static bool use_cond, burst_set;
+static bool use_lora;
+static srtp_lora_params_t lora;
+static srtp_lora_air_t lora_air;
+static srtp_lora_radio_t *gw_radio;
+static srtp_lora_stats_t lst;
+static uint32_t next_txid;
+
+static flow_t *flows;
+static int nfree_flows;
+static int *free_flow_idx;
+static flow_t **buckets;
+static uint32_t nbuckets;
+static link_t shared[2];
+static srtp_ge_t shared_ge[2];
+
+static pkt_t *pkts;
+static uint8_t *slab;
+static int free_pkt = -1, in_flight;
+
+static struct {
+    int head, tail;
+} wheel[WHEEL_SLOTS];
+static uint64_t wheel_tick;
+
+static struct {
+    uint64_t flows, in[2], out[2], in_bytes[2], out_bytes[2];
+    uint64_t lost, corrupted, queue_drops, pool_drops, oversize, send_errors, stale;
+    uint64_t batches, in_flight_max, tcp_paused;
+} st;
+
+static void handle_sig(int sig)
+{
+    (void)sig;
+    run = 0;
+}
+
+static double rnd(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (rng_state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* ---------- packet pool and timing wheel ---------- */
+
+static int pkt_alloc(void)
+{
+    int i = free_pkt;
+
+    if (i < 0)
+        return -1;
+    free_pkt = pkts[i].next;
+    pkts[i].next = -1;
+    return i;
+}
+
+static void pkt_free(int i)
+{
+    pkts[i].next = free_pkt;
+    free_pkt = i;
+}
+
+static void wheel_add(int i, uint64_t due_us)
+{
+    pkt_t *p = &pkts[i];
+    uint64_t t = due_us / TICK_US;
+    int slot;
+
+    if (t <= wheel_tick)
+        t = wheel_tick + 1;            /* due already: goes out on the next tick */
+    p->due_tick = t;
+    p->next = -1;
+    slot = (int)(t & (WHEEL_SLOTS - 1));
+    if (wheel[slot].tail >= 0)
+        pkts[wheel[slot].tail].next = i;
+    else
+        wheel[slot].head = i;
+    wheel[slot].tail = i;
+    if (++in_flight > (int)st.in_flight_max)
+        st.in_flight_max = (uint64_t)in_flight;
+}
+
+/* ---------- impairments ---------- */
+
+static link_t *link_of(flow_t *f, int dir)
+{
+    return aggregate ? &shared[dir] : &f->link[dir];
+}
+
+static bool lose(flow_t *f, int dir)
+{
+    if (use_ge)
+        return srtp_ge_lose(aggregate ? &shared_ge[dir] : &f->ge[dir], &ge, &ge_hist, rnd);
+    return loss > 0 && rnd() < loss;
+}
+
+/* Departure time through l's token bucket of len bytes arriving at now,
+ * or 0 if the backlog it would join is over the limit. */
+static uint64_t shape(link_t *l, size_t len, uint64_t now, bool may_drop)
+{
+    double wait;
+
+    if (rate_bpus <= 0)
+        return now;
+    l->tokens += (double)(now - l->at_us) * rate_bpus;
+    if (l->tokens > burst)
+        l->tokens = burst;
+    l->at_us = now;
+    wait = ((double)len - l->tokens) / rate_bpus;
+    if (may_drop && wait > queue_us)
+        return 0;
+    l->tokens -= (double)len;
+    return wait > 0 ? now + (uint64_t)wait : now;
+}
+
+static uint64_t delay_us(void)
+{
+    double d = half_latency_us;
+
+    if (half_jitter_us > 0)
+        d += (2 * rnd() - 1) * half_jitter_us;
+    return d > 0 ? (uint64_t)d : 0;
+}
+
+static void lora_hit(int ref, uint32_t id)
+{
+    if (pkts[ref].txid == id)
+        pkts[ref].hit = true;
+}
+
+/* Puts datagram i of f on the LoRa air: when its airtime ends, or 0 if
+ * the duty cycle would hold it past the backlog limit. */
+static uint64_t lora_schedule(flow_t *f, int dir, int i, uint64_t now)
+{
+    pkt_t *p = &pkts[i];
+    srtp_lora_radio_t *r = dir == UP ? &f->radio : &gw_radio[f->gw];
+    uint64_t airtime = srtp_lora_airtime_us(&lora, f->sf, p->len + (size_t)lora.overhead), start;
+
+    if ((int)p->len > srtp_lora_max_payload(f->sf))
+        lst.oversize++;                /* sent anyway: the datagram is the payload */
+    if (r->free_at_us > now && (double)(r->free_at_us - now) > queue_us)
+        return 0;
+    start = srtp_lora_start(r, now, airtime, dir == UP ? lora.duty : lora.gw_duty);
+    if (start > now) {
+        lst.duty_waits++;
+        lst.duty_wait_us += start - now;
+    }
+    if (dir == DOWN) {
+        lst.downlinks++;
+        lst.down_airtime_us += airtime;
+        return start + airtime;
+    }
+    if (!++next_txid)
+        next_txid = 1;
+    p->txid = next_txid;
+    if (srtp_lora_air_add(&lora_air, ((f->gw * lora.channels) + (int)(rnd() * lora.channels)) *
+                          SRTP_LORA_SFS + f->sf - 7, start, start + airtime, p->txid, i, lora_hit))
+        p->hit = true;
+    lst.uplinks++;
+    lst.up_airtime_us += airtime;
+    return start + airtime;
+}
+
+/* Applies loss, corruption, the bucket (or the LoRa channel) and the
+ * delay to datagram i of f, then holds it in the wheel (or frees it). */
+static void impair_datagram(flow_t *f, int dir, int i, uint64_t now)
+{
+    pkt_t *p = &pkts[i];
+    uint64_t at;
+
+    st.in[dir]++;
+    st.in_bytes[dir] += p->len;
+    p->txid = 0;
+    p->hit = false;
+    if (lose(f, dir)) {
+        st.lost++;
+        pkt_free(i);
+        return;
+    }
+    if (use_lora) {
+        if (!(at = lora_schedule(f, dir, i, now))) {
+            lst.duty_drops++;
+            pkt_free(i);
+            return;
+        }
+    } else if (!(at = shape(link_of(f, dir), p->len, now, true))) {
+        st.queue_drops++;
+        pkt_free(i);
+        return;
+    }
+    if (corruption > 0 && p->len && rnd() < corruption) {
+        p->data[(size_t)(rnd() * p->len)] ^= (uint8_t)(1u << (int)(rnd() * 8));
+        st.corrupted++;
+    }
+    p->flow = (int)(f - flows);
+    p->gen = f->gen;
+    p->dir = (uint8_t)dir;
+    wheel_add(i, at + delay_us());
+}
+
+/* Takes on a trace row: the bucket depth follows the rate unless -K set it. */
+static void apply_cond(const srtp_cond_row_t *r)
+{
+    rate_bpus = r->kbps / 8000.0;
+    if (!burst_set)
+        burst = rate_bpus * 10000.0 > pkt_max ? rate_bpus * 10000.0 : pkt_max;
+    half_latency_us = r->lat_ms * 500.0;
+    loss = r->loss_pct / 100.0;
+    if (r->jit_ms >= 0)
+        half_jitter_us = r->jit_ms * 500.0;
+}
+
+/* ---------- flows ---------- */
+
+static uint32_t addr_hash(const struct sockaddr_in *a)
+{
+    uint32_t h = a->sin_addr.s_addr * 2654435761u ^ a->sin_port * 40503u;
+    return (h ^ (h >> 15)) & (nbuckets - 1);
+}
+
+static void set_bufs(int fd)
+{
+    int size = SOCK_BUF;
+
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+}
+
+static flow_t *flow_new(void)
+{
+    flow_t *f;
+
+    if (nfree_flows == 0)
+        return NULL;
+    f = &flows[free_flow_idx[--nfree_flows]];
+    f->used = true;
+    f->fd[UP] = f->fd[DOWN] = -1;
+    for (int d = 0; d < 2; d++) {
+        f->end[d].f = f;
+        f->end[d].side = d;
+        f->link[d] = (link_t){ burst, srtp_now_us(), 0 };
+        f->ge[d] = (srtp_ge_t){ false, 0 };
+        f->out_head[d] = f->out_tail[d] = -1;
+        f->out_off[d] = f->held[d] = 0;
+        f->eof[d] = f->shut[d] = false;
+        f->events[d] = 0;
+    }
+    f->connected = !tcp;
+    f->last_ms = srtp_now_ms();
+    if (use_lora) {
+        f->radio = (srtp_lora_radio_t){ 0, 0, 0 };
+        f->sf = lora.sf ? lora.sf : 7 + (int)(rnd() * SRTP_LORA_SFS);
+        f->gw = (int)(f - flows) % lora.gateways;
+        lst.devices++;
+    }
+    st.flows++;
+    return f;
+}
+
+static void flow_close(flow_t *f)
+{
+    if (!tcp) {
+        flow_t **pp = &buckets[addr_hash(&f->client)];
+        while (*pp && *pp != f)
+            pp = &(*pp)->hnext;
+        if (*pp)
+            *pp = f->hnext;
+    }
+    for (int d = 0; d < 2; d++) {
+        srtp_ge_end_burst(&f->ge[d], &ge_hist);
+        for (int i = f->out_head[d], next; i >= 0; i = next) {
+            next = pkts[i].next;
+            pkt_free(i);
+        }
+        if (f->fd[d] >= 0)
+            close(f->fd[d]);           /* also leaves the epoll set */
+    }
+    f->used = false;
+    f->gen++;                          /* what is still in the wheel is dropped */
+    free_flow_idx[nfree_flows++] = (int)(f - flows);
+}
+
+static flow_t *udp_flow(const struct sockaddr_in *from)
+{
+    uint32_t b = addr_hash(from);
+    struct epoll_event ev = { .events = EPOLLIN };
+    flow_t *f;
+
+    for (f = buckets[b]; f; f = f->hnext)
+        if (f->client.sin_addr.s_addr == from->sin_addr.s_addr && f->client.sin_port == from->sin_port)
+            return f;
+    if (!(f = flow_new()))
+        return NULL;
+    f->client = *from;
+    if ((f->fd[DOWN] = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0)) < 0) {
+        f->used = false;
+        free_flow_idx[nfree_flows++] = (int)(f - flows);
+        return NULL;
+    }
+    set_bufs(f->fd[DOWN]);
+    ev.data.ptr = &f->end[DOWN];
+    epoll_ctl(epfd, EPOLL_CTL_ADD, f->fd[DOWN], &ev);
+    f->hnext = buckets[b];
+    buckets[b] = f;
+    return f;
+}
+
+/* Closes UDP flows that have been quiet for IDLE_MS. */
+static void sweep_idle(void)
+{
+    uint64_t now = srtp_now_ms();
+
+    /* a LoRa device keeps its flow while its duty cycle holds it off */
+    for (int i = 0; i < max_flows; i++)
+        if (flows[i].used && !tcp && now - flows[i].last_ms > IDLE_MS &&
+            flows[i].radio.free_at_us / 1000 < now)
+            flow_close(&flows[i]);
+}
+
+/* ---------- UDP ---------- */
+
+static struct mmsghdr rx_msg[BATCH];
+static struct iovec rx_iov[BATCH];
+static struct sockaddr_in rx_from[BATCH];
+static int rx_pkt[BATCH];
+static uint8_t scratch[65536];
+
+/* Receives up to BATCH datagrams from fd into pool buffers and hands each
+ * to impair_datagram; returns how many arrived. */
+static int udp_pump(int fd, flow_t *from_flow)
+{
+    uint64_t now;
+    int n;
+
+    for (int j = 0; j < BATCH; j++) {
+        rx_pkt[j] = pkt_alloc();
+        rx_iov[j].iov_base = rx_pkt[j] >= 0 ? pkts[rx_pkt[j]].data : scratch;
+        rx_iov[j].iov_len = rx_pkt[j] >= 0 ? (size_t)pkt_max : sizeof(scratch);
+        rx_msg[j].msg_hdr = (struct msghdr){
+            .msg_name = &rx_from[j], .msg_namelen = sizeof(rx_from[j]),
+            .msg_iov = &rx_iov[j], .msg_iovlen = 1,
+        };
+    }
+    n = recvmmsg(fd, rx_msg, BATCH, MSG_DONTWAIT, NULL);
+    now = srtp_now_us();
+    for (int j = 0; j < (n > 0 ? n : 0); j++) {
+        flow_t *f = from_flow ? from_flow : udp_flow(&rx_from[j]);
+        int i = rx_pkt[j];
+        if (i < 0) {
+            st.pool_drops++;
+            continue;
+        }
+        rx_pkt[j] = -1;
+        if (!f) {
+            st.pool_drops++;           /* out of flows */
+            pkt_free(i);
+            continue;
+        }
+        if (rx_msg[j].msg_hdr.msg_flags & MSG_TRUNC) {
+            st.oversize++;
+            pkt_free(i);
+            continue;
+        }
+        f->last_ms = now / 1000;
+        pkts[i].len = rx_msg[j].msg_len;
+        impair_datagram(f, from_flow ? DOWN : UP, i, now);
+    }
+    for (int j = 0; j < BATCH; j++)
+        if (rx_pkt[j] >= 0)
+            pkt_free(rx_pkt[j]);
+    return n;
+}
+
+static struct mmsghdr tx_msg[BATCH];
+static struct iovec tx_iov[BATCH];
+static int tx_pkt[BATCH], tx_n, tx_fd = -1;
+
+static void tx_flush(void)
+{
+    int off = 0;
+
+    while (off < tx_n) {
+        int rc = sendmmsg(tx_fd, tx_msg + off, (unsigned)(tx_n - off), MSG_DONTWAIT);
+        st.batches++;
+        if (rc <= 0) {
+            st.send_errors += (uint64_t)(tx_n - off);
+            break;
+        }
+        off += rc;
+    }
+    for (int j = 0; j < tx_n; j++) {
+        if (j < off) {
+            st.out[pkts[tx_pkt[j]].dir]++;
+            st.out_bytes[pkts[tx_pkt[j]].dir] += pkts[tx_pkt[j]].len;
+        }
+        pkt_free(tx_pkt[j]);
+    }
+    tx_n = 0;
+}
+
+static void udp_send(flow_t *f, int i)
+{
+    pkt_t *p = &pkts[i];
+    int fd = p->dir == UP ? f->fd[DOWN] : front_fd;
+
+    if (tx_n == BATCH || (tx_n && fd != tx_fd))
+        tx_flush();
+    tx_fd = fd;
+    tx_iov[tx_n] = (struct iovec){ p->data, p->len };
+    tx_msg[tx_n].msg_hdr = (struct msghdr){
+        .msg_name = p->dir == UP ? &upstream : &f->client,
+        .msg_namelen = sizeof(struct sockaddr_in),
+        .msg_iov = &tx_iov[tx_n], .msg_iovlen = 1,
+    };
+    tx_pkt[tx_n++] = i;
+}
+
+/* ---------- TCP ---------- */
+
+static void tcp_arm(flow_t *f)
+{
+    for (int side = 0; side < 2; side++) {
+        /* side UP (client socket) reads direction UP and writes DOWN */
+        int rd = side, wr = !side;
+        uint32_t want = 0;
+        struct epoll_event ev;
+        if (f->fd[side] < 0)
+            continue;
+        if (!f->eof[rd] && f->held[rd] < TCP_INFLIGHT && (side == UP || f->connected))
+            want |= EPOLLIN;
+        if ((side == DOWN && !f->connected) || f->out_head[wr] >= 0)
+            want |= EPOLLOUT;
+        if (want == f->events[side])
+            continue;
+        if (!(want & EPOLLIN) && (f->events[side] & EPOLLIN) && !f->eof[rd])
+            st.tcp_paused++;
+        ev.events = want;
+        ev.data.ptr = &f->end[side];
+        epoll_ctl(epfd, EPOLL_CTL_MOD, f->fd[side], &ev);
+        f->events[side] = want;
+    }
+}
+
+/* Writes what is due in direction dir; a zero-length chunk is the end of
+ * the stream.  Returns -1 if the flow was closed. */
+static int tcp_flush(flow_t *f, int dir)
+{
+    int fd = f->fd[dir == UP ? DOWN : UP];
+
+    if (dir == UP && !f->connected)
+        return 0;
+    while (f->out_head[dir] >= 0) {
+        int i = f->out_head[dir];
+        pkt_t *p = &pkts[i];
+        if (f->shut[dir]) {
+            f->held[dir] -= p->len - f->out_off[dir];   /* the reader is gone */
+        } else if (p->len == 0) {
+            shutdown(fd, SHUT_WR);
+            f->shut[dir] = true;
+        } else {
+            ssize_t rc = send(fd, p->data + f->out_off[dir], p->len - f->out_off[dir],
+                              MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                break;
+            if (rc < 0) {
+                flow_close(f);
+                return -1;
+            }
+            st.out_bytes[dir] += (uint64_t)rc;
+            f->held[dir] -= (uint32_t)rc;
+            if ((f->out_off[dir] += (uint32_t)rc) < p->len)
+                break;
+            st.out[dir]++;
+        }
+        f->out_off[dir] = 0;
+        if ((f->out_head[dir] = p->next) < 0)
+            f->out_tail[dir] = -1;
+        pkt_free(i);
+    }
+    if (f->shut[UP] && f->shut[DOWN]) {
+        flow_close(f);
+        return -1;
+    }
+    tcp_arm(f);
+    return 0;
+}
+
+/* Reads what side has to offer into delayed chunks. */
+static void tcp_read(flow_t *f, int side)
+{
+    int dir = side;                    /* the client socket feeds UP */
+    link_t *l = link_of(f, dir);
+
+    while (f->held[dir] < TCP_INFLIGHT && !f->eof[dir]) {
+        uint64_t now, at;
+        int i = pkt_alloc();
+        ssize_t rc;
+        if (i < 0) {
+            st.pool_drops++;           /* not read: the peer's window fills instead */
+            break;
+        }
+        rc = recv(f->fd[side], pkts[i].data, (size_t)pkt_max, MSG_DONTWAIT);
+        if (rc < 0) {
+            pkt_free(i);
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            flow_close(f);
+            return;
+        }
+        if (rc == 0)
+            f->eof[dir] = true;        /* passed on, in order, as a zero-length chunk */
+        now = srtp_now_us();
+        pkts[i].len = (uint32_t)rc;
+        pkts[i].flow = (int)(f - flows);
+        pkts[i].gen = f->gen;
+        pkts[i].dir = (uint8_t)dir;
+        st.in[dir] += rc > 0;
+        st.in_bytes[dir] += (uint64_t)rc;
+        f->held[dir] += (uint32_t)rc;
+        at = shape(l, (size_t)rc, now, false) + delay_us();
+        if (at < l->last_due)
+            at = l->last_due;          /* a stream never reorders */
+        l->last_due = at;
+        wheel_add(i, at);
+    }
+    tcp_arm(f);
+}
+
+static void tcp_accept(void)
+{
+    for (;;) {
+        struct sockaddr_in from;
+        socklen_t flen = sizeof(from);
+        int fd = accept4(front_fd, (struct sockaddr *)&from, &flen, SOCK_NONBLOCK), one = 1;
+        struct epoll_event ev;
+        flow_t *f;
+        if (fd < 0)
+            return;
+        if (!(f = flow_new())) {
+            close(fd);
+            continue;
+        }
+        f->client = from;
+        f->fd[UP] = fd;
+        f->fd[DOWN] = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (f->fd[DOWN] < 0 ||
+            (connect(f->fd[DOWN], (struct sockaddr *)&upstream, sizeof(upstream)) < 0 &&
+             errno != EINPROGRESS)) {
+            flow_close(f);
+            continue;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        setsockopt(f->fd[DOWN], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        for (int side = 0; side < 2; side++) {
+            ev.events = 0;
+            ev.data.ptr = &f->end[side];
+            epoll_ctl(epfd, EPOLL_CTL_ADD, f->fd[side], &ev);
+        }
+        tcp_arm(f);
+    }
+}
+
+static void tcp_event(flow_t *f, int side, uint32_t events)
+{
+    uint32_t gen = f->gen;
+
+    if (side == DOWN && !f->connected && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+        int err = 0;
+        socklen_t elen = sizeof(err);
+        getsockopt(f->fd[DOWN], SOL_SOCKET, SO_ERROR, &err, &elen);
+        if (err) {
+            flow_close(f);
+            return;
+        }
+        f->connected = true;
+    }
+    if (events & EPOLLERR) {
+        flow_close(f);
+        return;
+    }
+    if ((events & EPOLLHUP) && f->eof[side]) {
+        /* closed both ways: nothing more can be written to it either */
+        epoll_ctl(epfd, EPOLL_CTL_DEL, f->fd[side], NULL);
+        f->shut[!side] = true;
+        tcp_flush(f, !side);
+        return;
+    }
+    if ((events & EPOLLOUT) && tcp_flush(f, !side) < 0)
+        return;
+    if ((events & (EPOLLIN | EPOLLHUP)) && f->gen == gen && f->used)
+        tcp_read(f, side);
+}
+
+/* ---------- releasing due packets ---------- */
+
+static void release_due(void)
+{
+    uint64_t now_tick = srtp_now_us() / TICK_US, steps;
+
+    if (now_tick <= wheel_tick)
+        return;
+    steps = now_tick - wheel_tick;
+    if (steps > WHEEL_SLOTS)
+        steps = WHEEL_SLOTS;
+    for (uint64_t s = 1; s <= steps; s++) {
+        int slot = (int)((wheel_tick + s) & (WHEEL_SLOTS - 1));
+        int i = wheel[slot].head, keep_head = -1, keep_tail = -1;
+        while (i >= 0) {
+            pkt_t *p = &pkts[i];
+            int next = p->next;
+            flow_t *f = &flows[p->flow];
+            if (p->due_tick > now_tick) {      /* a later turn of the wheel */
+                p->next = -1;
+                if (keep_tail >= 0)
+                    pkts[keep_tail].next = i;
+                else
+                    keep_head = i;
+                keep_tail = i;
+                i = next;
+                continue;
+            }
+            in_flight--;
+            if (!f->used || f->gen != p->gen) {
+                st.stale++;
+                pkt_free(i);
+            } else if (p->hit) {
+                lst.collided++;
+                pkt_free(i);
+            } else if (!tcp) {
+                udp_send(f, i);
+            } else {
+                p->next = -1;
+                if (f->out_tail[p->dir] >= 0)
+                    pkts[f->out_tail[p->dir]].next = i;
+                else
+                    f->out_head[p->dir] = i;
+                f->out_tail[p->dir] = i;
+                tcp_flush(f, p->dir);
+            }
+            i = next;
+        }
+        wheel[slot].head = keep_head;
+        wheel[slot].tail = keep_tail;
+    }
+    wheel_tick = now_tick;
+    if (tx_n)
+        tx_flush();
+}
+
+/* ---------- setup ---------- */
+
+static double json_number(const char *text, const char *key, double dflt)
+{
+    char pat[64];
+    const char *p;
+
+    snprintf(pat, sizeof(pat), "\"%s\"", key);
+    if (!(p = strstr(text, pat)) || !(p = strchr(p + strlen(pat), ':')))
+        return dflt;
+    return strtod(p + 1, NULL);
+}
+
+/* The string value of key, copied to out; false if there is none. */
+static bool json_string(const char *text, const char *key, char *out, size_t size)
+{
+    char pat[64];
+    const char *p, *end;
+
+    snprintf(pat, sizeof(pat), "\"%s\"", key);
+    if (!(p = strstr(text, pat)) || !(p = strchr(p + strlen(pat), ':')) ||
+        !(p = strchr(p, '"')) || !(end = strchr(++p, '"')) || (size_t)(end - p) >= size)
+        return false;
+    memcpy(out, p, (size_t)(end - p));
+    out[end - p] = '\0';
+    return true;
+}
+
+static int load_profile(const char *path, double *lat_ms, double *jit_ms, double *loss_pct,
+                        double *corrupt_pct, double *kbps, srtp_ge_params_t *g,
+                        char *trace, size_t trace_size, bool *loop, srtp_lora_params_t *lp)
+{
+    char name[512];
+    const char *slash;
+
+    char text[4096];
+    size_t n;
+    FILE *fp = fopen(path, "r");
+
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+    n = fread(text, 1, sizeof(text) - 1, fp);
+    fclose(fp);
+    text[n] = '\0';
+    *lat_ms = json_number(text, "latency_ms", *lat_ms);
+    *jit_ms = json_number(text, "jitter_ms", *jit_ms);
+    *loss_pct = json_number(text, "loss_percent", *loss_pct);
+    *corrupt_pct = json_number(text, "corruption_percent", *corrupt_pct);
+    *kbps = json_number(text, "bandwidth_kbps", *kbps);
+    g->p = json_number(text, "gilbert_p", g->p);
+    g->q = json_number(text, "gilbert_q", g->q);
+    g->loss_bad = json_number(text, "gilbert_loss_bad", g->loss_bad);
+    if (strstr(text, "\"lora_sf\"")) {
+        use_lora = true;
+        lp->sf = (int)json_number(text, "lora_sf", lp->sf);
+        lp->bw_khz = (int)json_number(text, "lora_bw_khz", lp->bw_khz);
+        lp->cr = (int)json_number(text, "lora_cr", lp->cr);
+        lp->preamble = (int)json_number(text, "lora_preamble", lp->preamble);
+        lp->overhead = (int)json_number(text, "lora_overhead", lp->overhead);
+        lp->duty = json_number(text, "lora_duty_percent", lp->duty * 100) / 100;
+        lp->gw_duty = json_number(text, "lora_gw_duty_percent", lp->gw_duty * 100) / 100;
+        lp->channels = (int)json_number(text, "lora_channels", lp->channels);
+        lp->gateways = (int)json_number(text, "lora_gateways", lp->gateways);
+    }
+    if (json_string(text, "trace", name, sizeof(name))) {
+        int len;
+        slash = strrchr(path, '/');
+        if (name[0] == '/' || !slash)
+            len = snprintf(trace, trace_size, "%s", name);
+        else
+            len = snprintf(trace, trace_size, "%.*s/%s", (int)(slash - path), path, name);
+        if (len < 0 || (size_t)len >= trace_size) {
+            fprintf(stderr, "srtp_impair: trace path too long in %s\n", path);
+            return -1;
+        }
+        *loop = strstr(text, "\"trace_loop\": true") || json_number(text, "trace_loop", 0) > 0;
+    }
+    return 0;
+}
+
+static int listen_on(const char *ip, int port)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port) };
+    int fd = socket(AF_INET, (tcp ? SOCK_STREAM : SOCK_DGRAM) | SOCK_NONBLOCK, 0), one = 1;
+
+    addr.sin_addr.s_addr = inet_addr(ip);
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (!tcp)
+        set_bufs(fd);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || (tcp && listen(fd, 512) < 0)) {
+        perror("srtp_impair: bind");
+        exit(1);
+    }
+    return fd;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s -l port -u ip:port [-t] [-i ip] [-P profile.json] [-L latency_ms]\n"
+        "          [-J jitter_ms] [-X loss_percent | -g conf:row] [-C corruption_percent] [-B kbps]\n"
+        "          [-K burst_bytes] [-Q backlog_ms] [-a] [-F flows] [-q buffers]\n"
+        "          [-m bytes] [-s seed] [-V trace [-R]] [-O sf]\n"
+        "\t-l/-i\tListen on this port and address (default 127.0.0.1)\n"
+        "\t-u\tRelay to this numeric address and port\n"
+        "\t-t\tRelay TCP connections instead of UDP datagrams\n"
+        "\t-P\tNetwork profile (latency_ms, jitter_ms, loss_percent, corruption_percent,\n"
+        "\t\tbandwidth_kbps, gilbert_p/q/loss_bad); -L/-J/-X/-C/-B given after it\n"
+        "\t\toverride single values\n"
+        "\t-g\tGilbert-Elliott burst loss and latency from row n (from 0) of a\n"
+        "\t\tconf/test*.conf table (delay_ms p q) instead of -X\n"
+        "\t-V\tFollow a trace of \"t_ms kbps latency_ms loss_percent [jitter_ms]\" rows\n"
+        "\t\t(srtp_cond.h), over -B/-L/-X/-J; -R starts it over at its end\n"
+        "\t-O\tLoRaWAN channel at this spreading factor (0: 7-12 per device) with the\n"
+        "\t\tprofile's or default lora_* settings (srtp_lora.h), instead of -B\n"
+        "\t-K\tToken bucket depth, default 10 ms at -B and at least one buffer\n"
+        "\t-Q\tBacklog a UDP datagram may wait behind before it is dropped, default 1000 ms\n"
+        "\t-a\tOne pair of buckets for all flows instead of one per flow\n"
+        "\t-F\tMax flows (clients or connections), default 4096\n"
+        "\t-q/-m\tPacket buffers and their size: default 65536 x 2048 bytes; longer\n"
+        "\t\tdatagrams are dropped\n",
+        prog);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *ip = "127.0.0.1", *up = NULL;
+    char trace[512] = "";
+    bool trace_loop = false;
+    const srtp_cond_row_t *row;
+    int port = 0, opt, n;
+    double lat_ms = 0, jit_ms = 0, loss_pct = 0, corrupt_pct = 0, kbps = 0, backlog_ms = 1000;
+    struct epoll_event ev, events[BATCH];
+    struct rlimit rl;
+    struct rusage ru;
+    uint64_t start_us, last_sweep = 0;
+    double elapsed, cpu;
+
+    ge.loss_bad = 1;
+    srtp_lora_defaults(&lora);
+    while ((opt = getopt(argc, argv, "l:u:ti:P:L:J:X:C:B:K:Q:aF:q:m:s:g:V:RO:h")) != -1) {
+        switch (opt) {
+        case 'l': port = atoi(optarg); break;
+        case 'u': up = optarg; break;
+        case 't': tcp = true; break;
+        case 'i': ip = optarg; break;
+        case 'P':
+            if (load_profile(optarg, &lat_ms, &jit_ms, &loss_pct, &corrupt_pct, &kbps, &ge,
+                             trace, sizeof(trace), &trace_loop, &lora) < 0)
+                return 1;
+            break;
+        case 'g':
+            if (srtp_ge_parse(optarg, &lat_ms, &ge) < 0) {
+                fprintf(stderr, "srtp_impair: no row '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'L': lat_ms = atof(optarg); break;
+        case 'J': jit_ms = atof(optarg); break;
+        case 'X': loss_pct = atof(optarg); break;
+        case 'C': corrupt_pct = atof(optarg); break;
+        case 'B': kbps = atof(optarg); break;
+        case 'K': burst = atof(optarg); burst_set = burst > 0; break;
+        case 'Q': backlog_ms = atof(optarg); break;
+        case 'a': aggregate = true; break;
+        case 'F': max_flows = atoi(optarg); break;
+        case 'q': pool_size = atoi(optarg); break;
+        case 'm': pkt_max = atoi(optarg); break;
+        case 'V': snprintf(trace, sizeof(trace), "%s", optarg); break;
+        case 'R': trace_loop = true; break;
+        case 'O': use_lora = true; lora.sf = atoi(optarg); break;
+        case 's': rng_state ^= strtoull(optarg, NULL, 10) * 0x9E3779B97F4A7C15ULL; break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (up) {
+        char addr[INET_ADDRSTRLEN];
+        int up_port = 0;
+        upstream.sin_family = AF_INET;
+        if (sscanf(up, "%15[0-9.]:%d", addr, &up_port) != 2 || up_port <= 0 || up_port > 65535 ||
+            inet_pton(AF_INET, addr, &upstream.sin_addr) != 1)
+            up = NULL;
+        upstream.sin_port = htons(up_port);
+    }
+    if (!up || port <= 0 || port > 65535 || max_flows < 1 || pool_size < BATCH ||
+        pkt_max < 64 || pkt_max > 65536 || lat_ms < 0 || jit_ms < 0 || kbps < 0 || backlog_ms < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    half_latency_us = lat_ms * 500.0;
+    half_jitter_us = jit_ms * 500.0;
+    loss = loss_pct / 100.0;
+    use_ge = ge.p > 0 || ge.q > 0;      /* which replaces loss_percent */
+    corruption = corrupt_pct / 100.0;
+    rate_bpus = kbps / 8000.0;
+    queue_us = backlog_ms * 1000.0;
+    if (burst <= 0)
+        burst = rate_bpus * 10000.0;
+    if (burst < pkt_max)
+        burst = pkt_max;
+    if (trace[0]) {
+        if (srtp_cond_load(&cond, trace, trace_loop) < 0) {
+            fprintf(stderr, "srtp_impair: bad trace '%s'\n", trace);
+            return 1;
+        }
+        use_cond = true;
+    }
+    if (use_lora) {
+        if (tcp || lora.sf < 0 || (lora.sf && (lora.sf < 7 || lora.sf > 12)) || lora.bw_khz <= 0 ||
+            lora.cr < 1 || lora.cr > 4 || lora.preamble < 0 || lora.overhead < 0 ||
+            lora.duty <= 0 || lora.duty > 1 || lora.gw_duty <= 0 || lora.gw_duty > 1 ||
+            lora.channels < 1 || lora.gateways < 1) {
+            fprintf(stderr, "srtp_impair: bad LoRa settings (UDP only)\n");
+            return 1;
+        }
+        gw_radio = calloc((size_t)lora.gateways, sizeof(*gw_radio));
+        if (!gw_radio || srtp_lora_air_init(&lora_air, lora.gateways * lora.channels * SRTP_LORA_SFS) < 0) {
+            perror("srtp_impair");
+            return 1;
+        }
+    }
+
+    /* one or two descriptors per flow */
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    for (nbuckets = 64; nbuckets < (uint32_t)max_flows * 2; nbuckets <<= 1)
+        ;
+    flows = calloc((size_t)max_flows, sizeof(*flows));
+    free_flow_idx = malloc(sizeof(int) * (size_t)max_flows);
+    buckets = calloc(nbuckets, sizeof(*buckets));
+    pkts = malloc(sizeof(*pkts) * (size_t)pool_size);
+    slab = malloc((size_t)pool_size * (size_t)pkt_max);    /* pages are touched as used */
+    if (!flows || !free_flow_idx || !buckets || !pkts || !slab) {
+        perror("srtp_impair");
+        return 1;
+    }
+    for (int i = max_flows - 1; i >= 0; i--)
+        free_flow_idx[nfree_flows++] = i;
+    for (int i = pool_size - 1; i >= 0; i--) {
+        pkts[i].data = slab + (size_t)i * (size_t)pkt_max;
+        pkt_free(i);
+    }
+    for (int s = 0; s < WHEEL_SLOTS; s++)
+        wheel[s].head = wheel[s].tail = -1;
+    wheel_tick = srtp_now_us() / TICK_US;
+    for (int d = 0; d < 2; d++)
+        shared[d] = (link_t){ burst, srtp_now_us(), 0 };
+
+    front_fd = listen_on(ip, port);
+    epfd = epoll_create1(0);
+    ev.events = EPOLLIN;
+    ev.data.ptr = &front_fd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, front_fd, &ev);
+    signal(SIGTERM, handle_sig);
+    signal(SIGINT, handle_sig);
+    signal(SIGPIPE, SIG_IGN);
+    start_us = srtp_now_us();
+
+    while (run) {
+        int timeout = in_flight ? 1 : 100;
+        if (use_cond) {
+            double elapsed_ms = (double)(srtp_now_us() - start_us) / 1000.0, next;
+            if ((row = srtp_cond_step(&cond, elapsed_ms)))
+                apply_cond(row);
+            if ((next = srtp_cond_next_ms(&cond)) >= 0 && next - elapsed_ms < timeout)
+                timeout = next > elapsed_ms ? (int)(next - elapsed_ms) + 1 : 0;
+        }
+        n = epoll_wait(epfd, events, BATCH, timeout);
+        for (int i = 0; i < n; i++) {
+            end_t *e = events[i].data.ptr;
+            if (events[i].data.ptr == &front_fd) {
+                if (tcp)
+                    tcp_accept();
+                else
+                    for (int b = 0; b < DRAIN_BATCHES && udp_pump(front_fd, NULL) == BATCH; b++)
+                        ;
+            } else if (!e->f->used) {
+                continue;                  /* closed earlier in this batch */
+            } else if (tcp) {
+                tcp_event(e->f, e->side, events[i].events);
+            } else {
+                for (int b = 0; b < DRAIN_BATCHES && udp_pump(e->f->fd[DOWN], e->f) == BATCH; b++)
+                    ;
+            }
+        }
+        release_due();
+        if (srtp_now_ms() - last_sweep >= 1000) {
+            sweep_idle();
+            last_sweep = srtp_now_ms();
+        }
+    }
+
+    elapsed = (double)(srtp_now_us() - start_us) / 1e6;
+    getrusage(RUSAGE_SELF, &ru);
+    cpu = (double)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) +
+          (double)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+    printf("{\"mode\": \"%s\", \"flows\": %lu, \"up_in\": %lu, \"up_out\": %lu, \"down_in\": %lu, "
+           "\"down_out\": %lu, \"up_bytes\": %lu, \"down_bytes\": %lu, \"lost\": %lu, "
+           "\"corrupted\": %lu, \"queue_drops\": %lu, \"pool_drops\": %lu, \"oversize\": %lu, "
+           "\"send_errors\": %lu, \"stale\": %lu, \"in_flight\": %d, \"in_flight_max\": %lu, "
+           "\"tcp_paused\": %lu, \"batches\": %lu, \"elapsed_s\": %.3f, \"cpu_s\": %.3f, "
+           "\"pps\": %.0f, \"pps_per_cpu\": %.0f",
+           tcp ? "tcp" : "udp", (unsigned long)st.flows,
+           (unsigned long)st.in[UP], (unsigned long)st.out[UP],
+           (unsigned long)st.in[DOWN], (unsigned long)st.out[DOWN],
+           (unsigned long)st.out_bytes[UP], (unsigned long)st.out_bytes[DOWN],
+           (unsigned long)st.lost, (unsigned long)st.corrupted, (unsigned long)st.queue_drops,
+           (unsigned long)st.pool_drops, (unsigned long)st.oversize,
+           (unsigned long)st.send_errors, (unsigned long)st.stale, in_flight,
+           (unsigned long)st.in_flight_max, (unsigned long)st.tcp_paused,
+           (unsigned long)st.batches, elapsed, cpu,
+           elapsed > 0 ? (double)(st.in[UP] + st.in[DOWN]) / elapsed : 0.0,
+           cpu > 0 ? (double)(st.in[UP] + st.in[DOWN]) / cpu : 0.0);
+    for (int i = 0; i < max_flows; i++)
+        if (flows[i].used)
+            flow_close(&flows[i]);
+    for (int d = 0; d < 2; d++)
+        srtp_ge_end_burst(&shared_ge[d], &ge_hist);
+    if (use_ge) {
+        printf(", \"ge\": ");
+        srtp_ge_print(stdout, &ge, &ge_hist);
+    }
+    if (use_cond) {
+        printf(", \"trace_rows\": %d, \"trace_steps\": %lu", cond.n, (unsigned long)cond.steps);
+        srtp_cond_free(&cond);
+    }
+    if (use_lora) {
+        printf(", \"lora\": ");
+        srtp_lora_print(stdout, &lora, &lst);
+        srtp_lora_air_free(&lora_air);
+        free(gw_radio);
+    }
+    printf("}\n");
+    fflush(stdout);
+    free(slab);
+    free(pkts);
+    free(buckets);
+    free(free_flow_idx);
+    free(flows);
+    return 0;
+}
@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include "srtp_clock.h"
+#include "srtp_log.h"
+
+/*
+ * File layout, native byte order, after the magic "SRTPLOG1":
+ *   'F' u64 id  u32 len  fmt[len]            a format, before its first use
+ *   'R' u64 t_us  u64 id  u8 level  u8 nargs  u64 args[nargs]
+ *   'D' u64 dropped                          once, at close
+ */
+#define RING        65536              /* records, power of two */
+#define SEEN_CAP    1024               /* distinct formats remembered */
+#define FLUSH_NS    10000000           /* writer poll interval when idle */
+
+typedef struct {
+    uint64_t t_us;
+    const char *fmt;
+    uint8_t level, nargs;
+    uint64_t args[SRTP_LOG_MAXARGS];
+} rec_t;
+
+int srtp_log_on;
+
+static rec_t ring[RING];
+static _Atomic uint64_t head, tail, dropped;
+static atomic_int stop;
+static pthread_t writer;
+static FILE *out;
+static const char *seen[SEEN_CAP];
+
+void srtp_log_put(int level, const char *fmt, int nargs, const uint64_t *args)
+{
+    uint64_t h = atomic_load_explicit(&head, memory_order_relaxed);
+    rec_t *r;
+
+    if (h - atomic_load_explicit(&tail, memory_order_acquire) >= RING) {
+        atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+        return;
+    }
+    r = &ring[h & (RING - 1)];
+    r->t_us = srtp_now_us();
+    r->fmt = fmt;
+    r->level = (uint8_t)level;
+    r->nargs = (uint8_t)nargs;
+    memcpy(r->args, args, sizeof(uint64_t) * (size_t)nargs);
+    atomic_store_explicit(&head, h + 1, memory_order_release);
+}
+
+/* Writes fmt's 'F' entry the first time it is seen. */
+static void define_fmt(const char *fmt)
+{
+    uint64_t id = (uint64_t)(uintptr_t)fmt;
+    uint32_t len = (uint32_t)strlen(fmt), i = (uint32_t)(id >> 3) & (SEEN_CAP - 1);
+
+    for (uint32_t n = 0; n < SEEN_CAP && seen[i]; n++, i = (i + 1) & (SEEN_CAP - 1))
+        if (seen[i] == fmt)
+            return;
+    if (!seen[i])
+        seen[i] = fmt;                 /* a full table only means repeated 'F' entries */
+    fputc('F', out);
+    fwrite(&id, sizeof(id), 1, out);
+    fwrite(&len, sizeof(len), 1, out);
+    fwrite(fmt, 1, len, out);
+}
+
+static int drain(void)
+{
+    uint64_t t = atomic_load_explicit(&tail, memory_order_relaxed);
+    uint64_t h = atomic_load_explicit(&head, memory_order_acquire);
+
+    for (; t != h; t++) {
+        const rec_t *r = &ring[t & (RING - 1)];
+        uint64_t id = (uint64_t)(uintptr_t)r->fmt;
+
+        define_fmt(r->fmt);
+        fputc('R', out);
+        fwrite(&r->t_us, sizeof(r->t_us), 1, out);
+        fwrite(&id, sizeof(id), 1, out);
+        fputc(r->level, out);
+        fputc(r->nargs, out);
+        fwrite(r->args, sizeof(uint64_t), r->nargs, out);
+        atomic_store_explicit(&tail, t + 1, memory_order_release);
+    }
+    return t != atomic_load_explicit(&head, memory_order_acquire);
+}
+
+static void *writer_main(void *arg)
+{
+    struct timespec idle = { 0, FLUSH_NS };
+
+    (void)arg;
+    while (!atomic_load(&stop)) {
+        if (!drain()) {
+            fflush(out);
+            nanosleep(&idle, NULL);
+        }
+    }
+    return NULL;
+}
+
+int srtp_log_open(const char *path)
+{
+    if (!(out = fopen(path, "wb")))
+        return -1;
+    fwrite("SRTPLOG1", 1, 8, out);
+    if (pthread_create(&writer, NULL, writer_main, NULL) != 0) {
+        fclose(out);
+        out = NULL;
+        return -1;
+    }
+    srtp_log_on = 1;
+    return 0;
+}
+
+void srtp_log_close(void)
+{
+    uint64_t d;
+
+    if (!srtp_log_on)
+        return;
+    srtp_log_on = 0;
+    atomic_store(&stop, 1);
+    pthread_join(writer, NULL);
+    drain();
+    d = atomic_load(&dropped);
+    fputc('D', out);
+    fwrite(&d, sizeof(d), 1, out);
+    fclose(out);
+    out = NULL;
+}
@@ -0,0 +1,57 @@
+/*
+ * srtp_log - levelled trace logging for the native SRTP tools.
+ *
+ * The level is fixed at compile time (make SRTP_LOG_LEVEL=n, default
+ * SRTP_LOG_INFO): a call above it is a constant-false branch the compiler
+ * removes, arguments included, so per-packet DEBUG/TRACE points cost
+ * nothing in a normal build.  Calls at or below it are recorded only
+ * after srtp_log_open(): the caller stores a timestamp, the format
+ * pointer and up to SRTP_LOG_MAXARGS integer arguments into a lock-free
+ * ring, and a background thread writes the records unformatted to a
+ * binary file.  Formatting happens offline (srtp_trace.py).  A full ring
+ * drops records and counts them rather than block the caller.
+ *
+ * The ring has a single producer: log from one thread only.  Arguments
+ * are integers (converted to uint64_t); the format must be a string
+ * literal using integer conversions only.
+ */
+#pragma once
+#include <stdint.h>
+
+#define SRTP_LOG_ERROR  1
+#define SRTP_LOG_WARN   2
+#define SRTP_LOG_INFO   3
+#define SRTP_LOG_DEBUG  4
+#define SRTP_LOG_TRACE  5
+
+#ifndef SRTP_LOG_LEVEL
+#define SRTP_LOG_LEVEL  SRTP_LOG_INFO
+#endif
+
+#define SRTP_LOG_MAXARGS 6
+
+extern int srtp_log_on;
+
+void srtp_log_put(int level, const char *fmt, int nargs, const uint64_t *args);
+
+#define SRTP_LOG(level, fmt, ...)                                                   \
+    do {                                                                            \
+        if ((level) <= SRTP_LOG_LEVEL && srtp_log_on) {                             \
+            const uint64_t a_[] = { 0, ##__VA_ARGS__ };                             \
+            _Static_assert(sizeof(a_) / sizeof(a_[0]) - 1 <= SRTP_LOG_MAXARGS,      \
+                           "too many log arguments");                               \
+            srtp_log_put((level), "" fmt, (int)(sizeof(a_) / sizeof(a_[0]) - 1), a_ + 1); \
+        }                                                                           \
+    } while (0)
+
+#define LOG_ERROR(...) SRTP_LOG(SRTP_LOG_ERROR, __VA_ARGS__)
+#define LOG_WARN(...)  SRTP_LOG(SRTP_LOG_WARN, __VA_ARGS__)
+#define LOG_INFO(...)  SRTP_LOG(SRTP_LOG_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) SRTP_LOG(SRTP_LOG_DEBUG, __VA_ARGS__)
+#define LOG_TRACE(...) SRTP_LOG(SRTP_LOG_TRACE, __VA_ARGS__)
+
+/* Starts the writer thread on path; 0 on success, -1 with errno set. */
+int srtp_log_open(const char *path);
+
+/* Drains the ring, notes the dropped count and stops the writer. */
+void srtp_log_close(void);
@@ -0,0 +1,80 @@
+#include <stdlib.h>
+#include <math.h>
+#include "srtp_lora.h"
+
+void srtp_lora_defaults(srtp_lora_params_t *p)
+{
+    p->sf = 7;
+    p->bw_khz = 125;
+    p->cr = 1;
+    p->preamble = 8;
+    p->overhead = SRTP_LORA_MAC;
+    p->duty = 0.01;
+    p->gw_duty = 0.1;
+    p->channels = 8;
+    p->gateways = 1;
+}
+
+uint64_t srtp_lora_airtime_us(const srtp_lora_params_t *p, int sf, size_t payload)
+{
+    double tsym_us = (double)(1 << sf) * 1000.0 / p->bw_khz;
+    int de = tsym_us >= 16000.0;
+    double num = 8.0 * (double)payload - 4.0 * sf + 28 + 16;     /* CRC on, explicit header */
+    double sym = 8 + fmax(ceil(num / (4.0 * (sf - 2 * de))) * (p->cr + 4), 0);
+
+    return (uint64_t)((p->preamble + 4.25 + sym) * tsym_us);
+}
+
+int srtp_lora_max_payload(int sf)
+{
+    return sf <= 8 ? 222 : sf == 9 ? 115 : 51;
+}
+
+int srtp_lora_air_init(srtp_lora_air_t *a, int cells)
+{
+    a->cells = cells;
+    a->ring = calloc((size_t)cells * SRTP_LORA_RING, sizeof(*a->ring));
+    a->head = calloc((size_t)cells, sizeof(*a->head));
+    return a->ring && a->head ? 0 : -1;
+}
+
+void srtp_lora_air_free(srtp_lora_air_t *a)
+{
+    free(a->ring);
+    free(a->head);
+}
+
+int srtp_lora_air_add(srtp_lora_air_t *a, int cell, uint64_t start, uint64_t end, uint32_t id,
+                      int ref, void (*hit)(int ref, uint32_t id))
+{
+    srtp_lora_tx_t *ring = a->ring + (size_t)cell * SRTP_LORA_RING;
+    int n = 0;
+
+    for (int i = 0; i < SRTP_LORA_RING; i++) {
+        if (ring[i].id && ring[i].start < end && start < ring[i].end) {
+            hit(ring[i].ref, ring[i].id);
+            n++;
+        }
+    }
+    ring[a->head[cell]] = (srtp_lora_tx_t){ start, end, id, ref };
+    a->head[cell] = (a->head[cell] + 1) % SRTP_LORA_RING;
+    return n;
+}
+
+void srtp_lora_print(FILE *out, const srtp_lora_params_t *p, const srtp_lora_stats_t *s)
+{
+    fprintf(out, "{\"sf\": %d, \"bw_khz\": %d, \"cr\": %d, \"channels\": %d, \"gateways\": %d, "
+            "\"duty_percent\": %g, \"gw_duty_percent\": %g, \"devices\": %lu, \"uplinks\": %lu, "
+            "\"downlinks\": %lu, \"collided\": %lu, \"duty_waits\": %lu, \"duty_drops\": %lu, "
+            "\"oversize\": %lu, \"up_airtime_s\": %.6f, \"down_airtime_s\": %.6f, "
+            "\"airtime_per_uplink_ms\": %.3f, \"airtime_per_downlink_ms\": %.3f, "
+            "\"duty_wait_s\": %.3f}",
+            p->sf, p->bw_khz, p->cr, p->channels, p->gateways, p->duty * 100, p->gw_duty * 100,
+            (unsigned long)s->devices, (unsigned long)s->uplinks, (unsigned long)s->downlinks,
+            (unsigned long)s->collided, (unsigned long)s->duty_waits,
+            (unsigned long)s->duty_drops, (unsigned long)s->oversize,
+            (double)s->up_airtime_us / 1e6, (double)s->down_airtime_us / 1e6,
+            s->uplinks ? (double)s->up_airtime_us / 1e3 / (double)s->uplinks : 0.0,
+            s->downlinks ? (double)s->down_airtime_us / 1e3 / (double)s->downlinks : 0.0,
+            (double)s->duty_wait_us / 1e6);
+}
@@ -0,0 +1,104 @@
+/*
+ * srtp_lora - a LoRaWAN channel for srtp_impair: time on air, duty cycle
+ * and ALOHA collisions instead of a fixed latency and loss.
+ *
+ * Time on air follows Semtech AN1200.13 for a frame of the datagram plus
+ * the LoRaWAN MAC overhead (13 bytes: MHDR, FHDR, FPort, MIC):
+ *
+ *   Tsym = 2^SF / BW,  preamble (n + 4.25) Tsym,
+ *   payload 8 + max(ceil((8 PL - 4 SF + 28 + 16 CRC - 20 IH) /
+ *                        (4 (SF - 2 DE))) (CR + 4), 0) symbols
+ *
+ * with low data rate optimisation (DE) on where Tsym reaches 16 ms.
+ *
+ * Each device (srtp_impair: each flow) may be on the air duty of the time:
+ * after a frame of airtime T it waits T / duty - T before the next one,
+ * and a frame that arrives earlier waits for it (as LoRaWAN stacks do).
+ * Downlinks are paced by the same rule per gateway, at its own duty.
+ *
+ * Devices are spread over the gateways' cells (flow % gateways) and pick
+ * one of the channels at random per frame.  Two uplinks in the same cell,
+ * on the same channel and spreading factor, that overlap in time both
+ * fail (pure ALOHA, no capture); different SFs are taken as orthogonal.
+ * With lora_sf 0 every device gets one of SF7-12 at random.  Downlinks
+ * are scheduled by the network server and never collide.
+ *
+ * The air keeps the last SRTP_LORA_RING transmissions of each cell, which
+ * is plenty as long as fewer than that start within one airtime there.
+ */
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SRTP_LORA_RING   256
+#define SRTP_LORA_SFS    6          /* SF7 .. SF12 */
+#define SRTP_LORA_MAC    13         /* LoRaWAN bytes around FRMPayload */
+
+typedef struct {
+    int sf;                        /* 7-12, or 0: per device at random */
+    int bw_khz;                    /* 125, 250 or 500 */
+    int cr;                        /* coding rate 4/(4 + cr), 1-4 */
+    int preamble;                  /* symbols, 8 */
+    int overhead;                  /* MAC bytes per frame */
+    double duty, gw_duty;          /* fractions: 0.01 per device, 0.1 per gateway */
+    int channels, gateways;
+} srtp_lora_params_t;
+
+/* Duty-cycle state of a device or gateway, and what it has sent */
+typedef struct {
+    uint64_t free_at_us;
+    uint64_t frames, airtime_us;
+} srtp_lora_radio_t;
+
+typedef struct {
+    uint64_t start, end;
+    uint32_t id;                   /* 0: free */
+    int ref;                       /* the caller's, e.g. its packet */
+} srtp_lora_tx_t;
+
+/* Recent transmissions of every cell (gateway x channel x SF) */
+typedef struct {
+    srtp_lora_tx_t *ring;
+    int *head;
+    int cells;
+} srtp_lora_air_t;
+
+typedef struct {
+    uint64_t uplinks, downlinks, collided, duty_waits, duty_drops, oversize;
+    uint64_t up_airtime_us, down_airtime_us, duty_wait_us, devices;
+} srtp_lora_stats_t;
+
+/* Defaults: SF7, 125 kHz, 4/5, 8 symbols, 1 % / 10 %, 8 channels, 1 gateway. */
+void srtp_lora_defaults(srtp_lora_params_t *p);
+
+uint64_t srtp_lora_airtime_us(const srtp_lora_params_t *p, int sf, size_t payload);
+
+/* Largest FRMPayload at sf (EU868 data rates). */
+int srtp_lora_max_payload(int sf);
+
+/* When a frame of airtime_us handed over at now may start on r at duty;
+ * books the radio until then plus its off time. */
+static inline uint64_t srtp_lora_start(srtp_lora_radio_t *r, uint64_t now, uint64_t airtime_us,
+                                       double duty)
+{
+    uint64_t start = r->free_at_us > now ? r->free_at_us : now;
+
+    r->free_at_us = start + (uint64_t)((double)airtime_us / duty);
+    r->frames++;
+    r->airtime_us += airtime_us;
+    return start;
+}
+
+int srtp_lora_air_init(srtp_lora_air_t *a, int cells);
+void srtp_lora_air_free(srtp_lora_air_t *a);
+
+/* Puts [start, end) on the air of cell and calls hit(ref, id) for every
+ * earlier transmission it overlaps; returns how many there were.  ids
+ * must be unique among recent transmissions and not 0. */
+int srtp_lora_air_add(srtp_lora_air_t *a, int cell, uint64_t start, uint64_t end, uint32_t id,
+                      int ref, void (*hit)(int ref, uint32_t id));
+
+/* Writes p and s as a JSON object, airtime in seconds. */
+void srtp_lora_print(FILE *out, const srtp_lora_params_t *p, const srtp_lora_stats_t *s);
@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "prtp_msg.h"
+#include "srtp_ring.h"
+
+uint32_t srtp_ring_hash(const char *key)
+{
+    uint32_t h = prtp_sid_hash(key);
+
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static int cmp_point(const void *a, const void *b)
+{
+    const srtp_ring_point_t *x = a, *y = b;
+
+    if (x->point != y->point)
+        return x->point < y->point ? -1 : 1;
+    return x->node - y->node;   /* deterministic order on collisions */
+}
+
+int srtp_ring_init(srtp_ring_t *r, const char *const *names, int nnodes)
+{
+    char key[SRTP_NODE_NAME_MAX + 16];
+
+    r->npoints = nnodes * SRTP_RING_VNODES;
+    r->points = malloc(sizeof(*r->points) * (size_t)r->npoints);
+    if (!r->points)
+        return -1;
+    for (int n = 0; n < nnodes; n++) {
+        for (int v = 0; v < SRTP_RING_VNODES; v++) {
+            srtp_ring_point_t *p = &r->points[n * SRTP_RING_VNODES + v];
+            snprintf(key, sizeof(key), "%s#%d", names[n], v);
+            p->point = srtp_ring_hash(key);
+            p->node = n;
+        }
+    }
+    qsort(r->points, (size_t)r->npoints, sizeof(*r->points), cmp_point);
+    return 0;
+}
+
+int srtp_ring_owner(const srtp_ring_t *r, const char *sid)
+{
+    uint32_t h = srtp_ring_hash(sid);
+    int lo = 0, hi = r->npoints;
+
+    /* first point >= h, wrapping to the start of the ring */
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (r->points[mid].point < h)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return r->points[lo == r->npoints ? 0 : lo].node;
+}
+
+void srtp_ring_free(srtp_ring_t *r)
+{
+    free(r->points);
+    r->points = NULL;
+    r->npoints = 0;
+}
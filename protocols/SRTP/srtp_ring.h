@@ -0,0 +1,36 @@
+/*
+ * srtp_ring - consistent-hash ring that assigns sensor ids to SRTP nodes.
+ *
+ * Every node contributes SRTP_RING_VNODES points, hashed from its name
+ * ("ip:sensor_port") and the replica index; a sensor belongs to the first
+ * point clockwise from its own hash.  Adding or removing a node therefore
+ * only moves the sensors on that node's arcs.  srtp.py::HashRing must
+ * place points and keys identically.
+ */
+#pragma once
+#include <stdint.h>
+
+#define SRTP_RING_VNODES   64
+#define SRTP_NODE_NAME_MAX 64
+
+typedef struct {
+    uint32_t point;
+    int node;
+} srtp_ring_point_t;
+
+typedef struct {
+    srtp_ring_point_t *points;
+    int npoints;
+} srtp_ring_t;
+
+/* Key hash: FNV-1a (prtp_sid_hash) followed by the murmur3 finalizer, which
+ * spreads the near-identical ids ("temp_1", "temp_2") around the ring. */
+uint32_t srtp_ring_hash(const char *key);
+
+/* Builds the ring for nnodes node names.  Returns 0, or -1 on allocation failure. */
+int srtp_ring_init(srtp_ring_t *r, const char *const *names, int nnodes);
+
+/* Index of the node owning sid. */
+int srtp_ring_owner(const srtp_ring_t *r, const char *sid);
+
+void srtp_ring_free(srtp_ring_t *r);
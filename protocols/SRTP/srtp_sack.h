@@ -0,0 +1,55 @@
+/*
+ * srtp_sack - the selective-ack scoreboard shared by srtp_subscriber (which
+ * fills it), srtp_shard_router (which expands it into per-update acks for
+ * STGen_Server) and srtp_sim (which runs both against a simulated link).
+ *
+ * A flow's scoreboard is a cumulative seq_no, every update up to which has
+ * arrived, plus a 32-bit map of later arrivals: bit i set means cum + 2 + i
+ * arrived too (cum + 1 is by definition still missing).
+ */
+#pragma once
+#include <stdint.h>
+
+/* Folds a received seq_no into the scoreboard. */
+static inline void srtp_sack_note(uint32_t *cum, uint32_t *bits, uint32_t seq_no)
+{
+    if (seq_no <= *cum)
+        return;                        /* resend; the flow is re-acked as is */
+    if (seq_no == *cum + 1) {
+        *cum = seq_no;
+        while (*bits & 1) {
+            (*cum)++;
+            *bits >>= 1;
+        }
+        *bits >>= 1;
+    } else if (seq_no - *cum - 2 < 32) {
+        *bits |= 1u << (seq_no - *cum - 2);
+    } else {
+        *cum = seq_no;                 /* beyond the window: the gap is lost */
+        *bits = 0;
+    }
+}
+
+/*
+ * Number of updates a sack entry reports beyond *acked, the highest seq_no
+ * already acked upstream, which moves up to the highest one reported.
+ * STGen_Server acks by sid alone, so the caller sends that many acks.
+ */
+static inline int srtp_sack_fresh(uint32_t *acked, uint32_t cum, uint32_t bits)
+{
+    uint32_t top = cum;
+    int fresh = 0;
+
+    if (cum > *acked)
+        fresh += (int)(cum - *acked);
+    for (int b = 0; b < 32; b++) {
+        uint32_t seq = cum + 2 + (uint32_t)b;
+        if ((bits >> b & 1) && seq > *acked) {
+            fresh++;
+            top = seq;
+        }
+    }
+    if (fresh)
+        *acked = top;
+    return fresh;
+}
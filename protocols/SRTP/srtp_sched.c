@@ -0,0 +1,230 @@
+#include <stdlib.h>
+#include <string.h>
+#include "srtp_sched.h"
+
+static int add_class(srtp_sched_t *s, const char *name, int prio, int weight)
+{
+    srtp_sched_class_t *c;
+
+    if (s->nclasses >= SRTP_SCHED_MAX_CLASSES)
+        return -1;
+    c = &s->classes[s->nclasses];
+    memset(c, 0, sizeof(*c));
+    snprintf(c->name, sizeof(c->name), "%s", name);
+    c->prio = prio;
+    c->weight = weight > 0 ? weight : 1;
+    c->q = calloc(SRTP_SCHED_QLIMIT, sizeof(*c->q));
+    if (!c->q)
+        return -1;
+    s->nclasses++;
+    return 0;
+}
+
+int srtp_sched_init(srtp_sched_t *s, const char *path, uint64_t rate_bps)
+{
+    char line[512];
+    FILE *fp;
+    int lineno = 0;
+
+    memset(s, 0, sizeof(*s));
+    s->rate_bps = rate_bps;
+    if (!path) {
+        if (add_class(s, "default", 0, 1) < 0)
+            return -1;
+        strcpy(s->classes[0].match[0], "*");
+        s->classes[0].nmatch = 1;
+        return 0;
+    }
+    if (!(fp = fopen(path, "r"))) {
+        perror(path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        char name[32], *tok, *save;
+        int prio, weight, used;
+        srtp_sched_class_t *c;
+
+        lineno++;
+        line[strcspn(line, "#\r\n")] = '\0';
+        if (sscanf(line, "%31s %d %d %n", name, &prio, &weight, &used) < 3) {
+            if (strspn(line, " \t") != strlen(line))
+                fprintf(stderr, "%s:%d: expected 'name prio weight match...'\n", path, lineno);
+            continue;
+        }
+        if (add_class(s, name, prio, weight) < 0) {
+            fprintf(stderr, "%s:%d: more than %d classes\n", path, lineno, SRTP_SCHED_MAX_CLASSES);
+            break;
+        }
+        c = &s->classes[s->nclasses - 1];
+        for (tok = strtok_r(line + used, " \t", &save); tok && c->nmatch < SRTP_SCHED_MAX_MATCH;
+             tok = strtok_r(NULL, " \t", &save))
+            snprintf(c->match[c->nmatch++], sizeof(c->match[0]), "%s", tok);
+    }
+    fclose(fp);
+    if (s->nclasses == 0) {
+        fprintf(stderr, "%s: no classes\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+int srtp_sched_classify(const srtp_sched_t *s, const char *sid, int reliable)
+{
+    if (!sid) {
+        int best = 0;
+        for (int i = 1; i < s->nclasses; i++)
+            if (s->classes[i].prio < s->classes[best].prio)
+                best = i;
+        return best;
+    }
+    for (int i = 0; i < s->nclasses; i++) {
+        const srtp_sched_class_t *c = &s->classes[i];
+        for (int k = 0; k < c->nmatch; k++) {
+            const char *t = c->match[k];
+            if (strcmp(t, "*") == 0 ||
+                (strcmp(t, "@reliable") == 0 && reliable) ||
+                (t[0] != '@' && sid[0] && strncmp(sid, t, strlen(t)) == 0))
+                return i;
+        }
+    }
+    return s->nclasses - 1;
+}
+
+int srtp_sched_enqueue(srtp_sched_t *s, int cls, const void *buf, size_t len,
+                       const struct sockaddr_in *dst, uint64_t now_us)
+{
+    srtp_sched_class_t *c = &s->classes[cls];
+    srtp_sched_pkt_t *p;
+
+    p = &c->q[(c->head + c->count) % SRTP_SCHED_QLIMIT];
+    if (c->count == SRTP_SCHED_QLIMIT || !(p->data = malloc(len))) {
+        c->dropped++;
+        return -1;
+    }
+    memcpy(p->data, buf, len);
+    p->len = len;
+    p->dst = *dst;
+    p->enq_us = now_us;
+    c->count++;
+    c->enqueued++;
+    return 0;
+}
+
+/* Strict priority across prio levels, deficit round robin within one. */
+static int pick_class(srtp_sched_t *s)
+{
+    int best = -1;
+
+    for (int i = 0; i < s->nclasses; i++)
+        if (s->classes[i].count && (best < 0 || s->classes[i].prio < s->classes[best].prio))
+            best = i;
+    if (best < 0)
+        return -1;
+    for (;;) {
+        srtp_sched_class_t *c = &s->classes[s->cursor];
+        if (c->prio == s->classes[best].prio && c->count) {
+            if (c->deficit >= (int64_t)c->q[c->head].len)
+                return s->cursor;
+            c->deficit += (int64_t)SRTP_SCHED_QUANTUM * c->weight;
+        } else if (!c->count) {
+            c->deficit = 0;
+        }
+        s->cursor = (s->cursor + 1) % s->nclasses;
+    }
+}
+
+static int hist_bucket(uint64_t us)
+{
+    int msb, b;
+
+    if (us < SRTP_SCHED_HIST_SUB)
+        return (int)us;
+    msb = 63 - __builtin_clzll(us);
+    b = (msb - 2) * SRTP_SCHED_HIST_SUB + (int)((us >> (msb - 3)) & (SRTP_SCHED_HIST_SUB - 1));
+    return b < SRTP_SCHED_HIST ? b : SRTP_SCHED_HIST - 1;
+}
+
+/* Midpoint of a bucket, in us. */
+static double hist_value(int b)
+{
+    int msb = b / SRTP_SCHED_HIST_SUB + 2;
+    uint64_t low, width;
+
+    if (b < SRTP_SCHED_HIST_SUB)
+        return b;
+    width = 1ULL << (msb - 3);
+    low = (uint64_t)(SRTP_SCHED_HIST_SUB + b % SRTP_SCHED_HIST_SUB) * width;
+    return (double)low + width / 2.0;
+}
+
+uint64_t srtp_sched_run(srtp_sched_t *s, uint64_t now_us, srtp_sched_tx_fn tx, void *arg)
+{
+    int cls;
+
+    while (s->link_free_us <= now_us && (cls = pick_class(s)) >= 0) {
+        srtp_sched_class_t *c = &s->classes[cls];
+        srtp_sched_pkt_t *p = &c->q[c->head];
+        uint64_t start = s->link_free_us > p->enq_us ? s->link_free_us : p->enq_us;
+        uint64_t delay = start - p->enq_us;
+
+        tx(p->data, p->len, &p->dst, arg);
+        c->deficit -= (int64_t)p->len;
+        c->sent++;
+        c->bytes += p->len;
+        c->hist[hist_bucket(delay)]++;
+        if (delay > c->max_delay_us)
+            c->max_delay_us = delay;
+        if (s->rate_bps)
+            s->link_free_us = start + p->len * 8 * 1000000ULL / s->rate_bps;
+        free(p->data);
+        c->head = (c->head + 1) % SRTP_SCHED_QLIMIT;
+        c->count--;
+    }
+    for (int i = 0; i < s->nclasses; i++)
+        if (s->classes[i].count)
+            return s->link_free_us > now_us ? s->link_free_us - now_us : 0;
+    return UINT64_MAX;
+}
+
+static double delay_percentile_ms(const srtp_sched_class_t *c, double p)
+{
+    uint64_t rank = (uint64_t)(p * c->sent + 0.999999), seen = 0;
+
+    if (c->sent == 0)
+        return 0;
+    if (rank < 1)
+        rank = 1;
+    for (int b = 0; b < SRTP_SCHED_HIST; b++) {
+        seen += c->hist[b];
+        if (seen >= rank)
+            return hist_value(b) / 1000.0;
+    }
+    return c->max_delay_us / 1000.0;
+}
+
+void srtp_sched_print_json(const srtp_sched_t *s, FILE *out)
+{
+    fputc('[', out);
+    for (int i = 0; i < s->nclasses; i++) {
+        const srtp_sched_class_t *c = &s->classes[i];
+        fprintf(out, "%s{\"name\": \"%s\", \"prio\": %d, \"weight\": %d, \"enqueued\": %lu, "
+                "\"sent\": %lu, \"dropped\": %lu, \"queued\": %d, \"bytes\": %lu, \"qdelay_p50_ms\": %.3f, "
+                "\"qdelay_p95_ms\": %.3f, \"qdelay_p99_ms\": %.3f, \"qdelay_max_ms\": %.3f}",
+                i ? ", " : "", c->name, c->prio, c->weight, (unsigned long)c->enqueued,
+                (unsigned long)c->sent, (unsigned long)c->dropped, c->count, (unsigned long)c->bytes,
+                delay_percentile_ms(c, 0.50), delay_percentile_ms(c, 0.95),
+                delay_percentile_ms(c, 0.99), c->max_delay_us / 1000.0);
+    }
+    fputc(']', out);
+}
+
+void srtp_sched_free(srtp_sched_t *s)
+{
+    for (int i = 0; i < s->nclasses; i++) {
+        srtp_sched_class_t *c = &s->classes[i];
+        for (; c->count; c->count--, c->head = (c->head + 1) % SRTP_SCHED_QLIMIT)
+            free(c->q[c->head].data);
+        free(c->q);
+    }
+    s->nclasses = 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * srtp_sched - multi-class transmit scheduler for datagrams towards SRTP
+ * clients.
+ *
+ * Classes are read from a file, one per line:
+ *
+ *     # name     prio  weight  match...
+ *     alarm      0     1       device_ @reliable
+ *     telemetry  1     4       temp_ gps_
+ *     bulk       1     1       camera_
+ *     default    2     1       *
+ *
+ * A datagram goes to the first class with a matching token: a dev_id
+ * prefix, "@reliable" for updates of reliable subscriptions, or "*".
+ * Unmatched updates fall into the last class; control replies (list,
+ * subscribe acks) take the most urgent class.  A lower prio always
+ * drains first (strict priority); classes sharing a prio split the link
+ * by weight with deficit round robin.
+ *
+ * The link is modelled at rate_bps: a datagram leaves once the previous
+ * one has been serialised, so queues build exactly where a constrained
+ * downlink would build them.  With rate_bps 0 the link is never busy and
+ * only datagrams that arrive together are reordered.  Every class keeps
+ * a log-linear histogram of its queueing delay (enqueue to transmit).
+ */
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <netinet/in.h>
+
+#define SRTP_SCHED_MAX_CLASSES 8
+#define SRTP_SCHED_MAX_MATCH   8
+#define SRTP_SCHED_QLIMIT      4096      /* datagrams per class, tail drop */
+#define SRTP_SCHED_QUANTUM     1500      /* DRR bytes per weight unit */
+#define SRTP_SCHED_HIST_SUB    8         /* buckets per power of two */
+#define SRTP_SCHED_HIST        256
+
+typedef struct {
+    uint64_t enq_us;
+    struct sockaddr_in dst;
+    size_t len;
+    uint8_t *data;
+} srtp_sched_pkt_t;
+
+typedef struct {
+    char name[32];
+    int prio, weight;
+    char match[SRTP_SCHED_MAX_MATCH][32];
+    int nmatch;
+    /* FIFO ring of SRTP_SCHED_QLIMIT datagrams */
+    srtp_sched_pkt_t *q;
+    int head, count;
+    int64_t deficit;
+    uint64_t enqueued, sent, dropped, bytes, max_delay_us;
+    uint64_t hist[SRTP_SCHED_HIST];
+} srtp_sched_class_t;
+
+typedef struct {
+    srtp_sched_class_t classes[SRTP_SCHED_MAX_CLASSES];
+    int nclasses;
+    int cursor;                      /* DRR position */
+    uint64_t rate_bps;
+    uint64_t link_free_us;
+} srtp_sched_t;
+
+typedef void (*srtp_sched_tx_fn)(const void *buf, size_t len,
+                                 const struct sockaddr_in *dst, void *arg);
+
+/* Reads classes from path; NULL gives one catch-all FIFO class.
+ * Returns 0, or -1 with a message on stderr. */
+int srtp_sched_init(srtp_sched_t *s, const char *path, uint64_t rate_bps);
+
+/* Class index for an update on sid ("" if it has none), or for control
+ * traffic when sid is NULL. */
+int srtp_sched_classify(const srtp_sched_t *s, const char *sid, int reliable);
+
+/* Queues a copy of buf.  Returns 0, or -1 if the class queue is full. */
+int srtp_sched_enqueue(srtp_sched_t *s, int cls, const void *buf, size_t len,
+                       const struct sockaddr_in *dst, uint64_t now_us);
+
+/* Transmits everything the link lets out by now_us.  Returns the number of
+ * microseconds until the next departure, or UINT64_MAX when idle. */
+uint64_t srtp_sched_run(srtp_sched_t *s, uint64_t now_us, srtp_sched_tx_fn tx, void *arg);
+
+/* Per-class counters and queueing delay percentiles as a JSON array. */
+void srtp_sched_print_json(const srtp_sched_t *s, FILE *out);
+
+void srtp_sched_free(srtp_sched_t *s);
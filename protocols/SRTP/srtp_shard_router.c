@@ -0,0 +1,1743 @@
+/*
+ * srtp_shard_router - fronts N STGen_Server shards on the public SRTP ports.
+ *
+ * STGen_Server binds its sockets without SO_REUSEPORT, so shards cannot
+ * share a port and be steered in the kernel.  Each shard instead listens
+ * on its own port pair and this router steers in user space.  Shards are
+ * either local (-n: shard k on shard_base + 2k for sensors, + 2k + 1 for
+ * clients) or cluster nodes anywhere on the network (-N ip:port[:port]):
+ *
+ *   sensor port  dev_id placed on the consistent-hash ring (srtp_ring.h)
+ *                to find the owning shard, received and forwarded in
+ *                recvmmsg/sendmmsg batches.
+ *   client port  one upstream socket per client, so every shard sees the
+ *                client as a single peer.  List and subscribe requests are
+ *                split by owning shard (or broadcast), subscribes further
+ *                into chunks the server accepts, and the responses merged
+ *                back into one reply, so -a/-A subscribe-all works
+ *                unchanged against a sharded server.  Acks and nacks go to
+ *                the owning shard; keep-alives and unsubscribes to all.
+ *   sacks        srtp_subscriber -D batches the acks of many reliable
+ *                updates into one sack.  STGen_Server acks by sid alone
+ *                (each ack releases the next queued update), so the router
+ *                expands a sack into one ack per update not yet acked,
+ *                remembering per client and sid what it already passed on;
+ *                a repeated or stale sack therefore never acks an update
+ *                the client has not seen.  The server retransmits unacked
+ *                updates on its own 200 ms timer, which covers sack holes.
+ *   egress       with -Q (priority classes, see srtp_sched.h) or -B (link
+ *                rate), datagrams towards clients are queued per class and
+ *                leave by strict priority / weighted fair share, so bulk
+ *                camera updates cannot hold up alarms on a slow downlink.
+ *   stats        a PRTP_STATS request on the client port is answered, not
+ *                forwarded: the reply carries the summary below plus
+ *                per-sensor reading/update/retransmit counters and
+ *                per-client queue depths as one JSON string, so a run can
+ *                be sampled as a time series.  Retransmits are reliable
+ *                updates the server sends again with an unchanged seq_no.
+ *   batching     client and upstream sockets are drained in recvmmsg
+ *                batches of up to -b datagrams (a short batch means the
+ *                socket is empty, so no trailing EAGAIN call), datagrams
+ *                to clients are collected over one loop iteration and
+ *                leave in one sendmmsg, and the acks a sack expands into
+ *                go upstream in one call.  io_calls / io_msgs in the
+ *                stats count datagram syscalls against datagrams moved.
+ *   snapshot     with -S, the sessions (client address) and their acked
+ *                subscriptions and sack positions are written to an mmap'd
+ *                file shortly after every change, via a temporary file
+ *                and rename so a crash leaves the previous one intact.
+ *                A router started on an existing snapshot recreates the
+ *                sessions and replays their subscriptions upstream (acks
+ *                swallowed, retried until answered), so after a restart
+ *                of the router and its servers updates flow to the
+ *                clients again without any of them resubscribing.
+ *   options      a subscribe may carry per-sid options (prtp_sub_opts_t:
+ *                minimum interval, deadband, latest value only), which
+ *                the stock server does not know: the router strips them
+ *                upstream and applies them to each update before it fans
+ *                out to that client.  The router acks the reliable
+ *                updates of such a flow upstream itself on arrival, so a
+ *                dropped or held update never stalls the server's
+ *                per-sid stop-and-wait, and absorbs the client's acks for
+ *                it.  Held updates leave from housekeeping, within 50 ms
+ *                of their interval's end.
+ *   cache        with -V n, the latest update of up to n sensors (as the
+ *                server last sent it to any client, CACHE_UPDATE_MAX bytes
+ *                at most, fragments excluded) is kept, and a client whose
+ *                subscribe is acked gets the cached update of every sensor
+ *                it was not subscribed to right behind the ack (the server
+ *                answers a subscribe after an unsubscribe with "exists",
+ *                so the router's own flow state decides), rather than
+ *                waiting for the sensor's next reading.  The copy goes out
+ *                as seq_no 0 and unreliable: the server numbers the flow's
+ *                own updates from 1, and never sent this one, so it must
+ *                not be acked.  The server's own opening update for such a
+ *                flow (seq_no 0, its stored value, not always under the
+ *                right sid) is then dropped.  Sensors nobody subscribes
+ *                to, and so are never cached.
+ *   multicast    with -M group:port, a subscribe whose sid carries the
+ *                multicast option is not passed upstream per client:
+ *                the router subscribes once per sensor on a session of
+ *                its own and acks the client with the sensor's group
+ *                (group + sid hash % MCAST_GROUPS, same port).  Every
+ *                update from that session leaves once, to the group,
+ *                renumbered per sensor from 1 and unreliable, and the
+ *                last REPAIR_RING of each sensor are kept: a nack from
+ *                a member is answered with a unicast copy (repair), and
+ *                its acks are absorbed.  The upstream cost of a popular
+ *                sensor is then one subscriber rather than N, and its
+ *                egress one datagram per update.  Group datagrams bypass
+ *                the -Q/-B egress scheduler.
+ *   compression  a sid subscribed with the compress option gets its
+ *                updates header-compressed (srtp_hc.h) on the way to the
+ *                client, before the egress scheduler, so a slow downlink
+ *                carries only what changed since the flow's last IR.  A
+ *                client that lost an IR sends PRTP_HC_RESYNC for the
+ *                context, and the next update goes out as an IR again.
+ *
+ * A one-line JSON summary is printed to stdout on exit.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "prtp_msg.h"
+#include "srtp_clock.h"
+#include "srtp_hc.h"
+#include "srtp_log.h"
+#include "srtp_ring.h"
+#include "srtp_sack.h"
+#include "srtp_sched.h"
+
+#define MAX_SHARDS      64
+#define BATCH           64
+#define SENSOR_FRAME    8192
+#define MERGE_TIMEOUT_MS 200
+#define SESSION_IDLE_S  120
+#define SESSION_BUCKETS 4096
+#define SNAPSHOT_MS     200            /* snapshot delay after a change */
+#define REPLAY_RETRY_MS 100
+#define SNAPSHOT_MAGIC  "SRTPSNP2"
+#define CACHE_UPDATE_MAX 512           /* larger updates are not cached (or repaired) */
+#define MCAST_GROUPS    16             /* group addresses the sids hash onto */
+#define REPAIR_RING     64             /* group updates kept per sensor for repairs */
+#define GROUP_KEEPALIVE_MS 5000
+
+/* The four octets of a network-order IPv4 address, as log arguments */
+#define IP4(a) ((const uint8_t *)&(a))[0], ((const uint8_t *)&(a))[1], \
+               ((const uint8_t *)&(a))[2], ((const uint8_t *)&(a))[3]
+
+/* Open addressing on prtp_sid_hash; every entry starts with its sid */
+typedef struct {
+    char *slots;
+    size_t elem;
+    int cap, n;
+} sidtab_t;
+
+/* One client's flow of one sid */
+typedef struct {
+    char sid[PRTP_SID_MAX];
+    uint32_t acked;                /* last update seq_no acked upstream (sacks) */
+    uint32_t sent;                 /* last update seq_no passed to the client */
+    bool subscribed, reliable;     /* acked subscription, for snapshots */
+    bool cache_due;                /* subscribe sent while not subscribed */
+    bool cache_sent;               /* answered from the cache, no update since */
+    bool grouped;                  /* delivered through the sensor's multicast group */
+    uint8_t cid;                   /* header compression context, 0 if none */
+    prtp_sub_opts_t opts;          /* as subscribed; all zero: no filtering */
+    uint64_t next_ms;              /* min_interval_ms: next update not before */
+    double value;                  /* deadband: value last delivered */
+    bool has_value;
+    uint8_t *held;                 /* latest: newest update of the interval */
+    uint32_t held_len;
+    bool held_reliable, held_numeric;
+    double held_value;
+} flow_t;
+
+typedef struct {
+    char sid[PRTP_SID_MAX];
+    uint64_t readings, updates, retransmits;
+} sensor_stat_t;
+
+/* One sensor's multicast fan-out */
+typedef struct {
+    char sid[PRTP_SID_MAX];
+    int members;                   /* client flows on the group */
+    bool acked;                    /* upstream subscribe answered */
+    uint64_t retry_ms;
+    uint32_t seq;                  /* last group seq_no sent */
+    uint8_t *ring;                 /* REPAIR_RING slots of CACHE_UPDATE_MAX bytes */
+    uint16_t ring_len[REPAIR_RING];
+    uint32_t ring_seq[REPAIR_RING];
+} group_t;
+
+/* The latest update of one sensor */
+typedef struct {
+    char sid[PRTP_SID_MAX];
+    uint8_t *pkt;
+    uint16_t len, cap;
+} cached_t;
+
+typedef struct session {
+    struct sockaddr_in addr;       /* client as seen on the public port */
+    int fd;                        /* upstream socket towards all shards */
+    uint64_t last_seen_ms;
+    /* pending list/subscribe merge */
+    int merge_type;                /* PRTP_LIST_RESPONSE / PRTP_SUBSCRIBE_ACK, -1 if idle */
+    uint32_t merge_seq;
+    int merge_expected, merge_got;
+    uint64_t merge_deadline_ms;
+    prtp_sid_t *merge_sids;
+    int merge_nsids;
+    sidtab_t flows;                /* flow_t */
+    uint64_t updates, retransmits;
+    int queued;                    /* datagrams waiting in the egress scheduler */
+    int replay_pending;            /* restored subscribe chunks not yet acked */
+    uint64_t replay_deadline_ms;
+    int held;                      /* flows holding an update (latest) */
+    srtp_hc_ctx_t *hc;             /* SRTP_HC_CONTEXTS, once a flow is compressed */
+    int ncids;
+    struct session *next;
+} session_t;
+
+/* Snapshot file: header, then per session a record and its flows */
+typedef struct {
+    char magic[8];
+    uint32_t nsessions, nflows;
+} snap_header_t;
+
+typedef struct {
+    struct sockaddr_in addr;
+    uint32_t nflows;
+} snap_session_t;
+
+typedef struct {
+    char sid[PRTP_SID_MAX];
+    uint32_t sent, acked;
+    uint8_t reliable;
+    prtp_sub_opts_t opts;
+} snap_flow_t;
+
+static volatile sig_atomic_t run = 1;
+static void handle_sig(int s) { (void)s; run = 0; }
+
+static int nshards;
+static struct sockaddr_in shard_sensor[MAX_SHARDS], shard_client[MAX_SHARDS];
+static char shard_name[MAX_SHARDS][SRTP_NODE_NAME_MAX];
+static srtp_ring_t ring;
+static int client_fd, sensor_fd, epfd;
+static session_t *sessions[SESSION_BUCKETS];
+static prtp_sid_t scratch_sids[PRTP_MAX_SIDS];
+static srtp_sched_t sched;
+static int shaped;
+static uint64_t egress_kbps, start_ms;
+static int batch = BATCH;
+static const char *snapshot_path;
+static int snapshot_dirty, restoring;
+static uint64_t snapshot_due_ms;
+static sidtab_t sensor_stats = { .elem = sizeof(sensor_stat_t) };
+static sidtab_t cache = { .elem = sizeof(cached_t) };
+static int cache_max;
+static struct sockaddr_in mcast_base;  /* -M: first group address, and the port */
+static session_t *mcast_up;            /* upstream subscriber of the grouped sensors */
+static sidtab_t groups = { .elem = sizeof(group_t) };
+static uint64_t group_keepalive_ms;
+
+static struct {
+    uint64_t sensor_in, sensor_out[MAX_SHARDS], sensor_unrouted;
+    uint64_t client_in, client_out, client_bytes, merges, merge_timeouts, sessions;
+    uint64_t upstream_in, upstream_bytes;
+    uint64_t sacks, sack_entries, sack_acks, sack_stale;
+    uint64_t updates, update_out, update_bytes, retransmits, stats_queries;
+    uint64_t io_calls, io_msgs;        /* datagram syscalls / datagrams moved */
+    uint64_t snapshots, restored_sessions, restored_flows, replays;
+    int64_t restore_ms;                /* start until every replay was acked, -1 if pending */
+    uint64_t filtered, filtered_bytes, coalesced, filter_acks, acks_absorbed;
+    uint64_t cache_bytes, cache_hits, cache_misses, cache_full, cache_superseded;
+    uint64_t mcast_out, mcast_bytes, mcast_suppressed, repairs, repair_misses;
+    uint64_t hc_updates, hc_irs, hc_resyncs, hc_raw_bytes, hc_bytes;
+} st;
+
+/* Datagrams towards clients, collected until flush_clients() */
+static struct {
+    uint8_t buf[BATCH][PRTP_MAX_PKT];
+    struct iovec iov[BATCH];
+    struct sockaddr_in dst[BATCH];
+    struct mmsghdr msg[BATCH];
+    int n;
+} tx;
+
+/* The last recv_batch() */
+static struct {
+    uint8_t buf[BATCH][PRTP_MAX_PKT];
+    struct iovec iov[BATCH];
+    struct sockaddr_in from[BATCH];
+    struct mmsghdr msg[BATCH];
+} rx;
+
+static int bind_udp(const char *ip, int port)
+{
+    struct sockaddr_in a = { .sin_family = AF_INET, .sin_port = htons(port) };
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+
+    a.sin_addr.s_addr = inet_addr(ip);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&a, sizeof(a)) < 0) {
+        perror("bind");
+        exit(1);
+    }
+    return fd;
+}
+
+static int shard_of(const char *sid)
+{
+    return srtp_ring_owner(&ring, sid);
+}
+
+/* Entry for sid, zero-filled when new; NULL if out of memory or sid is
+ * empty (an empty key marks a free slot).  The pointer is valid until
+ * the next lookup that inserts. */
+static void *sidtab_get(sidtab_t *t, const char *sid)
+{
+    uint32_t mask, i;
+    char *e;
+
+    if (!sid[0])
+        return NULL;
+    if (2 * (t->n + 1) > t->cap) {
+        int cap = t->cap ? 2 * t->cap : 16;
+        char *old = t->slots, *slots = calloc((size_t)cap, t->elem);
+        if (!slots)
+            return NULL;
+        for (int k = 0; k < t->cap; k++) {
+            char *o = old + (size_t)k * t->elem;
+            if (!o[0])
+                continue;
+            for (i = prtp_sid_hash(o) & (cap - 1); slots[(size_t)i * t->elem]; i = (i + 1) & (cap - 1))
+                ;
+            memcpy(slots + (size_t)i * t->elem, o, t->elem);
+        }
+        free(old);
+        t->slots = slots;
+        t->cap = cap;
+    }
+    mask = (uint32_t)t->cap - 1;
+    for (i = prtp_sid_hash(sid) & mask; *(e = t->slots + (size_t)i * t->elem); i = (i + 1) & mask)
+        if (strcmp(e, sid) == 0)
+            return e;
+    memset(e, 0, t->elem);
+    snprintf(e, PRTP_SID_MAX, "%s", sid);
+    t->n++;
+    return e;
+}
+
+/* Entry for sid, or NULL if there is none. */
+static void *sidtab_find(const sidtab_t *t, const char *sid)
+{
+    uint32_t mask = (uint32_t)t->cap - 1, i;
+    char *e;
+
+    if (!t->cap || !sid[0])
+        return NULL;
+    for (i = prtp_sid_hash(sid) & mask; *(e = t->slots + (size_t)i * t->elem); i = (i + 1) & mask)
+        if (strcmp(e, sid) == 0)
+            return e;
+    return NULL;
+}
+
+static int add_shard(const char *ip, int sensor_port, int client_port)
+{
+    int k = nshards;
+
+    if (k >= MAX_SHARDS || inet_addr(ip) == INADDR_NONE ||
+        sensor_port < 1 || sensor_port > 65535 || client_port < 1 || client_port > 65535)
+        return -1;
+    shard_sensor[k].sin_family = shard_client[k].sin_family = AF_INET;
+    shard_sensor[k].sin_addr.s_addr = shard_client[k].sin_addr.s_addr = inet_addr(ip);
+    shard_sensor[k].sin_port = htons(sensor_port);
+    shard_client[k].sin_port = htons(client_port);
+    snprintf(shard_name[k], sizeof(shard_name[k]), "%s:%d", ip, sensor_port);
+    nshards++;
+    return 0;
+}
+
+/* "ip:sensor_port[:client_port]"; the client port defaults to sensor_port + 1 */
+static int add_node(const char *spec)
+{
+    char ip[32];
+    int sp, cp = 0;
+
+    if (sscanf(spec, "%31[^:]:%d:%d", ip, &sp, &cp) < 2)
+        return -1;
+    return add_shard(ip, sp, cp ? cp : sp + 1);
+}
+
+/* ---------- sensor path ---------- */
+
+/* Extracts the dev_id value from "{'dev_id': 'temp_0', ...}" framing. */
+static int frame_dev_id(const char *buf, size_t len, char *out, size_t cap)
+{
+    const char *k = memmem(buf, len, "dev_id", 6), *end = buf + len, *q;
+    char quote;
+    size_t n;
+
+    if (!k)
+        return -1;
+    k += 7;                                  /* past key and its closing quote */
+    while (k < end && *k != ':') k++;
+    while (k < end && *k != '\'' && *k != '"') k++;
+    if (k >= end)
+        return -1;
+    quote = *k++;
+    q = memchr(k, quote, end - k);
+    if (!q || (n = (size_t)(q - k)) >= cap)
+        return -1;
+    memcpy(out, k, n);
+    out[n] = '\0';
+    return 0;
+}
+
+static void pump_sensors(void)
+{
+    static char bufs[BATCH][SENSOR_FRAME];
+    struct mmsghdr in[BATCH], out[BATCH];
+    struct iovec iov[BATCH];
+    char sid[PRTP_SID_MAX];
+    sensor_stat_t *ss;
+    int n, m = 0;
+
+    memset(in, 0, sizeof(in));
+    for (int i = 0; i < BATCH; i++) {
+        iov[i].iov_base = bufs[i];
+        iov[i].iov_len = SENSOR_FRAME;
+        in[i].msg_hdr.msg_iov = &iov[i];
+        in[i].msg_hdr.msg_iovlen = 1;
+    }
+    n = recvmmsg(sensor_fd, in, (unsigned)batch, MSG_DONTWAIT, NULL);
+    st.io_calls++;
+    if (n <= 0)
+        return;
+    st.sensor_in += (uint64_t)n;
+    st.io_msgs += (uint64_t)n;
+    LOG_DEBUG("sensor batch: %d datagrams", n);
+
+    memset(out, 0, sizeof(out));
+    for (int i = 0; i < n; i++) {
+        int k;
+        if (frame_dev_id(bufs[i], in[i].msg_len, sid, sizeof(sid)) < 0) {
+            st.sensor_unrouted++;
+            continue;
+        }
+        k = shard_of(sid);
+        if ((ss = sidtab_get(&sensor_stats, sid)))
+            ss->readings++;
+        iov[i].iov_len = in[i].msg_len;
+        out[m].msg_hdr.msg_iov = &iov[i];
+        out[m].msg_hdr.msg_iovlen = 1;
+        out[m].msg_hdr.msg_name = &shard_sensor[k];
+        out[m].msg_hdr.msg_namelen = sizeof(shard_sensor[k]);
+        st.sensor_out[k]++;
+        m++;
+    }
+    for (int off = 0; off < m; ) {
+        int rc = sendmmsg(sensor_fd, out + off, (unsigned)(m - off), 0);
+        st.io_calls++;
+        if (rc <= 0)
+            break;
+        off += rc;
+        st.io_msgs += (uint64_t)rc;
+    }
+}
+
+/* Up to batch datagrams from fd into rx; returns the count (0 if none). */
+static int recv_batch(int fd)
+{
+    int n;
+
+    for (int i = 0; i < batch; i++) {
+        rx.iov[i].iov_base = rx.buf[i];
+        rx.iov[i].iov_len = sizeof(rx.buf[i]);
+        rx.msg[i].msg_hdr = (struct msghdr){
+            .msg_name = &rx.from[i], .msg_namelen = sizeof(rx.from[i]),
+            .msg_iov = &rx.iov[i], .msg_iovlen = 1,
+        };
+    }
+    n = recvmmsg(fd, rx.msg, (unsigned)batch, MSG_DONTWAIT, NULL);
+    st.io_calls++;
+    if (n <= 0)
+        return 0;
+    st.io_msgs += (uint64_t)n;
+    return n;
+}
+
+/* ---------- client path ---------- */
+
+static unsigned bucket_of(const struct sockaddr_in *a)
+{
+    return (a->sin_addr.s_addr * 2654435761u ^ a->sin_port) % SESSION_BUCKETS;
+}
+
+static session_t *find_session(const struct sockaddr_in *a)
+{
+    for (session_t *s = sessions[bucket_of(a)]; s; s = s->next)
+        if (s->addr.sin_port == a->sin_port && s->addr.sin_addr.s_addr == a->sin_addr.s_addr)
+            return s;
+    return NULL;
+}
+
+/* A session and its upstream socket, not yet in the session table */
+static session_t *open_session(const struct sockaddr_in *a)
+{
+    session_t *s = calloc(1, sizeof(*s));
+    struct sockaddr_in any = { .sin_family = AF_INET };
+    struct epoll_event ev = { .events = EPOLLIN };
+
+    if (!s)
+        return NULL;
+    s->addr = *a;
+    s->merge_type = -1;
+    s->flows.elem = sizeof(flow_t);
+    s->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (s->fd < 0 || bind(s->fd, (struct sockaddr *)&any, sizeof(any)) < 0) {
+        free(s);
+        return NULL;
+    }
+    ev.data.ptr = s;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, s->fd, &ev);
+    return s;
+}
+
+static session_t *new_session(const struct sockaddr_in *a)
+{
+    session_t *s = open_session(a);
+
+    if (!s)
+        return NULL;
+    s->next = sessions[bucket_of(a)];
+    sessions[bucket_of(a)] = s;
+    st.sessions++;
+    LOG_INFO("session %u.%u.%u.%u:%u opened", IP4(a->sin_addr.s_addr), ntohs(a->sin_port));
+    return s;
+}
+
+#define FLOW_AT(t, i) ((flow_t *)((t)->slots + (size_t)(i) * (t)->elem))
+
+static void group_leave(flow_t *f);
+
+static void free_session(session_t *s)
+{
+    for (int i = 0; i < s->flows.cap; i++) {
+        free(FLOW_AT(&s->flows, i)->held);
+        group_leave(FLOW_AT(&s->flows, i));
+    }
+    if (s->hc) {
+        srtp_hc_free(s->hc, SRTP_HC_CONTEXTS);
+        free(s->hc);
+    }
+    close(s->fd);
+    free(s->merge_sids);
+    free(s->flows.slots);
+    free(s);
+}
+
+/* count copies of one datagram to shard k, in one sendmmsg when several */
+static void to_shard_n(session_t *s, int k, const void *buf, size_t len, int count)
+{
+    struct mmsghdr out[BATCH];
+    struct iovec iov = { (void *)buf, len };
+
+    if (count == 1) {
+        st.io_calls++;
+        if (sendto(s->fd, buf, len, 0, (struct sockaddr *)&shard_client[k], sizeof(shard_client[k])) >= 0)
+            st.io_msgs++;
+        return;
+    }
+    while (count > 0) {
+        int m = count < batch ? count : batch, rc;
+        for (int i = 0; i < m; i++)
+            out[i].msg_hdr = (struct msghdr){
+                .msg_name = &shard_client[k], .msg_namelen = sizeof(shard_client[k]),
+                .msg_iov = &iov, .msg_iovlen = 1,
+            };
+        rc = sendmmsg(s->fd, out, (unsigned)m, 0);
+        st.io_calls++;
+        if (rc <= 0)
+            return;
+        st.io_msgs += (uint64_t)rc;
+        count -= rc;
+    }
+}
+
+static void to_shard(session_t *s, int k, const void *buf, size_t len)
+{
+    to_shard_n(s, k, buf, len, 1);
+}
+
+static void flush_clients(void)
+{
+    for (int off = 0; off < tx.n; ) {
+        int rc = sendmmsg(client_fd, tx.msg + off, (unsigned)(tx.n - off), 0);
+        st.io_calls++;
+        if (rc <= 0)
+            break;                     /* a full socket buffer drops the rest, as sendto did */
+        for (int i = off; i < off + rc; i++)
+            st.client_bytes += tx.iov[i].iov_len;
+        off += rc;
+        st.client_out += (uint64_t)rc;
+        st.io_msgs += (uint64_t)rc;
+    }
+    tx.n = 0;
+}
+
+/* Queues a datagram for the next flush_clients() */
+static void transmit(const void *buf, size_t len, const struct sockaddr_in *dst, void *arg)
+{
+    int i;
+
+    (void)arg;
+    if (tx.n == batch)
+        flush_clients();
+    i = tx.n++;
+    memcpy(tx.buf[i], buf, len);
+    tx.dst[i] = *dst;
+    tx.iov[i] = (struct iovec){ tx.buf[i], len };
+    tx.msg[i].msg_hdr = (struct msghdr){
+        .msg_name = &tx.dst[i], .msg_namelen = sizeof(tx.dst[i]),
+        .msg_iov = &tx.iov[i], .msg_iovlen = 1,
+    };
+}
+
+/* Scheduler callback: a queued datagram leaves */
+static void dequeue(const void *buf, size_t len, const struct sockaddr_in *dst, void *arg)
+{
+    session_t *s = find_session(dst);
+
+    if (s && s->queued > 0)
+        s->queued--;
+    transmit(buf, len, dst, arg);
+}
+
+/* Gives f a header compression context (forcing an IR), if one is left. */
+static void compress_flow(session_t *s, flow_t *f)
+{
+    if (!f->cid && s->ncids < SRTP_HC_CONTEXTS - 1) {
+        if (!s->hc && !(s->hc = calloc(SRTP_HC_CONTEXTS, sizeof(*s->hc))))
+            return;
+        f->cid = (uint8_t)++s->ncids;
+    }
+    if (f->cid)
+        srtp_hc_invalidate(&s->hc[f->cid]);
+}
+
+/* The update of a compressed flow, header-compressed; else buf as it is. */
+static const void *compress_update(session_t *s, const void *buf, size_t *len, const char *sid)
+{
+    static uint8_t out[PRTP_MAX_PKT];
+    const flow_t *f = sidtab_find(&s->flows, sid);
+    size_t n;
+
+    if (!f || !f->cid || !(n = srtp_hc_compress(&s->hc[f->cid], f->cid, buf, *len, out, sizeof(out))))
+        return buf;
+    st.hc_updates++;
+    st.hc_irs += out[1] == SRTP_HC_IR;
+    st.hc_raw_bytes += *len;
+    st.hc_bytes += n;
+    *len = n;
+    return out;
+}
+
+/* up is the parsed update, or NULL for control replies. */
+static void to_client(session_t *s, const void *buf, size_t len, const prtp_msg_t *up)
+{
+    int cls;
+
+    if (up && up->sid[0] && s->hc)
+        buf = compress_update(s, buf, &len, up->sid);
+    if (up) {
+        st.update_out++;
+        st.update_bytes += len;        /* as sent, header-compressed or not */
+    }
+    if (!shaped) {
+        transmit(buf, len, &s->addr, NULL);
+        return;
+    }
+    cls = up ? srtp_sched_classify(&sched, up->sid, up->reliable)
+             : srtp_sched_classify(&sched, NULL, 0);
+    if (srtp_sched_enqueue(&sched, cls, buf, len, &s->addr, srtp_now_us()) == 0)
+        s->queued++;
+}
+
+/* Returns whether m is a retransmit of a reliable update. */
+static int count_update(session_t *s, const prtp_msg_t *m)
+{
+    sensor_stat_t *ss;
+    flow_t *f;
+    int again = 0;
+
+    s->updates++;
+    st.updates++;
+    if (!m->sid[0])
+        return 0;                      /* the empty update opening a subscription */
+    if (m->reliable && (f = sidtab_get(&s->flows, m->sid))) {
+        again = f->sent == m->seq_no;
+        f->sent = m->seq_no;
+    }
+    if ((ss = sidtab_get(&sensor_stats, m->sid))) {
+        ss->updates++;
+        ss->retransmits += (uint64_t)again;
+    }
+    s->retransmits += (uint64_t)again;
+    st.retransmits += (uint64_t)again;
+    LOG_TRACE("update seq_no %u, reliable %d, retransmit %d", m->seq_no, m->reliable, again);
+    return again;
+}
+
+/* ---------- subscription options ---------- */
+
+static bool filtered_flow(const flow_t *f)
+{
+    return f->opts.min_interval_ms || f->opts.deadband > 0;
+}
+
+static void drop_held(session_t *s, flow_t *f)
+{
+    if (!f->held_len)
+        return;
+    f->held_len = 0;
+    s->held--;
+}
+
+static void deliver_held(session_t *s, flow_t *f)
+{
+    prtp_msg_t up = { .reliable = f->held_reliable };
+
+    memcpy(up.sid, f->sid, sizeof(up.sid));
+    if (f->held_numeric) {
+        f->value = f->held_value;
+        f->has_value = true;
+    }
+    f->next_ms = srtp_now_ms() + f->opts.min_interval_ms;
+    to_client(s, f->held, f->held_len, &up);
+    drop_held(s, f);
+}
+
+/* Applies f's options to an update from upstream; true if it goes to the
+ * client now.  Reliable updates are acked upstream here, retransmits
+ * included (the server resends until its ack arrives). */
+static bool admit_update(session_t *s, flow_t *f, const uint8_t *buf, size_t len,
+                         const prtp_msg_t *m, int again)
+{
+    static uint8_t pkt[256];
+    uint64_t now = srtp_now_ms();
+    double v = 0, d;
+    bool numeric;
+    size_t n;
+
+    if (m->reliable && (n = prtp_build_ack(pkt, sizeof(pkt), PRTP_UPDATE_ACK, m->seq_no, m->sid))) {
+        to_shard(s, shard_of(m->sid), pkt, n);
+        st.filter_acks++;
+    }
+    numeric = f->opts.deadband > 0 && prtp_update_value(m, &v) == 0;
+    d = v > f->value ? v - f->value : f->value - v;
+    if (again || (numeric && f->has_value && d < f->opts.deadband)) {
+        st.filtered++;
+        st.filtered_bytes += len;
+        return false;
+    }
+    if (f->opts.min_interval_ms && now < f->next_ms) {
+        uint8_t *held;
+        if (!f->opts.latest || !(held = realloc(f->held, len))) {
+            st.filtered++;
+            st.filtered_bytes += len;
+            return false;
+        }
+        if (f->held_len) {
+            st.coalesced++;            /* a newer update replaces the held one */
+            st.filtered_bytes += f->held_len;
+        } else {
+            s->held++;
+        }
+        f->held = held;
+        memcpy(f->held, buf, len);
+        f->held_len = (uint32_t)len;
+        f->held_reliable = m->reliable;
+        f->held_numeric = numeric;
+        f->held_value = v;
+        return false;
+    }
+    if (f->held_len) {
+        st.coalesced++;                /* housekeeping had not released it yet */
+        st.filtered_bytes += f->held_len;
+        drop_held(s, f);
+    }
+    f->next_ms = now + f->opts.min_interval_ms;
+    if (numeric) {
+        f->value = v;
+        f->has_value = true;
+    }
+    return true;
+}
+
+static void deliver_due(session_t *s, uint64_t now)
+{
+    for (int i = 0; i < s->flows.cap && s->held > 0; i++) {
+        flow_t *f = FLOW_AT(&s->flows, i);
+        if (f->held_len && now >= f->next_ms)
+            deliver_held(s, f);
+    }
+}
+
+/* Starts collecting a reply from the shards; false if out of memory, in
+ * which case the request goes unanswered and the client retries. */
+static bool begin_merge(session_t *s, int type, uint32_t seq, int expected)
+{
+    if (!s->merge_sids && !(s->merge_sids = malloc(sizeof(prtp_sid_t) * PRTP_MAX_SIDS)))
+        return false;
+    s->merge_type = type;
+    s->merge_seq = seq;
+    s->merge_expected = expected;
+    s->merge_got = 0;
+    s->merge_nsids = 0;
+    s->merge_deadline_ms = srtp_now_ms() + MERGE_TIMEOUT_MS;
+    return true;
+}
+
+/* ---------- latest-value cache ---------- */
+
+static void cache_update(const prtp_msg_t *m, const uint8_t *buf, size_t len)
+{
+    cached_t *c;
+
+    if (len > CACHE_UPDATE_MAX)
+        return;
+    if (m->blob && m->blob_len >= PRTP_FRAG_HDR && (m->blob[0] << 8 | m->blob[1]) == PRTP_FRAG_MAGIC)
+        return;                        /* one fragment is not a reading */
+    if (!(c = sidtab_find(&cache, m->sid))) {
+        if (cache.n >= cache_max) {
+            st.cache_full++;
+            return;
+        }
+        if (!(c = sidtab_get(&cache, m->sid)))
+            return;
+    }
+    if (len > c->cap) {
+        uint8_t *pkt = realloc(c->pkt, len);
+        if (!pkt)
+            return;
+        st.cache_bytes += len - c->cap;
+        c->pkt = pkt;
+        c->cap = (uint16_t)len;
+    }
+    memcpy(c->pkt, buf, len);
+    c->len = (uint16_t)len;
+}
+
+/* The cached update of every sid newly subscribed in an ack, to s. */
+static void send_cached(session_t *s, const prtp_sid_t *sids, int n)
+{
+    static uint8_t pkt[CACHE_UPDATE_MAX];
+
+    for (int i = 0; i < n; i++) {
+        flow_t *f = sidtab_find(&s->flows, sids[i].sid);
+        const cached_t *c;
+        prtp_msg_t up = { 0 };
+
+        if (!f || !f->cache_due)
+            continue;
+        f->cache_due = false;
+        if (sids[i].status != PRTP_SUB_OK && sids[i].status != PRTP_SUB_EXISTS)
+            continue;
+        if (!(c = sidtab_find(&cache, sids[i].sid))) {
+            st.cache_misses++;
+            continue;
+        }
+        memcpy(pkt, c->pkt, c->len);
+        if (prtp_patch_header(pkt, c->len, 0, false) < 0)
+            continue;
+        memcpy(up.sid, c->sid, sizeof(up.sid));
+        to_client(s, pkt, c->len, &up);
+        f->cache_sent = true;
+        st.cache_hits++;
+    }
+}
+
+/* ---------- multicast fan-out ---------- */
+
+static void group_of(const char *sid, struct sockaddr_in *a)
+{
+    *a = mcast_base;
+    a->sin_addr.s_addr = htonl(ntohl(mcast_base.sin_addr.s_addr) + prtp_sid_hash(sid) % MCAST_GROUPS);
+}
+
+static void group_subscribe(const char *sid, bool unsubscribe)
+{
+    static uint8_t pkt[512];
+    prtp_sid_t e = { 0 };
+    size_t len;
+
+    snprintf(e.sid, sizeof(e.sid), "%s", sid);
+    len = unsubscribe ? prtp_build_unsubscribe(pkt, sizeof(pkt), 1, &e, 1)
+                      : prtp_build_subscribe(pkt, sizeof(pkt), 1, &e, 1);
+    if (len)
+        to_shard(mcast_up, shard_of(sid), pkt, len);
+}
+
+/* Puts f on its sensor's group; the first member subscribes upstream. */
+static void group_join(flow_t *f)
+{
+    group_t *g;
+
+    if (f->grouped || !(g = sidtab_get(&groups, f->sid)))
+        return;
+    f->grouped = true;
+    if (g->members++ == 0) {
+        g->acked = false;
+        g->retry_ms = srtp_now_ms() + REPLAY_RETRY_MS;
+        group_subscribe(f->sid, false);
+    }
+}
+
+static void group_leave(flow_t *f)
+{
+    group_t *g;
+
+    if (!f->grouped)
+        return;
+    f->grouped = false;
+    if ((g = sidtab_find(&groups, f->sid)) && --g->members == 0)
+        group_subscribe(f->sid, true);
+}
+
+/* A datagram to the router's own upstream session. */
+static void on_group_packet(const uint8_t *buf, size_t len)
+{
+    static uint8_t pkt[PRTP_MAX_PKT];
+    prtp_msg_t m = { .sids = scratch_sids };
+    struct sockaddr_in dst;
+    sensor_stat_t *ss;
+    group_t *g;
+
+    if (len == 0 || prtp_parse(buf, len, &m) < 0)
+        return;
+    if (m.type == PRTP_SUBSCRIBE_ACK) {
+        for (int i = 0; i < m.nsids; i++)
+            if ((g = sidtab_find(&groups, m.sids[i].sid)))
+                g->acked = true;
+        return;
+    }
+    if (m.type != PRTP_UPDATE || !m.sid[0] || !(g = sidtab_find(&groups, m.sid)) || !g->members)
+        return;                        /* the server ignores unsubscribes */
+    st.updates++;
+    if ((ss = sidtab_get(&sensor_stats, m.sid)))
+        ss->updates++;
+    if (cache_max)
+        cache_update(&m, buf, len);
+    memcpy(pkt, buf, len);
+    if (prtp_patch_header(pkt, len, ++g->seq, false) < 0)
+        return;
+    if (len <= CACHE_UPDATE_MAX && (g->ring || (g->ring = malloc(REPAIR_RING * CACHE_UPDATE_MAX)))) {
+        int slot = g->seq % REPAIR_RING;
+        memcpy(g->ring + slot * CACHE_UPDATE_MAX, pkt, len);
+        g->ring_len[slot] = (uint16_t)len;
+        g->ring_seq[slot] = g->seq;
+    }
+    group_of(m.sid, &dst);
+    transmit(pkt, len, &dst, NULL);
+    st.mcast_out++;
+    st.mcast_bytes += len;
+}
+
+/* Sends group update seq_no of sid to s alone, if it is still kept. */
+static void group_repair(session_t *s, const char *sid, uint32_t seq_no)
+{
+    const group_t *g = sidtab_find(&groups, sid);
+    int slot = seq_no % REPAIR_RING;
+    prtp_msg_t up = { 0 };
+
+    if (!g || !g->ring || g->ring_seq[slot] != seq_no) {
+        st.repair_misses++;
+        return;
+    }
+    memcpy(up.sid, g->sid, sizeof(up.sid));
+    to_client(s, g->ring + slot * CACHE_UPDATE_MAX, g->ring_len[slot], &up);
+    st.repairs++;
+}
+
+/* Retries unanswered group subscribes and keeps the upstream session alive. */
+static void group_housekeeping(uint64_t now)
+{
+    static uint8_t pkt[256];
+    size_t len;
+
+    for (int i = 0; i < groups.cap; i++) {
+        group_t *g = (group_t *)(groups.slots + (size_t)i * groups.elem);
+        if (g->sid[0] && g->members && !g->acked && now >= g->retry_ms) {
+            g->retry_ms = now + REPLAY_RETRY_MS;
+            group_subscribe(g->sid, false);
+        }
+    }
+    if (groups.n && now >= group_keepalive_ms &&
+        (len = prtp_build_simple(pkt, sizeof(pkt), PRTP_KEEP_ALIVE, 1))) {
+        for (int k = 0; k < nshards; k++)
+            to_shard(mcast_up, k, pkt, len);
+        group_keepalive_ms = now + GROUP_KEEPALIVE_MS;
+    }
+}
+
+static void flush_merge(session_t *s)
+{
+    static uint8_t pkt[PRTP_MAX_PKT];
+    size_t len;
+
+    if (s->merge_type == PRTP_LIST_RESPONSE)
+        len = prtp_build_list_response(pkt, sizeof(pkt), s->merge_seq, s->merge_sids, s->merge_nsids);
+    else
+        len = prtp_build_subscribe_ack(pkt, sizeof(pkt), s->merge_seq, s->merge_sids, s->merge_nsids);
+    if (len)
+        to_client(s, pkt, len, NULL);
+    if (len && s->merge_type == PRTP_SUBSCRIBE_ACK && cache_max)
+        send_cached(s, s->merge_sids, s->merge_nsids);
+    s->merge_type = -1;
+    st.merges++;
+}
+
+/* The exit summary; detail adds the per-sensor and per-client tables. */
+static void print_stats(FILE *out, int detail, int truncated)
+{
+    uint64_t now = srtp_now_us();
+    int queued = 0;
+
+    fprintf(out, "{\"shards\": %d, \"sensor_in\": %lu, \"sensor_unrouted\": %lu, \"sensor_out\": [",
+            nshards, (unsigned long)st.sensor_in, (unsigned long)st.sensor_unrouted);
+    for (int k = 0; k < nshards; k++)
+        fprintf(out, "%s%lu", k ? ", " : "", (unsigned long)st.sensor_out[k]);
+    fprintf(out, "], \"client_in\": %lu, \"client_out\": %lu, \"client_bytes\": %lu, "
+            "\"upstream_in\": %lu, \"upstream_bytes\": %lu, \"sessions\": %lu, "
+            "\"merges\": %lu, \"merge_timeouts\": %lu, \"sacks\": %lu, "
+            "\"sack_entries\": %lu, \"sack_acks\": %lu, \"sack_stale\": %lu, "
+            "\"updates\": %lu, \"update_out\": %lu, \"update_bytes\": %lu, \"retransmits\": %lu, "
+            "\"stats_queries\": %lu, \"uptime_ms\": %lu, "
+            "\"batch\": %d, \"io_calls\": %lu, \"io_msgs\": %lu, \"syscalls_per_msg\": %.3f, "
+            "\"snapshots\": %lu, \"restored_sessions\": %lu, \"restored_flows\": %lu, "
+            "\"replays\": %lu, \"restore_ms\": %ld",
+            (unsigned long)st.client_in, (unsigned long)st.client_out,
+            (unsigned long)st.client_bytes, (unsigned long)st.upstream_in,
+            (unsigned long)st.upstream_bytes, (unsigned long)st.sessions, (unsigned long)st.merges,
+            (unsigned long)st.merge_timeouts, (unsigned long)st.sacks,
+            (unsigned long)st.sack_entries, (unsigned long)st.sack_acks,
+            (unsigned long)st.sack_stale, (unsigned long)st.updates,
+            (unsigned long)st.update_out, (unsigned long)st.update_bytes,
+            (unsigned long)st.retransmits, (unsigned long)st.stats_queries,
+            (unsigned long)(now / 1000 - start_ms), batch, (unsigned long)st.io_calls,
+            (unsigned long)st.io_msgs, st.io_msgs ? (double)st.io_calls / (double)st.io_msgs : 0.0,
+            (unsigned long)st.snapshots, (unsigned long)st.restored_sessions,
+            (unsigned long)st.restored_flows, (unsigned long)st.replays, (long)st.restore_ms);
+    fprintf(out, ", \"filtered\": %lu, \"filtered_bytes\": %lu, \"coalesced\": %lu, "
+            "\"filter_acks\": %lu, \"acks_absorbed\": %lu",
+            (unsigned long)st.filtered, (unsigned long)st.filtered_bytes,
+            (unsigned long)st.coalesced, (unsigned long)st.filter_acks,
+            (unsigned long)st.acks_absorbed);
+    fprintf(out, ", \"hc_updates\": %lu, \"hc_irs\": %lu, \"hc_resyncs\": %lu, "
+            "\"hc_raw_bytes\": %lu, \"hc_bytes\": %lu",
+            (unsigned long)st.hc_updates, (unsigned long)st.hc_irs, (unsigned long)st.hc_resyncs,
+            (unsigned long)st.hc_raw_bytes, (unsigned long)st.hc_bytes);
+    if (cache_max)
+        fprintf(out, ", \"cache_entries\": %d, \"cache_bytes\": %lu, \"cache_hits\": %lu, "
+                "\"cache_misses\": %lu, \"cache_full\": %lu, \"cache_superseded\": %lu", cache.n,
+                (unsigned long)(st.cache_bytes + (size_t)cache.cap * cache.elem),
+                (unsigned long)st.cache_hits, (unsigned long)st.cache_misses,
+                (unsigned long)st.cache_full, (unsigned long)st.cache_superseded);
+    if (mcast_up)
+        fprintf(out, ", \"mcast_sensors\": %d, \"mcast_out\": %lu, \"mcast_bytes\": %lu, "
+                "\"mcast_suppressed\": %lu, \"repairs\": %lu, \"repair_misses\": %lu", groups.n,
+                (unsigned long)st.mcast_out, (unsigned long)st.mcast_bytes,
+                (unsigned long)st.mcast_suppressed, (unsigned long)st.repairs,
+                (unsigned long)st.repair_misses);
+    if (shaped) {
+        for (int i = 0; i < sched.nclasses; i++)
+            queued += sched.classes[i].count;
+        fprintf(out, ", \"egress_kbps\": %lu, \"queued\": %d, \"backlog_ms\": %.3f, \"classes\": ",
+                (unsigned long)egress_kbps, queued,
+                sched.link_free_us > now ? (sched.link_free_us - now) / 1000.0 : 0.0);
+        srtp_sched_print_json(&sched, out);
+    }
+    if (truncated)
+        fprintf(out, ", \"truncated\": true");
+    if (detail) {
+        int first = 1;
+        fprintf(out, ", \"sensors\": [");
+        for (int i = 0; i < sensor_stats.cap; i++) {
+            const sensor_stat_t *e = (const sensor_stat_t *)(sensor_stats.slots + (size_t)i * sensor_stats.elem);
+            if (!e->sid[0])
+                continue;
+            fprintf(out, "%s{\"sid\": \"%s\", \"readings\": %lu, \"updates\": %lu, \"retransmits\": %lu}",
+                    first ? "" : ", ", e->sid, (unsigned long)e->readings,
+                    (unsigned long)e->updates, (unsigned long)e->retransmits);
+            first = 0;
+        }
+        fprintf(out, "], \"clients\": [");
+        first = 1;
+        for (int b = 0; b < SESSION_BUCKETS; b++) {
+            for (const session_t *c = sessions[b]; c; c = c->next) {
+                fprintf(out, "%s{\"client\": \"%s:%d\", \"queued\": %d, \"updates\": %lu, "
+                        "\"retransmits\": %lu}", first ? "" : ", ", inet_ntoa(c->addr.sin_addr),
+                        ntohs(c->addr.sin_port), c->queued, (unsigned long)c->updates,
+                        (unsigned long)c->retransmits);
+                first = 0;
+            }
+        }
+        fprintf(out, "]");
+    }
+    fprintf(out, "}");
+}
+
+/* Answers a PRTP_STATS request; the tables are dropped if they would not
+ * fit into one datagram. */
+static void reply_stats(const struct sockaddr_in *to, uint32_t seq_no)
+{
+    static uint8_t pkt[PRTP_MAX_PKT];
+    char *json = NULL;
+    size_t jlen = 0, len = 0;
+    FILE *mem;
+
+    st.stats_queries++;
+    for (int detail = 1; detail >= 0 && !len; detail--) {
+        if (!(mem = open_memstream(&json, &jlen)))
+            return;
+        print_stats(mem, detail, !detail);
+        fclose(mem);
+        len = prtp_build_stats(pkt, sizeof(pkt), seq_no, json);
+        free(json);
+        json = NULL;
+    }
+    if (len)
+        transmit(pkt, len, to, NULL);
+}
+
+/* ---------- warm restart ---------- */
+
+static void mark_dirty(void)
+{
+    if (snapshot_path && !snapshot_dirty) {
+        snapshot_dirty = 1;
+        snapshot_due_ms = srtp_now_ms() + SNAPSHOT_MS;
+    }
+}
+
+static void note_subscribed(session_t *s, const prtp_msg_t *m)
+{
+    for (int i = 0; i < m->nsids; i++) {
+        flow_t *f;
+        if (m->sids[i].status != PRTP_SUB_OK && m->sids[i].status != PRTP_SUB_EXISTS)
+            continue;
+        if ((f = sidtab_get(&s->flows, m->sids[i].sid)) && !f->subscribed) {
+            f->subscribed = true;
+            mark_dirty();
+        }
+    }
+}
+
+static int write_snapshot(void)
+{
+    char tmp[4096];
+    snap_header_t h = { SNAPSHOT_MAGIC, 0, 0 };
+    size_t size = sizeof(h);
+    uint8_t *map, *p;
+    int fd;
+
+    for (int b = 0; b < SESSION_BUCKETS; b++) {
+        for (session_t *c = sessions[b]; c; c = c->next) {
+            h.nsessions++;
+            size += sizeof(snap_session_t);
+            for (int i = 0; i < c->flows.cap; i++) {
+                if (FLOW_AT(&c->flows, i)->sid[0] && FLOW_AT(&c->flows, i)->subscribed) {
+                    h.nflows++;
+                    size += sizeof(snap_flow_t);
+                }
+            }
+        }
+    }
+    snprintf(tmp, sizeof(tmp), "%s.tmp", snapshot_path);
+    if ((fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0)
+        return -1;
+    if (ftruncate(fd, (off_t)size) < 0 ||
+        (map = mmap(NULL, size, PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    p = map;
+    memcpy(p, &h, sizeof(h));
+    p += sizeof(h);
+    for (int b = 0; b < SESSION_BUCKETS; b++) {
+        for (session_t *c = sessions[b]; c; c = c->next) {
+            snap_session_t *ss = (snap_session_t *)p;
+            ss->addr = c->addr;
+            ss->nflows = 0;
+            p += sizeof(*ss);
+            for (int i = 0; i < c->flows.cap; i++) {
+                const flow_t *f = FLOW_AT(&c->flows, i);
+                snap_flow_t *sf = (snap_flow_t *)p;
+                if (!f->sid[0] || !f->subscribed)
+                    continue;
+                memcpy(sf->sid, f->sid, PRTP_SID_MAX);
+                sf->sent = f->sent;
+                sf->acked = f->acked;
+                sf->reliable = f->reliable;
+                sf->opts = f->opts;
+                p += sizeof(*sf);
+                ss->nflows++;
+            }
+        }
+    }
+    munmap(map, size);
+    close(fd);
+    if (rename(tmp, snapshot_path) < 0)
+        return -1;
+    st.snapshots++;
+    snapshot_dirty = 0;
+    return 0;
+}
+
+/* Subscribes upstream to every subscribed flow of s, chunked per shard. */
+static void replay_subscriptions(session_t *s)
+{
+    static prtp_sid_t part[PRTP_MAX_SIDS];
+    static uint8_t pkt[PRTP_MAX_PKT];
+    size_t len;
+
+    s->replay_pending = 0;
+    for (int k = 0; k < nshards; k++) {
+        int n = 0;
+        for (int i = 0; i < s->flows.cap && n < PRTP_MAX_SIDS; i++) {
+            const flow_t *f = FLOW_AT(&s->flows, i);
+            if (!f->sid[0] || !f->subscribed || f->grouped || shard_of(f->sid) != k)
+                continue;
+            memset(&part[n], 0, sizeof(part[n]));
+            snprintf(part[n].sid, sizeof(part[n].sid), "%s", f->sid);
+            part[n++].reliable = f->reliable;
+        }
+        for (int off = 0, c; off < n; off += c) {
+            c = prtp_subscribe_fit(part + off, n - off);
+            if ((len = prtp_build_subscribe(pkt, sizeof(pkt), 1, part + off, c))) {
+                to_shard(s, k, pkt, len);
+                s->replay_pending++;
+            }
+        }
+    }
+    s->replay_deadline_ms = srtp_now_ms() + REPLAY_RETRY_MS;
+}
+
+static int restore_snapshot(void)
+{
+    struct stat sb;
+    const uint8_t *map, *p, *end;
+    const snap_header_t *h;
+    int fd = open(snapshot_path, O_RDONLY);
+
+    if (fd < 0)
+        return 0;                      /* cold start */
+    if (fstat(fd, &sb) < 0 || (size_t)sb.st_size < sizeof(*h) ||
+        (map = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    h = (const snap_header_t *)map;
+    end = map + sb.st_size;
+    if (memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) != 0) {
+        munmap((void *)map, (size_t)sb.st_size);
+        return -1;
+    }
+    p = map + sizeof(*h);
+    for (uint32_t n = 0; n < h->nsessions && p + sizeof(snap_session_t) <= end; n++) {
+        const snap_session_t *ss = (const snap_session_t *)p;
+        session_t *s = find_session(&ss->addr);
+
+        p += sizeof(*ss);
+        if (!s && !(s = new_session(&ss->addr)))
+            break;
+        s->last_seen_ms = srtp_now_ms();
+        for (uint32_t i = 0; i < ss->nflows && p + sizeof(snap_flow_t) <= end; i++) {
+            const snap_flow_t *sf = (const snap_flow_t *)p;
+            char sid[PRTP_SID_MAX];
+            flow_t *f;
+
+            p += sizeof(*sf);
+            snprintf(sid, sizeof(sid), "%.*s", PRTP_SID_MAX - 1, sf->sid);
+            if (!sid[0] || !(f = sidtab_get(&s->flows, sid)))
+                continue;
+            f->subscribed = true;
+            f->reliable = sf->reliable;
+            f->opts = sf->opts;
+            f->sent = sf->sent;
+            f->acked = sf->acked;
+            if (mcast_up && f->opts.multicast)
+                group_join(f);
+            else if (f->opts.compress)
+                compress_flow(s, f);
+            st.restored_flows++;
+        }
+        st.restored_sessions++;
+        replay_subscriptions(s);
+        if (s->replay_pending)
+            restoring++;
+    }
+    munmap((void *)map, (size_t)sb.st_size);
+    LOG_INFO("restored %lu sessions, %lu subscriptions", st.restored_sessions, st.restored_flows);
+    return 0;
+}
+
+static void on_client_packet(const struct sockaddr_in *from, const uint8_t *buf, size_t len)
+{
+    static prtp_sid_t part[PRTP_MAX_SIDS];
+    static uint8_t pkt[PRTP_MAX_PKT];
+    session_t *s = find_session(from);
+    prtp_msg_t m = { .sids = scratch_sids };
+    int ok = prtp_parse(buf, len, &m) == 0;
+
+    st.client_in++;
+    LOG_TRACE("client packet: type %d, %u bytes", ok ? m.type : -1, len);
+    if (ok && m.type == PRTP_STATS) {
+        reply_stats(from, m.seq_no);   /* no session: the asker is not a subscriber */
+        return;
+    }
+    if (!s) {
+        if (!(s = new_session(from)))
+            return;
+        mark_dirty();
+    }
+    s->last_seen_ms = srtp_now_ms();
+    if (!ok)
+        return;
+
+    switch (m.type) {
+    case PRTP_LIST:
+        if (!begin_merge(s, PRTP_LIST_RESPONSE, m.seq_no, nshards))
+            break;
+        for (int k = 0; k < nshards; k++)
+            to_shard(s, k, buf, len);
+        break;
+    case PRTP_SUBSCRIBE: {
+        int targets = 0, grouped = 0;
+        if (!begin_merge(s, PRTP_SUBSCRIBE_ACK, m.seq_no, 0))
+            break;
+        for (int i = 0; i < m.nsids; i++) {
+            flow_t *f = sidtab_get(&s->flows, m.sids[i].sid);
+            bool multicast = mcast_up && m.sids[i].opts.multicast;
+            if (f) {
+                f->reliable = m.sids[i].reliable;
+                f->opts = m.sids[i].opts;
+                f->cache_due = !f->subscribed;
+                if (multicast)
+                    group_join(f);
+                else
+                    group_leave(f);
+                if (m.sids[i].opts.compress && !multicast)
+                    compress_flow(s, f);
+                else
+                    f->cid = 0;
+            }
+            grouped += multicast;
+        }
+        for (int k = 0; k < nshards; k++) {
+            int n = 0;
+            for (int i = 0; i < m.nsids; i++) {
+                if (shard_of(m.sids[i].sid) == k && !(mcast_up && m.sids[i].opts.multicast)) {
+                    part[n] = m.sids[i];
+                    part[n++].opts = (prtp_sub_opts_t){ 0 };
+                }
+            }
+            for (int off = 0, c; off < n; off += c) {
+                c = prtp_subscribe_fit(part + off, n - off);
+                targets++;
+                len = prtp_build_subscribe(pkt, sizeof(pkt), m.seq_no, part + off, c);
+                if (len)
+                    to_shard(s, k, pkt, len);
+            }
+        }
+        if (grouped) {
+            /* answered here, with the group, merged with any shard acks */
+            for (int i = 0; i < m.nsids && s->merge_nsids < PRTP_MAX_SIDS; i++) {
+                prtp_sid_t *e = &s->merge_sids[s->merge_nsids];
+                flow_t *f = sidtab_find(&s->flows, m.sids[i].sid);
+                struct sockaddr_in g;
+                if (!f || !f->grouped)
+                    continue;
+                group_of(f->sid, &g);
+                memset(e, 0, sizeof(*e));
+                memcpy(e->sid, f->sid, sizeof(e->sid));
+                e->status = PRTP_SUB_OK;
+                e->group_addr = ntohl(g.sin_addr.s_addr);
+                e->group_port = ntohs(g.sin_port);
+                s->merge_nsids++;
+                if (!f->subscribed) {
+                    f->subscribed = true;
+                    mark_dirty();
+                }
+            }
+        }
+        /* nothing for the shards (e.g. no sids): ack what there is, as the server would */
+        if (targets)
+            s->merge_expected = targets;
+        else
+            flush_merge(s);
+        break;
+    }
+    case PRTP_UPDATE_ACK:
+    case PRTP_UPDATE_NACK: {
+        flow_t *f = sidtab_get(&s->flows, m.sid);
+        if (f && f->grouped && m.type == PRTP_UPDATE_NACK) {
+            group_repair(s, m.sid, m.seq_no);
+            break;
+        }
+        if (f && (filtered_flow(f) || f->grouped)) {
+            st.acks_absorbed++;        /* acked on arrival (admit_update), or a group update */
+            break;
+        }
+        to_shard(s, shard_of(m.sid), buf, len);
+        break;
+    }
+    case PRTP_SACK:
+        st.sacks++;
+        for (int i = 0; i < m.nsids; i++) {
+            const prtp_sid_t *e = &m.sids[i];
+            flow_t *a = sidtab_get(&s->flows, e->sid);
+            int k = shard_of(e->sid), fresh;
+
+            st.sack_entries++;
+            if (!a)
+                continue;
+            if (filtered_flow(a) || a->grouped) {
+                st.acks_absorbed++;
+                continue;
+            }
+            /* one upstream ack per received update above the last acked */
+            if ((fresh = srtp_sack_fresh(&a->acked, e->cum, e->bits)) == 0) {
+                LOG_DEBUG("stale sack entry: cum %u, bits %#x", e->cum, e->bits);
+                st.sack_stale++;
+                continue;
+            }
+            len = prtp_build_ack(pkt, sizeof(pkt), PRTP_UPDATE_ACK, m.seq_no, e->sid);
+            if (len)
+                to_shard_n(s, k, pkt, len, fresh);
+            st.sack_acks += (uint64_t)fresh;
+        }
+        break;
+    case PRTP_HC_RESYNC:
+        if (s->hc && m.seq_no > 0 && m.seq_no < SRTP_HC_CONTEXTS) {
+            srtp_hc_invalidate(&s->hc[m.seq_no]);
+            st.hc_resyncs++;
+        }
+        break;
+    case PRTP_UNSUBSCRIBE:
+        for (int i = 0; i < m.nsids; i++) {
+            flow_t *f = sidtab_get(&s->flows, m.sids[i].sid);
+            if (!f)
+                continue;
+            drop_held(s, f);
+            group_leave(f);
+            f->opts = (prtp_sub_opts_t){ 0 };
+            f->has_value = false;
+            if (f->subscribed) {
+                f->subscribed = false;
+                mark_dirty();
+            }
+        }
+        /* fall through */
+    default:
+        for (int k = 0; k < nshards; k++)
+            to_shard(s, k, buf, len);
+        break;
+    }
+}
+
+static void on_shard_packet(session_t *s, const uint8_t *buf, size_t len)
+{
+    prtp_msg_t m = { .sids = scratch_sids };
+    int ok;
+
+    st.upstream_in++;
+    st.upstream_bytes += len;
+    if (s == mcast_up) {
+        on_group_packet(buf, len);
+        return;
+    }
+    ok = len > 0 && prtp_parse(buf, len, &m) == 0;
+    if (ok && m.type == PRTP_SUBSCRIBE_ACK)
+        note_subscribed(s, &m);
+    if (ok && m.type == PRTP_SUBSCRIBE_ACK && s->replay_pending > 0 &&
+        s->merge_type != PRTP_SUBSCRIBE_ACK) {
+        if (--s->replay_pending == 0 && --restoring == 0)
+            st.restore_ms = (int64_t)(srtp_now_ms() - start_ms);
+        return;                        /* a replayed subscription: the client never asked */
+    }
+    if (ok && s->merge_type >= 0 && m.type == s->merge_type) {
+        for (int i = 0; i < m.nsids && s->merge_nsids < PRTP_MAX_SIDS; i++)
+            s->merge_sids[s->merge_nsids++] = m.sids[i];
+        if (++s->merge_got >= s->merge_expected)
+            flush_merge(s);
+        return;
+    }
+    if (ok && m.type == PRTP_UPDATE) {
+        int again = count_update(s, &m);
+        if (cache_max && m.sid[0])
+            cache_update(&m, buf, len);
+        flow_t *f = m.sid[0] ? sidtab_get(&s->flows, m.sid) : NULL;
+        if (f && f->cache_sent && m.seq_no == 0) {
+            st.cache_superseded++;     /* the server's stored value, answered from the cache */
+            return;
+        }
+        if (f && f->grouped) {
+            static uint8_t pkt[256];
+            size_t n;
+            /* a unicast copy from before the client joined the group */
+            if (m.reliable && (n = prtp_build_ack(pkt, sizeof(pkt), PRTP_UPDATE_ACK, m.seq_no, m.sid)))
+                to_shard(s, shard_of(m.sid), pkt, n);
+            st.mcast_suppressed++;
+            return;
+        }
+        if (f)
+            f->cache_sent = false;
+        if (f && filtered_flow(f) && !admit_update(s, f, buf, len, &m, again))
+            return;
+        to_client(s, buf, len, &m);
+        return;
+    }
+    to_client(s, buf, len, NULL);
+}
+
+static void housekeeping(void)
+{
+    uint64_t now = srtp_now_ms();
+
+    if (snapshot_dirty && now >= snapshot_due_ms && write_snapshot() < 0)
+        perror(snapshot_path);
+    if (mcast_up)
+        group_housekeeping(now);
+    for (int b = 0; b < SESSION_BUCKETS; b++) {
+        session_t **pp = &sessions[b];
+        while (*pp) {
+            session_t *s = *pp;
+            if (s->merge_type >= 0 && now >= s->merge_deadline_ms) {
+                LOG_WARN("merge timed out: type %d, %d of %d replies",
+                         s->merge_type, s->merge_got, s->merge_expected);
+                st.merge_timeouts++;
+                flush_merge(s);
+            }
+            if (s->held > 0)
+                deliver_due(s, now);
+            if (s->replay_pending > 0 && now >= s->replay_deadline_ms) {
+                st.replays++;
+                restoring -= s->replay_pending > 0;
+                replay_subscriptions(s);
+                restoring += s->replay_pending > 0;
+            }
+            if (now - s->last_seen_ms > SESSION_IDLE_S * 1000ULL) {
+                LOG_INFO("session %u.%u.%u.%u:%u idle, closed",
+                         IP4(s->addr.sin_addr.s_addr), ntohs(s->addr.sin_port));
+                *pp = s->next;
+                if (s->replay_pending > 0)
+                    restoring--;
+                free_session(s);
+                mark_dirty();
+                continue;
+            }
+            pp = &s->next;
+        }
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s (-n <shards> [-P shard_base_port] | -N ip:port[:port] ...)\n"
+        "          [-i ip] [-p sensor_port] [-s client_port] [-Q classes] [-B kbps] [-b n]\n"
+        "          [-T trace] [-S snapshot] [-V sensors] [-M group:port]\n"
+        "\t-n\tLocal shard k listens on shard_base + 2k (sensors) and + 2k + 1 (clients)\n"
+        "\t-N\tCluster node at ip:sensor_port[:client_port] (numeric ip), repeatable\n"
+        "\t-Q\tQueue datagrams to clients in the priority classes of this file\n"
+        "\t-B\tModel the downlink to clients at kbps (default unlimited)\n"
+        "\t-b\tMax datagrams per recvmmsg/sendmmsg call (1-%d), default %d\n"
+        "\t-T\tWrite the binary trace log here (srtp_log.h; decode with srtp_trace.py)\n"
+        "\t-S\tKeep sessions and subscriptions in this file; restored on start\n"
+        "\t-V\tCache the latest update of up to this many sensors for new subscribers\n"
+        "\t-M\tSend multicast subscriptions to groups from this address (numeric) on\n"
+        "\t\tthis port; sensors hash onto %d consecutive groups\n",
+        prog, BATCH, BATCH, MCAST_GROUPS);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *ip = "127.0.0.1";
+    int sensor_port = 5004, client_port = 5005, shard_base = 6000, local = 0, opt;
+    const char *names[MAX_SHARDS], *classes = NULL, *trace = NULL, *group = NULL;
+    uint64_t wait_us;
+    struct epoll_event ev, events[BATCH];
+    uint64_t last_hk = 0;
+
+    while ((opt = getopt(argc, argv, "i:p:s:n:P:N:Q:B:b:T:S:V:M:h")) != -1) {
+        switch (opt) {
+        case 'i': ip = optarg; break;
+        case 'p': sensor_port = atoi(optarg); break;
+        case 's': client_port = atoi(optarg); break;
+        case 'n': local = atoi(optarg); break;
+        case 'P': shard_base = atoi(optarg); break;
+        case 'Q': classes = optarg; break;
+        case 'B': egress_kbps = strtoull(optarg, NULL, 10); break;
+        case 'b': batch = atoi(optarg); break;
+        case 'T': trace = optarg; break;
+        case 'S': snapshot_path = optarg; break;
+        case 'V': cache_max = atoi(optarg); break;
+        case 'M': group = optarg; break;
+        case 'N':
+            if (add_node(optarg) < 0) {
+                fprintf(stderr, "srtp_shard_router: bad node '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    for (int k = 0; k < local; k++) {
+        if (add_shard(ip, shard_base + 2 * k, shard_base + 2 * k + 1) < 0) {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    for (int k = 0; k < nshards; k++)
+        names[k] = shard_name[k];
+    if (batch < 1 || batch > BATCH || nshards < 1 || srtp_ring_init(&ring, names, nshards) < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (group) {
+        char addr[INET_ADDRSTRLEN];
+        int port = 0;
+        mcast_base.sin_family = AF_INET;
+        if (sscanf(group, "%15[0-9.]:%d", addr, &port) != 2 || port <= 0 || port > 65535 ||
+            inet_pton(AF_INET, addr, &mcast_base.sin_addr) != 1 ||
+            !IN_MULTICAST(ntohl(mcast_base.sin_addr.s_addr))) {
+            fprintf(stderr, "srtp_shard_router: bad multicast group '%s'\n", group);
+            return 1;
+        }
+        mcast_base.sin_port = htons(port);
+    }
+
+    shaped = classes || egress_kbps;
+    if (shaped && srtp_sched_init(&sched, classes, egress_kbps * 1000) < 0)
+        return 1;
+
+    sensor_fd = bind_udp(ip, sensor_port);
+    client_fd = bind_udp(ip, client_port);
+    epfd = epoll_create1(0);
+    ev.events = EPOLLIN;
+    ev.data.ptr = &sensor_fd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, sensor_fd, &ev);
+    ev.data.ptr = &client_fd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, client_fd, &ev);
+    if (group) {
+        struct in_addr ifaddr = { inet_addr(ip) };
+        unsigned char loop = 1;
+        /* group datagrams leave by the client-port interface, and loop
+         * back to subscribers on this host */
+        if (setsockopt(client_fd, IPPROTO_IP, IP_MULTICAST_IF, &ifaddr, sizeof(ifaddr)) < 0 ||
+            setsockopt(client_fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) < 0 ||
+            !(mcast_up = open_session(&mcast_base))) {
+            perror("srtp_shard_router: multicast");
+            return 1;
+        }
+    }
+
+    if (trace && srtp_log_open(trace) < 0) {
+        perror(trace);
+        return 1;
+    }
+    signal(SIGTERM, handle_sig);
+    signal(SIGINT, handle_sig);
+    start_ms = srtp_now_ms();
+    LOG_INFO("router up: %d shards, batch %d, shaped %d, multicast %d",
+             nshards, batch, shaped, mcast_up != NULL);
+    if (snapshot_path && restore_snapshot() < 0)
+        fprintf(stderr, "srtp_shard_router: %s: not a snapshot, starting cold\n", snapshot_path);
+    if (!restoring)
+        st.restore_ms = 0;
+    else
+        st.restore_ms = -1;
+
+    while (run) {
+        int timeout = 50, n, got;
+
+        if (shaped && (wait_us = srtp_sched_run(&sched, srtp_now_us(), dequeue, NULL)) < 50000)
+            timeout = (int)((wait_us + 999) / 1000);
+        flush_clients();                /* what the last pass and the scheduler queued */
+        n = epoll_wait(epfd, events, BATCH, timeout);
+
+        for (int i = 0; i < n; i++) {
+            void *tag = events[i].data.ptr;
+            if (tag == &sensor_fd) {
+                pump_sensors();
+            } else if (tag == &client_fd) {
+                do {
+                    got = recv_batch(client_fd);
+                    for (int j = 0; j < got; j++)
+                        on_client_packet(&rx.from[j], rx.buf[j], rx.msg[j].msg_len);
+                } while (got == batch);
+            } else {
+                session_t *s = tag;
+                do {
+                    got = recv_batch(s->fd);
+                    for (int j = 0; j < got; j++)
+                        on_shard_packet(s, rx.buf[j], rx.msg[j].msg_len);
+                } while (got == batch);
+            }
+        }
+        if (shaped)
+            srtp_sched_run(&sched, srtp_now_us(), dequeue, NULL);
+        if (srtp_now_ms() - last_hk >= 50) {
+            housekeeping();
+            last_hk = srtp_now_ms();
+        }
+    }
+
+    if (snapshot_dirty && write_snapshot() < 0)
+        perror(snapshot_path);
+    srtp_log_close();
+    print_stats(stdout, 0, 0);
+    printf("\n");
+    fflush(stdout);
+    if (shaped)
+        srtp_sched_free(&sched);
+
+    for (int b = 0; b < SESSION_BUCKETS; b++) {
+        while (sessions[b]) {
+            session_t *s = sessions[b];
+            sessions[b] = s->next;
+            free_session(s);
+        }
+    }
+    if (mcast_up)
+        free_session(mcast_up);
+    for (int i = 0; i < groups.cap; i++)
+        free(((group_t *)(groups.slots + (size_t)i * groups.elem))->ring);
+    free(groups.slots);
+    for (int i = 0; i < cache.cap; i++)
+        free(((cached_t *)(cache.slots + (size_t)i * cache.elem))->pkt);
+    free(cache.slots);
+    free(sensor_stats.slots);
+    close(sensor_fd);
+    close(client_fd);
+    srtp_ring_free(&ring);
+    return 0;
+}
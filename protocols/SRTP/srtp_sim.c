@@ -0,0 +1,659 @@
+/*
+ * srtp_sim - discrete-event simulation of reliable SRTP delivery over an
+ * impaired link, on srtp_clock's virtual time.
+ *
+ * Models what a run with srtp_subscriber behind srtp_shard_router does:
+ *
+ *   server    STGen_Server's reliable delivery as observed on the wire:
+ *             stop-and-wait per subscription, a 200 ms retransmit timer,
+ *             and acks matched by sid alone (an ack releases whatever
+ *             update is outstanding).
+ *   downlink  the router's egress scheduler (srtp_sched.c, unchanged) at
+ *             -B kbps with optional -Q classes, then one-way delay, jitter
+ *             and loss.
+ *   client    per-update acks, or with -D the delayed-sack scoreboard of
+ *             srtp_subscriber (srtp_sack.h) and the router's expansion of
+ *             sacks into acks, over an uplink with the same impairments.
+ *
+ * Impairments follow run_srtp_ack_test.py's relay: half the profile
+ * latency each way plus a uniform +-half jitter, loss per datagram, and
+ * serialisation at bandwidth_kbps.  -P reads them from a
+ * configs/network_conditions profile; -g (or the profile's gilbert_*
+ * keys) makes the loss of each direction Gilbert-Elliott bursts instead
+ * (srtp_ge.h).  -V (or the profile's "trace" and "trace_loop") changes
+ * bandwidth, latency, loss and jitter over the run as an srtp_cond.h
+ * trace says, each row by an event at its time.  Time only moves from event to
+ * event, so an hour of LoRaWAN traffic takes seconds; a one-line JSON
+ * summary is printed to stdout.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <netinet/in.h>
+#include "srtp_clock.h"
+#include "srtp_cond.h"
+#include "srtp_ge.h"
+#include "srtp_sack.h"
+#include "srtp_sched.h"
+
+#define RTO_US      200000         /* STGen_Server's retransmit timer */
+#define SACK_MAX    48             /* flows per sack packet, as srtp_subscriber */
+#define ACK_BYTES   90
+#define SACK_BYTES(n) (60 + 30 * (n))
+
+enum { EV_PUBLISH, EV_RTO, EV_DOWN, EV_UP_ACK, EV_UP_SACK, EV_SACK_TIMER, EV_SCHED, EV_COND };
+
+typedef struct {
+    int flow;
+    uint32_t cum, bits;
+} sack_entry_t;
+
+typedef struct {
+    uint64_t t, order;
+    int type, a;
+    uint32_t b;
+    sack_entry_t *sack;            /* EV_UP_SACK payload, b entries */
+} event_t;
+
+typedef struct {
+    int client, sensor, next_of_sensor;
+    /* server side: updates head..next-1 queued, head outstanding if inflight */
+    uint32_t head, next;
+    int inflight;
+    uint64_t *pub_us;              /* publish time by seq_no */
+    uint32_t pub_cap;
+    uint32_t router_acked;
+    /* client side */
+    uint32_t cum, bits;
+    int ack_pending;
+    uint8_t *got;
+} flow_t;
+
+typedef struct {
+    int pending;
+} client_t;
+
+/* What travels through the scheduler in place of an update */
+typedef struct {
+    int flow;
+    uint32_t seq;
+} wire_t;
+
+static event_t *heap;
+static int nheap, heap_cap;
+static uint64_t order;
+static flow_t *flows;
+static client_t *clients;
+static int *first_of_sensor;
+static char (*sensor_name)[32];
+static int nflows, nclients, nsensors;
+static srtp_sched_t sched;
+static uint64_t wake_at, up_free_us;
+static uint64_t rng_state = 88172645463325252ULL;
+
+static double half_latency_us, half_jitter_us, loss;
+static bool use_ge;
+static srtp_ge_params_t ge;
+static srtp_ge_t ge_down, ge_up;
+static srtp_ge_hist_t ge_hist;
+static uint64_t rate_bps;
+static srtp_cond_t cond;
+static int ack_delay_ms, update_bytes = 140;
+
+static struct {
+    uint64_t events, published, delivered, dups, retransmits, control, lost_down, lost_up;
+    uint64_t spurious_acks;
+    uint32_t *lat_us;
+    uint64_t nlat, lat_cap;
+} st;
+
+static double rnd(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (rng_state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* ---------- event heap ---------- */
+
+static int before(const event_t *x, const event_t *y)
+{
+    return x->t < y->t || (x->t == y->t && x->order < y->order);
+}
+
+static void push(uint64_t t, int type, int a, uint32_t b, sack_entry_t *sack)
+{
+    int i;
+
+    if (nheap == heap_cap) {
+        heap_cap = heap_cap ? 2 * heap_cap : 1024;
+        heap = realloc(heap, sizeof(*heap) * (size_t)heap_cap);
+        if (!heap) {
+            perror("srtp_sim");
+            exit(1);
+        }
+    }
+    i = nheap++;
+    heap[i] = (event_t){ t, order++, type, a, b, sack };
+    while (i > 0 && before(&heap[i], &heap[(i - 1) / 2])) {
+        event_t tmp = heap[i];
+        heap[i] = heap[(i - 1) / 2];
+        heap[(i - 1) / 2] = tmp;
+        i = (i - 1) / 2;
+    }
+}
+
+static int pop(event_t *out)
+{
+    int i = 0;
+
+    if (nheap == 0)
+        return 0;
+    *out = heap[0];
+    heap[0] = heap[--nheap];
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        if (l < nheap && before(&heap[l], &heap[m])) m = l;
+        if (r < nheap && before(&heap[r], &heap[m])) m = r;
+        if (m == i)
+            break;
+        event_t tmp = heap[i];
+        heap[i] = heap[m];
+        heap[m] = tmp;
+        i = m;
+    }
+    return 1;
+}
+
+/* ---------- link ---------- */
+
+static uint64_t one_way_us(void)
+{
+    double d = half_latency_us + (2.0 * rnd() - 1.0) * half_jitter_us;
+    return d > 0 ? (uint64_t)d : 0;
+}
+
+static uint64_t serialise_us(size_t len)
+{
+    return rate_bps ? len * 8 * 1000000ULL / rate_bps : 0;
+}
+
+/* Scheduler callback: an update leaves the router towards its client. */
+static void downlink(const void *buf, size_t len, const struct sockaddr_in *dst, void *arg)
+{
+    const wire_t *w = buf;
+
+    (void)dst;
+    (void)arg;
+    if (use_ge ? srtp_ge_lose(&ge_down, &ge, &ge_hist, rnd) : rnd() < loss) {
+        st.lost_down++;
+        return;
+    }
+    push(srtp_now_us() + serialise_us(len) + one_way_us(), EV_DOWN, w->flow, w->seq, NULL);
+}
+
+static void pump_sched(void)
+{
+    uint64_t now = srtp_now_us(), wait = srtp_sched_run(&sched, now, downlink, NULL);
+
+    if (wait != UINT64_MAX && (wake_at <= now || now + wait < wake_at)) {
+        wake_at = now + (wait ? wait : 1);
+        push(wake_at, EV_SCHED, 0, 0, NULL);
+    }
+}
+
+/* Client -> router datagram of len bytes; returns its arrival time, or UINT64_MAX if lost. */
+static uint64_t uplink(size_t len)
+{
+    uint64_t now = srtp_now_us(), start = up_free_us > now ? up_free_us : now;
+
+    st.control++;
+    if (use_ge ? srtp_ge_lose(&ge_up, &ge, &ge_hist, rnd) : rnd() < loss) {
+        st.lost_up++;
+        return UINT64_MAX;
+    }
+    up_free_us = start + serialise_us(len);
+    return up_free_us + one_way_us();
+}
+
+/* ---------- server ---------- */
+
+static void transmit(int f)
+{
+    static uint8_t pkt[2048];
+    flow_t *fl = &flows[f];
+    wire_t w = { f, fl->head };
+    struct sockaddr_in dst = { .sin_family = AF_INET };
+
+    memcpy(pkt, &w, sizeof(w));
+    srtp_sched_enqueue(&sched, srtp_sched_classify(&sched, sensor_name[fl->sensor], 1),
+                       pkt, (size_t)update_bytes, &dst, srtp_now_us());
+    fl->inflight = 1;
+    push(srtp_now_us() + RTO_US, EV_RTO, f, fl->head, NULL);
+    pump_sched();
+}
+
+static void publish(int sensor)
+{
+    for (int f = first_of_sensor[sensor]; f >= 0; f = flows[f].next_of_sensor) {
+        flow_t *fl = &flows[f];
+        if (fl->next >= fl->pub_cap) {
+            fl->pub_cap = fl->pub_cap ? 2 * fl->pub_cap : 256;
+            fl->pub_us = realloc(fl->pub_us, sizeof(uint64_t) * fl->pub_cap);
+            fl->got = realloc(fl->got, fl->pub_cap);
+            if (!fl->pub_us || !fl->got) {
+                perror("srtp_sim");
+                exit(1);
+            }
+            memset(fl->got + fl->next, 0, fl->pub_cap - fl->next);
+        }
+        fl->pub_us[fl->next++] = srtp_now_us();
+        st.published++;
+        if (!fl->inflight)
+            transmit(f);
+    }
+}
+
+/* An ack for the flow's sid reaches the server. */
+static void server_ack(int f)
+{
+    flow_t *fl = &flows[f];
+
+    if (!fl->inflight) {
+        st.spurious_acks++;
+        return;
+    }
+    fl->inflight = 0;
+    if (++fl->head < fl->next)
+        transmit(f);
+}
+
+/* ---------- client ---------- */
+
+static void flush_sack(int c)
+{
+    sack_entry_t *e = NULL;
+    int n = 0;
+
+    for (int f = 0; f < nflows; f++) {
+        flow_t *fl = &flows[f];
+        if (fl->client != c || !fl->ack_pending)
+            continue;
+        fl->ack_pending = 0;
+        if (!e && !(e = malloc(sizeof(*e) * SACK_MAX))) {
+            perror("srtp_sim");
+            exit(1);
+        }
+        e[n++] = (sack_entry_t){ f, fl->cum, fl->bits };
+        if (n == SACK_MAX) {
+            uint64_t at = uplink(SACK_BYTES(n));
+            if (at != UINT64_MAX)
+                push(at, EV_UP_SACK, c, (uint32_t)n, e);
+            else
+                free(e);
+            e = NULL;
+            n = 0;
+        }
+    }
+    if (n > 0) {
+        uint64_t at = uplink(SACK_BYTES(n));
+        if (at != UINT64_MAX)
+            push(at, EV_UP_SACK, c, (uint32_t)n, e);
+        else
+            free(e);
+    } else {
+        free(e);
+    }
+    clients[c].pending = 0;
+}
+
+static void deliver(int f, uint32_t seq)
+{
+    flow_t *fl = &flows[f];
+    client_t *c = &clients[fl->client];
+
+    if (fl->got[seq]) {
+        st.dups++;
+    } else {
+        fl->got[seq] = 1;
+        st.delivered++;
+        if (st.nlat == st.lat_cap) {
+            st.lat_cap = st.lat_cap ? 2 * st.lat_cap : 4096;
+            if (!(st.lat_us = realloc(st.lat_us, sizeof(uint32_t) * st.lat_cap))) {
+                perror("srtp_sim");
+                exit(1);
+            }
+        }
+        st.lat_us[st.nlat++] = (uint32_t)(srtp_now_us() - fl->pub_us[seq]);
+    }
+    if (ack_delay_ms == 0) {
+        uint64_t at = uplink(ACK_BYTES);
+        if (at != UINT64_MAX)
+            push(at, EV_UP_ACK, f, 0, NULL);
+        return;
+    }
+    /* seq_no on the wire starts at 1 */
+    srtp_sack_note(&fl->cum, &fl->bits, seq + 1);
+    if (fl->ack_pending)
+        return;
+    fl->ack_pending = 1;
+    if (c->pending++ == 0)
+        push(srtp_now_us() + (uint64_t)ack_delay_ms * 1000, EV_SACK_TIMER, fl->client, 0, NULL);
+    if (c->pending >= SACK_MAX)
+        flush_sack(fl->client);
+}
+
+/* Takes on the trace row due now and schedules the next change. */
+static void step_cond(void)
+{
+    const srtp_cond_row_t *r = srtp_cond_step(&cond, (double)srtp_now_us() / 1000.0);
+    double next = srtp_cond_next_ms(&cond);
+
+    if (r) {
+        rate_bps = sched.rate_bps = (uint64_t)(r->kbps * 1000);
+        half_latency_us = r->lat_ms * 500.0;
+        loss = r->loss_pct / 100.0;
+        if (r->jit_ms >= 0)
+            half_jitter_us = r->jit_ms * 500.0;
+    }
+    if (next >= 0)
+        push((uint64_t)(next * 1000.0), EV_COND, 0, 0, NULL);
+}
+
+/* ---------- setup ---------- */
+
+static double json_number(const char *text, const char *key, double dflt)
+{
+    char pat[64];
+    const char *p;
+
+    snprintf(pat, sizeof(pat), "\"%s\"", key);
+    if (!(p = strstr(text, pat)) || !(p = strchr(p + strlen(pat), ':')))
+        return dflt;
+    return strtod(p + 1, NULL);
+}
+
+/* The string value of key, copied to out; false if there is none. */
+static bool json_string(const char *text, const char *key, char *out, size_t size)
+{
+    char pat[64];
+    const char *p, *end;
+
+    snprintf(pat, sizeof(pat), "\"%s\"", key);
+    if (!(p = strstr(text, pat)) || !(p = strchr(p + strlen(pat), ':')) ||
+        !(p = strchr(p, '"')) || !(end = strchr(++p, '"')) || (size_t)(end - p) >= size)
+        return false;
+    memcpy(out, p, (size_t)(end - p));
+    out[end - p] = '\0';
+    return true;
+}
+
+static int load_profile(const char *path, double *lat_ms, double *jit_ms, double *loss_pct, double *kbps,
+                        srtp_ge_params_t *g, char *trace, size_t trace_size, bool *loop)
+{
+    char name[256];
+    const char *slash;
+    int len;
+    char text[4096];
+    size_t n;
+    FILE *fp = fopen(path, "r");
+
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+    n = fread(text, 1, sizeof(text) - 1, fp);
+    fclose(fp);
+    text[n] = '\0';
+    *lat_ms = json_number(text, "latency_ms", *lat_ms);
+    *jit_ms = json_number(text, "jitter_ms", *jit_ms);
+    *loss_pct = json_number(text, "loss_percent", *loss_pct);
+    *kbps = json_number(text, "bandwidth_kbps", *kbps);
+    g->p = json_number(text, "gilbert_p", g->p);
+    g->q = json_number(text, "gilbert_q", g->q);
+    g->loss_bad = json_number(text, "gilbert_loss_bad", g->loss_bad);
+    if (json_string(text, "trace", name, sizeof(name))) {
+        slash = strrchr(path, '/');
+        if (name[0] == '/' || !slash)
+            len = snprintf(trace, trace_size, "%s", name);
+        else
+            len = snprintf(trace, trace_size, "%.*s/%s", (int)(slash - path), path, name);
+        if (len < 0 || (size_t)len >= trace_size) {
+            fprintf(stderr, "srtp_sim: trace path too long in %s\n", path);
+            return -1;
+        }
+        *loop = strstr(text, "\"trace_loop\": true") || json_number(text, "trace_loop", 0) > 0;
+    }
+    return 0;
+}
+
+static int cmp_u32(const void *x, const void *y)
+{
+    uint32_t a = *(const uint32_t *)x, b = *(const uint32_t *)y;
+    return a < b ? -1 : a > b;
+}
+
+static double lat_pct_ms(double p)
+{
+    uint64_t i;
+
+    if (st.nlat == 0)
+        return 0;
+    i = (uint64_t)(p * (double)(st.nlat - 1) + 0.5);
+    return st.lat_us[i] / 1000.0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [-n clients] [-m sensors_per_client] [-S sensors] [-r rate_hz]\n"
+        "          [-d duration_s] [-W drain_s] [-D ack_delay_ms] [-P profile.json]\n"
+        "          [-L latency_ms] [-J jitter_ms] [-X loss_percent | -g conf:row] [-B kbps]\n"
+        "          [-Q classes] [-b update_bytes] [-s seed] [-V trace [-R]]\n"
+        "\t-n/-m\tClients, each reliably subscribed to m sensors (default 8 x 4)\n"
+        "\t-S\tDistinct sensors, default n * m; names follow srtp.py (temp_0, device_1, ...)\n"
+        "\t-r\tReadings per sensor per second, default 1\n"
+        "\t-d/-W\tSimulated publishing time and drain time in seconds, default 60 / 10\n"
+        "\t-D\tDelayed-sack timer in ms, 0 = one ack per update (default)\n"
+        "\t-P\tNetwork profile (latency_ms, jitter_ms, loss_percent, bandwidth_kbps,\n"
+        "\t\tgilbert_p/q/loss_bad); -L/-J/-X/-B given after it override single values\n"
+        "\t-g\tGilbert-Elliott burst loss and latency from row n (from 0) of a\n"
+        "\t\tconf/test*.conf table (delay_ms p q) instead of -X\n"
+        "\t-Q\tEgress priority classes for the downlink (see srtp_sched.h)\n"
+        "\t-V\tFollow a trace of \"t_ms kbps latency_ms loss_percent [jitter_ms]\" rows\n"
+        "\t\t(srtp_cond.h), over -B/-L/-X/-J; -R starts it over at its end\n",
+        prog);
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *types[] = { "temp", "device", "gps", "camera" };
+    int per_client = 4, opt;
+    double rate_hz = 1.0, duration_s = 60, drain_s = 10;
+    double lat_ms = 0, jit_ms = 0, loss_pct = 0, kbps = 0;
+    const char *classes = NULL;
+    char trace[512] = "";
+    bool trace_loop = false;
+    struct timespec w0, w1;
+    uint64_t end_us;
+    event_t e;
+
+    nclients = 8;
+    ge.loss_bad = 1;
+    while ((opt = getopt(argc, argv, "n:m:S:r:d:W:D:P:L:J:X:B:Q:b:s:g:V:Rh")) != -1) {
+        switch (opt) {
+        case 'n': nclients = atoi(optarg); break;
+        case 'm': per_client = atoi(optarg); break;
+        case 'S': nsensors = atoi(optarg); break;
+        case 'r': rate_hz = atof(optarg); break;
+        case 'd': duration_s = atof(optarg); break;
+        case 'W': drain_s = atof(optarg); break;
+        case 'D': ack_delay_ms = atoi(optarg); break;
+        case 'P':
+            if (load_profile(optarg, &lat_ms, &jit_ms, &loss_pct, &kbps, &ge,
+                             trace, sizeof(trace), &trace_loop) < 0)
+                return 1;
+            break;
+        case 'g':
+            if (srtp_ge_parse(optarg, &lat_ms, &ge) < 0) {
+                fprintf(stderr, "srtp_sim: no row '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'L': lat_ms = atof(optarg); break;
+        case 'J': jit_ms = atof(optarg); break;
+        case 'X': loss_pct = atof(optarg); break;
+        case 'B': kbps = atof(optarg); break;
+        case 'Q': classes = optarg; break;
+        case 'b': update_bytes = atoi(optarg); break;
+        case 'V': snprintf(trace, sizeof(trace), "%s", optarg); break;
+        case 'R': trace_loop = true; break;
+        case 's': rng_state ^= strtoull(optarg, NULL, 10) * 0x9E3779B97F4A7C15ULL; break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (nsensors == 0)
+        nsensors = nclients * per_client;
+    if (nclients < 1 || per_client < 1 || nsensors < 1 || rate_hz <= 0 || duration_s <= 0 ||
+        ack_delay_ms < 0 || update_bytes < (int)sizeof(wire_t) || update_bytes > 2048) {
+        usage(argv[0]);
+        return 1;
+    }
+    half_latency_us = lat_ms * 500.0;
+    half_jitter_us = jit_ms * 500.0;
+    loss = loss_pct / 100.0;
+    use_ge = ge.p > 0 || ge.q > 0;
+    rate_bps = (uint64_t)(kbps * 1000);
+    if (srtp_sched_init(&sched, classes, rate_bps) < 0)
+        return 1;
+    if (trace[0] && srtp_cond_load(&cond, trace, trace_loop) < 0) {
+        fprintf(stderr, "srtp_sim: bad trace '%s'\n", trace);
+        return 1;
+    }
+
+    nflows = nclients * per_client;
+    flows = calloc((size_t)nflows, sizeof(*flows));
+    clients = calloc((size_t)nclients, sizeof(*clients));
+    first_of_sensor = malloc(sizeof(int) * (size_t)nsensors);
+    sensor_name = malloc(sizeof(*sensor_name) * (size_t)nsensors);
+    if (!flows || !clients || !first_of_sensor || !sensor_name) {
+        perror("srtp_sim");
+        return 1;
+    }
+    for (int i = 0; i < nsensors; i++) {
+        first_of_sensor[i] = -1;
+        snprintf(sensor_name[i], sizeof(sensor_name[i]), "%s_%d", types[i % 4], i);
+    }
+    for (int f = nflows - 1; f >= 0; f--) {
+        flows[f].client = f / per_client;
+        flows[f].sensor = f % nsensors;
+        flows[f].next_of_sensor = first_of_sensor[f % nsensors];
+        first_of_sensor[f % nsensors] = f;
+    }
+
+    srtp_clock_virtual(0);
+    end_us = (uint64_t)((duration_s + drain_s) * 1e6);
+    for (int i = 0; i < nsensors; i++)
+        push((uint64_t)(1e6 / rate_hz * i / nsensors), EV_PUBLISH, i, 0, NULL);
+    if (cond.n)
+        step_cond();
+
+    clock_gettime(CLOCK_MONOTONIC, &w0);
+    while (pop(&e) && e.t <= end_us) {
+        srtp_clock_advance(e.t);
+        st.events++;
+        switch (e.type) {
+        case EV_PUBLISH: {
+            uint64_t next = e.t + (uint64_t)(1e6 / rate_hz);
+            publish(e.a);
+            if (next < (uint64_t)(duration_s * 1e6))
+                push(next, EV_PUBLISH, e.a, 0, NULL);
+            break;
+        }
+        case EV_RTO:
+            if (flows[e.a].inflight && flows[e.a].head == e.b) {
+                st.retransmits++;
+                transmit(e.a);
+            }
+            break;
+        case EV_DOWN:
+            deliver(e.a, e.b);
+            break;
+        case EV_UP_ACK:
+            server_ack(e.a);
+            break;
+        case EV_UP_SACK:
+            /* the router expands each entry into one ack per fresh update */
+            for (uint32_t i = 0; i < e.b; i++) {
+                flow_t *fl = &flows[e.sack[i].flow];
+                int fresh = srtp_sack_fresh(&fl->router_acked, e.sack[i].cum, e.sack[i].bits);
+                while (fresh-- > 0)
+                    server_ack(e.sack[i].flow);
+            }
+            free(e.sack);
+            break;
+        case EV_SACK_TIMER:
+            if (clients[e.a].pending)
+                flush_sack(e.a);
+            break;
+        case EV_SCHED:
+            pump_sched();
+            break;
+        case EV_COND:
+            step_cond();
+            break;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &w1);
+
+    {
+        double wall_ms = (w1.tv_sec - w0.tv_sec) * 1e3 + (w1.tv_nsec - w0.tv_nsec) / 1e6;
+        double sim_s = (duration_s + drain_s);
+
+        qsort(st.lat_us, st.nlat, sizeof(uint32_t), cmp_u32);
+        printf("{\"sim_s\": %.1f, \"wall_ms\": %.1f, \"speedup\": %.0f, \"events\": %lu, "
+               "\"published\": %lu, \"delivered\": %lu, \"dups\": %lu, \"retransmits\": %lu, "
+               "\"control_packets\": %lu, \"control_per_update\": %.3f, \"lost_down\": %lu, "
+               "\"lost_up\": %lu, \"spurious_acks\": %lu, \"lat_p50_ms\": %.1f, "
+               "\"lat_p95_ms\": %.1f, \"lat_p99_ms\": %.1f, \"lat_max_ms\": %.1f, \"classes\": ",
+               sim_s, wall_ms, wall_ms > 0 ? sim_s * 1e3 / wall_ms : 0.0,
+               (unsigned long)st.events, (unsigned long)st.published,
+               (unsigned long)st.delivered, (unsigned long)st.dups,
+               (unsigned long)st.retransmits, (unsigned long)st.control,
+               st.delivered ? (double)st.control / (double)st.delivered : 0.0,
+               (unsigned long)st.lost_down, (unsigned long)st.lost_up,
+               (unsigned long)st.spurious_acks, lat_pct_ms(0.50), lat_pct_ms(0.95),
+               lat_pct_ms(0.99), st.nlat ? st.lat_us[st.nlat - 1] / 1000.0 : 0.0);
+        srtp_sched_print_json(&sched, stdout);
+        if (use_ge) {
+            srtp_ge_end_burst(&ge_down, &ge_hist);
+            srtp_ge_end_burst(&ge_up, &ge_hist);
+            printf(", \"ge\": ");
+            srtp_ge_print(stdout, &ge, &ge_hist);
+        }
+        if (cond.n)
+            printf(", \"trace_rows\": %d, \"trace_steps\": %lu", cond.n, (unsigned long)cond.steps);
+        printf("}\n");
+    }
+
+    while (pop(&e))
+        free(e.sack);
+    for (int f = 0; f < nflows; f++) {
+        free(flows[f].pub_us);
+        free(flows[f].got);
+    }
+    free(flows);
+    free(clients);
+    free(first_of_sensor);
+    free(sensor_name);
+    free(heap);
+    free(st.lat_us);
+    srtp_cond_free(&cond);
+    srtp_sched_free(&sched);
+    return 0;
+}
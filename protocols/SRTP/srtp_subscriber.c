@@ -0,0 +1,1200 @@
+/*
+ * srtp_subscriber - hosts many PRTP subscriber sessions in one process.
+ *
+ * Every session behaves like one STGen_Client: it lists (-a/-A) and/or
+ * subscribes to its sensors, keeps an active flow per subscription that
+ * tracks the server's per-subscription seq_no for losses, acks reliable
+ * updates and sends a keep-alive when the server has been quiet for -k
+ * seconds.  The server tells clients apart by address, so each session
+ * owns one socket; all of them share a single epoll loop, and per-session
+ * stats stay in memory instead of per-client log directories.
+ *
+ * Positional sensor ids are dealt out round-robin, -m per session.
+ * Subscribes are split into chunks the server acks (PRTP_SUBSCRIBE_MAX_BYTES)
+ * and sent one at a time; an unanswered list or subscribe is retried twice
+ * before the session settles for what it has.  Sessions are opened at -R
+ * per second so the server is not hit by thousands of lists at once.
+ *
+ * Reliable updates are acked one by one, as STGen_Client does, unless -D
+ * sets a delayed-ack timer: acks then accumulate per session in a
+ * cumulative-plus-bitmap scoreboard per flow and leave as one sack packet
+ * when the oldest pending ack is -D ms old (or the packet is full).  Sacks
+ * need srtp_shard_router in front of the server to expand them.
+ *
+ * Reliable updates carry the server's send time (see prtp_ntp_middle()),
+ * so their one-way latency is taken on receive and kept in a log-linear
+ * histogram.  The stamps only have whole-second resolution: a latency is
+ * an upper bound, at most one second above the true value.
+ *
+ * Camera frames sent as fragment readings (srtp_feeder -F, see PRTP_FRAG_*)
+ * are put back together in REASM_SLOTS preallocated slots, each with a
+ * received-fragment bitmap, keyed by session, sid and frame id.  A fragment
+ * of a frame not seen before opens a slot, evicting the oldest one if all
+ * are busy; slots still incomplete after REASM_TIMEOUT_MS are dropped.
+ *
+ * Time to first data is taken per flow from its subscribe ack to its
+ * first update.  Updates with seq_no 0 carry a stored value rather than
+ * a new reading (the server numbers a flow's own updates from 1): the
+ * server's opening update, or the cached latest update srtp_shard_router
+ * -V sends right behind a subscribe ack.  They are counted as
+ * cached_updates and kept out of the latency histogram, their stamp being
+ * the original send time.
+ *
+ * -I, -E and -L subscribe every flow with options (prtp_sub_opts_t) that
+ * srtp_shard_router applies before the update fans out: a minimum
+ * interval, a deadband, latest value only.  Seq_no gaps of such a flow
+ * are updates the router filtered, counted as skipped rather than lost.
+ *
+ * -G subscribes every flow with the multicast option (router -M): the
+ * subscribe ack names the sensor's group, which the process joins once on
+ * a shared socket, and each group datagram is handed to every session
+ * with an active flow of its sid.  Group updates are numbered per sensor
+ * and unreliable; a gap in a reliable flow is nacked per missing seq_no
+ * (at most REPAIR_MAX) and the router repairs it by unicast, so a repair
+ * takes its loss back off the lost count.
+ *
+ * -H subscribes every flow with the compress option: the router sends
+ * its updates header-compressed (srtp_hc.h), restored here per session
+ * before parsing.  A compressed update whose context was lost with its
+ * IR is dropped and PRTP_HC_RESYNC asks for a new IR.  rx_bytes counts
+ * every byte received on the session sockets, as sent.
+ *
+ * -b binds session i to local port base + i, so each session is a device
+ * with a known address that per-device tc classes can filter on (see
+ * NetworkEmulator.from_mix).
+ *
+ * With -C, a UDP control socket on 127.0.0.1 takes scripted churn: each
+ * datagram holds newline-separated commands and gets one reply datagram
+ * with an "ok <n>" or "err <why>" line per command.
+ *
+ *   sub <session|*> sid...    subscribe (rsub: reliably); n = sids sent
+ *   unsub <session|*> sid...  unsubscribe active flows; n = sids dropped
+ *   list <session|*>          send a list request; n = requests sent
+ *   stats                     "ok key=value ..." counters so far
+ *
+ * Sessions still listing or subscribing from startup answer "err busy".
+ *
+ * Active subscriptions are dropped with unsubscribes on exit, and a
+ * one-line JSON summary, latency percentiles included, is printed to
+ * stdout.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "prtp_msg.h"
+#include "srtp_clock.h"
+#include "srtp_hc.h"
+#include "srtp_log.h"
+#include "srtp_sack.h"
+
+#define BATCH           64
+#define RETRY_MS        1000
+#define MAX_TRIES       3
+#define SACK_MAX        48         /* flows per sack packet */
+#define HIST_SUB        8          /* sub-buckets per power of two (~12%) */
+#define HIST_BUCKETS    (32 * HIST_SUB)
+#define REASM_SLOTS     16
+#define REASM_FRAME_MAX (256 * 1024)
+#define REASM_FRAGS     ((REASM_FRAME_MAX + PRTP_FRAG_DATA - 1) / PRTP_FRAG_DATA)
+#define REASM_TIMEOUT_MS 2000
+#define JOIN_MAX        20         /* net.ipv4.igmp_max_memberships default */
+#define REPAIR_MAX      16         /* nacks per gap */
+
+enum { S_LISTING, S_SUBSCRIBING, S_READY };
+
+typedef struct {
+    prtp_sid_t sub;                /* sid and reliable flag as subscribed */
+    bool active;                   /* acked by the server */
+    bool requested;                /* sub command sent, ack outstanding */
+    bool seen;
+    bool grouped;                  /* updates arrive on a multicast group */
+    uint64_t active_ms;            /* subscribe acked, no update yet (else 0) */
+    uint32_t last_seq;
+    uint64_t received, lost, late;
+    uint32_t cum, bits;            /* sack scoreboard, see prtp_sid_t */
+    bool ack_pending;
+} flow_t;
+
+typedef struct {
+    int fd;
+    int state;
+    int tries;
+    uint64_t deadline_ms;          /* retry of the pending list/subscribe */
+    uint64_t last_rx_ms;
+    flow_t *flows;                 /* sorted by sid once planned */
+    int nflows, cap;
+    int next, inflight;            /* subscribe progress through flows */
+    int acks_pending;
+    uint64_t ack_deadline_ms;
+    uint64_t updates;
+    srtp_hc_ctx_t *hc;             /* SRTP_HC_CONTEXTS, on the first compressed update */
+} session_t;
+
+/* One camera frame being reassembled */
+typedef struct {
+    bool used;
+    int session;
+    char sid[PRTP_SID_MAX];
+    uint16_t frame_id, total, got;
+    size_t len;
+    uint64_t first_ms;
+    uint64_t bits[(REASM_FRAGS + 63) / 64];
+    uint8_t *buf;                  /* REASM_FRAME_MAX bytes, allocated up front */
+} reasm_t;
+
+static volatile sig_atomic_t run = 1;
+static void handle_sig(int s) { (void)s; run = 0; }
+
+static struct sockaddr_in server;
+static session_t *sessions;
+static int nsessions, epfd;
+static bool list_all, all_reliable, sids_reliable;
+static prtp_sub_opts_t sub_opts;
+static int ack_delay_ms;
+static int base_port;                  /* -b: session i binds base_port + i */
+static uint32_t seq_counter = 1;
+static prtp_sid_t scratch_sids[PRTP_MAX_SIDS];
+static reasm_t reasm[REASM_SLOTS];
+static int ctl_fd = -1, opened;
+static int mcast_fd = -1, njoined;
+static uint16_t mcast_port;
+static uint32_t joined[JOIN_MAX];  /* group addresses, host order */
+
+static struct {
+    uint64_t updates, empty_updates, unknown, lost, late, skipped;
+    uint64_t acks, ack_packets, keepalives, retries, gave_up, rejected, send_errors;
+    uint64_t lat_samples, lat_negative, lat_sum_us, lat_min_us, lat_max_us;
+    uint64_t ttfd_samples, ttfd_sum_ms, ttfd_max_ms, cached_updates;
+    uint64_t lat_hist[HIST_BUCKETS];
+    uint64_t frames, frame_bytes, frame_ms_sum, frame_ms_max, frames_expired, frames_evicted;
+    uint64_t fragments, frag_dups, frag_bad, frame_first_ms, frame_last_ms;
+    uint64_t ctl_commands, ctl_subs, ctl_unsubs, ctl_lists, list_responses;
+    uint64_t group_datagrams, group_errors, nacks, repaired;
+    uint64_t rx_bytes, hc_updates, hc_irs, hc_damaged, hc_bad;
+} st = { .lat_min_us = UINT64_MAX };
+
+static void send_pkt(session_t *s, const uint8_t *pkt, size_t len)
+{
+    if (len == 0 || send(s->fd, pkt, len, 0) < 0)
+        st.send_errors++;
+}
+
+/* Appends a flow for sid (unsorted until finish_plan); NULL if out of memory. */
+static flow_t *add_flow(session_t *s, const char *sid, bool reliable)
+{
+    flow_t *f;
+
+    if (s->nflows == s->cap) {
+        int cap = s->cap ? 2 * s->cap : 4;
+        flow_t *nf = realloc(s->flows, sizeof(flow_t) * cap);
+        if (!nf)
+            return NULL;
+        s->flows = nf;
+        s->cap = cap;
+    }
+    f = &s->flows[s->nflows++];
+    memset(f, 0, sizeof(*f));
+    snprintf(f->sub.sid, sizeof(f->sub.sid), "%s", sid);
+    f->sub.reliable = reliable;
+    f->sub.opts = sub_opts;
+    return f;
+}
+
+static int cmp_flow(const void *a, const void *b)
+{
+    return strcmp(((const flow_t *)a)->sub.sid, ((const flow_t *)b)->sub.sid);
+}
+
+/* Sorts the planned flows and drops duplicate sids (the first one wins). */
+static void finish_plan(session_t *s)
+{
+    int n = 0;
+
+    qsort(s->flows, s->nflows, sizeof(flow_t), cmp_flow);
+    for (int i = 0; i < s->nflows; i++)
+        if (n == 0 || strcmp(s->flows[n - 1].sub.sid, s->flows[i].sub.sid) != 0)
+            s->flows[n++] = s->flows[i];
+    s->nflows = n;
+}
+
+/* Looks sid up among the first n flows, which must be sorted. */
+static flow_t *find_flow_in(session_t *s, const char *sid, int n)
+{
+    flow_t key;
+
+    if (n == 0)
+        return NULL;
+    snprintf(key.sub.sid, sizeof(key.sub.sid), "%s", sid);
+    return bsearch(&key, s->flows, n, sizeof(flow_t), cmp_flow);
+}
+
+static flow_t *find_flow(session_t *s, const char *sid)
+{
+    return find_flow_in(s, sid, s->nflows);
+}
+
+/* ---------- active flows ---------- */
+
+static void create_active_flow(flow_t *f, uint32_t seq_no)
+{
+    f->seen = true;
+    f->last_seq = seq_no;
+    f->received = 1;
+}
+
+static void update_active_flow(flow_t *f, uint32_t seq_no)
+{
+    f->received++;
+    if (seq_no > f->last_seq && (f->sub.opts.min_interval_ms || f->sub.opts.deadband > 0)) {
+        st.skipped += seq_no - f->last_seq - 1;
+        f->last_seq = seq_no;
+    } else if (seq_no > f->last_seq) {
+        f->lost += seq_no - f->last_seq - 1;
+        st.lost += seq_no - f->last_seq - 1;
+        f->last_seq = seq_no;
+    } else if (f->grouped && f->lost > 0) {
+        f->lost--;                     /* a repair (or a reordered group update) */
+        st.lost--;
+        st.repaired++;
+    } else {
+        f->late++;
+        st.late++;
+    }
+}
+
+/* ---------- delayed acks ---------- */
+
+static void flush_sack(session_t *s)
+{
+    static uint8_t pkt[PRTP_MAX_PKT];
+    int n = 0;
+
+    for (int i = 0; i < s->nflows; i++) {
+        flow_t *f = &s->flows[i];
+        if (!f->ack_pending)
+            continue;
+        f->ack_pending = false;
+        scratch_sids[n] = f->sub;
+        scratch_sids[n].cum = f->cum;
+        scratch_sids[n].bits = f->bits;
+        if (++n == SACK_MAX || i == s->nflows - 1) {
+            send_pkt(s, pkt, prtp_build_sack(pkt, sizeof(pkt), seq_counter++, scratch_sids, n));
+            st.ack_packets++;
+            n = 0;
+        }
+    }
+    if (n > 0) {
+        send_pkt(s, pkt, prtp_build_sack(pkt, sizeof(pkt), seq_counter++, scratch_sids, n));
+        st.ack_packets++;
+    }
+    LOG_DEBUG("session %d: sack for %d flows", (int)(s - sessions), s->acks_pending);
+    s->acks_pending = 0;
+}
+
+static void ack_later(session_t *s, flow_t *f, uint32_t seq_no)
+{
+    srtp_sack_note(&f->cum, &f->bits, seq_no);
+    st.acks++;
+    if (f->ack_pending)
+        return;
+    f->ack_pending = true;
+    if (s->acks_pending++ == 0)
+        s->ack_deadline_ms = srtp_now_ms() + (uint64_t)ack_delay_ms;
+    if (s->acks_pending >= SACK_MAX)
+        flush_sack(s);
+}
+
+static void flush_due_acks(int opened)
+{
+    uint64_t now = srtp_now_ms();
+
+    for (int i = 0; i < opened; i++)
+        if (sessions[i].acks_pending && now >= sessions[i].ack_deadline_ms)
+            flush_sack(&sessions[i]);
+}
+
+/* ---------- latency ---------- */
+
+/* Values below HIST_SUB us get a bucket each; above, every power of two
+ * is split into HIST_SUB equal buckets. */
+static int hist_bucket(uint64_t us)
+{
+    int msb, b;
+
+    if (us < HIST_SUB)
+        return (int)us;
+    msb = 63 - __builtin_clzll(us);
+    b = (msb - 2) * HIST_SUB + (int)((us >> (msb - 3)) & (HIST_SUB - 1));
+    return b < HIST_BUCKETS ? b : HIST_BUCKETS - 1;
+}
+
+/* Midpoint of a bucket, in us. */
+static double hist_value(int b)
+{
+    int msb = b / HIST_SUB + 2;
+    uint64_t low, width;
+
+    if (b < HIST_SUB)
+        return b;
+    width = 1ULL << (msb - 3);
+    low = (uint64_t)(HIST_SUB + b % HIST_SUB) * width;
+    return (double)low + width / 2.0;
+}
+
+static double lat_percentile_ms(double p)
+{
+    uint64_t rank = (uint64_t)(p * st.lat_samples + 0.999999), seen = 0;
+
+    if (st.lat_samples == 0)
+        return 0;
+    if (rank < 1)
+        rank = 1;
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        seen += st.lat_hist[b];
+        if (seen >= rank)
+            return hist_value(b) / 1000.0;
+    }
+    return st.lat_max_us / 1000.0;
+}
+
+static void record_latency(uint32_t stamp)
+{
+    struct timespec ts;
+    int32_t d;
+    uint64_t us;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    d = (int32_t)(prtp_ntp_middle(&ts) - stamp);   /* 16.16 seconds */
+    if (d < 0) {
+        /* clocks apart (remote server) or stamp from a later second */
+        st.lat_negative++;
+        return;
+    }
+    us = ((uint64_t)d * 1000000u) >> 16;
+    st.lat_samples++;
+    st.lat_sum_us += us;
+    if (us < st.lat_min_us) st.lat_min_us = us;
+    if (us > st.lat_max_us) st.lat_max_us = us;
+    st.lat_hist[hist_bucket(us)]++;
+}
+
+/* ---------- camera frame reassembly ---------- */
+
+static reasm_t *reasm_slot(int session, const char *sid, uint16_t frame_id, uint16_t total)
+{
+    reasm_t *r, *oldest = &reasm[0];
+
+    for (r = reasm; r < reasm + REASM_SLOTS; r++)
+        if (r->used && r->frame_id == frame_id && r->session == session &&
+            strcmp(r->sid, sid) == 0)
+            return r->total == total ? r : NULL;
+    for (r = reasm; r < reasm + REASM_SLOTS; r++) {
+        if (!r->used)
+            break;
+        if (r->first_ms < oldest->first_ms)
+            oldest = r;
+    }
+    if (r == reasm + REASM_SLOTS) {
+        r = oldest;
+        st.frames_evicted++;
+    }
+    r->used = true;
+    r->session = session;
+    snprintf(r->sid, sizeof(r->sid), "%s", sid);
+    r->frame_id = frame_id;
+    r->total = total;
+    r->got = 0;
+    r->len = 0;
+    r->first_ms = srtp_now_ms();
+    memset(r->bits, 0, sizeof(r->bits));
+    return r;
+}
+
+static void on_fragment(int session, const prtp_msg_t *m)
+{
+    const uint8_t *b = m->blob;
+    uint16_t frame_id, frag_no, total;
+    uint32_t data;
+    reasm_t *r;
+
+    if (m->blob_len < PRTP_FRAG_HDR || (b[0] << 8 | b[1]) != PRTP_FRAG_MAGIC)
+        return;                        /* an ordinary camera reading */
+    frame_id = (uint16_t)(b[2] << 8 | b[3]);
+    frag_no = (uint16_t)(b[4] << 8 | b[5]);
+    total = (uint16_t)(b[6] << 8 | b[7]);
+    data = m->blob_len - PRTP_FRAG_HDR;
+    st.fragments++;
+    if (!st.frame_first_ms)
+        st.frame_first_ms = srtp_now_ms();
+    if (total == 0 || frag_no >= total || total > REASM_FRAGS ||
+        (frag_no + 1 < total ? data != PRTP_FRAG_DATA : data > PRTP_FRAG_DATA) ||
+        !(r = reasm_slot(session, m->sid, frame_id, total))) {
+        st.frag_bad++;
+        return;
+    }
+    if (r->bits[frag_no / 64] >> (frag_no % 64) & 1) {
+        st.frag_dups++;
+        return;
+    }
+    r->bits[frag_no / 64] |= 1ULL << (frag_no % 64);
+    memcpy(r->buf + (size_t)frag_no * PRTP_FRAG_DATA, b + PRTP_FRAG_HDR, data);
+    if (frag_no + 1 == total)
+        r->len = (size_t)frag_no * PRTP_FRAG_DATA + data;
+    if (++r->got == r->total) {
+        uint64_t now = srtp_now_ms(), ms = now - r->first_ms;
+        st.frames++;
+        st.frame_bytes += r->len;
+        st.frame_ms_sum += ms;
+        if (ms > st.frame_ms_max)
+            st.frame_ms_max = ms;
+        st.frame_last_ms = now;
+        r->used = false;
+    }
+}
+
+static void expire_frames(uint64_t now)
+{
+    for (reasm_t *r = reasm; r < reasm + REASM_SLOTS; r++) {
+        if (r->used && now - r->first_ms >= REASM_TIMEOUT_MS) {
+            LOG_WARN("session %d: frame %u expired with %u of %u fragments",
+                     r->session, r->frame_id, r->got, r->total);
+            r->used = false;
+            st.frames_expired++;
+        }
+    }
+}
+
+/* ---------- multicast groups ---------- */
+
+/* Joins group on the shared group socket, opened on the first join. */
+static int join_group(uint32_t group, uint16_t port)
+{
+    struct ip_mreq mr = { .imr_multiaddr.s_addr = htonl(group) };
+
+    if (mcast_fd < 0) {
+        struct sockaddr_in a = { .sin_family = AF_INET, .sin_port = htons(port) };
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = &mcast_fd };
+        int one = 1;
+
+        a.sin_addr.s_addr = htonl(INADDR_ANY);
+        mcast_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+        if (mcast_fd < 0 || setsockopt(mcast_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+            bind(mcast_fd, (struct sockaddr *)&a, sizeof(a)) < 0 ||
+            epoll_ctl(epfd, EPOLL_CTL_ADD, mcast_fd, &ev) < 0) {
+            perror("srtp_subscriber: group socket");
+            return -1;
+        }
+        mcast_port = port;
+    }
+    if (port != mcast_port)
+        return -1;                     /* one router, one group port */
+    for (int i = 0; i < njoined; i++)
+        if (joined[i] == group)
+            return 0;
+    /* a loopback server sends its groups on lo; elsewhere the kernel picks */
+    if (ntohl(server.sin_addr.s_addr) >> 24 == IN_LOOPBACKNET)
+        mr.imr_interface = server.sin_addr;
+    if (njoined == JOIN_MAX || setsockopt(mcast_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mr, sizeof(mr)) < 0)
+        return -1;
+    joined[njoined++] = group;
+    LOG_INFO("joined group %u.%u.%u.%u:%u", group >> 24, group >> 16 & 0xff,
+             group >> 8 & 0xff, group & 0xff, port);
+    return 0;
+}
+
+/* Nacks the group updates missing before seq_no; the router resends them. */
+static void request_repairs(session_t *s, const flow_t *f, uint32_t seq_no)
+{
+    static uint8_t pkt[256];
+    uint32_t from = f->last_seq + 1;
+
+    if (seq_no - from > REPAIR_MAX)
+        from = seq_no - REPAIR_MAX;
+    for (uint32_t q = from; q < seq_no; q++) {
+        send_pkt(s, pkt, prtp_build_ack(pkt, sizeof(pkt), PRTP_UPDATE_NACK, q, f->sub.sid));
+        st.nacks++;
+    }
+}
+
+/* ---------- list / subscribe ---------- */
+
+static void send_list(session_t *s)
+{
+    static uint8_t pkt[256];
+
+    s->state = S_LISTING;
+    s->deadline_ms = srtp_now_ms() + RETRY_MS;
+    send_pkt(s, pkt, prtp_build_simple(pkt, sizeof(pkt), PRTP_LIST, seq_counter++));
+}
+
+static void send_subscribe(session_t *s)
+{
+    static uint8_t pkt[PRTP_MAX_PKT];
+    int n = s->nflows - s->next;
+
+    if (n <= 0) {
+        s->state = S_READY;
+        LOG_INFO("session %d ready: %d flows", (int)(s - sessions), s->nflows);
+        return;
+    }
+    if (n > PRTP_MAX_SIDS)
+        n = PRTP_MAX_SIDS;
+    for (int i = 0; i < n; i++)
+        scratch_sids[i] = s->flows[s->next + i].sub;
+    s->inflight = prtp_subscribe_fit(scratch_sids, n);
+    s->state = S_SUBSCRIBING;
+    s->deadline_ms = srtp_now_ms() + RETRY_MS;
+    send_pkt(s, pkt, prtp_build_subscribe(pkt, sizeof(pkt), seq_counter++,
+                                          scratch_sids, s->inflight));
+}
+
+static void on_list_response(session_t *s, const prtp_msg_t *m)
+{
+    for (int i = 0; i < m->nsids; i++)
+        add_flow(s, m->sids[i].sid, all_reliable);
+    finish_plan(s);
+    s->tries = 0;
+    send_subscribe(s);
+}
+
+static void activate_flows(session_t *s, const prtp_msg_t *m)
+{
+    for (int i = 0; i < m->nsids; i++) {
+        flow_t *f = find_flow(s, m->sids[i].sid);
+        if (!f)
+            continue;
+        if (!f->requested && s->state == S_READY)
+            continue;                  /* unsubscribed again before the ack */
+        f->requested = false;
+        if (m->sids[i].status == PRTP_SUB_OK || m->sids[i].status == PRTP_SUB_EXISTS) {
+            if (!f->active) {
+                f->seen = false;       /* a new subscription numbers from 1 again */
+                f->active_ms = srtp_now_ms();
+            }
+            f->active = true;
+            f->grouped = m->sids[i].group_port != 0;
+            if (f->grouped && join_group(m->sids[i].group_addr, m->sids[i].group_port) < 0) {
+                LOG_WARN("session %d: cannot join group port %u", (int)(s - sessions), m->sids[i].group_port);
+                st.group_errors++;
+            }
+        } else
+            st.rejected++;
+    }
+}
+
+static void on_subscribe_ack(session_t *s, const prtp_msg_t *m)
+{
+    activate_flows(s, m);
+    s->next += s->inflight;
+    s->inflight = 0;
+    s->tries = 0;
+    send_subscribe(s);
+}
+
+static void on_update(session_t *s, const prtp_msg_t *m)
+{
+    static uint8_t pkt[256];
+    flow_t *f;
+
+    s->updates++;
+    st.updates++;
+    LOG_TRACE("session %d: update seq_no %u reliable %d", (int)(s - sessions), m->seq_no, m->reliable);
+    if (m->sid[0] == '\0') {
+        /* the server opens every subscription with an empty update, which
+         * STGen_Client leaves unacked (acking it only speeds up resends) */
+        st.empty_updates++;
+        return;
+    }
+    if (m->seq_no == 0)
+        st.cached_updates++;
+    else if (m->has_timestamp)
+        record_latency(m->timestamp);
+    if (m->blob && prtp_sensor_type(m->sid) == PRTP_SENSOR_CAMERA)
+        on_fragment((int)(s - sessions), m);
+    f = find_flow(s, m->sid);
+    if (m->reliable && f && ack_delay_ms > 0) {
+        ack_later(s, f, m->seq_no);
+    } else if (m->reliable) {
+        /* acks are matched by sid and carry the client's own seq_no */
+        send_pkt(s, pkt, prtp_build_ack(pkt, sizeof(pkt), PRTP_UPDATE_ACK, seq_counter++, m->sid));
+        st.acks++;
+        st.ack_packets++;
+    }
+    if (!f) {
+        st.unknown++;
+        return;
+    }
+    if (f->active_ms) {
+        uint64_t ms = srtp_now_ms() - f->active_ms;
+        st.ttfd_samples++;
+        st.ttfd_sum_ms += ms;
+        if (ms > st.ttfd_max_ms)
+            st.ttfd_max_ms = ms;
+        f->active_ms = 0;
+    }
+    if (!f->seen) {
+        create_active_flow(f, m->seq_no);
+        return;
+    }
+    if (f->grouped && f->sub.reliable && m->seq_no > f->last_seq + 1)
+        request_repairs(s, f, m->seq_no);
+    update_active_flow(f, m->seq_no);
+}
+
+/* A group datagram goes to every session with an active grouped flow of its sid. */
+static void on_group_datagram(const uint8_t *buf, size_t len)
+{
+    prtp_msg_t m = { 0 };
+
+    st.group_datagrams++;
+    if (prtp_parse(buf, len, &m) < 0 || m.type != PRTP_UPDATE || !m.sid[0])
+        return;
+    for (int i = 0; i < opened; i++) {
+        const flow_t *f = find_flow(&sessions[i], m.sid);
+        if (f && f->active && f->grouped)
+            on_update(&sessions[i], &m);
+    }
+}
+
+/* Restores a compressed update into plain; its length, or -1 to drop it. */
+static int decompress(session_t *s, const uint8_t *buf, size_t len, uint8_t *plain)
+{
+    static uint8_t pkt[256];
+    int n;
+
+    if (!s->hc && !(s->hc = calloc(SRTP_HC_CONTEXTS, sizeof(*s->hc))))
+        return -1;
+    n = srtp_hc_decompress(s->hc, buf, len, plain, PRTP_MAX_PKT);
+    if (n == SRTP_HC_DAMAGED) {
+        /* the context's IR was lost: ask for another */
+        send_pkt(s, pkt, prtp_build_simple(pkt, sizeof(pkt), PRTP_HC_RESYNC, buf[2]));
+        st.hc_damaged++;
+        return -1;
+    }
+    if (n < 0) {
+        st.hc_bad++;
+        return -1;
+    }
+    st.hc_updates++;
+    st.hc_irs += buf[1] == SRTP_HC_IR;
+    return n;
+}
+
+static void on_packet(session_t *s, const uint8_t *buf, size_t len)
+{
+    static uint8_t plain[PRTP_MAX_PKT];
+    prtp_msg_t m = { .sids = scratch_sids };
+    int n;
+
+    s->last_rx_ms = srtp_now_ms();
+    st.rx_bytes += len;
+    if (srtp_hc_is_compressed(buf, len)) {
+        if ((n = decompress(s, buf, len, plain)) < 0)
+            return;
+        buf = plain;
+        len = (size_t)n;
+    }
+    if (prtp_parse(buf, len, &m) < 0)
+        return;
+    switch (m.type) {
+    case PRTP_LIST_RESPONSE:
+        if (s->state == S_LISTING)
+            on_list_response(s, &m);
+        else
+            st.list_responses++;       /* a list command */
+        break;
+    case PRTP_SUBSCRIBE_ACK:
+        if (s->state == S_SUBSCRIBING)
+            on_subscribe_ack(s, &m);
+        else
+            activate_flows(s, &m);     /* a sub command */
+        break;
+    case PRTP_UPDATE:
+        on_update(s, &m);
+        break;
+    default:
+        break;
+    }
+}
+
+/* ---------- control socket ---------- */
+
+/* Sends one subscribe (or unsubscribe) per chunk of scratch_sids[0..n). */
+static void send_sid_chunks(session_t *s, int n, bool unsubscribe)
+{
+    static uint8_t pkt[PRTP_MAX_PKT];
+
+    for (int off = 0, c; off < n; off += c) {
+        c = prtp_subscribe_fit(scratch_sids + off, n - off);
+        send_pkt(s, pkt, unsubscribe
+                 ? prtp_build_unsubscribe(pkt, sizeof(pkt), seq_counter++, scratch_sids + off, c)
+                 : prtp_build_subscribe(pkt, sizeof(pkt), seq_counter++, scratch_sids + off, c));
+    }
+}
+
+/* Flows added below sit unsorted past the first nsorted until finish_plan,
+ * so lookups go to the sorted part and a sid repeated in the command is
+ * caught by the flows it has added. */
+static int ctl_subscribe(session_t *s, char **sids, int n, bool reliable)
+{
+    int k = 0, nsorted = s->nflows;
+
+    for (int i = 0; i < n && k < PRTP_MAX_SIDS; i++) {
+        flow_t *f = find_flow_in(s, sids[i], nsorted);
+        bool repeat = false;
+
+        for (int j = nsorted; j < s->nflows && !repeat; j++)
+            repeat = strcmp(s->flows[j].sub.sid, sids[i]) == 0;
+        if (repeat || (f && (f->active || f->requested)))
+            continue;
+        if (!f && !(f = add_flow(s, sids[i], reliable)))
+            break;
+        f->sub.reliable = reliable;
+        f->requested = true;
+        memset(&scratch_sids[k], 0, sizeof(scratch_sids[k]));
+        snprintf(scratch_sids[k].sid, sizeof(scratch_sids[k].sid), "%s", sids[i]);
+        scratch_sids[k].opts = sub_opts;
+        scratch_sids[k++].reliable = reliable;
+    }
+    finish_plan(s);
+    send_sid_chunks(s, k, false);
+    return k;
+}
+
+static int ctl_unsubscribe(session_t *s, char **sids, int n)
+{
+    int k = 0;
+
+    for (int i = 0; i < n && k < PRTP_MAX_SIDS; i++) {
+        flow_t *f = find_flow(s, sids[i]);
+        if (!f || !(f->active || f->requested))
+            continue;
+        f->active = f->requested = false;
+        f->active_ms = 0;
+        scratch_sids[k++] = f->sub;
+    }
+    send_sid_chunks(s, k, true);
+    return k;
+}
+
+/* Runs one command line, appending its reply line to out. */
+static void ctl_command(char *line, char *out, size_t cap)
+{
+    static uint8_t pkt[256];
+    char *argv[PRTP_MAX_SIDS + 2], *save;
+    int argc = 0, first, last, done = 0;
+    size_t used = strlen(out);
+
+    for (char *t = strtok_r(line, " \t", &save); t && argc < PRTP_MAX_SIDS + 2;
+         t = strtok_r(NULL, " \t", &save))
+        argv[argc++] = t;
+    if (argc == 0)
+        return;
+    st.ctl_commands++;
+    if (strcmp(argv[0], "stats") == 0) {
+        uint64_t active = 0;
+        for (int i = 0; i < opened; i++)
+            for (int j = 0; j < sessions[i].nflows; j++)
+                active += sessions[i].flows[j].active;
+        snprintf(out + used, cap - used,
+                 "ok sessions=%d active_flows=%lu updates=%lu lost=%lu late=%lu rejected=%lu "
+                 "ctl_subs=%lu ctl_unsubs=%lu list_responses=%lu\n", opened,
+                 (unsigned long)active, (unsigned long)st.updates, (unsigned long)st.lost,
+                 (unsigned long)st.late, (unsigned long)st.rejected, (unsigned long)st.ctl_subs,
+                 (unsigned long)st.ctl_unsubs, (unsigned long)st.list_responses);
+        return;
+    }
+    if (argc < 2) {
+        snprintf(out + used, cap - used, "err usage\n");
+        return;
+    }
+    if (strcmp(argv[1], "*") == 0) {
+        first = 0;
+        last = opened;
+    } else {
+        char *end;
+        first = (int)strtol(argv[1], &end, 10);
+        last = first + 1;
+        if (*end || first < 0 || first >= opened) {
+            snprintf(out + used, cap - used, "err no session %s\n", argv[1]);
+            return;
+        }
+    }
+    for (int i = first; i < last; i++) {
+        if (sessions[i].state != S_READY) {
+            snprintf(out + used, cap - used, "err busy\n");
+            return;
+        }
+    }
+    for (int i = first; i < last; i++) {
+        session_t *s = &sessions[i];
+        if (strcmp(argv[0], "sub") == 0 || strcmp(argv[0], "rsub") == 0) {
+            int k = ctl_subscribe(s, argv + 2, argc - 2, argv[0][0] == 'r');
+            st.ctl_subs += (uint64_t)k;
+            done += k;
+        } else if (strcmp(argv[0], "unsub") == 0) {
+            int k = ctl_unsubscribe(s, argv + 2, argc - 2);
+            st.ctl_unsubs += (uint64_t)k;
+            done += k;
+        } else if (strcmp(argv[0], "list") == 0) {
+            send_pkt(s, pkt, prtp_build_simple(pkt, sizeof(pkt), PRTP_LIST, seq_counter++));
+            st.ctl_lists++;
+            done++;
+        } else {
+            snprintf(out + used, cap - used, "err unknown command %s\n", argv[0]);
+            return;
+        }
+    }
+    snprintf(out + used, cap - used, "ok %d\n", done);
+}
+
+static void on_control(void)
+{
+    static char buf[PRTP_MAX_PKT], out[PRTP_MAX_PKT];
+    struct sockaddr_in from;
+    socklen_t fl = sizeof(from);
+    ssize_t len;
+
+    while ((len = recvfrom(ctl_fd, buf, sizeof(buf) - 1, 0, (struct sockaddr *)&from, &fl)) >= 0) {
+        char *save;
+        buf[len] = '\0';
+        out[0] = '\0';
+        for (char *line = strtok_r(buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save))
+            ctl_command(line, out, sizeof(out));
+        sendto(ctl_fd, out, strlen(out), 0, (struct sockaddr *)&from, fl);
+        fl = sizeof(from);
+    }
+}
+
+static int open_control(int port)
+{
+    struct sockaddr_in a = { .sin_family = AF_INET, .sin_port = htons(port) };
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = &ctl_fd };
+
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ctl_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (ctl_fd < 0 || bind(ctl_fd, (struct sockaddr *)&a, sizeof(a)) < 0)
+        return -1;
+    return epoll_ctl(epfd, EPOLL_CTL_ADD, ctl_fd, &ev);
+}
+
+/* ---------- sessions ---------- */
+
+static int open_session(session_t *s, char **sids, int nsids, int index, int per_session)
+{
+    struct epoll_event ev = { .events = EPOLLIN };
+    struct sockaddr_in local = { .sin_family = AF_INET, .sin_port = htons(base_port + index) };
+
+    s->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (s->fd < 0 ||
+        (base_port && bind(s->fd, (struct sockaddr *)&local, sizeof(local)) < 0) ||
+        connect(s->fd, (struct sockaddr *)&server, sizeof(server)) < 0) {
+        perror("srtp_subscriber: socket");
+        return -1;
+    }
+    ev.data.ptr = s;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, s->fd, &ev);
+    s->last_rx_ms = srtp_now_ms();
+
+    for (int j = 0; j < per_session && nsids > 0; j++)
+        add_flow(s, sids[((long)index * per_session + j) % nsids], sids_reliable);
+    if (list_all) {
+        send_list(s);
+    } else {
+        finish_plan(s);
+        send_subscribe(s);
+    }
+    return 0;
+}
+
+static void close_session(session_t *s)
+{
+    static uint8_t pkt[PRTP_MAX_PKT];
+    int n = 0;
+
+    if (s->acks_pending)
+        flush_sack(s);
+    for (int i = 0; i < s->nflows && n < PRTP_MAX_SIDS; i++)
+        if (s->flows[i].active)
+            scratch_sids[n++] = s->flows[i].sub;
+    for (int off = 0, c; off < n; off += c) {
+        c = prtp_subscribe_fit(scratch_sids + off, n - off);
+        send_pkt(s, pkt, prtp_build_unsubscribe(pkt, sizeof(pkt), seq_counter++,
+                                                scratch_sids + off, c));
+    }
+    close(s->fd);
+    s->fd = -1;
+    if (s->hc) {
+        srtp_hc_free(s->hc, SRTP_HC_CONTEXTS);
+        free(s->hc);
+    }
+}
+
+static void housekeeping(int opened, int keepalive_s)
+{
+    static uint8_t pkt[256];
+    uint64_t now = srtp_now_ms();
+
+    expire_frames(now);
+    for (int i = 0; i < opened; i++) {
+        session_t *s = &sessions[i];
+
+        if (s->state != S_READY && now >= s->deadline_ms) {
+            if (++s->tries < MAX_TRIES) {
+                st.retries++;
+                if (s->state == S_LISTING)
+                    send_list(s);
+                else
+                    send_subscribe(s);
+            } else {
+                /* settle: subscribe what was planned, or keep what was acked */
+                LOG_WARN("session %d: unanswered after %d tries (state %d)", i, MAX_TRIES, s->state);
+                st.gave_up++;
+                s->tries = 0;
+                if (s->state == S_LISTING) {
+                    finish_plan(s);
+                    send_subscribe(s);
+                } else {
+                    s->state = S_READY;
+                }
+            }
+        }
+        if (keepalive_s > 0 && now - s->last_rx_ms >= (uint64_t)keepalive_s * 1000) {
+            send_pkt(s, pkt, prtp_build_simple(pkt, sizeof(pkt), PRTP_KEEP_ALIVE, seq_counter++));
+            s->last_rx_ms = now;
+            st.keepalives++;
+        }
+    }
+}
+
+static void raise_fd_limit(int need)
+{
+    struct rlimit rl;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < (rlim_t)need) {
+        rl.rlim_cur = rl.rlim_max < (rlim_t)need ? rl.rlim_max : (rlim_t)need;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [-s server_ip] [-p client_port] [-n sessions] [-a|-A] [-r]\n"
+        "          [-m sids_per_session] [-k keepalive_s] [-R sessions_per_s]\n"
+        "          [-D ack_delay_ms] [-d duration_s] [-T trace] [-C control_port]\n"
+        "          [-I min_interval_ms] [-E deadband] [-L] [-G] [-H] [-b base_port]\n"
+        "          [sensor_id ...]\n"
+        "\t-a(-A)\tEvery session subscribes (reliably) to all sensors the server lists\n"
+        "\t-r\tSubscribe reliably to the given sensor ids\n"
+        "\t-m\tGiven sensor ids are dealt out round-robin, m per session (default 1)\n"
+        "\t-D\tBatch reliable acks into sacks after ack_delay_ms (needs srtp_shard_router)\n"
+        "\t-T\tWrite the binary trace log here (srtp_log.h; decode with srtp_trace.py)\n"
+        "\t-C\tTake sub/rsub/unsub/list/stats commands on this 127.0.0.1 UDP port\n"
+        "\t-I\tAt most one update per flow every min_interval_ms (needs srtp_shard_router)\n"
+        "\t-E\tSkip temp/device updates within deadband of the last one (router too)\n"
+        "\t-L\tWith -I, deliver the latest update of each interval instead of the first\n"
+        "\t-G\tReceive updates on the router's multicast groups (srtp_shard_router -M)\n"
+        "\t-H\tHave the router header-compress updates (srtp_hc.h)\n"
+        "\t-b\tBind session i to local port base_port + i (per-device tc filters)\n",
+        prog);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *server_ip = "127.0.0.1", *trace = NULL;
+    int client_port = 5005, per_session = 1, keepalive_s = 5, rate = 500, duration = 0;
+    int control_port = 0, nsids, opt;
+    struct epoll_event events[BATCH];
+    uint64_t t0, last_hk = 0, recv_min = UINT64_MAX, recv_max = 0;
+    uint64_t flows = 0, active = 0, ready = 0;
+    char **sids;
+
+    nsessions = 1;
+    while ((opt = getopt(argc, argv, "s:p:n:aArm:k:R:D:d:T:C:I:E:LGHb:h")) != -1) {
+        switch (opt) {
+        case 's': server_ip = optarg; break;
+        case 'p': client_port = atoi(optarg); break;
+        case 'n': nsessions = atoi(optarg); break;
+        case 'a': list_all = true; break;
+        case 'A': list_all = all_reliable = true; break;
+        case 'r': sids_reliable = true; break;
+        case 'm': per_session = atoi(optarg); break;
+        case 'k': keepalive_s = atoi(optarg); break;
+        case 'R': rate = atoi(optarg); break;
+        case 'D': ack_delay_ms = atoi(optarg); break;
+        case 'd': duration = atoi(optarg); break;
+        case 'T': trace = optarg; break;
+        case 'C': control_port = atoi(optarg); break;
+        case 'I': sub_opts.min_interval_ms = (uint32_t)atoi(optarg); break;
+        case 'E': sub_opts.deadband = atof(optarg); break;
+        case 'L': sub_opts.latest = true; break;
+        case 'G': sub_opts.multicast = true; break;
+        case 'H': sub_opts.compress = true; break;
+        case 'b': base_port = atoi(optarg); break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    sids = argv + optind;
+    nsids = argc - optind;
+    if (nsessions < 1 || rate < 1 || per_session < 1 || (!list_all && nsids == 0) ||
+        base_port < 0 || base_port + nsessions > 65536 ||
+        inet_pton(AF_INET, server_ip, &server.sin_addr) != 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    server.sin_family = AF_INET;
+    server.sin_port = htons(client_port);
+
+    raise_fd_limit(nsessions + 16);
+    sessions = calloc(nsessions, sizeof(session_t));
+    epfd = epoll_create1(0);
+    if (!sessions || epfd < 0) {
+        perror("srtp_subscriber");
+        return 1;
+    }
+    for (int i = 0; i < REASM_SLOTS; i++) {
+        if (!(reasm[i].buf = malloc(REASM_FRAME_MAX))) {
+            perror("srtp_subscriber");
+            return 1;
+        }
+    }
+
+    if (trace && srtp_log_open(trace) < 0) {
+        perror(trace);
+        return 1;
+    }
+    if (control_port && open_control(control_port) < 0) {
+        perror("srtp_subscriber: control socket");
+        return 1;
+    }
+    signal(SIGTERM, handle_sig);
+    signal(SIGINT, handle_sig);
+
+    t0 = srtp_now_ms();
+    while (run) {
+        static uint8_t buf[PRTP_MAX_PKT];
+        uint64_t now = srtp_now_ms();
+        int n;
+
+        /* open sessions at the configured rate */
+        while (opened < nsessions && (now - t0) * rate >= (uint64_t)opened * 1000) {
+            if (open_session(&sessions[opened], sids, nsids, opened, per_session) < 0) {
+                run = 0;
+                break;
+            }
+            opened++;
+        }
+        if (duration > 0 && now - t0 >= (uint64_t)duration * 1000)
+            break;
+
+        n = epoll_wait(epfd, events, BATCH,
+                       ack_delay_ms > 0 && ack_delay_ms < 20 ? ack_delay_ms : 20);
+        for (int i = 0; i < n; i++) {
+            session_t *s = events[i].data.ptr;
+            ssize_t len;
+            if (events[i].data.ptr == &ctl_fd) {
+                on_control();
+                continue;
+            }
+            if (events[i].data.ptr == &mcast_fd) {
+                while ((len = recv(mcast_fd, buf, sizeof(buf), 0)) >= 0)
+                    on_group_datagram(buf, (size_t)len);
+                continue;
+            }
+            while ((len = recv(s->fd, buf, sizeof(buf), 0)) >= 0)
+                on_packet(s, buf, (size_t)len);
+        }
+        if (ack_delay_ms > 0)
+            flush_due_acks(opened);
+        if (srtp_now_ms() - last_hk >= 50) {
+            housekeeping(opened, keepalive_s);
+            last_hk = srtp_now_ms();
+        }
+    }
+
+    for (int i = 0; i < opened; i++) {
+        session_t *s = &sessions[i];
+        bool any = false;
+
+        flows += (uint64_t)s->nflows;
+        for (int j = 0; j < s->nflows; j++) {
+            active += s->flows[j].active;
+            any |= s->flows[j].active;
+        }
+        ready += (s->state == S_READY && any);
+        if (s->updates < recv_min) recv_min = s->updates;
+        if (s->updates > recv_max) recv_max = s->updates;
+        close_session(s);
+        free(s->flows);
+    }
+    if (opened == 0)
+        recv_min = 0;
+    srtp_log_close();
+
+    printf("{\"sessions\": %d, \"ready\": %lu, \"flows\": %lu, \"active_flows\": %lu, "
+           "\"rejected\": %lu, \"updates\": %lu, \"empty_updates\": %lu, \"unknown\": %lu, "
+           "\"lost\": %lu, \"late\": %lu, \"skipped\": %lu, \"acks\": %lu, \"ack_packets\": %lu, \"keepalives\": %lu, "
+           "\"retries\": %lu, \"gave_up\": %lu, \"send_errors\": %lu, "
+           "\"session_updates_min\": %lu, \"session_updates_max\": %lu, "
+           "\"lat_samples\": %lu, \"lat_negative\": %lu, \"lat_avg_ms\": %.3f, "
+           "\"lat_min_ms\": %.3f, \"lat_max_ms\": %.3f, \"lat_p50_ms\": %.3f, "
+           "\"lat_p95_ms\": %.3f, \"lat_p99_ms\": %.3f, \"fragments\": %lu, "
+           "\"frag_dups\": %lu, \"frag_bad\": %lu, \"frames\": %lu, \"frame_bytes\": %lu, "
+           "\"frames_expired\": %lu, \"frames_evicted\": %lu, \"frame_avg_ms\": %.1f, "
+           "\"frame_max_ms\": %lu, \"frame_mbps\": %.3f, \"ctl_commands\": %lu, "
+           "\"ctl_subs\": %lu, \"ctl_unsubs\": %lu, \"ctl_lists\": %lu, \"list_responses\": %lu, "
+           "\"ttfd_samples\": %lu, \"ttfd_avg_ms\": %.1f, \"ttfd_max_ms\": %lu, "
+           "\"cached_updates\": %lu, \"groups_joined\": %d, \"group_datagrams\": %lu, "
+           "\"group_errors\": %lu, \"nacks\": %lu, \"repaired\": %lu, \"rx_bytes\": %lu, "
+           "\"hc_updates\": %lu, \"hc_irs\": %lu, \"hc_damaged\": %lu, \"hc_bad\": %lu}\n",
+           opened, (unsigned long)ready, (unsigned long)flows, (unsigned long)active,
+           (unsigned long)st.rejected, (unsigned long)st.updates,
+           (unsigned long)st.empty_updates, (unsigned long)st.unknown,
+           (unsigned long)st.lost, (unsigned long)st.late, (unsigned long)st.skipped,
+           (unsigned long)st.acks,
+           (unsigned long)st.ack_packets, (unsigned long)st.keepalives, (unsigned long)st.retries,
+           (unsigned long)st.gave_up, (unsigned long)st.send_errors,
+           (unsigned long)recv_min, (unsigned long)recv_max,
+           (unsigned long)st.lat_samples, (unsigned long)st.lat_negative,
+           st.lat_samples ? st.lat_sum_us / 1000.0 / st.lat_samples : 0.0,
+           st.lat_samples ? st.lat_min_us / 1000.0 : 0.0, st.lat_max_us / 1000.0,
+           lat_percentile_ms(0.50), lat_percentile_ms(0.95), lat_percentile_ms(0.99),
+           (unsigned long)st.fragments, (unsigned long)st.frag_dups, (unsigned long)st.frag_bad,
+           (unsigned long)st.frames, (unsigned long)st.frame_bytes,
+           (unsigned long)st.frames_expired, (unsigned long)st.frames_evicted,
+           st.frames ? (double)st.frame_ms_sum / st.frames : 0.0, (unsigned long)st.frame_ms_max,
+           st.frame_last_ms > st.frame_first_ms
+               ? st.frame_bytes * 8.0 / 1000.0 / (st.frame_last_ms - st.frame_first_ms) : 0.0,
+           (unsigned long)st.ctl_commands, (unsigned long)st.ctl_subs, (unsigned long)st.ctl_unsubs,
+           (unsigned long)st.ctl_lists, (unsigned long)st.list_responses,
+           (unsigned long)st.ttfd_samples,
+           st.ttfd_samples ? (double)st.ttfd_sum_ms / st.ttfd_samples : 0.0,
+           (unsigned long)st.ttfd_max_ms, (unsigned long)st.cached_updates, njoined,
+           (unsigned long)st.group_datagrams, (unsigned long)st.group_errors,
+           (unsigned long)st.nacks, (unsigned long)st.repaired, (unsigned long)st.rx_bytes,
+           (unsigned long)st.hc_updates, (unsigned long)st.hc_irs, (unsigned long)st.hc_damaged,
+           (unsigned long)st.hc_bad);
+    fflush(stdout);
+
+    for (int i = 0; i < REASM_SLOTS; i++)
+        free(reasm[i].buf);
+    if (ctl_fd >= 0)
+        close(ctl_fd);
+    if (mcast_fd >= 0)
+        close(mcast_fd);
+    close(epfd);
+    free(sessions);
+    return 0;
+}
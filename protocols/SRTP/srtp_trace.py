@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""
+Offline decoder for the binary trace logs of the native SRTP tools.
+
+srtp_shard_router and srtp_subscriber record trace points (srtp_log.h)
+unformatted when started with -T; this formats them after the run:
+
+    python3 protocols/SRTP/srtp_trace.py router.trace [--level debug]
+"""
+
+import re
+import sys
+import struct
+import argparse
+from typing import Dict, List, Tuple
+
+LEVELS = {1: "ERROR", 2: "WARN", 3: "INFO", 4: "DEBUG", 5: "TRACE"}
+
+# C integer conversions: flags, width, precision, length modifier, type
+_CONV_RE = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(?:hh|h|ll|l|z|j|t)?([diouxXc%])")
+
+
+def _format(fmt: str, args: Tuple[int, ...]) -> str:
+    """printf() for integer conversions; %d/%i read the argument as signed."""
+    it = iter(args)
+
+    def conv(m: re.Match) -> str:
+        spec, kind = m.group(1), m.group(2)
+        if kind == "%":
+            return "%"
+        value = next(it, 0)
+        if kind in "di":
+            value = value - (1 << 64) if value >= 1 << 63 else value
+            kind = "d"
+        elif kind == "u":
+            kind = "d"
+        elif kind == "c":
+            value = chr(value & 0xff)
+        return ("%" + spec + kind) % value
+
+    return _CONV_RE.sub(conv, fmt)
+
+
+def read_trace(path: str) -> Tuple[List[Dict], int]:
+    """Records of a trace file as {t_us, level, msg} dicts, plus the
+    number the writer dropped (-1 if the run did not close the log)."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != b"SRTPLOG1":
+        raise ValueError(f"{path}: not an SRTP trace log")
+
+    fmts: Dict[int, str] = {}
+    records: List[Dict] = []
+    dropped, off = -1, 8
+    while off < len(data):
+        tag = data[off:off + 1]
+        off += 1
+        if tag == b"F":
+            fid, n = struct.unpack_from("=QI", data, off)
+            off += 12
+            fmts[fid] = data[off:off + n].decode(errors="replace")
+            off += n
+        elif tag == b"R":
+            if off + 18 > len(data):
+                break                   # cut short by a crash
+            t_us, fid, level, nargs = struct.unpack_from("=QQBB", data, off)
+            off += 18
+            args = struct.unpack_from(f"={nargs}Q", data, off)
+            off += 8 * nargs
+            records.append({
+                "t_us": t_us,
+                "level": level,
+                "msg": _format(fmts.get(fid, "<unknown format>"), args),
+            })
+        elif tag == b"D":
+            (dropped,) = struct.unpack_from("=Q", data, off)
+            off += 8
+        else:
+            break
+    return records, dropped
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("trace")
+    parser.add_argument("--level", default="trace", choices=[l.lower() for l in LEVELS.values()])
+    args = parser.parse_args()
+
+    limit = {v.lower(): k for k, v in LEVELS.items()}[args.level]
+    records, dropped = read_trace(args.trace)
+    t0 = records[0]["t_us"] if records else 0
+    for r in records:
+        if r["level"] <= limit:
+            print(f"{(r['t_us'] - t0) / 1000:10.3f} {LEVELS.get(r['level'], '?'):5} {r['msg']}")
+    if dropped > 0:
+        print(f"({dropped} records dropped: ring full)", file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,248 @@
+#!/usr/bin/env python3
+"""
+SRTP ack-policy comparison under impaired links.
+
+Runs reliable SRTP subscriptions through an in-process UDP relay that
+applies a network profile from configs/network_conditions (one-way delay,
+jitter, loss and a serialised link rate in each direction), once with
+STGen_Client-style per-update acks and once per sack delay.  Reports the
+client->server control packets per delivered update and the recovery
+latency of updates whose first copy the relay dropped: the time from that
+first copy to the first copy that got through.
+
+Sacks are expanded by srtp_shard_router, so every run fronts a single
+server with the router; the relay sits between srtp_subscriber and the
+router's client port.
+
+Usage:
+  python run_srtp_ack_test.py --profile agri_bad --delays 0,20,50
+  python run_srtp_ack_test.py --profile lorawan --duration 60 --output lorawan.json
+"""
+
+import argparse
+import heapq
+import json
+import random
+import selectors
+import socket
+import statistics
+import struct
+import subprocess
+import sys
+import threading
+import time
+from pathlib import Path
+from typing import Dict, List, Tuple
+
+sys.path.insert(0, str(Path(__file__).parent))
+
+from distributed.srtp_cluster import UPDATE, _msg_type, _update_sid
+from protocols.SRTP import Protocol
+
+PROFILES = Path(__file__).parent / "configs" / "network_conditions"
+BIN_DIR = Path(__file__).parent / "bin"
+ACK, SACK = 5, 9
+
+
+def _seq_no(pkt: bytes) -> int:
+    i = pkt.find(b"\x10seq_no\x00")
+    return struct.unpack_from("<i", pkt, i + 8)[0] if i >= 0 else -1
+
+
+class ImpairmentRelay:
+    """
+    UDP relay applying one profile to both directions.
+
+    Each client address gets its own upstream socket so replies can be
+    routed back.  Packets are dropped with loss_percent, then leave a
+    per-direction link after bandwidth_kbps serialisation plus half the
+    profile latency and a uniform +-jitter (reordering is allowed).
+    """
+
+    def __init__(self, listen_port: int, upstream: Tuple[str, int], profile: Dict, seed: int = 1):
+        self.upstream = upstream
+        self.delay = profile.get("latency_ms", 0) / 2e3
+        self.jitter = profile.get("jitter_ms", 0) / 2e3
+        self.loss = profile.get("loss_percent", 0) / 100.0
+        self.rate = profile.get("bandwidth_kbps", 0) * 1e3 / 8     # bytes/s, 0 = unlimited
+        self.rng = random.Random(seed)
+        self.sel = selectors.DefaultSelector()
+        self.front = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.front.bind(("127.0.0.1", listen_port))
+        self.front.setblocking(False)
+        self.sel.register(self.front, selectors.EVENT_READ, None)
+        self.back: Dict[Tuple[str, int], socket.socket] = {}
+        self.queue: List[Tuple[float, int, socket.socket, bytes, Tuple[str, int]]] = []
+        self.link_free = {"up": 0.0, "down": 0.0}
+        self.order = 0
+        self.running = False
+        # measurements
+        self.control = {ACK: 0, SACK: 0}
+        self.first_seen: Dict[Tuple, float] = {}
+        self.first_dropped: set = set()
+        self.delivered: set = set()
+        self.recovery_ms: List[float] = []
+
+    def _schedule(self, direction: str, sock: socket.socket, pkt: bytes, dst) -> bool:
+        now = time.monotonic()
+        if self.rng.random() < self.loss:
+            return False
+        start = max(now, self.link_free[direction])
+        if self.rate:
+            self.link_free[direction] = start + len(pkt) / self.rate
+        at = self.link_free[direction] if self.rate else now
+        at += max(0.0, self.delay + self.rng.uniform(-self.jitter, self.jitter))
+        heapq.heappush(self.queue, (at, self.order, sock, pkt, dst))
+        self.order += 1
+        return True
+
+    def _client_to_server(self, pkt: bytes, client) -> None:
+        if client not in self.back:
+            sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            sock.setblocking(False)
+            self.back[client] = sock
+            self.sel.register(sock, selectors.EVENT_READ, client)
+        if _msg_type(pkt) in self.control:
+            self.control[_msg_type(pkt)] += 1
+        self._schedule("up", self.back[client], pkt, self.upstream)
+
+    def _server_to_client(self, pkt: bytes, client) -> None:
+        sid = _update_sid(pkt) if _msg_type(pkt) == UPDATE else ""
+        key = (client, sid, _seq_no(pkt))
+        if sid and key not in self.first_seen:
+            self.first_seen[key] = time.monotonic()
+        sent = self._schedule("down", self.front, pkt, client)
+        if not sid or key in self.delivered:
+            return
+        if not sent:
+            self.first_dropped.add(key)
+        else:
+            self.delivered.add(key)
+            if key in self.first_dropped:
+                self.recovery_ms.append((time.monotonic() - self.first_seen[key]) * 1e3)
+
+    def run(self) -> None:
+        self.running = True
+        while self.running:
+            timeout = 0.01
+            if self.queue:
+                timeout = min(timeout, max(0.0, self.queue[0][0] - time.monotonic()))
+            for key, _ in self.sel.select(timeout):
+                try:
+                    pkt, addr = key.fileobj.recvfrom(65535)
+                except BlockingIOError:
+                    continue
+                if key.data is None:
+                    self._client_to_server(pkt, addr)
+                else:
+                    self._server_to_client(pkt, key.data)
+            now = time.monotonic()
+            while self.queue and self.queue[0][0] <= now:
+                _, _, sock, pkt, dst = heapq.heappop(self.queue)
+                try:
+                    sock.sendto(pkt, dst)
+                except OSError:
+                    pass
+
+    def close(self) -> None:
+        self.running = False
+        for sock in [self.front, *self.back.values()]:
+            sock.close()
+
+
+def run_once(args, profile: Dict, ack_delay: int) -> Dict:
+    # the names Protocol registers in the shard's sensor list
+    types = ["temp", "device", "gps", "camera"]
+    sensors = [f"{types[i % 4]}_{i}" for i in range(args.sessions * args.per_session)]
+    proto = Protocol({
+        "server_ip": "127.0.0.1",
+        "server_port": args.sensor_port,
+        "client_port": args.sensor_port + 1,
+        "shard_base_port": args.base_port,
+        "num_clients": len(sensors),
+        "subscriber_host": True,
+        "subscriber_ack_delay_ms": max(ack_delay, 1),   # always behind the router
+    })
+    proto.start_server()
+    relay = ImpairmentRelay(args.relay_port, ("127.0.0.1", args.sensor_port + 1), profile, args.seed)
+    thread = threading.Thread(target=relay.run, daemon=True)
+    thread.start()
+    host = subprocess.Popen(
+        [str(BIN_DIR / "srtp_subscriber"), "-s", "127.0.0.1", "-p", str(args.relay_port),
+         "-n", str(args.sessions), "-m", str(args.per_session), "-r", "-D", str(ack_delay)]
+        + sensors,
+        stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, text=True,
+    )
+    try:
+        time.sleep(3.0)                                  # subscribe over the impaired link
+        end, seq = time.monotonic() + args.duration, 0
+        while time.monotonic() < end:
+            seq += 1
+            for sid in sensors:
+                proto.send_data("ackbench", {"dev_id": sid, "seq_no": seq,
+                                             "sensor_data": {"value": 21.0}})
+            time.sleep(1.0 / args.rate_hz)
+        time.sleep(args.drain)
+    finally:
+        host.send_signal(2)
+        out, _ = host.communicate(timeout=10)
+        relay.close()
+        thread.join(timeout=2)
+        proto.stop()
+
+    lines = [l for l in out.splitlines() if l.startswith("{")]
+    stats = json.loads(lines[-1]) if lines else {}
+    delivered = len(relay.delivered)
+    control = relay.control[ACK] + relay.control[SACK]
+    rec = sorted(relay.recovery_ms)
+    return {
+        "ack_delay_ms": ack_delay,
+        "published": seq * len(sensors),
+        "delivered": delivered,
+        "control_packets": control,
+        "control_per_update": round(control / delivered, 3) if delivered else None,
+        "recovered": len(rec),
+        "recovery_p50_ms": round(statistics.median(rec), 1) if rec else None,
+        "recovery_p95_ms": round(rec[min(len(rec) - 1, int(0.95 * len(rec)))], 1) if rec else None,
+        "acked_updates": stats.get("acks"),
+        "host": stats,
+        "lat_p50_ms": stats.get("lat_p50_ms"),
+        "router": proto.get_metrics().get("shard_router", {}),
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description="SRTP per-update acks vs delayed sacks")
+    parser.add_argument("--profile", default="agri_bad", help="configs/network_conditions/<name>.json")
+    parser.add_argument("--delays", default="0,20,50", help="Comma-separated ack delays (0 = per-update acks)")
+    parser.add_argument("--sessions", default=8, type=int)
+    parser.add_argument("--per-session", default=4, type=int, help="Reliable sensors per session")
+    parser.add_argument("--rate-hz", default=1.0, type=float, help="Readings per sensor per second")
+    parser.add_argument("--duration", default=20, type=int)
+    parser.add_argument("--drain", default=5.0, type=float, help="Seconds to wait for retransmits")
+    parser.add_argument("--seed", default=1, type=int)
+    parser.add_argument("--sensor-port", default=5104, type=int)
+    parser.add_argument("--relay-port", default=5110, type=int)
+    parser.add_argument("--base-port", default=6100, type=int)
+    parser.add_argument("--output", default="")
+    args = parser.parse_args()
+
+    profile = json.loads((PROFILES / f"{args.profile}.json").read_text())
+    results = []
+    for delay in [int(d) for d in args.delays.split(",")]:
+        r = run_once(args, profile, delay)
+        results.append(r)
+        print(f"📊 {args.profile} D={delay} ms: {r['delivered']}/{r['published']} delivered, "
+              f"{r['control_per_update']} ctl pkts/update, "
+              f"recovery p50 {r['recovery_p50_ms']} ms p95 {r['recovery_p95_ms']} ms "
+              f"({r['recovered']} recovered)")
+
+    if args.output:
+        Path(args.output).write_text(json.dumps({"profile": profile, "runs": results}, indent=2))
+        print(f"✓ Results written to {args.output}")
+    else:
+        print(json.dumps(results, indent=2))
+
+
+if __name__ == "__main__":
+    main()
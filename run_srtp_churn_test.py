@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+"""
+SRTP subscription churn benchmark.
+
+Runs srtp_subscriber sessions subscribed reliably to every sensor, feeds
+one steady sensor at a fixed rate, and drives scripted churn through the
+subscriber host's control socket: every session unsubscribes and
+resubscribes the other sensors as fast as the server answers, or at
+--ops-rate sid operations per second.  The same run without churn is the
+baseline.  Reports the server's CPU time (its subscription-table cost)
+and the steady flow's delivery and latency (the disruption churn causes).
+
+Usage:
+  python run_srtp_churn_test.py --sessions 16 --sensors 8 --duration 5
+  python run_srtp_churn_test.py --ops-rate 5000 --output churn.json
+"""
+
+import argparse
+import json
+import os
+import sys
+import time
+from pathlib import Path
+from typing import Dict
+
+sys.path.insert(0, str(Path(__file__).parent))
+
+from protocols.SRTP import Protocol
+
+SENSOR_TYPES = ["temp", "device", "gps", "camera"]
+
+
+def _cpu_seconds(pid: int) -> float:
+    """utime + stime of a process, from /proc."""
+    with open(f"/proc/{pid}/stat") as f:
+        fields = f.read().rsplit(")", 1)[1].split()
+    return (int(fields[11]) + int(fields[12])) / os.sysconf("SC_CLK_TCK")
+
+
+def run_once(args, churn: bool) -> Dict:
+    sensors = [f"{SENSOR_TYPES[i % 4]}_{i}" for i in range(args.sensors)]
+    steady, churned = sensors[0], sensors[1:]
+    proto = Protocol({
+        "server_ip": "127.0.0.1", "server_port": args.sensor_port,
+        "client_port": args.sensor_port + 1, "num_clients": args.sensors,
+        "subscriber_host": True, "subscriber_control_port": args.control_port,
+    })
+    proto.start_server()
+    ops = commands = busy = 0
+    try:
+        # -A: every session subscribes reliably to every listed sensor
+        proto.start_clients(args.sessions)
+        deadline = time.monotonic() + 10
+        while time.monotonic() < deadline:
+            replies = proto.control(["unsub *"])   # "err busy" until all are subscribed
+            if replies[0].startswith("ok"):
+                break
+            time.sleep(0.1)
+        server_pid = proto._server_process.pid
+        cpu0, t0 = _cpu_seconds(server_pid), time.monotonic()
+        seq, next_reading = 1, t0
+        subscribed = True
+        while (now := time.monotonic()) - t0 < args.duration:
+            if now >= next_reading:
+                proto.send_data("churn", {"dev_id": steady, "seq_no": seq, "sensor_data": {"value": seq}})
+                seq += 1
+                next_reading += 1.0 / args.reading_hz
+            if not churn:
+                time.sleep(min(0.01, max(0.0, next_reading - now)))
+                continue
+            if args.ops_rate and ops >= args.ops_rate * (now - t0):
+                time.sleep(0.001)
+                continue
+            cmd = "unsub" if subscribed else "rsub"
+            reply = proto.control([f"{cmd} * " + " ".join(churned)])[0]
+            commands += 1
+            if reply.startswith("ok"):
+                ops += int(reply.split()[1])
+                subscribed = not subscribed
+            else:
+                busy += 1
+        elapsed = time.monotonic() - t0
+        cpu = _cpu_seconds(server_pid) - cpu0
+        time.sleep(args.drain)
+    finally:
+        proto.stop()
+
+    host = proto.get_metrics()["subscriber_host"]
+    readings = seq - 1
+    return {
+        "churn": churn,
+        "sessions": args.sessions,
+        "churned_sids": len(churned),
+        "commands": commands,
+        "sid_ops": ops,
+        "sid_ops_per_s": round(ops / elapsed, 1),
+        "busy_replies": busy,
+        "server_cpu_s": round(cpu, 3),
+        "server_cpu_pct": round(100 * cpu / elapsed, 1),
+        "steady_readings": readings,
+        "steady_delivered": host["lat_samples"],
+        "steady_delivery_pct": round(100 * host["lat_samples"] / max(1, readings * args.sessions), 1),
+        "lat_p50_ms": host["lat_p50_ms"],
+        "lat_p99_ms": host["lat_p99_ms"],
+        "lost": host["lost"],
+        "late": host["late"],
+        "empty_updates": host["empty_updates"],
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description="SRTP subscription churn benchmark")
+    parser.add_argument("--sessions", default=16, type=int)
+    parser.add_argument("--sensors", default=8, type=int, help="Sensor 0 is steady, the rest churn")
+    parser.add_argument("--duration", default=5.0, type=float)
+    parser.add_argument("--drain", default=1.0, type=float)
+    parser.add_argument("--reading-hz", default=10.0, type=float, help="Steady sensor readings per second")
+    parser.add_argument("--ops-rate", default=0, type=int, help="Target sid operations per second (0 = max)")
+    parser.add_argument("--sensor-port", default=5204, type=int)
+    parser.add_argument("--control-port", default=5299, type=int)
+    parser.add_argument("--output", default="")
+    args = parser.parse_args()
+
+    results = [run_once(args, churn=False), run_once(args, churn=True)]
+    print(f"\n{'':10} {'sid ops/s':>10} {'server cpu':>11} {'delivered':>10} {'p50 ms':>8} {'p99 ms':>8}")
+    for r in results:
+        print(f"{'churn' if r['churn'] else 'baseline':10} {r['sid_ops_per_s']:>10} "
+              f"{r['server_cpu_pct']:>10}% {r['steady_delivery_pct']:>9}% "
+              f"{r['lat_p50_ms']:>8.1f} {r['lat_p99_ms']:>8.1f}")
+    if args.output:
+        Path(args.output).write_text(json.dumps(results, indent=2))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
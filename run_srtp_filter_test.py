@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+"""
+SRTP subscription-option savings on a scenario's traffic.
+
+Replays --hours of a scenario's sensors (configs/scenarios, rates from its
+traffic_pattern) compressed by --speedup: one srtp_subscriber session per
+client subscribes reliably to every sensor, once plainly and once with a
+minimum interval, a deadband and/or latest-value-only (prtp_sub_opts_t),
+which srtp_shard_router applies before updates fan out.  Temperatures are
+a slow random walk and device states flip now and then, so the deadband
+has something to drop.  Reports the updates and bytes that reached the
+subscribers, what the router filtered, and the router's CPU time.
+
+Intervals are given in scenario time and scaled with the speedup.
+
+Usage:
+  python run_srtp_filter_test.py --scenario configs/scenarios/smart_agriculture.json
+  python run_srtp_filter_test.py --hours 4 --min-interval-s 600 --deadband 0.5 --latest
+"""
+
+import argparse
+import json
+import os
+import random
+import sys
+import time
+from pathlib import Path
+from typing import Dict, List, Tuple
+
+sys.path.insert(0, str(Path(__file__).parent))
+
+from protocols.SRTP import Protocol
+
+SENSOR_TYPES = ["temp", "device", "gps", "camera"]
+
+
+def _cpu_seconds(pid: int) -> float:
+    """utime + stime of a process, from /proc."""
+    with open(f"/proc/{pid}/stat") as f:
+        fields = f.read().rsplit(")", 1)[1].split()
+    return (int(fields[11]) + int(fields[12])) / os.sysconf("SC_CLK_TCK")
+
+
+def schedule(scenario: Dict, hours: float, speedup: float, seed: int) -> List[Tuple[float, str, Dict]]:
+    """(wall offset s, dev_id, sensor_data) for every reading, in order.
+    Sensor i is the plugin's SENSOR_TYPES[i % 4]_i and takes the rate of
+    the scenario's i-th traffic_pattern entry (cycled)."""
+    rng = random.Random(seed)
+    rates = [p.get("rate_hz", 1.0) for p in scenario.get("traffic_pattern", {}).values()] or [1.0]
+    span = hours * 3600
+    readings = []
+    for i in range(scenario.get("num_clients", 4)):
+        kind, rate = SENSOR_TYPES[i % 4], rates[i % len(rates)]
+        value, t = 22.0 + rng.random(), rng.random() / rate
+        while t < span:
+            if kind == "temp":
+                value += rng.choice([-1, 1]) * rng.random() * 0.15
+                data = {"value": round(value, 2)}
+            elif kind == "device":
+                value = (1 - value) if rng.random() < 0.2 else value
+                data = {"value": bool(round(value))}
+            elif kind == "gps":
+                data = {"latitude": 23.8 + rng.random() / 1e3, "longitude": 90.4 + rng.random() / 1e3}
+            else:
+                data = {}
+            readings.append((t / speedup, f"{kind}_{i}", data))
+            t += 1.0 / rate
+    readings.sort(key=lambda r: r[0])
+    return readings
+
+
+def run_once(args, scenario: Dict, readings, filtered: bool) -> Dict:
+    cfg = {
+        "server_ip": "127.0.0.1", "server_port": args.sensor_port,
+        "client_port": args.sensor_port + 1, "num_clients": scenario.get("num_clients", 4),
+        "subscriber_host": True,
+        # two shards put the router in front of the plain run too
+        "shards": 2, "shard_base_port": args.sensor_port + 1000,
+    }
+    if filtered:
+        cfg.update({
+            "subscriber_min_interval_ms": int(args.min_interval_s * 1000 / args.speedup),
+            "subscriber_deadband": args.deadband,
+            "subscriber_latest": args.latest,
+        })
+    proto = Protocol(cfg)
+    proto.start_server()
+    try:
+        proto.start_clients(cfg["num_clients"])
+        time.sleep(1.0)
+        router_pid = proto._router_process.pid
+        cpu0, t0 = _cpu_seconds(router_pid), time.monotonic()
+        for seq, (due, sid, data) in enumerate(readings, 1):
+            delay = t0 + due - time.monotonic()
+            if delay > 0:
+                time.sleep(delay)
+            proto.send_data("filter", {"dev_id": sid, "seq_no": seq, "sensor_data": data})
+        time.sleep(args.drain)
+        cpu = _cpu_seconds(router_pid) - cpu0
+    finally:
+        proto.stop()
+
+    metrics = proto.get_metrics()
+    host, router = metrics["subscriber_host"], metrics["shard_router"]
+    delivered = host["updates"] - host["empty_updates"]
+    return {
+        "filtered": filtered,
+        "readings": len(readings),
+        "updates_in": router["updates"],
+        "delivered": delivered,
+        "skipped": host.get("skipped", 0),
+        "router_filtered": router["filtered"],
+        "router_coalesced": router["coalesced"],
+        "filtered_bytes": router["filtered_bytes"],
+        "router_cpu_s": round(cpu, 3),
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description="SRTP subscription-option savings")
+    parser.add_argument("--scenario", default="configs/scenarios/smart_agriculture.json")
+    parser.add_argument("--hours", default=1.0, type=float, help="Scenario time to replay")
+    parser.add_argument("--speedup", default=360.0, type=float, help="Scenario seconds per wall second")
+    parser.add_argument("--min-interval-s", default=300.0, type=float, help="Scenario seconds, 0 = off")
+    parser.add_argument("--deadband", default=0.25, type=float, help="Degrees / device state, 0 = off")
+    parser.add_argument("--latest", action="store_true", help="Deliver each interval's newest update")
+    parser.add_argument("--drain", default=1.0, type=float)
+    parser.add_argument("--seed", default=1, type=int)
+    parser.add_argument("--sensor-port", default=5204, type=int)
+    parser.add_argument("--output", default="")
+    args = parser.parse_args()
+
+    scenario = json.loads(Path(args.scenario).read_text())
+    readings = schedule(scenario, args.hours, args.speedup, args.seed)
+    results = [run_once(args, scenario, readings, False), run_once(args, scenario, readings, True)]
+    base = max(1, results[0]["delivered"])
+    print(f"\n{scenario.get('name', args.scenario)}: {len(readings)} readings, "
+          f"{scenario.get('num_clients', 4)} subscribers")
+    print(f"{'':10} {'delivered':>10} {'saved':>7} {'filtered':>9} {'coalesced':>10} {'bytes saved':>12} {'router cpu':>11}")
+    for r in results:
+        print(f"{'options' if r['filtered'] else 'plain':10} {r['delivered']:>10} "
+              f"{100 * (1 - r['delivered'] / base):>6.1f}% {r['router_filtered']:>9} "
+              f"{r['router_coalesced']:>10} {r['filtered_bytes']:>12} {r['router_cpu_s']:>10}s")
+    if args.output:
+        Path(args.output).write_text(json.dumps(results, indent=2))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+"""
+SRTP header compression under impaired links.
+
+Runs reliable SRTP subscriptions through the ImpairmentRelay of
+run_srtp_ack_test.py, once per network profile with plain updates and
+once with compressed ones (srtp_subscriber -H): srtp_shard_router keeps a
+context per client flow and sends each update as an IR or as a CO that
+carries only the seq_no and timestamp deltas and the changed reading
+bytes.  Reports the bytes per update datagram sent downlink (the stock
+server's sid-less opening updates and retransmits included), the plain
+and coded size of the flow updates the router compressed, the updates
+received, and the contexts the subscriber had to resync after a lost IR.
+
+Usage:
+  python run_srtp_hc_test.py --profiles lorawan,agri_bad,wifi
+  python run_srtp_hc_test.py --profiles lorawan --duration 60 --output hc.json
+"""
+
+import argparse
+import json
+import random
+import subprocess
+import sys
+import threading
+import time
+from pathlib import Path
+from typing import Dict
+
+sys.path.insert(0, str(Path(__file__).parent))
+
+from protocols.SRTP import Protocol
+from run_srtp_ack_test import BIN_DIR, PROFILES, ImpairmentRelay
+
+SENSOR_TYPES = ["temp", "device", "gps", "camera"]
+
+
+def _reading(kind: str, rng: random.Random) -> Dict:
+    if kind == "temp":
+        return {"value": round(rng.uniform(18.0, 32.0), 2)}
+    if kind == "device":
+        return {"value": rng.random() < 0.5}
+    if kind == "gps":
+        return {"latitude": round(23.8 + rng.uniform(-1e-3, 1e-3), 6),
+                "longitude": round(90.4 + rng.uniform(-1e-3, 1e-3), 6)}
+    return {}
+
+
+def run_once(args, name: str, profile: Dict, compress: bool) -> Dict:
+    sensors = [f"{SENSOR_TYPES[i % 4]}_{i}" for i in range(args.sessions * args.per_session)]
+    proto = Protocol({
+        "server_ip": "127.0.0.1",
+        "server_port": args.sensor_port,
+        "client_port": args.sensor_port + 1,
+        "shard_base_port": args.base_port,
+        "num_clients": len(sensors),
+        "subscriber_host": True,
+        "subscriber_compress": True,        # always behind the router
+    })
+    proto.start_server()
+    relay = ImpairmentRelay(args.relay_port, ("127.0.0.1", args.sensor_port + 1), profile, args.seed)
+    thread = threading.Thread(target=relay.run, daemon=True)
+    thread.start()
+    host = subprocess.Popen(
+        [str(BIN_DIR / "srtp_subscriber"), "-s", "127.0.0.1", "-p", str(args.relay_port),
+         "-n", str(args.sessions), "-m", str(args.per_session), "-r"]
+        + (["-H"] if compress else []) + sensors,
+        stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, text=True,
+    )
+    rng = random.Random(args.seed)
+    try:
+        time.sleep(3.0)                                  # subscribe over the impaired link
+        end, seq = time.monotonic() + args.duration, 0
+        while time.monotonic() < end:
+            seq += 1
+            for i, sid in enumerate(sensors):
+                proto.send_data("hcbench", {"dev_id": sid, "seq_no": seq,
+                                            "sensor_data": _reading(SENSOR_TYPES[i % 4], rng)})
+            time.sleep(1.0 / args.rate_hz)
+        time.sleep(args.drain)
+    finally:
+        host.send_signal(2)
+        out, _ = host.communicate(timeout=10)
+        relay.close()
+        thread.join(timeout=2)
+        proto.stop()
+
+    lines = [l for l in out.splitlines() if l.startswith("{")]
+    stats = json.loads(lines[-1]) if lines else {}
+    router = proto.get_metrics().get("shard_router", {})
+    # late: reliable retransmits the client had already received
+    received = stats.get("updates", 0) - stats.get("empty_updates", 0) - stats.get("late", 0) \
+        - stats.get("unknown", 0)
+    out_updates = router.get("update_out", 0)
+    return {
+        "profile": name,
+        "compress": compress,
+        "published": seq * len(sensors),
+        "received": received,
+        # every update datagram sent downlink, retransmits and sid-less ones included
+        "update_datagrams": out_updates,
+        "bytes_per_update_datagram": round(router.get("update_bytes", 0) / max(1, out_updates), 1),
+        "flow_raw_bytes_per_update": round(router.get("hc_raw_bytes", 0) / max(1, router.get("hc_updates", 0)), 1),
+        "flow_coded_bytes_per_update": round(router.get("hc_bytes", 0) / max(1, router.get("hc_updates", 0)), 1),
+        "hc_irs": router.get("hc_irs", 0),
+        "hc_resyncs": router.get("hc_resyncs", 0),
+        "hc_damaged": stats.get("hc_damaged", 0),
+        "hc_bad": stats.get("hc_bad", 0),
+        "lost": stats.get("lost"),
+        "lat_p50_ms": stats.get("lat_p50_ms"),
+        "host": stats,
+        "router": router,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description="SRTP plain vs header-compressed updates")
+    parser.add_argument("--profiles", default="lorawan,agri_bad,wifi",
+                        help="Comma-separated configs/network_conditions/<name>.json")
+    parser.add_argument("--sessions", default=8, type=int)
+    parser.add_argument("--per-session", default=4, type=int, help="Reliable sensors per session")
+    parser.add_argument("--rate-hz", default=1.0, type=float, help="Readings per sensor per second")
+    parser.add_argument("--duration", default=20, type=int)
+    parser.add_argument("--drain", default=5.0, type=float, help="Seconds to wait for retransmits")
+    parser.add_argument("--seed", default=1, type=int)
+    parser.add_argument("--sensor-port", default=5304, type=int)
+    parser.add_argument("--relay-port", default=5310, type=int)
+    parser.add_argument("--base-port", default=6300, type=int)
+    parser.add_argument("--output", default="")
+    args = parser.parse_args()
+
+    results = []
+    for name in args.profiles.split(","):
+        profile = json.loads((PROFILES / f"{name}.json").read_text())
+        for compress in (False, True):
+            r = run_once(args, name, profile, compress)
+            results.append(r)
+            print(f"📊 {name} {'compressed' if compress else 'plain':10}: "
+                  f"{r['received']}/{r['published']} received, "
+                  f"{r['bytes_per_update_datagram']} B per downlink update datagram"
+                  + (f", flow updates {r['flow_raw_bytes_per_update']} -> {r['flow_coded_bytes_per_update']} B, "
+                     f"{r['hc_irs']} IRs, {r['hc_resyncs']} resyncs" if compress else ""))
+
+    if args.output:
+        Path(args.output).write_text(json.dumps(results, indent=2))
+        print(f"✓ Results written to {args.output}")
+    else:
+        print(json.dumps([{k: v for k, v in r.items() if k not in ("host", "router")} for r in results],
+                         indent=2))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""
+SRTP multicast fan-out against unicast fan-out.
+
+Runs --sessions srtp_subscriber sessions, each subscribed reliably to all
+--sensors sensors, and feeds every sensor at --reading-hz for --duration
+seconds: once with every subscriber a unicast peer of the server (behind
+srtp_shard_router), once with multicast subscriptions (router -M), where
+the router subscribes once per sensor and sends each update once to the
+sensor's group on loopback, repairing nacked gaps by unicast.  Reports
+the server tier's CPU time and the bytes it sent, the router's CPU time
+and the bytes it sent towards the subscribers, and delivery.
+
+Usage:
+  python run_srtp_multicast_test.py --sessions 200 --sensors 4 --duration 5
+  python run_srtp_multicast_test.py --group 239.255.0.1:7400 --output mcast.json
+"""
+
+import argparse
+import json
+import os
+import sys
+import time
+from pathlib import Path
+from typing import Dict
+
+sys.path.insert(0, str(Path(__file__).parent))
+
+from protocols.SRTP import Protocol
+
+SENSOR_TYPES = ["temp", "device", "gps", "camera"]
+
+
+def _cpu_seconds(pid: int) -> float:
+    """utime + stime of a process, from /proc."""
+    with open(f"/proc/{pid}/stat") as f:
+        fields = f.read().rsplit(")", 1)[1].split()
+    return (int(fields[11]) + int(fields[12])) / os.sysconf("SC_CLK_TCK")
+
+
+def run_once(args, multicast: bool) -> Dict:
+    sensors = [f"{SENSOR_TYPES[i % 4]}_{i}" for i in range(args.sensors)]
+    cfg = {
+        "server_ip": "127.0.0.1", "server_port": args.sensor_port,
+        "client_port": args.sensor_port + 1, "num_clients": args.sensors,
+        "subscriber_host": True,
+        # two shards put the router in front of the unicast run too
+        "shards": 2, "shard_base_port": args.sensor_port + 1000,
+    }
+    if multicast:
+        cfg["srtp_multicast"] = args.group
+    proto = Protocol(cfg)
+    proto.start_server()
+    try:
+        proto.start_clients(args.sessions)
+        time.sleep(args.settle)
+        pids = [p.pid for p in proto._shard_processes]
+        router_pid = proto._router_process.pid
+        server0, router0 = sum(_cpu_seconds(p) for p in pids), _cpu_seconds(router_pid)
+        t0, seq = time.monotonic(), 1
+        while time.monotonic() - t0 < args.duration:
+            for sid in sensors:
+                proto.send_data("mcast", {"dev_id": sid, "seq_no": seq, "sensor_data": {"value": seq}})
+            seq += 1
+            time.sleep(max(0.0, t0 + seq / args.reading_hz - time.monotonic()))
+        time.sleep(args.drain)
+        elapsed = time.monotonic() - t0
+        server_cpu = sum(_cpu_seconds(p) for p in pids) - server0
+        router_cpu = _cpu_seconds(router_pid) - router0
+    finally:
+        proto.stop()
+
+    metrics = proto.get_metrics()
+    host, router = metrics["subscriber_host"], metrics["shard_router"]
+    readings = (seq - 1) * len(sensors)
+    # late: reliable retransmits the client had already received
+    delivered = host["updates"] - host["empty_updates"] - host["cached_updates"] - host["late"]
+    return {
+        "multicast": multicast,
+        "sessions": args.sessions,
+        "readings": readings,
+        "server_cpu_s": round(server_cpu, 3),
+        "server_cpu_pct": round(100 * server_cpu / elapsed, 1),
+        "server_datagrams": router["upstream_in"],
+        "server_bytes": router["upstream_bytes"],
+        "router_cpu_s": round(router_cpu, 3),
+        "egress_datagrams": router["client_out"],
+        "egress_bytes": router["client_bytes"],
+        "mcast_out": router.get("mcast_out", 0),
+        "repairs": router.get("repairs", 0),
+        "delivered": delivered,
+        "delivery_pct": round(100 * delivered / max(1, readings * args.sessions), 1),
+        "lost": host["lost"],
+        "late": host["late"],
+        "nacks": host["nacks"],
+        "repaired": host["repaired"],
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description="SRTP multicast vs unicast fan-out")
+    parser.add_argument("--sessions", default=200, type=int)
+    parser.add_argument("--sensors", default=4, type=int)
+    parser.add_argument("--duration", default=5.0, type=float)
+    parser.add_argument("--reading-hz", default=10.0, type=float, help="Readings per sensor per second")
+    parser.add_argument("--settle", default=2.0, type=float, help="Wait for the sessions to subscribe")
+    parser.add_argument("--drain", default=1.0, type=float)
+    parser.add_argument("--group", default="239.255.0.1:7400", help="First group address and port")
+    parser.add_argument("--sensor-port", default=5204, type=int)
+    parser.add_argument("--output", default="")
+    args = parser.parse_args()
+
+    results = [run_once(args, False), run_once(args, True)]
+    print(f"\n{args.sessions} sessions x {args.sensors} sensors at {args.reading_hz} Hz")
+    print(f"{'':10} {'server cpu':>11} {'server bytes':>13} {'router cpu':>11} "
+          f"{'egress dgrams':>14} {'egress bytes':>13} {'delivered':>10}")
+    for r in results:
+        print(f"{'multicast' if r['multicast'] else 'unicast':10} {r['server_cpu_s']:>10}s "
+              f"{r['server_bytes']:>13} {r['router_cpu_s']:>10}s {r['egress_datagrams']:>14} "
+              f"{r['egress_bytes']:>13} {r['delivery_pct']:>9}%")
+    if args.output:
+        Path(args.output).write_text(json.dumps(results, indent=2))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -18,16 +18,19 @@ _LOG = logging.getLogger("stgen.compare")
 class ProtocolComparator:
     """Compare multiple protocols on identical workloads."""
     
-    def __init__(self, scenario_file: str, protocols: List[str]):
+    def __init__(self, scenario_file: str, protocols: List[str], parallel: bool = False):
         """
         Initialize comparator.
         
         Args:
             scenario_file: Path to scenario config
             protocols: List of protocol names to compare
+            parallel: Run the protocols at once, each in its own network
+                namespace cell (stgen.experiment_cell)
         """
         self.scenario = json.loads(Path(scenario_file).read_text())
         self.protocols = protocols
+        self.parallel = parallel
         self.results: Dict[str, Dict] = {}
         
         _LOG.info("Comparing protocols: %s on scenario: %s", 
@@ -40,6 +43,9 @@ class ProtocolComparator:
         Returns:
             Dict mapping protocol name to results
         """
+        if self.parallel:
+            return self._run_in_cells()
+        
         for protocol in self.protocols:
             _LOG.info("=" * 60)
             _LOG.info("Testing protocol: %s", protocol)
@@ -78,6 +84,19 @@ class ProtocolComparator:
         
         return self.results
     
+    def _run_in_cells(self) -> Dict[str, Any]:
+        """Run all protocols side by side, one network namespace cell each."""
+        from .experiment_cell import run_in_cells
+        
+        cfgs = [dict(self.scenario, protocol=protocol) for protocol in self.protocols]
+        for protocol, summary in zip(self.protocols, run_in_cells(cfgs)):
+            if summary is not None:
+                self.results[protocol] = summary
+                _LOG.info(" %s test completed", protocol)
+            else:
+                _LOG.error(" %s test failed", protocol)
+        return self.results
+    
     def generate_report(self, output_file: str = "comparison_report.txt") -> None:
         """
         Generate comparison report.
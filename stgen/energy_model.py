@@ -36,6 +36,16 @@ class EnergyModel:
     # --------------------------------------------------------------------
 
 
+    def tx_time_s(self, sim_results: Dict[str, Any]) -> float:
+        """
+        Time on air per transmission: measured by a LoRaWAN relay if the run
+        had one (summary "lora_airtime"), else TIME_PER_TX_S.
+        """
+        lora = sim_results.get("lora_airtime") or {}
+        if lora.get("uplinks"):
+            return lora["airtime_per_uplink_ms"] / 1000.0
+        return self.TIME_PER_TX_S
+
     def estimate_battery_life(self, 
                              traffic_pattern: Dict[str, Any], 
                              sim_results: Dict[str, Any], 
@@ -82,7 +92,7 @@ class EnergyModel:
         # --- (Rest of the function is the same) ---
         
         # 2. Calculate total time (in seconds) spent PER DAY in each state
-        total_time_tx_s = total_events_per_day * self.TIME_PER_TX_S
+        total_time_tx_s = total_events_per_day * self.tx_time_s(sim_results)
         total_time_rx_s = total_events_per_day * self.TIME_PER_RX_S
         total_time_idle_s = total_events_per_day * self.TIME_IDLE_PER_EVENT_S
         
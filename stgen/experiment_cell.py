@@ -0,0 +1,203 @@
+##! @file experiment_cell.py
+##! @brief Network-namespace test cells for running experiments side by side
+##!
+##! @details
+##! Runs on one host share loopback ports, the tc rules NetworkEmulator puts
+##! on "lo" and the CPUs, so comparisons and sweeps used to go one at a time.
+##! An ExperimentCell is a network namespace of its own: its own lo (so the
+##! same ports and the same interface-wide tc/netem rules can be used in
+##! every cell), a veth pair to the host on 10.231.<index>.0/30, and a CPU
+##! set everything run in it is pinned to.  A run started in a cell
+##! (stgen.main, server and clients alike) applies its profile inside it.
+##!
+##! run_in_cells() runs a list of configs this way, as many at once as
+##! there are CPU sets, each with its own results_dir and work_dir.
+##! Creating namespaces needs root (or sudo); without it the configs run
+##! one after the other as before.
+##!
+##! @author STGen Development Team
+##! @version 2.0
+##! @date 2024
+
+import os
+import sys
+import json
+import shutil
+import logging
+import tempfile
+import subprocess
+import time
+from pathlib import Path
+from typing import Any, Dict, List, Optional, Sequence
+
+_LOG = logging.getLogger("experiment_cell")
+
+_ROOT = Path(__file__).resolve().parent.parent
+CELL_NET = "10.231"                ##! Cell i gets CELL_NET.i.0/30: .1 on the host, .2 inside
+
+
+def _priv(cmd: List[str]) -> List[str]:
+    return cmd if os.geteuid() == 0 else ["sudo"] + cmd
+
+
+def _kill(proc: subprocess.Popen):
+    # under sudo the group is root's and the run sits in sudo's own session:
+    # whatever this cannot reach, ExperimentCell.destroy() kills in the namespace
+    try:
+        os.killpg(proc.pid, 9)
+    except (ProcessLookupError, PermissionError):
+        pass
+    proc.wait()
+
+
+def cells_available() -> bool:
+    ##! @brief Whether namespaces can be made here (ip found, root or sudo)
+    return shutil.which("ip") is not None and (os.geteuid() == 0 or shutil.which("sudo") is not None)
+
+
+class ExperimentCell:
+    ##! @class ExperimentCell
+    ##! @brief One network namespace with a veth pair to the host and a CPU set
+
+    def __init__(self, index: int, cpus: Optional[Sequence[int]] = None):
+        ##! @param index Cell number, 0-254; picks the subnet and device names
+        ##! @param cpus CPUs everything run in the cell is pinned to (None: all)
+        if not 0 <= index < 255:
+            raise ValueError(f"cell index out of range: {index}")
+        self.index = index
+        self.cpus = sorted(cpus) if cpus else None
+        tag = f"{os.getpid() % 100000}x{index}"
+        self.name = f"stgen-{tag}"
+        self.host_dev, self.cell_dev = f"sth{tag}", f"stc{tag}"   # 15 characters at most
+        self.host_ip = f"{CELL_NET}.{index}.1"
+        self.ip = f"{CELL_NET}.{index}.2"
+        self.created = False
+
+    def create(self) -> "ExperimentCell":
+        ##! @brief Make the namespace, its lo and the veth pair
+        ##! @return self
+        ns = ["ip", "-n", self.name]
+        steps = [
+            ["ip", "netns", "add", self.name],
+            ["ip", "link", "add", self.host_dev, "type", "veth", "peer", "name", self.cell_dev,
+             "netns", self.name],
+            ["ip", "addr", "add", f"{self.host_ip}/30", "dev", self.host_dev],
+            ["ip", "link", "set", self.host_dev, "up"],
+            ns + ["link", "set", "lo", "up"],
+            ns + ["addr", "add", f"{self.ip}/30", "dev", self.cell_dev],
+            ns + ["link", "set", self.cell_dev, "up"],
+            ns + ["route", "add", "default", "via", self.host_ip],
+        ]
+        try:
+            for step in steps:
+                subprocess.run(_priv(step), check=True, capture_output=True, text=True)
+                self.created = True
+        except subprocess.CalledProcessError as e:
+            self.destroy()
+            raise RuntimeError(f"cell {self.name}: {' '.join(e.cmd)}: {e.stderr.strip()}") from e
+        _LOG.info("Cell %s: %s <-> %s, cpus %s", self.name, self.host_ip, self.ip, self.cpus or "all")
+        return self
+
+    def command(self, cmd: List[str]) -> List[str]:
+        ##! @brief cmd as run inside the cell, pinned to its CPUs
+        pin = ["taskset", "-c", ",".join(map(str, self.cpus))] if self.cpus else []
+        return _priv(["ip", "netns", "exec", self.name] + pin + cmd)
+
+    def popen(self, cmd: List[str], **kwargs) -> subprocess.Popen:
+        ##! @brief Start cmd inside the cell (Popen keyword arguments pass through)
+        return subprocess.Popen(self.command(cmd), **kwargs)
+
+    def run(self, cmd: List[str], **kwargs) -> subprocess.CompletedProcess:
+        ##! @brief Run cmd inside the cell to completion
+        return subprocess.run(self.command(cmd), **kwargs)
+
+    def destroy(self):
+        ##! @brief Kill what still runs in the namespace and remove it; its end of
+        ##! the veth pair takes the other along
+        if self.created:
+            pids = subprocess.run(_priv(["ip", "netns", "pids", self.name]),
+                                  capture_output=True, text=True).stdout.split()
+            if pids:
+                subprocess.run(_priv(["kill", "-9"] + pids), capture_output=True)
+            subprocess.run(_priv(["ip", "netns", "del", self.name]), capture_output=True)
+            subprocess.run(_priv(["ip", "link", "del", self.host_dev]), capture_output=True)
+            self.created = False
+
+    def __enter__(self) -> "ExperimentCell":
+        return self.create()
+
+    def __exit__(self, *exc):
+        self.destroy()
+
+
+def run_in_cells(cfgs: List[Dict[str, Any]], cpus_per_cell: int = 1, max_cells: Optional[int] = None,
+                 timeout: Optional[float] = None) -> List[Optional[Dict[str, Any]]]:
+    ##! @brief Run each config through stgen.main, as many at once as there are CPU sets
+    ##! @param cfgs Run configs (as for stgen.main); results_dir and work_dir are set here
+    ##! @param cpus_per_cell CPUs given to each run
+    ##! @param max_cells Runs at once if not one per CPU set; cells then share the sets
+    ##! @param timeout Seconds one run may take
+    ##! @return summary.json of each run, in order, or None where a run failed
+    cpus = sorted(os.sched_getaffinity(0))
+    sets = [cpus[i:i + cpus_per_cell] for i in range(0, len(cpus) - cpus_per_cell + 1, cpus_per_cell)]
+    sets = sets or [cpus]
+    sets = [sets[k % len(sets)] for k in range(max_cells or len(sets))]
+    stamp = int(time.time())
+    scratch = Path(tempfile.mkdtemp(prefix="stgen_cells_"))
+    parallel = cells_available()
+    if not parallel:
+        _LOG.warning("Network namespaces unavailable (need ip and root): running one at a time")
+        sets = [None]
+
+    runs = []
+    for i, cfg in enumerate(cfgs):
+        cfg = dict(cfg)
+        cfg["results_dir"] = str(_ROOT / "results" / "cells" / f"{stamp}_{i}_{cfg.get('protocol', 'run')}")
+        cfg["work_dir"] = str(scratch / f"run{i}")
+        path = scratch / f"run{i}.json"
+        path.write_text(json.dumps(cfg, indent=2))
+        runs.append((cfg, path))
+
+    results: List[Optional[Dict[str, Any]]] = [None] * len(runs)
+    pending = list(enumerate(runs))
+    active: Dict[int, Any] = {}           # slot -> (run index, cell, process, started, log)
+    free = list(range(len(sets)))
+    try:
+        while pending or active:
+            while pending and free:
+                slot = free.pop(0)
+                i, (cfg, path) = pending.pop(0)
+                cmd = [sys.executable, "-m", "stgen.main", str(path)]
+                cell = ExperimentCell(slot, sets[slot]).create() if parallel else None
+                log = open(scratch / f"run{i}.log", "w")
+                # a session of its own, so a timed-out run goes with its servers and clients
+                kw = dict(cwd=str(_ROOT), stdout=log, stderr=subprocess.STDOUT, start_new_session=True)
+                proc = cell.popen(cmd, **kw) if cell else subprocess.Popen(cmd, **kw)
+                _LOG.info("Run %d (%s) started%s", i, cfg.get("protocol"),
+                          f" in cell {cell.name}" if cell else "")
+                active[slot] = (i, cell, proc, time.monotonic(), log)
+            time.sleep(0.1)
+            for slot, (i, cell, proc, started, log) in list(active.items()):
+                if proc.poll() is None:
+                    if timeout is None or time.monotonic() - started < timeout:
+                        continue
+                    _LOG.error("Run %d timed out", i)
+                    _kill(proc)
+                log.close()
+                summary = Path(runs[i][0]["results_dir"]) / "summary.json"
+                if proc.returncode == 0 and summary.exists():
+                    results[i] = json.loads(summary.read_text())
+                else:
+                    _LOG.error("Run %d failed (exit %s), log: %s", i, proc.returncode,
+                               scratch / f"run{i}.log")
+                if cell:
+                    cell.destroy()
+                del active[slot]
+                free.append(slot)
+    finally:
+        for i, cell, proc, _, log in active.values():
+            _kill(proc)
+            log.close()
+            if cell:
+                cell.destroy()
+    return results
@@ -3,7 +3,7 @@
 ##! 
 ##! @details
 ##! Simulates realistic network failures and client crashes:
-##! - Packet loss (random or targeted)
+##! - Packet loss (random, targeted or Gilbert-Elliott bursts)
 ##! - Client crashes and recoveries
 ##! - Network partitions
 ##! - Data corruption
@@ -19,6 +19,8 @@ import logging
 from typing import Dict, Any, List, Optional
 from dataclasses import dataclass
 
+from .gilbert_elliott import GilbertElliott
+
 _LOG = logging.getLogger("failure_injector")
 
 
@@ -53,6 +55,8 @@ class FailureInjector:
         Args:
             cfg: Configuration with 'failure_injection' section:
                 - packet_loss: float (0.0-1.0)
+                - burst_loss: {p, q, loss_bad} or {conf, row} (Gilbert-Elliott,
+                  per client; replaces packet_loss)
                 - client_crashes: List[int] (times in seconds)
                 - network_partition: {start_sec, duration_sec}
                 - message_corruption: float (0.0-1.0)
@@ -67,6 +71,9 @@ class FailureInjector:
         
         self.packet_loss_rate = fi_cfg.get("packet_loss", top_loss)
         self.corruption_rate = fi_cfg.get("message_corruption", 0.0)
+        burst_cfg = fi_cfg.get("burst_loss")
+        self.burst_loss = GilbertElliott.from_config(burst_cfg) if burst_cfg else None
+        self.burst_links: Dict[str, GilbertElliott] = {}
         
         self.crash_times = fi_cfg.get("client_crashes", [])
         self.partition_cfg = self.cfg.get("network_partition", None)
@@ -124,9 +131,16 @@ class FailureInjector:
                 _LOG.debug(" Packet dropped: network partition active")
                 return True
         
-        # Random packet loss
-        if random.random() < self.packet_loss_rate:
-            _LOG.debug(" Packet dropped: random loss")
+        # Bursty (per-client Gilbert-Elliott link) or random packet loss
+        if self.burst_loss:
+            link = self.burst_links.get(client_id)
+            if link is None:
+                link = self.burst_links[client_id] = self.burst_loss.spawn()
+            lost = link.lose()
+        else:
+            lost = random.random() < self.packet_loss_rate
+        if lost:
+            _LOG.debug(" Packet dropped: %s loss", "burst" if self.burst_loss else "random")
             self.events.append(FailureEvent(
                 time_sec=elapsed,
                 failure_type="packet_loss",
@@ -306,6 +320,10 @@ class FailureInjector:
                 for e in self.events[:50]  # Limit to first 50 events
             ]
         }
+        if self.burst_loss:
+            for link in self.burst_links.values():
+                link.end_burst()
+            summary["burst_loss"] = self.burst_loss.report()
         
         return summary
 
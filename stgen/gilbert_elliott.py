@@ -0,0 +1,134 @@
+##! @file gilbert_elliott.py
+##! @brief Gilbert-Elliott burst loss for in-process protocol adapters
+##!
+##! @details
+##! The Python side of protocols/SRTP/srtp_ge.h, which srtp_impair and
+##! srtp_sim use on the wire: same model, same conf tables and profile
+##! keys, same report.  A link is good or bad; before each packet it moves
+##! good->bad with p and bad->good with q, and a packet is lost in the bad
+##! state with loss_bad (1 in the conf/test*.conf "delay(ms) p_prob q_prob"
+##! rows).  Loss bursts are geometric with continuation c = (1 - q) * loss_bad.
+##!
+##! @author STGen Development Team
+##! @version 2.0
+##! @date 2024
+
+import json
+import random
+from pathlib import Path
+from typing import Any, Dict, List, Optional, Tuple
+
+HIST = 16                          ##! Burst-length buckets, the last one is HIST or more
+
+_CONF_DIR = Path(__file__).resolve().parent.parent / "protocols" / "SRTP" / "conf"
+
+
+def load_conf(path: str) -> List[Tuple[float, float, float]]:
+    ##! @brief Rows of a conf/test*.conf table as (delay_ms, p, q)
+    ##! @param path Table path; a bare name is looked up in protocols/SRTP/conf
+    conf = Path(path)
+    if not conf.exists() and "/" not in path:
+        conf = _CONF_DIR / path
+    rows = []
+    for line in conf.read_text().splitlines():
+        fields = line.split()
+        if len(fields) < 3 or line.startswith("#"):
+            continue
+        rows.append((float(fields[0]), float(fields[1]), float(fields[2])))
+    return rows
+
+
+class BurstStats:
+    ##! @class BurstStats
+    ##! @brief Packets, losses and loss-burst lengths, shared by the links of one model
+
+    def __init__(self):
+        self.packets = 0
+        self.lost = 0
+        self.bursts = [0] * HIST
+
+
+class GilbertElliott:
+    ##! @class GilbertElliott
+    ##! @brief One link's two-state loss process
+
+    def __init__(self, p: float, q: float, loss_bad: float = 1.0,
+                 stats: Optional[BurstStats] = None, rng: Optional[random.Random] = None):
+        ##! @param stats Shared counters; a fresh one if omitted
+        if not (0 <= p <= 1 and 0 <= q <= 1 and 0 <= loss_bad <= 1):
+            raise ValueError(f"Gilbert-Elliott parameters out of range: p={p} q={q} loss_bad={loss_bad}")
+        self.p, self.q, self.loss_bad = p, q, loss_bad
+        self.stats = stats or BurstStats()
+        self.rng = rng or random.Random()
+        self.bad = False
+        self.run = 0
+        self.delay_ms = 0.0        ##! A conf row's delay column, for the caller to apply
+
+    @classmethod
+    def from_conf(cls, path: str, row: int, **kw) -> "GilbertElliott":
+        ##! @brief Model of row (from 0) of a conf/test*.conf table
+        delay_ms, p, q = load_conf(path)[row]
+        engine = cls(p, q, **kw)
+        engine.delay_ms = delay_ms
+        return engine
+
+    @classmethod
+    def from_profile(cls, profile: Any, **kw) -> Optional["GilbertElliott"]:
+        ##! @brief Model of a network profile's gilbert_p/gilbert_q/gilbert_loss_bad
+        ##! @param profile Profile dict or JSON path
+        ##! @return None if the profile has no burst loss
+        if not isinstance(profile, dict):
+            profile = json.loads(Path(profile).read_text())
+        p, q = profile.get("gilbert_p", 0.0), profile.get("gilbert_q", 0.0)
+        if not (p or q):
+            return None
+        return cls(p, q, profile.get("gilbert_loss_bad", 1.0), **kw)
+
+    @classmethod
+    def from_config(cls, spec: Dict[str, Any], **kw) -> "GilbertElliott":
+        ##! @brief Model of {"p", "q"[, "loss_bad"]} or {"conf", "row"}
+        if "conf" in spec:
+            return cls.from_conf(spec["conf"], int(spec.get("row", 0)), **kw)
+        return cls(spec["p"], spec["q"], spec.get("loss_bad", 1.0), **kw)
+
+    def spawn(self) -> "GilbertElliott":
+        ##! @brief Another link with the same parameters and shared counters
+        engine = GilbertElliott(self.p, self.q, self.loss_bad, self.stats, self.rng)
+        engine.delay_ms = self.delay_ms
+        return engine
+
+    def lose(self) -> bool:
+        ##! @brief Move one packet on
+        ##! @return True if that packet is lost
+        self.bad = self.rng.random() >= self.q if self.bad else self.rng.random() < self.p
+        lost = self.bad and (self.loss_bad >= 1 or self.rng.random() < self.loss_bad)
+        self.stats.packets += 1
+        if lost:
+            self.stats.lost += 1
+            self.run += 1
+        else:
+            self.end_burst()
+        return lost
+
+    def end_burst(self) -> None:
+        ##! @brief Count the burst in progress, e.g. when the link goes away
+        if self.run:
+            self.stats.bursts[min(self.run, HIST) - 1] += 1
+        self.run = 0
+
+    def report(self) -> Dict[str, Any]:
+        ##! @brief Configured against observed loss and burst lengths, as srtp_ge_print
+        st = self.stats
+        c = (1 - self.q) * self.loss_bad
+        bursts = sum(st.bursts)
+        pmf = [(1 - c) * c ** i for i in range(HIST - 1)] + [c ** (HIST - 1)]
+        return {
+            "p": self.p, "q": self.q, "loss_bad": self.loss_bad,
+            "packets": st.packets, "lost": st.lost,
+            "configured_loss": round(self.loss_bad * self.p / (self.p + self.q), 4) if self.p + self.q else 0.0,
+            "observed_loss": round(st.lost / st.packets, 4) if st.packets else 0.0,
+            "configured_mean_burst": round(1 / (1 - c), 3) if c < 1 else 0.0,
+            "observed_mean_burst": round(st.lost / bursts, 3) if bursts else 0.0,
+            "bursts": list(st.bursts),
+            "configured_bursts": [round(bursts * x, 1) for x in pmf],
+        }
@@ -66,6 +66,9 @@ def parse_arguments():
             # Compare protocols
             python -m stgen.main --compare coap,srtp --scenario industrial_iot
             
+            # ... side by side, one network namespace each (needs root)
+            python -m stgen.main --compare coap,srtp --scenario industrial_iot --parallel
+            
             # List available scenarios
             python -m stgen.main --list-scenarios
             
@@ -78,6 +81,8 @@ def parse_arguments():
     parser.add_argument("--scenario", help="Use predefined scenario (e.g., smart_home)")
     parser.add_argument("--protocol", help="Protocol to test")
     parser.add_argument("--compare", help="Comma-separated list of protocols to compare")
+    parser.add_argument("--parallel", action="store_true",
+                        help="With --compare, run the protocols at once in network namespace cells")
     parser.add_argument("--list-scenarios", action="store_true", help="List available scenarios")
     parser.add_argument("--list-protocols", action="store_true", help="List available protocols")
     parser.add_argument("--validate", action="store_true", help="Run validation checks on results")
@@ -143,7 +148,14 @@ def run_single_test(cfg: dict) -> bool:
     
     try:
         # --- 1. START NETWORK EMULATOR ---
-        if "network_profile" in cfg:
+        if "network_mix" in cfg and cfg.get("network_emulation") != "relay":
+            # per-device profiles: one HTB class + netem leaf per device port
+            # (device_base_port + i), all installed by a single tc -batch
+            from .network_emulator import NetworkEmulator
+            emulator = NetworkEmulator.from_mix(cfg["network_mix"],
+                                                int(cfg.get("device_base_port", 30000)),
+                                                interface="lo")
+        elif "network_profile" in cfg:
             profile_name = cfg['network_profile']
             _LOG.info(f"Applying network profile: {profile_name}")
             
@@ -151,11 +163,16 @@ def run_single_test(cfg: dict) -> bool:
             # (Your configs are in 'networks/', not 'networks_conditions/')
             profile_path = f"configs/network_conditions/{profile_name}.json"
             
-            # Import here to avoid circular dependency
-            from .network_emulator import NetworkEmulator 
-            
-            # Use 'lo' for local testing (requires sudo)
-            emulator = NetworkEmulator.from_profile(profile_path, interface="lo")
+            if cfg.get("network_emulation") == "relay":
+                # per-flow user-space relay (bin/srtp_impair), started by
+                # protocols that support it in front of their client port
+                _LOG.info("Network profile applied by the protocol's relay")
+            else:
+                # Import here to avoid circular dependency
+                from .network_emulator import NetworkEmulator 
+                
+                # Use 'lo' for local testing (requires sudo)
+                emulator = NetworkEmulator.from_profile(profile_path, interface="lo")
         
         # --- 2. CREATE ORCHESTRATOR ---
         orch = Orchestrator(cfg["protocol"], cfg)
@@ -214,6 +231,9 @@ def run_single_test(cfg: dict) -> bool:
             scenario_name = scenario_name.replace('.json', '')
             
         out_dir = Path("results") / f"{cfg['protocol']}_{scenario_name}_{timestamp}"
+        if cfg.get("results_dir"):
+            # set by run_in_cells, whose runs finish side by side
+            out_dir = Path(cfg["results_dir"])
         
         orch.save_report(out_dir)
         _LOG.info("Test completed successfully")
@@ -221,7 +241,7 @@ def run_single_test(cfg: dict) -> bool:
     else:
         _LOG.error("Test failed - no results saved")
         return False
-def run_comparison(protocols: list, scenario_cfg: dict):
+def run_comparison(protocols: list, scenario_cfg: dict, parallel: bool = False):
     """Run comparison of multiple protocols."""
     from .comparator import ProtocolComparator
     
@@ -232,7 +252,7 @@ def run_comparison(protocols: list, scenario_cfg: dict):
     temp_scenario.write_text(json.dumps(scenario_cfg, indent=2))
     
     try:
-        comparator = ProtocolComparator(str(temp_scenario), protocols)
+        comparator = ProtocolComparator(str(temp_scenario), protocols, parallel)
         comparator.run_comparison()
         
         # Generate report
@@ -303,7 +323,7 @@ def main():
     # Run comparison or single test
     if args.compare:
         protocols = [p.strip() for p in args.compare.split(",")]
-        run_comparison(protocols, cfg)
+        run_comparison(protocols, cfg, args.parallel)
     else:
         success = run_single_test(cfg)
         sys.exit(0 if success else 1)
@@ -2,25 +2,42 @@
 ##! @brief Network Condition Emulation Module
 ##! 
 ##! @details
-##! Provides realistic network condition emulation using Linux tc (traffic control).
+##! Provides realistic network condition emulation using Linux tc (traffic control),
+##! or without root through the bin/srtp_impair relay (NetworkRelay).
 ##! Supports:
 ##! - Latency simulation (constant + jitter)
 ##! - Packet loss injection
-##! - Bandwidth throttling
+##! - Packet corruption (relay only)
+##! - Bandwidth throttling (per flow with the relay)
 ##! - JSON profile-based configuration
+##! - Per-device profiles in one run (HTB classes, netem leaves, flower filters)
 ##!
 ##! @author STGen Development Team
 ##! @version 2.0
 ##! @date 2024
 
 import subprocess
+import signal
 import logging
 import json
 from pathlib import Path
-from typing import Dict, Any
+from typing import Dict, Any, List, Optional
 
 _LOG = logging.getLogger("network_emulator")
 
+_ROOT = Path(__file__).resolve().parent.parent
+PROFILE_DIR = _ROOT / "configs" / "network_conditions"
+HTB_MAX_RATE = "10gbit"            ##! Class rate of unshaped profiles and unmatched traffic
+RELAY_BIN = _ROOT / "bin" / "srtp_impair"
+
+
+def profile_path(profile: str) -> Path:
+    ##! @brief Resolve a profile name ("lorawan") or path to its JSON file
+    path = Path(profile)
+    if path.suffix != ".json" and "/" not in profile:
+        path = PROFILE_DIR / f"{profile}.json"
+    return path
+
 
 class NetworkEmulator:
     ##! @class NetworkEmulator
@@ -35,6 +52,7 @@ class NetworkEmulator:
         self.interface = interface
         self.enabled = False
         self.profile_name = None
+        self.devices: List[Dict[str, Any]] = []   ##! Ports, profile and class of each mix entry
     
     @classmethod
     def from_profile(cls, profile_path: str, interface: str = "eth0"):
@@ -54,7 +72,13 @@ class NetworkEmulator:
         
         emulator.profile_name = profile.get("name", "Unknown")
         _LOG.info("Applied profile: %s", emulator.profile_name)
-        
+        if "trace" in profile:
+            _LOG.warning("Profile trace %s ignored: time-varying conditions need "
+                         "network_emulation 'relay' (srtp_impair)", profile["trace"])
+        if "lora_sf" in profile:
+            _LOG.warning("Profile LoRaWAN channel ignored: time on air and duty cycle "
+                         "need network_emulation 'relay' (srtp_impair)")
+
         return emulator
     
     def apply_conditions(self, latency_ms: int = 0, jitter_ms: int = 0,
@@ -90,6 +114,90 @@ class NetworkEmulator:
             _LOG.error("Failed to apply network conditions: %s", e)
             _LOG.error("Make sure you run with sudo or have CAP_NET_ADMIN")
     
+    @classmethod
+    def from_mix(cls, mix: List[Dict[str, Any]], base_port: int = 30000,
+                 interface: str = "lo", ip_proto: str = "udp"):
+        ##! @brief Give each device (or port range) of a mix its own profile
+        ##! @param mix Entries {"profile", "devices": n} (one class per device,
+        ##!        on ports base_port, base_port + 1, ... in mix order) or
+        ##!        {"profile", "ports": [first, last]} (one class for the range)
+        ##! @param base_port Port of the first device, e.g. srtp_subscriber -b
+        ##! @return NetworkEmulator with the whole tree installed by one tc -batch
+        emulator = cls(interface)
+        emulator.apply_batch(emulator.mix_batch(mix, base_port, ip_proto))
+        emulator.profile_name = "+".join(e["profile"] for e in mix)
+        return emulator
+
+    def mix_batch(self, mix: List[Dict[str, Any]], base_port: int = 30000,
+                  ip_proto: str = "udp") -> str:
+        ##! @brief tc -batch commands for a mix (see from_mix), without running them
+        ##! @details
+        ##! An HTB root whose default class 1:1 leaves unmatched traffic alone;
+        ##! per class an HTB class for bandwidth_kbps with a netem leaf for
+        ##! latency, jitter and loss, and two flower filters, one on the source
+        ##! and one on the destination port, so both directions of a device
+        ##! pass its class.  Exact-port filters share one flower mask, which
+        ##! the kernel hashes, so thousands of devices classify in O(1).
+        dev = self.interface
+        lines = [f"qdisc add dev {dev} root handle 1: htb default 1",
+                 f"class add dev {dev} parent 1: classid 1:1 htb rate {HTB_MAX_RATE}"]
+        profiles: Dict[str, Dict[str, Any]] = {}
+        self.devices = []
+        port, minor = base_port, 2
+        for entry in mix:
+            name = entry["profile"]
+            if name not in profiles:
+                profiles[name] = json.loads(profile_path(name).read_text())
+            if "ports" in entry:
+                first, last = entry["ports"]
+                ranges = [(first, last)]
+            else:
+                ranges = [(p, p) for p in range(port, port + int(entry["devices"]))]
+                port += len(ranges)
+            for first, last in ranges:
+                if minor > 0xffff or not 0 < first <= last <= 65535:
+                    raise ValueError(f"Network mix entry out of range: {entry}")
+                ports = str(first) if first == last else f"{first}-{last}"
+                lines += self._class_batch(minor, profiles[name], ports, ip_proto)
+                self.devices.append({"ports": ports, "profile": name, "classid": f"1:{minor:x}"})
+                minor += 1
+        return "\n".join(lines) + "\n"
+
+    def _class_batch(self, minor: int, profile: Dict[str, Any], ports: str,
+                     ip_proto: str) -> List[str]:
+        ##! @brief HTB class, netem leaf and filters of one device or port range
+        dev, cid = self.interface, f"1:{minor:x}"
+        kbps = profile.get("bandwidth_kbps", 0)
+        rate = f"{kbps}kbit" if kbps > 0 else HTB_MAX_RATE
+        netem = f"qdisc add dev {dev} parent {cid} handle {minor:x}: netem"
+        if profile.get("latency_ms", 0) > 0:
+            netem += f" delay {profile['latency_ms']}ms"
+            if profile.get("jitter_ms", 0) > 0:
+                netem += f" {profile['jitter_ms']}ms"
+        if profile.get("loss_percent", 0) > 0:
+            netem += f" loss {profile['loss_percent']}%"
+        if profile.get("corruption_percent", 0) > 0:
+            netem += f" corrupt {profile['corruption_percent']}%"
+        match = f"filter add dev {dev} parent 1: protocol ip prio 1 flower ip_proto {ip_proto}"
+        return [f"class add dev {dev} parent 1: classid {cid} htb rate {rate} ceil {rate}",
+                netem,
+                f"{match} src_port {ports} classid {cid}",
+                f"{match} dst_port {ports} classid {cid}"]
+
+    def apply_batch(self, batch: str):
+        ##! @brief Replace the interface's qdiscs with a tc -batch script in one tc run
+        try:
+            subprocess.run(
+                ["sudo", "tc", "qdisc", "del", "dev", self.interface, "root"],
+                stderr=subprocess.DEVNULL
+            )
+            subprocess.run(["sudo", "tc", "-batch", "-"], input=batch, text=True, check=True)
+            self.enabled = True
+            _LOG.info(" Network mix: %d tc commands on %s", batch.count("\n"), self.interface)
+        except (subprocess.CalledProcessError, FileNotFoundError) as e:
+            _LOG.error("Failed to apply network mix: %s", e)
+            _LOG.error("Make sure you run with sudo or have CAP_NET_ADMIN")
+
     def clear(self):
         """Remove network emulation."""
         if self.enabled:
@@ -97,4 +205,58 @@ class NetworkEmulator:
                 ["sudo", "tc", "qdisc", "del", "dev", self.interface, "root"],
                 stderr=subprocess.DEVNULL
             )
-            _LOG.info("Network emulation cleared")
\ No newline at end of file
+            _LOG.info("Network emulation cleared")
+
+
+class NetworkRelay:
+    ##! @class NetworkRelay
+    ##! @brief User-space alternative to NetworkEmulator (bin/srtp_impair)
+    ##! @details
+    ##! Relays listen_port to an upstream address and applies a profile's
+    ##! latency, jitter, loss, corruption and bandwidth to every flow (a UDP
+    ##! client address or a TCP connection) on its own, half of the latency
+    ##! each way.  Needs no root and leaves the interface alone; clients
+    ##! must be pointed at the relay port instead of the server.
+    ##! Build with: make -C protocols/SRTP
+
+    def __init__(self, profile: str, listen_port: int, upstream_port: int,
+                 upstream_ip: str = "127.0.0.1", tcp: bool = False,
+                 listen_ip: str = "127.0.0.1", extra_args: Optional[List[str]] = None):
+        ##! @brief Describe a relay; start() launches it
+        ##! @param profile Profile name in configs/network_conditions, or a JSON path
+        ##! @param extra_args More srtp_impair options, e.g. ["-a"] for one shared link
+        self.profile = profile_path(profile)
+        self.listen_port = listen_port
+        self.cmd = [str(RELAY_BIN), "-i", listen_ip, "-l", str(listen_port),
+                    "-u", f"{upstream_ip}:{upstream_port}", "-P", str(self.profile)]
+        if tcp:
+            self.cmd.append("-t")
+        self.cmd += extra_args or []
+        self.process: Optional[subprocess.Popen] = None
+        self.stats: Dict[str, Any] = {}
+
+    def start(self) -> "NetworkRelay":
+        ##! @brief Launch srtp_impair
+        if not RELAY_BIN.exists():
+            raise FileNotFoundError(f"srtp_impair not found: {RELAY_BIN}\n"
+                                    "Run: make -C protocols/SRTP")
+        if not self.profile.exists():
+            raise FileNotFoundError(f"Network profile not found: {self.profile}")
+        self.process = subprocess.Popen(self.cmd, stdout=subprocess.PIPE,
+                                        stderr=subprocess.PIPE, text=True)
+        _LOG.info(" Network relay on port %d with %s (PID: %d)",
+                  self.listen_port, self.profile.stem, self.process.pid)
+        return self
+
+    def stop(self) -> Dict[str, Any]:
+        ##! @brief Stop the relay
+        ##! @return Its summary: packets in and out per direction, drops, in flight
+        if self.process and self.process.poll() is None:
+            self.process.send_signal(signal.SIGINT)
+            try:
+                out, _ = self.process.communicate(timeout=5)
+                lines = out.strip().splitlines()
+                self.stats = json.loads(lines[-1]) if lines else {}
+            except Exception:
+                self.process.kill()
+        return self.stats
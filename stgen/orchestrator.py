@@ -65,6 +65,8 @@ class Orchestrator:
             _LOG.error(f"Failed to load protocol '{protocol_name}'")
             raise RuntimeError(f"Protocol load error: {e}")
         
+        self._failures_applied = False
+        
         # Metrics storage
         self.metrics: Dict[str, Any] = {
             "sent": 0,
@@ -81,6 +83,7 @@ class Orchestrator:
         # Monkey patch the send_data method of the protocol instance
         original_send = self.protocol.send_data
         self.protocol.send_data = wrap_send_with_failures(original_send, injector)
+        self._failures_applied = True
 
     def run_test(self, stream: Iterable[Tuple[str, Dict, float]]) -> bool:
         """
@@ -130,6 +133,16 @@ class Orchestrator:
             time.sleep(duration)
             return True
         
+        # Protocols with a native feeder pace the stream themselves, unless
+        # failure injection has wrapped send_data() and needs every message
+        fed = None if self._failures_applied else self.protocol.feed_stream(stream)
+        if fed is not None:
+            # fed counts the datagrams the socket took, which is what a
+            # send_data() returning ok counts as received
+            self.metrics["sent"] += fed
+            self.metrics["recv"] += fed
+            return True
+        
         # Initialize drift compensation
         # time.perf_counter() is monotonic and suitable for measuring intervals
         next_wake_time = time.perf_counter()
@@ -235,6 +248,18 @@ class Orchestrator:
             summary["lat_p50_ms"] = lat[len(lat) // 2]
             summary["lat_p95_ms"] = lat[int(len(lat) * 0.95)]
         
+        # Protocols that measure delivery latency at the subscriber report
+        # it in the same lat_*_ms terms; it replaces the send-side figures
+        proto_lat = self.protocol.get_metrics().get("latency", {})
+        if proto_lat:
+            summary.update(proto_lat)
+            summary["lat_source"] = "protocol"
+        
+        # A LoRaWAN relay measured the time on air; EnergyModel uses it
+        lora = self.protocol.get_metrics().get("network_relay", {}).get("lora")
+        if lora:
+            summary["lora_airtime"] = lora
+        
         # Save summary
         (out_dir / "summary.json").write_text(json.dumps(summary, indent=2))
         
@@ -248,5 +273,5 @@ class Orchestrator:
         
         _LOG.info(f"Report saved to {out_dir}/")
         _LOG.info(f"  Sent: {summary['sent']}, Recv: {summary['recv']}, Loss: {summary['loss']*100:.2f}%")
-        if lat:
+        if "lat_avg_ms" in summary:
             _LOG.info(f"  Latency: avg={summary['lat_avg_ms']:.2f}ms, p50={summary['lat_p50_ms']:.2f}ms")
\ No newline at end of file
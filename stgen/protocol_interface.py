@@ -4,7 +4,7 @@ All protocol implementations must inherit from this base class.
 """
 
 from abc import ABC, abstractmethod
-from typing import Tuple, Dict, Any
+from typing import Tuple, Dict, Any, Iterable, Optional
 
 
 class ProtocolInterface(ABC):
@@ -75,6 +75,21 @@ class ProtocolInterface(ABC):
         """
         raise NotImplementedError("Use passive mode or override send_data")
     
+    def feed_stream(self, stream: Iterable[Tuple[str, Dict, float]]) -> Optional[int]:
+        """
+        Optional: consume the whole sensor stream natively (ACTIVE MODE ONLY).
+        
+        Protocols with a native feeder can override this to pace and send
+        the stream themselves instead of one send_data() call per message.
+        
+        Args:
+            stream: Generator yielding (client_id, data_dict, interval)
+        
+        Returns:
+            Number of messages sent, or None to fall back to send_data()
+        """
+        return None
+    
     @abstractmethod
     def stop(self) -> None:
         """
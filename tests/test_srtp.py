@@ -0,0 +1,1373 @@
+#!/usr/bin/env python3
+"""
+SRTP Protocol Plugin Test Suite
+Validates sensor-port framing, the native SRTP tools, sharding and the
+subscriber host.
+
+Native tests need the binaries built first:
+    make -C protocols/SRTP
+"""
+
+import sys
+import re
+import time
+import json
+import socket
+import struct
+import logging
+import tempfile
+import subprocess
+from pathlib import Path
+
+# Add parent directory to path
+ROOT = Path(__file__).parent.parent
+sys.path.insert(0, str(ROOT))
+
+logging.basicConfig(
+    level=logging.INFO,
+    format="%(asctime)s | %(levelname)s | %(name)s | %(message)s"
+)
+
+_LOG = logging.getLogger("srtp_test")
+
+BIN_DIR = ROOT / "bin"
+
+# One flat dict of quoted strings, as PRTP_server's parse_sensor_update() expects
+FRAME_RE = re.compile(
+    r"^\{'dev_id': '([a-z]+_\d+)', 'seq_no': '(\d+)', 'sensor_data': '((?:[^'\\]|\\.)*)'\}$"
+)
+
+
+def _udp_listener():
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("127.0.0.1", 0))
+    sock.settimeout(2.0)
+    return sock, sock.getsockname()[1]
+
+
+def test_import():
+    """Test 1: Verify SRTP module can be imported."""
+    _LOG.info("Test 1: Import test")
+    from protocols.SRTP import Protocol
+    assert Protocol is not None
+    return True
+
+
+def test_sensor_frame_format():
+    """Test 2: Generated readings are framed the way the server parses them."""
+    _LOG.info("Test 2: Sensor frame format")
+    from protocols.SRTP.srtp import format_sensor_update
+
+    cases = [
+        ({"dev_id": "temp_0", "seq_no": 7, "sensor_data": {"value": 21.384, "unit": "C"}},
+         "21.38 C"),
+        ({"dev_id": "device_1", "seq_no": 1, "sensor_data": {"value": 80.0}}, "ON"),
+        ({"dev_id": "device_1", "seq_no": 2, "sensor_data": {"value": 10.0}}, "OFF"),
+        ({"dev_id": "gps_2", "seq_no": 3,
+          "sensor_data": {"latitude": 23.8, "longitude": 90.4}}, "[23.800000, 90.400000]"),
+    ]
+    for data, expected in cases:
+        frame = format_sensor_update(data).decode()
+        m = FRAME_RE.match(frame)
+        assert m, frame
+        assert m.group(3) == expected, frame
+        assert m.group(2) == str(data["seq_no"])
+
+    frame = format_sensor_update(
+        {"dev_id": "camera_3", "seq_no": 4, "sensor_data": b"\x41\xff"}
+    ).decode()
+    assert frame.endswith("'sensor_data': '\\x41\\xff'}"), frame
+    return True
+
+
+def test_feeder_synthetic():
+    """Test 3: srtp_feeder paces a synthetic workload over many sensor ids."""
+    _LOG.info("Test 3: Native feeder (synthetic)")
+    feeder = BIN_DIR / "srtp_feeder"
+    assert feeder.exists(), "build with: make -C protocols/SRTP"
+
+    sock, port = _udp_listener()
+    proc = subprocess.Popen(
+        [str(feeder), "-p", str(port), "-n", "8", "-r", "20", "-d", "0.5", "-b", "4"],
+        stdout=subprocess.PIPE, text=True
+    )
+
+    frames = []
+    try:
+        while len(frames) < 80:
+            frames.append(sock.recv(4096).decode())
+    except socket.timeout:
+        pass
+    out, _ = proc.communicate(timeout=5)
+    sock.close()
+
+    summary = json.loads(out.strip().splitlines()[-1])
+    assert summary["sent"] == 80, summary
+    assert summary["syscalls"] <= summary["sent"]
+    assert len(frames) == 80
+    assert len({FRAME_RE.match(f).group(1) for f in frames}) == 8
+    return True
+
+
+def test_feeder_schedule():
+    """Test 4: srtp_feeder replays a schedule from stdin in order."""
+    _LOG.info("Test 4: Native feeder (schedule)")
+    feeder = BIN_DIR / "srtp_feeder"
+    assert feeder.exists(), "build with: make -C protocols/SRTP"
+
+    sock, port = _udp_listener()
+    schedule = "".join(
+        f"{i * 10000}\ttemp_{i % 2}\t{i + 1}\t2{i}.50 C\n" for i in range(10)
+    )
+    t0 = time.perf_counter()
+    proc = subprocess.run(
+        [str(feeder), "-p", str(port), "-f", "-"],
+        input=schedule, capture_output=True, text=True, timeout=5
+    )
+    elapsed = time.perf_counter() - t0
+    frames = [sock.recv(4096).decode() for _ in range(10)]
+    sock.close()
+
+    assert proc.returncode == 0
+    assert [FRAME_RE.match(f).group(2) for f in frames] == [str(i + 1) for i in range(10)]
+    assert elapsed >= 0.09, "schedule offsets were not honoured"
+    return True
+
+
+def _list_request(seq_no: int) -> bytes:
+    """PRTP LIST request: the common header only (BSON, little endian)."""
+    body = (b"\x10type\x00" + struct.pack("<i", 0)
+            + b"".join(b"\x08" + k + b"\x00\x00"
+                       for k in (b"end_marker", b"reliable", b"fragmented", b"utilize_timestamp"))
+            + b"\x10seq_no\x00" + struct.pack("<i", seq_no))
+    return struct.pack("<i", len(body) + 5) + body + b"\x00"
+
+
+def test_shard_router():
+    """Test 5: Two shards behind srtp_shard_router answer as one server."""
+    _LOG.info("Test 5: Sharded server")
+    from protocols.SRTP import Protocol
+    from protocols.SRTP.srtp import HashRing
+    from distributed.srtp_cluster import SUBSCRIBE, SUBSCRIBE_ACK, _msg_type, _subscribe
+    assert (BIN_DIR / "srtp_shard_router").exists(), "build with: make -C protocols/SRTP"
+
+    sensors = ["temp_0", "device_1", "gps_2", "camera_3", "temp_4", "device_5"]
+    ring = HashRing(["127.0.0.1:16100", "127.0.0.1:16102"])
+    assert len({ring.owner(s) for s in sensors}) == 2, "test sensors must span both shards"
+
+    proto = Protocol({
+        "server_ip": "127.0.0.1", "server_port": 15104, "client_port": 15105,
+        "num_clients": len(sensors), "shards": 2, "shard_base_port": 16100,
+        "work_dir": tempfile.mkdtemp(),
+    })
+    proto.start_server()
+    try:
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.settimeout(2.0)
+        sock.sendto(_list_request(7), ("127.0.0.1", 15105))
+        reply = sock.recv(65535)
+        # no sids, so nothing for the shards: the router acks it itself
+        sock.sendto(_subscribe(SUBSCRIBE, 8, [], False), ("127.0.0.1", 15105))
+        empty_ack = _msg_type(sock.recv(65535))
+        sock.close()
+    finally:
+        proto.stop()
+
+    # PRTP strings: int32 length (without NUL), bytes, NUL; array keys are empty
+    listed = {m.decode() for m in re.findall(rb"\x02\x00.{4}([a-z]+_\d+)\x00", reply, re.S)}
+    assert listed == set(sensors), listed
+    assert empty_ack == SUBSCRIBE_ACK
+    assert proto.get_metrics()["shard_router"]["merges"] == 2
+    return True
+
+
+def test_ring_placement():
+    """Test 6: Feeder -N steering agrees with HashRing; adding a node moves few ids."""
+    _LOG.info("Test 6: Consistent-hash placement")
+    from protocols.SRTP.srtp import HashRing
+    feeder = BIN_DIR / "srtp_feeder"
+    assert feeder.exists(), "build with: make -C protocols/SRTP"
+
+    nodes = [_udp_listener() for _ in range(3)]
+    names = [f"127.0.0.1:{port}" for _, port in nodes]
+    sids = [f"temp_{i}" for i in range(60)]
+    schedule = "".join(f"0\t{sid}\t1\t21.00 C\n" for sid in sids)
+    cmd = [str(feeder), "-f", "-", "-b", "16"]
+    for name in names:
+        cmd += ["-N", name]
+    proc = subprocess.run(cmd, input=schedule, capture_output=True, text=True, timeout=5)
+    assert proc.returncode == 0, proc.stderr
+
+    ring = HashRing(names)
+    for k, (sock, _) in enumerate(nodes):
+        got = set()
+        try:
+            while True:
+                got.add(FRAME_RE.match(sock.recv(4096).decode()).group(1))
+        except socket.timeout:
+            pass
+        sock.close()
+        assert got == {sid for sid in sids if ring.owner(sid) == k}, (k, got)
+
+    # Only ids claimed by the new node change owner
+    grown = HashRing(names + ["127.0.0.1:1"])
+    moved = [sid for sid in sids if grown.owner(sid) != ring.owner(sid)]
+    assert all(grown.owner(sid) == 3 for sid in moved)
+    assert len(moved) < len(sids) // 2
+    return True
+
+
+def test_subscriber_host():
+    """Test 7: One srtp_subscriber process serves hundreds of subscriber sessions."""
+    _LOG.info("Test 7: Subscriber host")
+    from protocols.SRTP import Protocol
+    host = BIN_DIR / "srtp_subscriber"
+    assert host.exists(), "build with: make -C protocols/SRTP"
+
+    sensors = ["temp_0", "device_1", "gps_2", "camera_3"]
+    sessions, rounds = 300, 3
+    proto = Protocol({
+        "server_ip": "127.0.0.1", "server_port": 15304, "client_port": 15305,
+        "num_clients": len(sensors),
+        "work_dir": tempfile.mkdtemp(),
+    })
+    proto.start_server()
+    try:
+        # two sensors per session, dealt round-robin
+        proc = subprocess.Popen(
+            [str(host), "-p", "15305", "-n", str(sessions), "-R", "1000", "-m", "2"] + sensors,
+            stdout=subprocess.PIPE, text=True
+        )
+        time.sleep(1.0)
+        for seq in range(1, rounds + 1):
+            for sid in sensors:
+                proto.send_data("test", {"dev_id": sid, "seq_no": seq, "sensor_data": {"value": 21.0}})
+            time.sleep(0.3)
+        time.sleep(0.5)
+        proc.send_signal(2)
+        stats = json.loads(proc.communicate(timeout=5)[0].strip().splitlines()[-1])
+    finally:
+        proto.stop()
+
+    assert stats["sessions"] == sessions and stats["ready"] == sessions, stats
+    assert stats["active_flows"] == 2 * sessions, stats
+    assert stats["updates"] - stats["empty_updates"] == 2 * sessions * rounds, stats
+    assert stats["session_updates_min"] == stats["session_updates_max"], stats
+    assert stats["lost"] == 0 and stats["unknown"] == 0, stats
+    return True
+
+
+def test_subscriber_latency():
+    """Test 8: Reliable updates yield one-way latency from the server's timestamps."""
+    _LOG.info("Test 8: Subscriber latency")
+    from protocols.SRTP import Protocol
+    assert (BIN_DIR / "srtp_subscriber").exists(), "build with: make -C protocols/SRTP"
+
+    sensors = ["temp_0", "device_1"]
+    proto = Protocol({
+        "server_ip": "127.0.0.1", "server_port": 15404, "client_port": 15405,
+        "num_clients": len(sensors), "subscriber_host": True,
+        "work_dir": tempfile.mkdtemp(),
+    })
+    proto.start_server()
+    try:
+        proto.start_clients(len(sensors))
+        time.sleep(1.0)
+        for seq in range(1, 6):
+            for sid in sensors:
+                proto.send_data("test", {"dev_id": sid, "seq_no": seq, "sensor_data": {"value": 21.0}})
+            time.sleep(0.3)
+        time.sleep(0.5)
+    finally:
+        proto.stop()
+
+    lat = proto.get_metrics()["latency"]
+    # both sessions subscribe reliably to both sensors; stamps are whole seconds
+    assert lat["lat_samples"] == 2 * 2 * 5 and lat["lat_negative"] == 0, lat
+    assert 0 <= lat["lat_min_ms"] <= lat["lat_p50_ms"] <= lat["lat_p95_ms"] <= lat["lat_p99_ms"], lat
+    assert lat["lat_max_ms"] < 1000 + 250, lat
+    return True
+
+
+def test_subscriber_sack():
+    """Test 9: Delayed sacks through the router release every reliable update."""
+    _LOG.info("Test 9: Subscriber sacks")
+    from protocols.SRTP import Protocol
+    assert (BIN_DIR / "srtp_shard_router").exists(), "build with: make -C protocols/SRTP"
+
+    sensors = ["temp_0", "device_1"]
+    proto = Protocol({
+        "server_ip": "127.0.0.1", "server_port": 15504, "client_port": 15505,
+        "shard_base_port": 16500, "num_clients": len(sensors),
+        "subscriber_host": True, "subscriber_ack_delay_ms": 50,
+        "work_dir": tempfile.mkdtemp(),
+    })
+    proto.start_server()
+    try:
+        proto.start_clients(len(sensors))
+        time.sleep(1.0)
+        for seq in range(1, 6):
+            for sid in sensors:
+                proto.send_data("test", {"dev_id": sid, "seq_no": seq, "sensor_data": {"value": 21.0}})
+            time.sleep(0.3)
+        time.sleep(0.5)
+    finally:
+        proto.stop()
+
+    metrics = proto.get_metrics()
+    host, router = metrics["subscriber_host"], metrics["shard_router"]
+    # a lost sack would show up as a stalled flow and missing samples
+    assert metrics["latency"]["lat_samples"] == 2 * 2 * 5, metrics["latency"]
+    assert host["acks"] >= 2 * 2 * 5 and host["ack_packets"] < host["acks"], host
+    assert router["sack_acks"] == 2 * 2 * 5, router
+    return True
+
+
+def test_egress_classes():
+    """Test 10: Alarms keep a short queue on a slow downlink under camera load."""
+    _LOG.info("Test 10: Egress priority classes")
+    from protocols.SRTP import Protocol
+
+    sensors = ["temp_0", "device_1", "gps_2", "camera_3"]
+    proto = Protocol({
+        "server_ip": "127.0.0.1", "server_port": 15604, "client_port": 15605,
+        "shard_base_port": 16600, "num_clients": len(sensors), "subscriber_host": True,
+        "srtp_classes": "classes.conf", "srtp_egress_kbps": 256,
+        "work_dir": tempfile.mkdtemp(),
+    })
+    proto.start_server()
+    try:
+        proto.start_clients(len(sensors))
+        time.sleep(1.0)
+        for seq in range(1, 11):
+            for _ in range(4):
+                proto.send_data("test", {"dev_id": "camera_3", "seq_no": seq, "sensor_data": {"value": 1}})
+            proto.send_data("test", {"dev_id": "device_1", "seq_no": seq, "sensor_data": {"value": 99}})
+            time.sleep(0.1)
+        time.sleep(2.0)
+    finally:
+        proto.stop()
+
+    classes = {c["name"]: c for c in proto.get_metrics()["shard_router"]["classes"]}
+    alarm, bulk = classes["alarm"], classes["bulk"]
+    assert alarm["sent"] > 0 and bulk["sent"] > 0, classes
+    # strict priority: an alarm waits for at most the datagram on the wire
+    assert alarm["qdelay_p95_ms"] < bulk["qdelay_p95_ms"], classes
+    return True
+
+
+def test_camera_frames():
+    """Test 11: 100 KB camera frames cross the server as fragments and reassemble."""
+    _LOG.info("Test 11: Camera frame fragmentation")
+    from protocols.SRTP import Protocol
+    assert (BIN_DIR / "srtp_feeder").exists(), "build with: make -C protocols/SRTP"
+
+    sensors = ["temp_0", "device_1", "gps_2", "camera_3"]
+    proto = Protocol({
+        "server_ip": "127.0.0.1", "server_port": 15704, "client_port": 15705,
+        "num_clients": len(sensors), "work_dir": tempfile.mkdtemp(),
+    })
+    proto.start_server()
+    try:
+        host = subprocess.Popen(
+            [str(BIN_DIR / "srtp_subscriber"), "-p", "15705", "-n", "1", "camera_3"],
+            stdout=subprocess.PIPE, text=True
+        )
+        time.sleep(1.0)
+        feeder = subprocess.run(
+            [str(BIN_DIR / "srtp_feeder"), "-p", "15704", "-n", "4", "-r", "1", "-d", "2",
+             "-F", "102400", "-G", "-g", "5000"],
+            capture_output=True, text=True, timeout=20
+        )
+        time.sleep(2.0)
+        host.send_signal(2)
+        stats = json.loads(host.communicate(timeout=5)[0].strip().splitlines()[-1])
+    finally:
+        proto.stop()
+
+    sent = json.loads(feeder.stdout.strip().splitlines()[-1])
+    assert sent["frames"] == 2 and sent["fragments"] == 2 * 415, sent
+    # the stock server may still shed a fragment under a burst; count whole frames only
+    assert stats["fragments"] >= 0.9 * sent["fragments"] and stats["frag_bad"] == 0, stats
+    assert stats["frames"] >= 1 and stats["frame_bytes"] == stats["frames"] * 102400, stats
+    return True
+
+
+def test_router_stats():
+    """Test 12: The router answers PRTP_STATS and the plugin keeps a time series."""
+    _LOG.info("Test 12: Router stats channel")
+    from protocols.SRTP import Protocol
+    from distributed.srtp_cluster import SUBSCRIBE, _subscribe
+
+    sensors = ["temp_0", "device_1"]
+    proto = Protocol({
+        "server_ip": "127.0.0.1", "server_port": 15804, "client_port": 15805,
+        "shard_base_port": 16800, "num_clients": len(sensors), "subscriber_host": True,
+        "srtp_stats_interval_ms": 200,
+        "work_dir": tempfile.mkdtemp(),
+    })
+    proto.start_server()
+    # a reliable subscriber that never acks: the server retransmits to it
+    mute = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    try:
+        proto.start_clients(len(sensors))
+        mute.sendto(_subscribe(SUBSCRIBE, 1, ["temp_0"], True), ("127.0.0.1", 15805))
+        time.sleep(1.0)
+        for seq in range(1, 6):
+            for sid in sensors:
+                proto.send_data("test", {"dev_id": sid, "seq_no": seq, "sensor_data": {"value": 21.0}})
+            time.sleep(0.3)
+        time.sleep(0.5)
+    finally:
+        mute.close()
+        proto.stop()
+
+    series = proto.get_metrics()["srtp_timeseries"]
+    assert len(series) >= 5, len(series)
+    last = series[-1]
+    # readings go straight to the shard, updates pass the router
+    assert last["sensors"]["temp_0"]["updates"] >= 2 * 5, last["sensors"]
+    assert any(s["sensors"].get("temp_0", {}).get("updates_hz", 0) > 0 for s in series), series
+    assert last["retransmits"] > 0, last
+    assert sum(e["retransmits"] for e in last["sensors"].values()) == last["retransmits"], last
+    assert sum(c["retransmits"] for c in last["clients"]) == last["retransmits"], last
+    # two host sessions and the mute client; the poller is not a session
+    assert len(last["clients"]) == 3, last["clients"]
+    return True
+
+
+def test_fast_startup():
+    """Test 13: start_server returns once the server answers, not after a fixed sleep."""
+    _LOG.info("Test 13: Readiness probe startup")
+    from protocols.SRTP import Protocol
+
+    for extra in ({}, {"shards": 2, "shard_base_port": 16900}):
+        proto = Protocol({
+            "server_ip": "127.0.0.1", "server_port": 15904, "client_port": 15905,
+            "num_clients": 4, "work_dir": tempfile.mkdtemp(), **extra,
+        })
+        t0 = time.monotonic()
+        proto.start_server()
+        startup = time.monotonic() - t0
+        try:
+            sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            sock.settimeout(2.0)
+            sock.sendto(_list_request(1), ("127.0.0.1", 15905))
+            reply = sock.recv(65535)
+            sock.close()
+        finally:
+            proto.stop()
+        listed = {m.decode() for m in re.findall(rb"\x02\x00.{4}([a-z]+_\d+)\x00", reply, re.S)}
+        assert startup < 0.5, (extra, startup)
+        assert listed == {"temp_0", "device_1", "gps_2", "camera_3"}, (extra, listed)
+    return True
+
+
+def test_simulated_lorawan():
+    """Test 14: an hour of reliable LoRaWAN traffic simulates in well under a second."""
+    _LOG.info("Test 14: Virtual-clock simulation")
+    sim = BIN_DIR / "srtp_sim"
+    assert sim.exists(), "build with: make -C protocols/SRTP"
+
+    profile = ROOT / "configs" / "network_conditions" / "lorawan.json"
+    runs = {}
+    for delay in (0, 50):
+        proc = subprocess.run(
+            [str(sim), "-P", str(profile), "-n", "8", "-m", "4", "-r", "0.1",
+             "-d", "3600", "-W", "30", "-D", str(delay), "-s", "7"],
+            capture_output=True, text=True, timeout=10
+        )
+        assert proc.returncode == 0, proc.stderr
+        runs[delay] = json.loads(proc.stdout)
+
+    for r in runs.values():
+        assert r["sim_s"] == 3630 and r["wall_ms"] < 2000, r
+        assert r["published"] == 8 * 4 * 360 and r["delivered"] == r["published"], r
+        # 600 ms round trip against the 200 ms retransmit timer
+        assert r["retransmits"] > r["published"] and r["lat_p50_ms"] >= 260, r
+    # delayed sacks coalesce acks across a client's flows
+    assert runs[50]["control_packets"] < runs[0]["control_packets"], runs
+    assert runs[50]["spurious_acks"] == 0, runs[50]
+    return True
+
+
+def test_router_batching():
+    """Test 15: a sensor burst crosses the router in recvmmsg/sendmmsg batches."""
+    _LOG.info("Test 15: Router syscall batching")
+    import signal
+    router = BIN_DIR / "srtp_shard_router"
+    assert router.exists(), "build with: make -C protocols/SRTP"
+
+    ratio = {}
+    for batch in (1, 64):
+        shard, shard_port = _udp_listener()
+        proc = subprocess.Popen(
+            [str(router), "-p", "16004", "-s", "16005", "-b", str(batch),
+             "-N", f"127.0.0.1:{shard_port}"],
+            stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True
+        )
+        try:
+            time.sleep(0.2)
+            # queue the burst while the router sleeps, so it finds a full socket
+            proc.send_signal(signal.SIGSTOP)
+            out = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            for i in range(200):
+                out.sendto(f"{{'dev_id': 'temp_{i % 4}', 'seq_no': '{i}', 'sensor_data': '1'}}"
+                           .encode(), ("127.0.0.1", 16004))
+            out.close()
+            proc.send_signal(signal.SIGCONT)
+            got = sum(1 for _ in range(200) if shard.recv(4096))
+        finally:
+            proc.send_signal(signal.SIGINT)
+            stdout, _ = proc.communicate(timeout=5)
+            shard.close()
+        stats = json.loads(stdout.strip().splitlines()[-1])
+        assert got == 200 and stats["sensor_out"] == [200], (batch, stats)
+        ratio[batch] = stats["syscalls_per_msg"]
+
+    assert ratio[1] >= 1.0 and ratio[64] < 0.2, ratio
+    return True
+
+
+def test_trace_logs():
+    """Test 16: -T trace logs decode offline; per-packet levels are compiled out."""
+    _LOG.info("Test 16: Binary trace logs")
+    from protocols.SRTP import Protocol
+    from protocols.SRTP.srtp_trace import read_trace
+
+    with tempfile.TemporaryDirectory() as tmp:
+        proto = Protocol({
+            "server_ip": "127.0.0.1", "server_port": 16204, "client_port": 16205,
+            "shard_base_port": 17200, "num_clients": 2, "subscriber_host": True,
+            "subscriber_ack_delay_ms": 50, "srtp_trace_dir": tmp,
+            "work_dir": tempfile.mkdtemp(),
+        })
+        proto.start_server()
+        try:
+            proto.start_clients(2)
+            time.sleep(1.0)
+            for seq in range(1, 4):
+                proto.send_data("test", {"dev_id": "temp_0", "seq_no": seq, "sensor_data": {"value": 1}})
+                time.sleep(0.2)
+        finally:
+            proto.stop()
+        traces = proto.get_metrics()["srtp_traces"]
+        router, router_dropped = read_trace(traces["shard_router"])
+        host, host_dropped = read_trace(traces["subscriber_host"])
+
+    msgs = [r["msg"] for r in router]
+    assert router_dropped == 0 and host_dropped == 0
+    assert msgs[0].startswith("router up: 1 shards, batch 64"), msgs
+    assert sum(m.startswith("session 127.0.0.1:") for m in msgs) == 2, msgs
+    assert sorted(r["msg"] for r in host) == [f"session {i} ready: 2 flows" for i in (0, 1)], host
+    # the default build keeps INFO and above only
+    assert all(r["level"] <= 3 for r in router + host)
+    return True
+
+
+def test_warm_restart():
+    """Test 17: after a crash of router and server, a snapshot restores the
+    subscriptions without the subscribers resubscribing."""
+    _LOG.info("Test 17: Warm restart from a router snapshot")
+    from protocols.SRTP import Protocol
+
+    sensors = ["temp_0", "device_1", "gps_2", "camera_3"]
+    samples = {}
+    for warm in (True, False):
+        with tempfile.TemporaryDirectory() as tmp:
+            cfg = {
+                "server_ip": "127.0.0.1", "server_port": 16404, "client_port": 16405,
+                "shard_base_port": 17400, "num_clients": len(sensors), "subscriber_host": True,
+                "work_dir": tempfile.mkdtemp(),
+            }
+            # cold: any option that puts the router in front, minus the snapshot
+            cfg.update({"srtp_snapshot": f"{tmp}/router.snap"} if warm else {"shards": 2})
+            proto = Protocol(cfg)
+            proto.start_server()
+            try:
+                proto.start_clients(len(sensors))
+                time.sleep(1.0)
+                for seq in range(1, 7):
+                    if seq == 4:
+                        assert proto.restart_server() < 0.5
+                        time.sleep(0.5)
+                    for sid in sensors:
+                        proto.send_data("test", {"dev_id": sid, "seq_no": seq, "sensor_data": {"value": 1}})
+                    time.sleep(0.2)
+                time.sleep(0.5)
+            finally:
+                proto.stop()
+        metrics = proto.get_metrics()
+        samples[warm] = metrics["subscriber_host"]["lat_samples"]
+        if warm:
+            router = metrics["shard_router"]
+            assert router["restored_sessions"] == 4 and router["restored_flows"] == 16, router
+            assert 0 <= router["restore_ms"] < 1000, router
+
+    # every session subscribes (-A) to every sensor: 4 x 4 updates per round
+    assert samples == {True: 16 * 6, False: 16 * 3}, samples
+    return True
+
+
+def test_control_churn():
+    """Test 18: the subscriber host's control socket subscribes and drops
+    sids at runtime without disturbing the other flows."""
+    _LOG.info("Test 18: Subscription churn through the control socket")
+    from protocols.SRTP import Protocol
+
+    def stat(proto, key):
+        reply = proto.control(["stats"])[0]
+        return int(dict(kv.split("=") for kv in reply.split()[1:])[key])
+
+    proto = Protocol({
+        "server_ip": "127.0.0.1", "server_port": 16604, "client_port": 16605,
+        "num_clients": 2, "subscriber_host": True, "subscriber_control_port": 16699,
+        "work_dir": tempfile.mkdtemp(),
+    })
+    proto.start_server()
+    try:
+        proto.start_clients(2)
+        deadline = time.monotonic() + 5
+        while proto.control(["unsub *"])[0] != "ok 0" and time.monotonic() < deadline:
+            time.sleep(0.1)
+        # -A: both sessions hold both sensors
+        assert stat(proto, "active_flows") == 4
+        assert proto.control(["frob *", "unsub 7 temp_0", "unsub"]) == [
+            "err unknown command frob", "err no session 7", "err usage"]
+
+        assert proto.control(["unsub * device_1"]) == ["ok 2"]
+        assert stat(proto, "active_flows") == 2
+        for i in range(20):
+            verb = "unsub" if i % 2 else "rsub"
+            assert proto.control([f"{verb} 0 device_1"]) == ["ok 1"]
+            time.sleep(0.02)
+        assert stat(proto, "active_flows") == 2
+        # new sids (unknown to the server), a repeat and an active one in one
+        # command: one subscribe each, and device_1 comes back on its old flow
+        assert proto.control(["sub 0 camera_9 device_1 camera_9 temp_0 camera_8"]) == ["ok 3"]
+        time.sleep(0.2)
+        assert stat(proto, "active_flows") == 3 and stat(proto, "rejected") == 2
+        assert proto.control(["unsub 0 device_1 camera_9 camera_8"]) == ["ok 1"]
+        assert stat(proto, "active_flows") == 2
+        for seq in range(1, 6):
+            proto.send_data("test", {"dev_id": "temp_0", "seq_no": seq, "sensor_data": {"value": 1}})
+            time.sleep(0.05)
+        time.sleep(0.5)
+    finally:
+        proto.stop()
+
+    host = proto.get_metrics()["subscriber_host"]
+    assert host["lat_samples"] == 2 * 5 and host["lost"] == 0, host
+    assert host["ctl_unsubs"] == 2 + 10 + 1 and host["ctl_subs"] == 10 + 3, host
+    return True
+
+
+def test_subscription_options():
+    """Test 19: the router applies minimum interval, deadband and latest
+    value only to each subscriber's flow before the update fans out."""
+    _LOG.info("Test 19: Rate-limited and deadband subscriptions")
+    from protocols.SRTP import Protocol
+
+    proto = Protocol({
+        "server_ip": "127.0.0.1", "server_port": 16804, "client_port": 16805,
+        "shard_base_port": 17800, "num_clients": 2, "subscriber_host": True,
+        "subscriber_min_interval_ms": 300, "subscriber_deadband": 0.5, "subscriber_latest": True,
+        "work_dir": tempfile.mkdtemp(),
+    })
+    proto.start_server()
+    try:
+        proto.start_clients(2)
+        time.sleep(1.0)
+        # (pause before, temp_0, device_1); None sends nothing
+        steps = [
+            (0.0, 20.0, True),      # both delivered
+            (0.05, 20.1, True),     # both within the deadband: dropped
+            (0.05, 21.0, None),     # within the interval: held
+            (0.05, 21.2, None),     # replaces the held one, delivered at the interval's end
+            (0.9, 21.3, False),     # temp within the deadband of 21.2; device changed
+        ]
+        seq = 0
+        for pause, temp, dev in steps:
+            time.sleep(pause)
+            seq += 1
+            proto.send_data("test", {"dev_id": "temp_0", "seq_no": seq, "sensor_data": {"value": temp}})
+            if dev is not None:
+                proto.send_data("test", {"dev_id": "device_1", "seq_no": seq, "sensor_data": {"value": dev}})
+        time.sleep(0.5)
+    finally:
+        proto.stop()
+
+    metrics = proto.get_metrics()
+    host, router = metrics["subscriber_host"], metrics["shard_router"]
+    # per session: temp 20.0 and 21.2, device ON and OFF
+    assert host["updates"] - host["empty_updates"] == 2 * 4, host
+    assert host["lost"] == 0 and host["skipped"] > 0, host
+    assert router["filtered"] == 2 * 3 and router["coalesced"] == 2, router
+    assert router["acks_absorbed"] == 2 * 4, router
+    return True
+
+
+def test_latest_value_cache():
+    """Test 20: with the router's latest-value cache, a new subscriber
+    gets each sensor's last update with the subscribe ack."""
+    _LOG.info("Test 20: Latest-value cache for new subscribers")
+    import socket
+    from distributed.srtp_cluster import UPDATE, _msg_type, _subscribe, _update_sid
+    from protocols.SRTP import Protocol
+
+    first = {}
+    for cached in (True, False):
+        cfg = {
+            "server_ip": "127.0.0.1", "server_port": 17004, "client_port": 17005,
+            "shard_base_port": 18000, "num_clients": 2, "subscriber_host": True,
+            "work_dir": tempfile.mkdtemp(),
+        }
+        cfg.update({"srtp_latest_cache": 1000} if cached else {"shards": 2})
+        proto = Protocol(cfg)
+        proto.start_server()
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.settimeout(0.3)
+        try:
+            proto.start_clients(1)
+            time.sleep(1.0)
+            for sid in ("temp_0", "device_1"):
+                proto.send_data("test", {"dev_id": sid, "seq_no": 1, "sensor_data": {"value": 1}})
+            time.sleep(0.3)
+            # a late subscriber, with no reading due
+            sock.sendto(_subscribe(2, 1, ["temp_0", "device_1"], False), ("127.0.0.1", 17005))
+            got = []
+            try:
+                while True:
+                    reply = sock.recv(65535)
+                    if _msg_type(reply) == UPDATE and _update_sid(reply):
+                        got.append(_update_sid(reply))
+            except socket.timeout:
+                pass
+            first[cached] = sorted(got)
+        finally:
+            sock.close()
+            proto.stop()
+        metrics = proto.get_metrics()
+        host = metrics["subscriber_host"]
+        assert host["lost"] == 0 and host["late"] == 0 and host["cached_updates"] == 0, host
+        if cached:
+            router = metrics["shard_router"]
+            assert router["cache_entries"] == 2 and router["cache_hits"] == 2, router
+
+    # without the cache only the server's own opening update, which skips temp_0
+    assert first[True] == ["device_1", "temp_0"] and "temp_0" not in first[False], first
+    return True
+
+
+def test_multicast_fanout():
+    """Test 21: multicast subscriptions get each update through the
+    sensor's group, sent once by the router, and nacked gaps repaired."""
+    _LOG.info("Test 21: Multicast fan-out with unicast repair")
+    import socket
+    from distributed.srtp_cluster import UPDATE, _doc, _header, _msg_type, _str, _update_sid
+    from protocols.SRTP import Protocol
+
+    proto = Protocol({
+        "server_ip": "127.0.0.1", "server_port": 17204, "client_port": 17205,
+        "shard_base_port": 18200, "num_clients": 4, "subscriber_host": True,
+        "srtp_multicast": "239.255.0.1:17400",
+        "work_dir": tempfile.mkdtemp(),
+    })
+    proto.start_server()
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.settimeout(0.5)
+    try:
+        proto.start_clients(4)
+        time.sleep(1.0)
+        # a raw member of temp_0's group, which only nacks
+        opts = b"\x08reliable\x00\x01\x08multicast\x00\x01"
+        sock.sendto(_doc(_header(2, 1) + b"\x04sids\x00" + _doc(b"\x03\x00" + _doc(_str("sid", "temp_0") + opts))),
+                    ("127.0.0.1", 17205))
+        ack = sock.recv(65535)
+        assert _msg_type(ack) == 3 and b"group_port" in ack, ack
+        for seq in range(1, 6):
+            proto.send_data("test", {"dev_id": "temp_0", "seq_no": seq, "sensor_data": {"value": seq}})
+            time.sleep(0.05)
+        time.sleep(0.3)
+        for seq in (3, 99):
+            sock.sendto(_doc(_header(6, seq) + _str("sid", "temp_0")), ("127.0.0.1", 17205))
+        repair = sock.recv(65535)
+        assert _msg_type(repair) == UPDATE and _update_sid(repair) == "temp_0", repair
+    finally:
+        sock.close()
+        proto.stop()
+
+    metrics = proto.get_metrics()
+    host, router = metrics["subscriber_host"], metrics["shard_router"]
+    # 4 sessions x 5 readings out of 5 group datagrams, one upstream subscriber per sensor
+    assert host["updates"] == 20 and host["group_datagrams"] == 5, host
+    assert host["lost"] == 0 and host["empty_updates"] == 0 and host["group_errors"] == 0, host
+    assert router["mcast_out"] == 5 and router["mcast_sensors"] == 4, router
+    assert router["repairs"] == 1 and router["repair_misses"] == 1, router
+    return True
+
+
+def test_header_compression():
+    """Test 22: compressed subscriptions get each flow's first update as an
+    IR and the rest as small COs, and a PRTP_HC_RESYNC forces a new IR."""
+    _LOG.info("Test 22: Header compression of updates")
+    import socket
+    from distributed.srtp_cluster import _doc, _header, _msg_type, _str
+    from protocols.SRTP import Protocol
+
+    proto = Protocol({
+        "server_ip": "127.0.0.1", "server_port": 17404, "client_port": 17405,
+        "shard_base_port": 18400, "num_clients": 4, "subscriber_host": True,
+        "subscriber_compress": True,
+        "work_dir": tempfile.mkdtemp(),
+    })
+    proto.start_server()
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.settimeout(0.5)
+
+    def next_compressed():
+        while True:
+            pkt = sock.recv(65535)
+            if pkt[0] == 0xC5:
+                return pkt
+
+    try:
+        proto.start_clients(4)
+        time.sleep(1.0)
+        # a raw compressed subscriber of temp_0
+        opts = b"\x08compress\x00\x01"
+        sock.sendto(_doc(_header(2, 1) + b"\x04sids\x00" + _doc(b"\x03\x00" + _doc(_str("sid", "temp_0") + opts))),
+                    ("127.0.0.1", 17405))
+        assert _msg_type(sock.recv(65535)) == 3
+        kinds = []
+        for seq in range(1, 21):
+            proto.send_data("test", {"dev_id": "temp_0", "seq_no": seq, "sensor_data": {"value": 20 + seq * 0.25}})
+            time.sleep(0.02)
+            if seq in (1, 2, 3):
+                kinds.append(next_compressed())
+            if seq == 3:
+                sock.sendto(_doc(_header(11, kinds[0][2])), ("127.0.0.1", 17405))
+                time.sleep(0.1)
+            if seq == 4:
+                kinds.append(next_compressed())
+        ir, co, _, again = kinds
+        assert ir[1] == 0x80 and co[1] == 0x81 and len(co) < len(ir) // 4, (ir, co)
+        assert again[1] == 0x80 and again[2] == ir[2] and again[3] == ir[3] + 1, again
+        time.sleep(0.5)
+    finally:
+        sock.close()
+        proto.stop()
+
+    metrics = proto.get_metrics()
+    host, router = metrics["subscriber_host"], metrics["shard_router"]
+    assert host["hc_updates"] > 0 and host["hc_bad"] == 0 and host["hc_damaged"] == 0, host
+    assert host["lost"] == 0 and host["unknown"] == 0, host
+    assert router["hc_resyncs"] == 1 and router["hc_bytes"] * 3 < router["hc_raw_bytes"], router
+    return True
+
+
+def test_impairment_relay():
+    """Test 23: srtp_impair delays, paces, drops and corrupts each flow as
+    its profile says, over UDP and TCP, and can front the client port."""
+    _LOG.info("Test 23: User-space impairment relay")
+    import threading
+    from stgen.network_emulator import NetworkRelay
+    from protocols.SRTP import Protocol
+
+    profile = Path(tempfile.mkdtemp()) / "relay_test.json"
+    profile.write_text(json.dumps({"latency_ms": 60, "jitter_ms": 0, "loss_percent": 0,
+                                   "bandwidth_kbps": 400}))
+    echo, echo_port = _udp_listener()
+    echo.settimeout(0.1)
+    stop = threading.Event()
+
+    def serve_udp():
+        while not stop.is_set():
+            try:
+                data, addr = echo.recvfrom(65535)
+                echo.sendto(data, addr)
+            except socket.timeout:
+                pass
+
+    def serve_tcp(listener):
+        conn, _ = listener.accept()
+        while data := conn.recv(65536):
+            conn.sendall(data)
+        conn.close()
+
+    server = threading.Thread(target=serve_udp, daemon=True)
+    server.start()
+    client = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    client.settimeout(2.0)
+    relay = NetworkRelay(str(profile), 17610, echo_port).start()
+    try:
+        time.sleep(0.2)
+        t0 = time.monotonic()
+        client.sendto(b"x" * 100, ("127.0.0.1", 17610))
+        assert client.recv(2048) == b"x" * 100
+        rtt = time.monotonic() - t0
+        assert 0.055 < rtt < 0.2, rtt
+        # 20 x 1000 B through 400 kbps (50 kB/s) each way: paced, not dropped
+        t0 = time.monotonic()
+        for i in range(20):
+            client.sendto(bytes([i]) * 1000, ("127.0.0.1", 17610))
+        got = sorted(client.recv(2048)[0] for _ in range(20))
+        assert got == list(range(20)) and time.monotonic() - t0 > 0.35, time.monotonic() - t0
+    finally:
+        stats = relay.stop()
+    assert stats["flows"] == 1 and stats["up_in"] == 21 and stats["down_out"] == 21, stats
+    assert stats["lost"] == 0 and stats["queue_drops"] == 0 and stats["in_flight"] == 0, stats
+
+    # options after the profile override it: half of everything lost, all corrupted
+    relay = NetworkRelay(str(profile), 17611, echo_port,
+                         extra_args=["-L", "0", "-B", "0", "-X", "50", "-C", "100"]).start()
+    received = []
+    try:
+        time.sleep(0.2)
+        for _ in range(4):
+            for _ in range(100):
+                client.sendto(bytes(200), ("127.0.0.1", 17611))
+            time.sleep(0.05)
+        client.settimeout(0.3)
+        try:
+            while True:
+                received.append(client.recv(2048))
+        except socket.timeout:
+            pass
+    finally:
+        stats = relay.stop()
+        stop.set()
+        server.join()
+        echo.close()
+    assert 140 < stats["up_out"] < 260 and stats["down_out"] == len(received), stats
+    assert stats["corrupted"] == stats["up_out"] + stats["down_out"], stats
+    assert sum(pkt != bytes(200) for pkt in received) >= 0.9 * len(received), received
+
+    # TCP: jitter never reorders the stream
+    listener = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    listener.bind(("127.0.0.1", 0))
+    listener.listen(1)
+    server = threading.Thread(target=serve_tcp, args=(listener,), daemon=True)
+    server.start()
+    relay = NetworkRelay(str(profile), 17612, listener.getsockname()[1], tcp=True,
+                         extra_args=["-J", "40", "-B", "8000"]).start()
+    try:
+        time.sleep(0.2)
+        data = bytes(range(256)) * 800
+        conn = socket.create_connection(("127.0.0.1", 17612), timeout=5)
+        conn.sendall(data)
+        conn.shutdown(socket.SHUT_WR)
+        echoed = b""
+        while chunk := conn.recv(65536):
+            echoed += chunk
+        conn.close()
+        assert echoed == data, len(echoed)
+    finally:
+        stats = relay.stop()
+        server.join(timeout=2)
+        listener.close()
+    assert stats["mode"] == "tcp" and stats["up_bytes"] == stats["down_bytes"] == len(data), stats
+
+    # in front of the client port: every session is a flow of its own
+    proto = Protocol({
+        "server_ip": "127.0.0.1", "server_port": 17504, "client_port": 17505,
+        "num_clients": 4, "subscriber_host": True,
+        "network_emulation": "relay", "network_profile": str(profile),
+        "network_relay_port": 17605,
+        "work_dir": tempfile.mkdtemp(),
+    })
+    proto.start_server()
+    try:
+        proto.start_clients(4)
+        time.sleep(1.5)
+        for seq in range(1, 4):
+            for sid in ("temp_0", "device_1", "gps_2", "camera_3"):
+                proto.send_data("test", {"dev_id": sid, "seq_no": seq, "sensor_data": {"value": seq}})
+            time.sleep(0.1)
+        time.sleep(1.0)
+    finally:
+        proto.stop()
+    metrics = proto.get_metrics()
+    host, relay_stats = metrics["subscriber_host"], metrics["network_relay"]
+    assert host["ready"] == 4 and host["updates"] - host["empty_updates"] >= 12, host
+    assert relay_stats["flows"] == 4 and relay_stats["lost"] == 0, relay_stats
+    assert relay_stats["down_out"] == relay_stats["down_in"] > 0, relay_stats
+    return True
+
+
+def test_burst_loss():
+    """Test 24: the Gilbert-Elliott engine loses what a conf row says, in
+    bursts of the configured lengths, in Python, srtp_impair and srtp_sim."""
+    _LOG.info("Test 24: Gilbert-Elliott burst loss")
+    import random
+    from stgen.gilbert_elliott import GilbertElliott
+    from stgen.failure_injector import FailureInjector
+    from stgen.network_emulator import NetworkRelay
+
+    conf = ROOT / "protocols" / "SRTP" / "conf" / "test3.conf"
+    assert not any(GilbertElliott.from_conf("test3.conf", 0).lose() for _ in range(1000))
+    engine = GilbertElliott.from_conf("test3.conf", 3, rng=random.Random(5))
+    for _ in range(100000):
+        engine.lose()
+    engine.end_burst()
+    r = engine.report()
+    assert r["configured_loss"] == 0.6226 and abs(r["observed_loss"] - 0.6226) < 0.02, r
+    assert r["configured_mean_burst"] == 5.0 and abs(r["observed_mean_burst"] - 5.0) < 0.3, r
+    assert sum(r["bursts"][:-1]) < sum(r["bursts"]) and r["bursts"][0] > r["bursts"][4] > r["bursts"][9], r
+
+    # one link per client, counted together
+    injector = FailureInjector({"failure_injection": {"burst_loss": {"conf": str(conf), "row": 2}}})
+    drops = sum(injector.should_drop_packet(f"c{i % 4}") for i in range(40000))
+    burst = injector.get_failure_summary()["burst_loss"]
+    assert len(injector.burst_links) == 4 and burst["packets"] == 40000 and burst["lost"] == drops, burst
+    assert abs(burst["observed_loss"] - burst["configured_loss"]) < 0.03, burst
+
+    # on the wire: the relay's summary reports the same
+    sink, sink_port = _udp_listener()
+    client = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    relay = NetworkRelay("perfect", 17613, sink_port, extra_args=["-g", f"{conf}:3"]).start()
+    try:
+        time.sleep(0.2)
+        for i in range(20000):
+            client.sendto(bytes(20), ("127.0.0.1", 17613))
+            if i % 500 == 499:
+                time.sleep(0.01)
+        time.sleep(0.3)
+    finally:
+        stats = relay.stop()
+        sink.close()
+    ge = stats["ge"]
+    assert ge["packets"] == stats["up_in"] == 20000 and ge["lost"] == stats["lost"], stats
+    assert abs(ge["observed_loss"] - 0.6226) < 0.03 and abs(ge["observed_mean_burst"] - 5.0) < 0.5, ge
+
+    proc = subprocess.run([str(BIN_DIR / "srtp_sim"), "-g", f"{conf}:2", "-d", "60", "-s", "3"],
+                          capture_output=True, text=True, timeout=10)
+    assert proc.returncode == 0, proc.stderr
+    sim = json.loads(proc.stdout)
+    assert sim["delivered"] == sim["published"] and sim["ge"]["lost"] == sim["lost_up"] + sim["lost_down"], sim
+    assert abs(sim["ge"]["observed_loss"] - sim["ge"]["configured_loss"]) < 0.05, sim["ge"]
+    return True
+
+
+def test_network_mix():
+    """Test 25: a network mix becomes one tc -batch script with a class,
+    netem leaf and two-way filters per device, and host sessions sit on
+    the device ports those filters match."""
+    _LOG.info("Test 25: Per-device network profiles")
+    from stgen.network_emulator import NetworkEmulator
+
+    emulator = NetworkEmulator("lo")
+    t0 = time.monotonic()
+    batch = emulator.mix_batch([{"profile": "wifi", "devices": 3000},
+                                {"profile": "lorawan", "devices": 2000},
+                                {"profile": "4g", "ports": [40000, 40999]}], 30000)
+    assert time.monotonic() - t0 < 1.0
+    lines = batch.splitlines()
+    assert lines[0] == "qdisc add dev lo root handle 1: htb default 1"
+    assert len(emulator.devices) == 5001 and len(lines) == 2 + 4 * 5001, len(lines)
+    assert sum(" netem " in l for l in lines) == 5001
+    assert emulator.devices[2999] == {"ports": "32999", "profile": "wifi", "classid": "1:bb9"}
+    assert emulator.devices[3000]["ports"] == "33000" and emulator.devices[-1]["ports"] == "40000-40999"
+    lora = [l for l in lines if "parent 1:bba " in l or "classid 1:bba" in l]
+    assert lora == [
+        "class add dev lo parent 1: classid 1:bba htb rate 50kbit ceil 50kbit",
+        "qdisc add dev lo parent 1:bba handle bba: netem delay 600ms 40ms loss 2.5% corrupt 0.5%",
+        "filter add dev lo parent 1: protocol ip prio 1 flower ip_proto udp src_port 33000 classid 1:bba",
+        "filter add dev lo parent 1: protocol ip prio 1 flower ip_proto udp dst_port 33000 classid 1:bba",
+    ], lora
+
+    # srtp_subscriber -b: session i lists from port base + i
+    server, server_port = _udp_listener()
+    host = subprocess.Popen([str(BIN_DIR / "srtp_subscriber"), "-p", str(server_port),
+                             "-n", "4", "-a", "-b", "31000", "-d", "2"],
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    try:
+        ports = {server.recvfrom(2048)[1][1] for _ in range(4)}
+    finally:
+        host.terminate()
+        host.wait(timeout=5)
+        server.close()
+    assert ports == {31000, 31001, 31002, 31003}, ports
+    return True
+
+
+def test_trace_conditions():
+    """Test 26: a profile with a trace changes srtp_impair's delay, loss and
+    bandwidth on schedule while packets flow, and srtp_sim's too."""
+    _LOG.info("Test 26: Trace-driven network conditions")
+    import threading
+    from stgen.network_emulator import NetworkRelay
+
+    tmp = Path(tempfile.mkdtemp())
+    (tmp / "steps.trace").write_text(
+        "# t_ms kbps latency_ms loss_percent\n"
+        "0    0 20  0\n"
+        "800  0 200 0\n"
+        "1600 0 20  100\n"
+        "2200 0 20  0\n")
+    (tmp / "steps.json").write_text(json.dumps({"latency_ms": 0, "trace": "steps.trace"}))
+    echo, echo_port = _udp_listener()
+    echo.settimeout(0.1)
+    stop = threading.Event()
+
+    def serve():
+        while not stop.is_set():
+            try:
+                data, addr = echo.recvfrom(2048)
+                echo.sendto(data, addr)
+            except socket.timeout:
+                pass
+
+    server = threading.Thread(target=serve, daemon=True)
+    server.start()
+    client = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    client.settimeout(0.3)
+    relay = NetworkRelay(str(tmp / "steps.json"), 17614, echo_port).start()
+    rtts = []
+    t0 = time.monotonic()
+    try:
+        time.sleep(0.2)
+        while time.monotonic() - t0 < 2.9:
+            sent = time.monotonic()
+            client.sendto(struct.pack("!d", sent), ("127.0.0.1", 17614))
+            try:
+                while struct.unpack("!d", client.recv(64))[0] != sent:
+                    pass
+                rtts.append((sent - t0, time.monotonic() - sent))
+            except socket.timeout:
+                rtts.append((sent - t0, None))
+            time.sleep(0.02)
+    finally:
+        stats = relay.stop()
+        stop.set()
+        server.join()
+        echo.close()
+    # relay start-up shifts its clock a little against ours: skip the edges
+    before = [r for t, r in rtts if 0.3 < t < 0.6]
+    during = [r for t, r in rtts if 1.1 < t < 1.4]
+    outage = [r for t, r in rtts if 1.7 < t < 2.1]
+    after = [r for t, r in rtts if t > 2.5]
+    assert before and all(r is not None and r < 0.1 for r in before), rtts
+    assert during and all(r is not None and 0.19 < r < 0.3 for r in during), rtts
+    assert outage and all(r is None for r in outage), rtts
+    assert after and all(r is not None and r < 0.1 for r in after), rtts
+    assert stats["trace_rows"] == 4 and stats["trace_steps"] == 4 and stats["lost"] > 0, stats
+
+    # the simulator, on virtual time, with the looped congestion_event profile
+    runs = {}
+    for name in ("wifi", "congestion_event"):
+        profile = ROOT / "configs" / "network_conditions" / f"{name}.json"
+        proc = subprocess.run([str(BIN_DIR / "srtp_sim"), "-P", str(profile), "-d", "120", "-r", "2", "-s", "4"],
+                              capture_output=True, text=True, timeout=10)
+        assert proc.returncode == 0, proc.stderr
+        runs[name] = json.loads(proc.stdout)
+    wifi, event = runs["wifi"], runs["congestion_event"]
+    assert "trace_steps" not in wifi and event["trace_steps"] == 26, event   # 6 rows a 30 s pass
+    assert event["lat_p95_ms"] > 5 * wifi["lat_p95_ms"], runs
+    assert event["retransmits"] > 5 * wifi["retransmits"], runs
+    return True
+
+
+def test_experiment_cells():
+    """Test 27: experiment cells isolate loopback ports, reach the host over
+    their veth pair, pin to their CPUs, and run whole SRTP runs on the same
+    ports side by side."""
+    _LOG.info("Test 27: Network-namespace experiment cells")
+    import os
+    import shutil
+    from stgen.experiment_cell import ExperimentCell, cells_available, run_in_cells
+
+    if not cells_available() or subprocess.run(["ip", "netns", "list"], capture_output=True).returncode:
+        _LOG.warning("No network namespaces here (need ip and root); skipped")
+        return True
+
+    echo = "import socket; s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM); " \
+           "s.bind(('0.0.0.0', 17800)); d, a = s.recvfrom(64); s.sendto(d + b'@' + a[0].encode(), a)"
+    pinned = "import os; print(sorted(os.sched_getaffinity(0)))"
+    cpu = sorted(os.sched_getaffinity(0))[0]
+    with ExperimentCell(0, [cpu]) as a, ExperimentCell(1, [cpu]) as b:
+        # the same port in both cells, and neither on the host's lo
+        servers = [cell.popen([sys.executable, "-c", echo]) for cell in (a, b)]
+        try:
+            time.sleep(0.5)
+            assert all(p.poll() is None for p in servers)
+            sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            sock.settimeout(2.0)
+            for cell in (a, b):
+                sock.sendto(b"ping", (cell.ip, 17800))
+                assert sock.recv(64) == f"ping@{cell.host_ip}".encode()
+            sock.close()
+        finally:
+            for p in servers:
+                p.kill()
+                p.wait()
+        out = a.run([sys.executable, "-c", pinned], capture_output=True, text=True, check=True)
+        assert out.stdout.strip() == str([cpu]), out.stdout
+        name = a.name
+        # left running in a session of its own: removing the cell kills it
+        stray = a.popen(["sleep", "60"], start_new_session=True)
+        time.sleep(0.2)
+    assert name not in subprocess.run(["ip", "netns", "list"], capture_output=True, text=True).stdout
+    assert stray.wait(timeout=5) == -9
+
+    cfg = json.loads((ROOT / "configs" / "srtp.json").read_text())
+    cfg.update(server_ip="127.0.0.1", duration=3, subscriber_host=True)
+    t0 = time.monotonic()
+    summaries = run_in_cells([cfg, dict(cfg, num_clients=2), dict(cfg, feeder=True)], max_cells=2, timeout=60)
+    took = time.monotonic() - t0
+    try:
+        assert all(summaries), summaries
+        assert [s["sent"] for s in summaries[:2]] == [12, 6], summaries
+        assert [s["recv"] for s in summaries[:2]] == [12, 6], summaries
+        # the feeder run counts what it sent as received, as send_data() does
+        assert summaries[2]["sent"] > 0 and summaries[2]["recv"] == summaries[2]["sent"], summaries
+        assert summaries[2]["loss"] == 0.0, summaries
+        assert took < 2 * 3 + 3 * 3, took            # two side by side, then the third
+    finally:
+        shutil.rmtree(ROOT / "results" / "cells", ignore_errors=True)
+    return True
+
+def test_lorawan_channel():
+    """Test 28: srtp_impair's LoRaWAN channel gives frames their time on air,
+    holds devices to their duty cycle, loses overlapping uplinks, and feeds
+    the airtime to EnergyModel."""
+    _LOG.info("Test 28: LoRaWAN channel model")
+    from stgen.energy_model import EnergyModel
+    from stgen.network_emulator import NetworkRelay
+
+    tmp = Path(tempfile.mkdtemp())
+
+    def relay_run(port, profile, devices, payload, wait):
+        (tmp / "lora.json").write_text(json.dumps(dict(latency_ms=0, lora_overhead=0, **profile)))
+        echo, echo_port = _udp_listener()
+        echo.settimeout(0.05)
+        relay = NetworkRelay(str(tmp / "lora.json"), port, echo_port).start()
+        socks = []
+        got = 0
+        try:
+            time.sleep(0.2)
+            for _ in range(devices):
+                socks.append(socket.socket(socket.AF_INET, socket.SOCK_DGRAM))
+                socks[-1].sendto(payload, ("127.0.0.1", port))
+            deadline = time.monotonic() + wait
+            while time.monotonic() < deadline:
+                try:
+                    echo.recvfrom(2048)
+                    got += 1
+                except socket.timeout:
+                    pass
+        finally:
+            stats = relay.stop()
+            echo.close()
+            for s in socks:
+                s.close()
+        return stats["lora"], got
+
+    # Semtech time on air: 20 bytes at SF7 56.576 ms, 51 at SF12 2465.792 ms
+    lora, got = relay_run(17620, {"lora_sf": 7}, 1, b"x" * 20, 0.3)
+    assert lora["uplinks"] == 1 and got == 1, lora
+    assert abs(lora["airtime_per_uplink_ms"] - 56.576) < 0.01, lora
+    lora, _ = relay_run(17621, {"lora_sf": 12}, 1, b"x" * 51, 0.1)
+    assert abs(lora["airtime_per_uplink_ms"] - 2465.792) < 0.01, lora
+
+    # one device, 1 % duty: a frame 5.6 s after the last is more than -Q allows
+    (tmp / "duty.json").write_text(json.dumps({"latency_ms": 0, "lora_sf": 7}))
+    echo, echo_port = _udp_listener()
+    relay = NetworkRelay(str(tmp / "duty.json"), 17622, echo_port).start()
+    client = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    try:
+        time.sleep(0.2)
+        for _ in range(3):
+            client.sendto(b"reading", ("127.0.0.1", 17622))
+        echo.recvfrom(64)
+        time.sleep(0.1)
+    finally:
+        stats = relay.stop()
+        echo.close()
+        client.close()
+    assert stats["lora"]["uplinks"] == 1 and stats["lora"]["duty_drops"] == 2, stats
+
+    # 40 devices at once on one channel and SF: pure ALOHA, next to nothing gets through
+    lora, got = relay_run(17623, {"lora_sf": 9, "lora_channels": 1}, 40, b"x" * 20, 0.5)
+    assert lora["devices"] == 40 and lora["uplinks"] == 40, lora
+    assert lora["collided"] >= 38 and got == 40 - lora["collided"], (lora, got)
+    # spread over 8 channels and SF7-12 (48 cells) some 40 (47/48)^39 = 17 do
+    lora, got = relay_run(17624, {"lora_sf": 0, "lora_channels": 8}, 40, b"x" * 20, 2.5)
+    assert lora["collided"] < 30 and got == 40 - lora["collided"], (lora, got)
+
+    model = EnergyModel()
+    measured = {"sent": 10, "lora_airtime": {"uplinks": 10, "airtime_per_uplink_ms": 1482.752}}
+    assert abs(model.tx_time_s(measured) - 1.482752) < 1e-9
+    assert model.tx_time_s({"sent": 10}) == EnergyModel.TIME_PER_TX_S
+    assert model.estimate_battery_life({}, measured, 60) < model.estimate_battery_life({}, {"sent": 10}, 60)
+    return True
+
+
+def run_all_tests():
+    """Run all test cases."""
+    print("\n" + "="*70)
+    print("  SRTP Protocol Plugin Test Suite")
+    print("="*70 + "\n")
+
+    tests = [
+        ("Import Test", test_import),
+        ("Sensor Frame Format Test", test_sensor_frame_format),
+        ("Feeder Synthetic Test", test_feeder_synthetic),
+        ("Feeder Schedule Test", test_feeder_schedule),
+        ("Shard Router Test", test_shard_router),
+        ("Ring Placement Test", test_ring_placement),
+        ("Subscriber Host Test", test_subscriber_host),
+        ("Subscriber Latency Test", test_subscriber_latency),
+        ("Subscriber Sack Test", test_subscriber_sack),
+        ("Egress Classes Test", test_egress_classes),
+        ("Camera Frames Test", test_camera_frames),
+        ("Router Stats Test", test_router_stats),
+        ("Fast Startup Test", test_fast_startup),
+        ("Simulated LoRaWAN Test", test_simulated_lorawan),
+        ("Router Batching Test", test_router_batching),
+        ("Trace Log Test", test_trace_logs),
+        ("Warm Restart Test", test_warm_restart),
+        ("Control Churn Test", test_control_churn),
+        ("Subscription Options Test", test_subscription_options),
+        ("Latest Value Cache Test", test_latest_value_cache),
+        ("Multicast Fan-out Test", test_multicast_fanout),
+        ("Header Compression Test", test_header_compression),
+        ("Impairment Relay Test", test_impairment_relay),
+        ("Burst Loss Test", test_burst_loss),
+        ("Network Mix Test", test_network_mix),
+        ("Trace Conditions Test", test_trace_conditions),
+        ("Experiment Cells Test", test_experiment_cells),
+        ("LoRaWAN Channel Test", test_lorawan_channel),
+    ]
+
+    results = []
+    for name, test_func in tests:
+        print(f"\n{'─'*70}")
+        try:
+            result = test_func()
+            results.append((name, result))
+        except Exception as e:
+            _LOG.exception("Test crashed: %s", e)
+            results.append((name, False))
+
+    # Summary
+    print(f"\n{'='*70}")
+    print("  TEST SUMMARY")
+    print("="*70)
+
+    passed = sum(1 for _, r in results if r)
+    total = len(results)
+
+    for name, result in results:
+        status = " PASS" if result else " FAIL"
+        print(f"  {status}  {name}")
+
+    print("─"*70)
+    print(f"  Results: {passed}/{total} tests passed ({(passed/total)*100:.1f}%)")
+    print("="*70 + "\n")
+    return passed == total
+
+
+if __name__ == "__main__":
+    sys.exit(0 if run_all_tests() else 1)